@@ -50,7 +50,7 @@ BHVApp::BHVApp(int width, int height)
 
 void BHVApp::renderContent() 
 {
-	double now = glfwGetTime();
+	double now = getTime();
 	dt_ = now - t0_;
 	t0_ = now;
 	tPassed_ += dt_;
@@ -58,7 +58,7 @@ void BHVApp::renderContent()
 
 	if (camOrbit_) {
 		calculateCameraOrbit();
-	} else {
+	} else if (!isReplaying()) {
 		cam_.keyBoardInput(window_.getPtr(), dt_);
 		cam_.mouseInput(window_.getPtr());
 	}
@@ -95,10 +95,13 @@ void BHVApp::renderContent()
 		workGroups.x = std::ceil(fboTexture_.getWidth() / (float)workGroups.x);
 		workGroups.y = std::ceil(fboTexture_.getHeight() / (float)workGroups.y);
 
+		profiler_->begin("blackHole");
 		glDispatchCompute(workGroups.x, workGroups.y, 1);
 		//glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		profiler_->end();
 
 		if (bloomEffect_) {
+			GpuProfiler::Scope scope(profiler_, "bloom");
 			bloomShader_->use();
 			for (int i = 0; i < bloomPasses_; ++i) {
 				int index = i % 2;
@@ -115,6 +118,7 @@ void BHVApp::renderContent()
 		bloomEffect_ = false;
 		uploadCameraVectors();
 
+		GpuProfiler::Scope scope(profiler_, "blackHole");
 		glBindFramebuffer(GL_FRAMEBUFFER, fboTexture_.getFboId());
 		glViewport(0, 0, fboTexture_.getWidth(), fboTexture_.getHeight());
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -123,6 +127,7 @@ void BHVApp::renderContent()
 
 	}
 
+	GpuProfiler::Scope scope(profiler_, "present");
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(0, 0, window_.getWidth(), window_.getHeight());
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -243,9 +248,14 @@ void BHVApp::renderGui() {
 				glfwSwapInterval((int)vSync_);
 
 			ImGui::Checkbox("Show FPS", &showFps_);
+			ImGui::Checkbox("Show GPU Profiler", &showProfiler_);
+			ImGui::Spacing();
+			recorder_.renderGui();
 			ImGui::Spacing();
 			if(showFps_)
 				renderFPSWindow();
+			if (showProfiler_)
+				profiler_->renderWindow(&showProfiler_);
 
 			ImGui::EndTabItem();
 		}
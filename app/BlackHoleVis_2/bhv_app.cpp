@@ -64,7 +64,7 @@ BHVApp::BHVApp(int width, int height)
 	, direction_(1,0,0)
 	, speed_(0.1f)
 	, disc_(std::make_shared<ParticleDiscGui>())
-	, noiseTexture_(std::make_shared<Texture2D>("ebruneton/noise_texture.png"))
+	, textureLoader_(std::make_shared<TextureLoader>(jobs_))
 	, fboTexture_(std::make_shared<FBOTexture>(width, height))
 	, fboScale_(1)
 	, bloom_(false)
@@ -76,6 +76,7 @@ BHVApp::BHVApp(int width, int height)
 	, showCamera_(false)
 {
 	showGui_ = true;
+	bloomEffect_.setProfiler(profiler_);
 	cam_.update(window_.getWidth(), window_.getHeight());
 	cam_.use(window_.getWidth(), window_.getHeight());
 	initShaders();
@@ -86,14 +87,16 @@ BHVApp::BHVApp(int width, int height)
 
 void BHVApp::renderContent() 
 {
-	double now = glfwGetTime();
+	double now = getTime();
 	dt_ = now - t0_;
 	t0_ = now;
 	tPassed_ += dt_;
 
+	textureLoader_->update();
+
 	if (camOrbit_) {
 		calculateCameraOrbit();
-	} else {
+	} else if (!isReplaying()) {
 		cam_.processInput(window_.getPtr(), dt_);
 	}
 
@@ -156,13 +159,16 @@ void BHVApp::renderContent()
 		glBindFramebuffer(GL_FRAMEBUFFER, fboTexture_->getFboId());
 		glViewport(0, 0, fboTexture_->getWidth(), fboTexture_->getHeight());
 	}
+	profiler_->begin("blackHole");
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	quad_.draw(GL_TRIANGLES);
+	profiler_->end();
 
 	if(bloom_)
 		bloomEffect_.render(fboTexture_->getFboId());
 	
+	GpuProfiler::Scope scope(profiler_, "present");
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(0, 0, window_.getWidth(), window_.getHeight());
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -184,7 +190,7 @@ void BHVApp::initShaders() {
 
 void BHVApp::initTextures() {
 
-	jetTexture_ = std::make_shared<Texture2D>("jet_noise.jpg");
+	jetTexture_ = textureLoader_->load("jet_noise.jpg").texture;
 	std::vector<std::pair<GLenum, GLint>> jettexParameters{
 		{GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE },
 		{GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE },
@@ -330,8 +336,8 @@ void BHVApp::initTextures() {
 		{GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR },
 		{GL_TEXTURE_MAG_FILTER, GL_LINEAR }
 	};
+	noiseTexture_ = textureLoader_->load("ebruneton/noise_texture.png", false, true).texture;
 	noiseTexture_->setParam(texParameters);
-	noiseTexture_->generateMipMap();
 }
 
 void BHVApp::initCubeMaps(){
@@ -344,7 +350,7 @@ void BHVApp::initCubeMaps(){
 		"milkyway2048/front.png",
 		"milkyway2048/back.png"
 	};
-	cubemaps_.push_back({ "Milky Way", std::make_shared<CubeMap>(mwPaths) });
+	cubemaps_.push_back({ "Milky Way", textureLoader_->loadCubeMap(mwPaths, true).texture });
 
 	std::vector<std::string> grid{
 		"gradient/right.png",
@@ -354,7 +360,7 @@ void BHVApp::initCubeMaps(){
 		"gradient/front.png",
 		"gradient/back.png"
 	};
-	cubemaps_.push_back({ "Gradient Grid", std::make_shared<CubeMap>(grid) });
+	cubemaps_.push_back({ "Gradient Grid", textureLoader_->loadCubeMap(grid, true).texture });
 
 	std::vector<std::string> bwgrid{
 		"grid/right.png",
@@ -364,15 +370,14 @@ void BHVApp::initCubeMaps(){
 		"grid/right.png",
 		"grid/right.png"
 	};
-	cubemaps_.push_back({ "Grid", std::make_shared<CubeMap>(bwgrid) });
+	cubemaps_.push_back({ "Grid", textureLoader_->loadCubeMap(bwgrid, true).texture });
 
 	std::vector<std::pair<GLenum, GLint>> texParametersi{
 		{GL_TEXTURE_MIN_FILTER, GL_LINEAR},
 		{GL_TEXTURE_MAG_FILTER, GL_LINEAR},
 	};
 	for (const auto& [name, map] : cubemaps_) {
-		// configure cubemap
-		map->generateMipMap();
+		// configure cubemap, the mip maps are generated after the upload
 		map->setParam(texParametersi);
 		map->setParam(GL_TEXTURE_MAX_ANISOTROPY, 1.0f);
 	}
@@ -383,8 +388,10 @@ void BHVApp::initCubeMaps(){
 
 void BHVApp::initScenes()
 {
-	environmentScenes_.insert({ "Solar System", std::make_shared<SolarSystemScene>(2048) });
+	environmentScenes_.insert({ "Solar System", std::make_shared<SolarSystemScene>(2048, textureLoader_) });
 	environmentScenes_.insert({ "Checker Sphere", std::make_shared<CheckerSphereScene>(2048) });
+	for (auto const& [name, scene] : environmentScenes_)
+		scene->setProfiler(profiler_);
 	currentEnvironmentScene_ = environmentScenes_["Solar System"];
 }
 
@@ -616,6 +623,8 @@ void BHVApp::renderGui() {
 
 	if (showFps_)
 		renderFPSWindow();
+	if (showProfiler_)
+		profiler_->renderWindow(&showProfiler_);
 
 	ImGui::Begin("Application Options");
 	if (ImGui::BeginTabBar("Options")) {
@@ -649,9 +658,12 @@ void BHVApp::renderGui() {
 				glfwSwapInterval((int)vSync_);
 
 			ImGui::Checkbox("Show FPS", &showFps_);
+			ImGui::Checkbox("Show GPU Profiler", &showProfiler_);
 			ImGui::Spacing();
 			if (ImGui::Button("Debug Print"))
 				printDebug();
+			ImGui::Separator();
+			recorder_.renderGui();
 			ImGui::EndTabItem();
 		}
 		if (ImGui::BeginTabItem("Shader Settings")) {
@@ -680,6 +692,7 @@ void BHVApp::renderGui() {
 				ImGui::SliderFloat("intensity", &bloomEffect_.intensity_, 0.f, 1.f);
 				ImGui::SliderFloat("exposure", &bloomEffect_.exposure_, 0.f, 10.f);
 				ImGui::Checkbox("High contrast", &bloomEffect_.highContrast_);
+				ImGui::Checkbox("Compute Shader", &bloomEffect_.compute_);
 			}
 			ImGui::EndTabItem();
 		}
@@ -822,8 +835,7 @@ void BHVApp::renderSceneTab()
 	}
 }
 
-void BHVApp::dumpState(std::string const& file) {
-	boost::json::object configuration;
+void BHVApp::storeState(boost::json::object& configuration) {
 	configuration["camOrbit"] = camOrbit_;
 	configuration["camOrbitTilt"] = camOrbitTilt_;
 	configuration["camOrbitRad"] = camOrbitRad_;
@@ -849,6 +861,43 @@ void BHVApp::dumpState(std::string const& file) {
 	boost::json::object bloomConfiguration;
 	bloomEffect_.storeConfig(bloomConfiguration);
 	configuration["bloomEffect"] = bloomConfiguration;
+}
+
+void BHVApp::loadState(boost::json::object& configuration) {
+	int fboScale = fboScale_;
+	jhelper::getValue(configuration, "camOrbit", camOrbit_);
+	jhelper::getValue(configuration, "camOrbitTilt", camOrbitTilt_);
+	jhelper::getValue(configuration, "camOrbitRad", camOrbitRad_);
+	jhelper::getValue(configuration, "camOrbitSpeed", camOrbitSpeed_);
+	jhelper::getValue(configuration, "camOrbitAngle", camOrbitAngle_);
+	jhelper::getValue(configuration, "aberration", aberration_);
+	jhelper::getValue(configuration, "fido", fido_);
+	jhelper::getValue(configuration, "useCustomDirection", useCustomDirection_);
+	jhelper::getValue(configuration, "useLocalDirection", useLocalDirection_);
+	jhelper::getValue(configuration, "speed", speed_);
+	jhelper::getValue(configuration, "fboScale", fboScale_);
+	jhelper::getValue(configuration, "bloom", bloom_);
+	jhelper::getValue(configuration, "direction", direction_);
+
+	boost::json::object discConfiguration;
+	if(jhelper::getValue(configuration, "disc", discConfiguration))
+		disc_->loadConfig(discConfiguration);
+
+	boost::json::object shaderConfiguration;
+	if(jhelper::getValue(configuration, "shader",shaderConfiguration))
+		shaderElement_->loadConfig(shaderConfiguration);
+
+	boost::json::object bloomConfiguration;
+	if(jhelper::getValue(configuration, "bloomEffect", bloomConfiguration))
+		bloomEffect_.loadConfig(bloomConfiguration);
+
+	if (fboScale != fboScale_)
+		resizeTextures();
+}
+
+void BHVApp::dumpState(std::string const& file) {
+	boost::json::object configuration;
+	storeState(configuration);
 
 	boost::json::object cameraConfiguration;
 	cam_.storeConfig(cameraConfiguration);
@@ -880,35 +929,11 @@ void BHVApp::readState(std::string const& file) {
 	}
 
 	boost::json::object configuration = v.get_object();
-	jhelper::getValue(configuration, "camOrbit", camOrbit_);
-	jhelper::getValue(configuration, "camOrbitTilt", camOrbitTilt_);
-	jhelper::getValue(configuration, "camOrbitRad", camOrbitRad_);
-	jhelper::getValue(configuration, "camOrbitSpeed", camOrbitSpeed_);
-	jhelper::getValue(configuration, "camOrbitAngle", camOrbitAngle_);
-	jhelper::getValue(configuration, "aberration", aberration_);
-	jhelper::getValue(configuration, "fido", fido_);
-	jhelper::getValue(configuration, "useCustomDirection", useCustomDirection_);
-	jhelper::getValue(configuration, "useLocalDirection", useLocalDirection_);
-	jhelper::getValue(configuration, "speed", speed_);
-	jhelper::getValue(configuration, "fboScale", fboScale_);
-	jhelper::getValue(configuration, "bloom", bloom_);
-	jhelper::getValue(configuration, "direction", direction_);
-
-	boost::json::object discConfiguration;
-	if(jhelper::getValue(configuration, "disc", discConfiguration))
-		disc_->loadConfig(discConfiguration);
-
-	boost::json::object shaderConfiguration;
-	if(jhelper::getValue(configuration, "shader",shaderConfiguration))
-		shaderElement_->loadConfig(shaderConfiguration);
-
-	boost::json::object bloomConfiguration;
-	if(jhelper::getValue(configuration, "bloomEffect", bloomConfiguration))
-		bloomEffect_.loadConfig(bloomConfiguration);
+	loadState(configuration);
 
 	boost::json::object cameraConfiguration;
 	if(jhelper::getValue(configuration, "camera", cameraConfiguration))
-		cam_.storeConfig(cameraConfiguration);
+		cam_.loadConfig(cameraConfiguration);
 
 	resizeTextures();
 	
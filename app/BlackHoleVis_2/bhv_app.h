@@ -10,6 +10,7 @@
 #include <rendering/schwarzschildCamera.h>
 #include <rendering/window.h>
 #include <rendering/texture.h>
+#include <rendering/textureLoader.h>
 #include <rendering/mesh.h>
 #include <rendering/bloom.h>
 #include <objects/blackHole.h>
@@ -32,6 +33,10 @@ private:
 	void renderContent() override;
 	void renderGui() override;
 	void processKeyboardInput() override;
+	void storeCamera(boost::json::object& obj) override { cam_.storeConfig(obj); }
+	void loadCamera(boost::json::object& obj) override { cam_.loadConfig(obj); }
+	void storeState(boost::json::object& obj) override;
+	void loadState(boost::json::object& obj) override;
 
 	SchwarzschildCamera cam_;
 	bool camOrbit_;
@@ -47,6 +52,8 @@ private:
 	float speed_;
 
 	std::shared_ptr<ParticleDiscGui> disc_;
+	// decodes image files in the background, the textures are placeholders until uploaded
+	std::shared_ptr<TextureLoader> textureLoader_;
 	std::shared_ptr<Texture2D> jetTexture_;
 	
 	std::vector<std::pair<std::string,std::shared_ptr<CubeMap>>> cubemaps_;
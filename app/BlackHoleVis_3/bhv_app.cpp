@@ -74,12 +74,13 @@ BHVApp::BHVApp(int width, int height)
 
 void BHVApp::renderContent() 
 {
-	double now = glfwGetTime();
+	double now = getTime();
 	dt_ = now - t0_;
 	t0_ = now;
 	tPassed_ += dt_;
 
-	cam_.processInput(window_.getPtr(), dt_);
+	if (!isReplaying())
+		cam_.processInput(window_.getPtr(), dt_);
 
 
 	if (window_.hasChanged()) {
@@ -134,12 +135,15 @@ void BHVApp::renderContent()
 	}
 
 
+	profiler_->begin("blackHole");
 	glBindFramebuffer(GL_FRAMEBUFFER, fboTexture_->getFboId());
 	glViewport(0, 0, fboTexture_->getWidth(), fboTexture_->getHeight());
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	quad_.draw(GL_TRIANGLES);
+	profiler_->end();
 
+	GpuProfiler::Scope scope(profiler_, "present");
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(0, 0, window_.getWidth(), window_.getHeight());
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -258,6 +262,8 @@ void BHVApp::renderGui() {
 
 	if (showFps_)
 		renderFPSWindow();
+	if (showProfiler_)
+		profiler_->renderWindow(&showProfiler_);
 
 	ImGui::Begin("Application Options");
 	if (ImGui::BeginTabBar("Options")) {
@@ -289,9 +295,12 @@ void BHVApp::renderGui() {
 				glfwSwapInterval((int)vSync_);
 
 			ImGui::Checkbox("Show FPS", &showFps_);
+			ImGui::Checkbox("Show GPU Profiler", &showProfiler_);
 			ImGui::Spacing();
 			if (ImGui::Button("Debug Print"))
 				printDebug();
+			ImGui::Separator();
+			recorder_.renderGui();
 			ImGui::EndTabItem();
 		}
 		if (ImGui::BeginTabItem("Shader Settings")) {
@@ -371,6 +380,24 @@ void BHVApp::renderCameraTab() {
 		cam_.setPosXYZ(camPos);
 }
 
+void BHVApp::storeState(boost::json::object& configuration) {
+	configuration["fboScale"] = fboScale_;
+	configuration["showBruneton"] = showBruneton_;
+	configuration["compareDeflection"] = compareDeflection_;
+	configuration["discSize"] = { discSize_.x, discSize_.y };
+}
+
+void BHVApp::loadState(boost::json::object& configuration) {
+	int fboScale = fboScale_;
+	jhelper::getValue(configuration, "fboScale", fboScale_);
+	jhelper::getValue(configuration, "showBruneton", showBruneton_);
+	jhelper::getValue(configuration, "compareDeflection", compareDeflection_);
+	jhelper::getValue(configuration, "discSize", discSize_);
+
+	if (fboScale != fboScale_)
+		resizeTextures();
+}
+
 void BHVApp::dumpState(std::string const& file) {
 	
 	return;
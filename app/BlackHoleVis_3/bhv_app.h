@@ -27,6 +27,10 @@ private:
 	void renderContent() override;
 	void renderGui() override;
 	void processKeyboardInput() override;
+	void storeCamera(boost::json::object& obj) override { cam_.storeConfig(obj); }
+	void loadCamera(boost::json::object& obj) override { cam_.loadConfig(obj); }
+	void storeState(boost::json::object& obj) override;
+	void loadState(boost::json::object& obj) override;
 
 	SchwarzschildCamera cam_;
 	std::shared_ptr<CubeMap> panoramaGrid_;
@@ -0,0 +1,120 @@
+#include <rendering/window.h>
+#include <rendering/shader.h>
+#include <rendering/texture.h>
+#include <rendering/buffers.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Runs bloom_downsample.comp (the compute path of Bloom) on an offscreen context and compares
+// every level with a CPU 2x2 box chain. Returns 1 if the shader doesn't build or a level differs,
+// 77 (skipped) if there is no GL 4.5 context. Usage: BloomComputeTest_main
+
+// levels like Bloom::initLevels
+static std::vector<glm::ivec2> levelSizes(int width, int height, int maxLevels = 9)
+{
+	std::vector<glm::ivec2> sizes;
+	while (height > 2 && width > 2 && (int)sizes.size() < maxLevels) {
+		sizes.push_back({ width, height });
+		width /= 2;
+		height /= 2;
+	}
+	return sizes;
+}
+
+static bool checkDownsample(ShaderBase& shader, int width, int height)
+{
+	std::vector<glm::ivec2> sizes = levelSizes(width, height);
+	int levels = (int)sizes.size();
+
+	std::vector<float> pixels((size_t)width * height * 4);
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pixels[i] = (float)((i * 7919) % 1000) / 100.f;
+
+	FBOTexture source(width, height);
+	// allocates the levels
+	source.generateMipMap();
+	glTextureSubImage2D(source.getTexId(), 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, pixels.data());
+	// sampler of Bloom::initFBOS
+	std::vector<std::pair<GLenum, GLint>> texParameters{
+			{GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE},
+			{GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE},
+			{GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR},
+			{GL_TEXTURE_MAG_FILTER, GL_LINEAR}
+	};
+	source.setParam(texParameters);
+	unsigned int zero = 0;
+	SSBO counter(sizeof(unsigned int), &zero, GL_DYNAMIC_COPY);
+
+	// same bindings as Bloom::renderCompute, twice to check that the counter is reset
+	glActiveTexture(GL_TEXTURE0);
+	source.bind();
+	for (int i = 1; i < levels; ++i)
+		glBindImageTexture(i - 1, source.getTexId(), i, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	counter.bindBase(0);
+	shader.use();
+	shader.setUniform("levels", levels - 1);
+	shader.setUniform("texDim", glm::vec2(width, height));
+	for (int run = 0; run < 2; ++run) {
+		glDispatchCompute((sizes[1].x + 31) / 32, (sizes[1].y + 31) / 32, 1);
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	}
+
+	bool ok = true;
+	std::vector<float> fine = pixels;
+	for (int level = 1; level < levels; ++level) {
+		glm::ivec2 fineSize = sizes[level - 1], size = sizes[level];
+		std::vector<float> expected((size_t)size.x * size.y * 4);
+		for (int y = 0; y < size.y; ++y) {
+			for (int x = 0; x < size.x; ++x) {
+				for (int c = 0; c < 4; ++c) {
+					auto at = [&](int dx, int dy) { return fine[((size_t)(2 * y + dy) * fineSize.x + 2 * x + dx) * 4 + c]; };
+					expected[((size_t)y * size.x + x) * 4 + c] = 0.25f * (at(0, 0) + at(1, 0) + at(0, 1) + at(1, 1));
+				}
+			}
+		}
+
+		std::vector<float> result(expected.size());
+		glGetTextureImage(source.getTexId(), level, GL_RGBA, GL_FLOAT, (GLsizei)(result.size() * sizeof(float)), result.data());
+		float maxError = 0.f;
+		for (size_t i = 0; i < result.size(); ++i)
+			maxError = std::max(maxError, std::abs(result[i] - expected[i]));
+		// level 1 is fetched bilinearly, texture units quantize the weights (values are up to 10)
+		if (maxError > 1e-2f) {
+			std::cerr << "[BloomComputeTest] " << width << "x" << height << " level " << level
+				<< " differs by " << maxError << std::endl;
+			ok = false;
+		}
+		fine = expected;
+	}
+	std::cout << "[BloomComputeTest] " << width << "x" << height << ", " << levels << " levels"
+		<< (ok ? " match" : " differ") << std::endl;
+	return ok;
+}
+
+int main() {
+	glfwInit();
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLWindow window(64, 64, "BloomComputeTest");
+	if (!window.getPtr()) {
+		std::cout << "[BloomComputeTest] no GL context, skipped" << std::endl;
+		return 77;
+	}
+
+	ComputeShader shader("bloom_downsample.comp");
+	if (shader.getID() == 0) {
+		std::cerr << "[BloomComputeTest] bloom_downsample.comp doesn't build" << std::endl;
+		return 1;
+	}
+
+	bool ok = true;
+	// more than 6 levels use the last workgroup, odd sizes leave partial tiles
+	for (glm::ivec2 size : { glm::ivec2(1024, 512), glm::ivec2(640, 360), glm::ivec2(100, 60) })
+		ok = checkDownsample(shader, size.x, size.y) && ok;
+
+	if (!ok) return 1;
+	std::cout << "[BloomComputeTest] passed" << std::endl;
+	return 0;
+}
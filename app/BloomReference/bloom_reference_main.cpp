@@ -0,0 +1,60 @@
+#include <rendering/bloomCPU.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Applies the CPU bloom chain (same as Bloom) to an HDR image and reports the throughput.
+// Usage: BloomReference_main <input.hdr> [output.png] [repetitions] [threads] [intensity] [exposure]
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cout << "Usage: " << argv[0] << " <input.hdr> [output.png] [repetitions] [threads] [intensity] [exposure]" << std::endl;
+		return 1;
+	}
+
+	std::string input = argv[1];
+	std::string output = argc > 2 ? argv[2] : "";
+	int reps = argc > 3 ? std::max(1, std::stoi(argv[3])) : 5;
+	int threads = argc > 4 ? std::stoi(argv[4]) : 0;
+
+	int width, height, components;
+	float* data = stbi_loadf(input.c_str(), &width, &height, &components, 4);
+	if (!data) {
+		std::cerr << "[BloomReference] failed to load " << input << std::endl;
+		return 1;
+	}
+	std::vector<float> source(data, data + (size_t)width * height * 4);
+	stbi_image_free(data);
+
+	BloomCPU bloom(9, threads);
+	if (argc > 5) bloom.intensity_ = std::stof(argv[5]);
+	if (argc > 6) bloom.exposure_ = std::stof(argv[6]);
+
+	// the first run allocates the levels
+	std::vector<float> result = bloom.render(source, width, height);
+	double best = bloom.getRenderTime();
+	for (int r = 1; r < reps; ++r) {
+		result = bloom.render(source, width, height);
+		best = std::min(best, bloom.getRenderTime());
+	}
+
+	std::cout << "[BloomReference] " << width << "x" << height << ", " << bloom.getLevel() << " levels" << std::endl;
+	std::cout << "[BloomReference] best of " << reps << ": " << best << "ms, "
+		<< (double)width * height / (best * 1e3) << " MPixel/s" << std::endl;
+
+	if (!output.empty()) {
+		std::vector<unsigned char> pixels(result.size());
+		for (size_t i = 0; i < result.size(); ++i)
+			pixels[i] = (unsigned char)(std::clamp(result[i], 0.f, 1.f) * 255.f + 0.5f);
+		if (!stbi_write_png(output.c_str(), width, height, 4, pixels.data(), width * 4))
+			std::cerr << "[BloomReference] failed to write " << output << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include <blacktracer/CompactGrid.h>
+#include <blacktracer/Grid.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Encodes a traced grid and a copy that only keeps the hash (like a grid loaded from file) as
+// 16 bit tables and checks the decoded points of each level against the error bound.
+// Returns 1 if a level exceeds it. Usage: CompactGridTest_main [max level]
+
+static bool check(std::string const& name, CompactGrid const& compact, Grid const& reference)
+{
+	if (compact.empty()) {
+		std::cerr << "[CompactGridTest] " << name << ": no tables" << std::endl;
+		return false;
+	}
+	// measureError skips points that aren't decoded
+	FlatHashMap<glm::vec2> decoded;
+	compact.decode(decoded);
+	size_t missing = 0;
+	for (auto const& [ij, thphi] : reference.CamToCel)
+		missing += decoded.find(ij) == decoded.end();
+	bool ok = missing == 0;
+	if (missing) std::cerr << "[CompactGridTest] " << name << ": " << missing << " points not decoded" << std::endl;
+
+	glm::dvec2 bound = CompactGrid::getErrorBound();
+	std::vector<glm::dvec2> errors = compact.measureError(reference);
+	for (int level = 0; level < (int)errors.size(); ++level) {
+		glm::dvec2 error = errors[level];
+		bool levelOk = error.x <= bound.x && error.y <= bound.y;
+		std::cout << "[CompactGridTest] " << name << " level " << level << ": theta " << error.x
+			<< ", phi " << error.y << (levelOk ? "" : "  exceeds the bound") << std::endl;
+		ok = ok && levelOk;
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+
+	GridProperties props;
+	props.grid_maxLvl_ = argc > 1 ? std::stoi(argv[1]) : 8;
+	props.blackHole_a_ = 0.9;
+	props.cam_vel_ = 0.3;
+	props.cam_the_ = PI1_2 - 0.2;
+
+	Grid traced(props);
+	traced.saveAsGpuHash();
+	if (traced.hasher.n == 0) {
+		std::cerr << "[CompactGridTest] the grid has no hash" << std::endl;
+		return 1;
+	}
+	glm::dvec2 bound = CompactGrid::getErrorBound();
+	std::cout << "[CompactGridTest] " << traced.CamToCel.size() << " points, bound theta " << bound.x
+		<< ", phi " << bound.y << std::endl;
+
+	bool ok = check("traced", CompactGrid(traced), traced);
+
+	// encoded from the float values of the hash (Grid::loadFromFile keeps no CamToCel)
+	Grid hashOnly = traced;
+	hashOnly.CamToCel.clear();
+	CompactGrid fromHash(hashOnly);
+	ok = check("hash only", fromHash, traced) && ok;
+
+	if (!ok) return 1;
+	std::cout << "[CompactGridTest] passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <cubeMapScene/CubeMapScheduler.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Checks which faces CubeMapScheduler renders for scripted object movements. Returns 1 if a check fails.
+// Usage: CubeMapSchedulerTest_main
+
+static int failures = 0;
+
+static void check(bool ok, std::string const& what)
+{
+	if (!ok) {
+		std::cerr << "[CubeMapSchedulerTest] failed: " << what << std::endl;
+		failures++;
+	}
+}
+
+static std::vector<unsigned int> allFaces() { return { 0, 1, 2, 3, 4, 5 }; }
+
+static glm::mat4 at(glm::vec3 pos, float scale = 1.f)
+{
+	glm::mat4 model(scale);
+	model[3] = glm::vec4(pos, 1.f);
+	return model;
+}
+
+int main() {
+	glm::vec3 cam(0.f);
+
+	// static scene: every face once, then nothing
+	{
+		CubeMapScheduler scheduler(2, 1e-3f);
+		std::vector<glm::mat4> models = { at(glm::vec3(10.f, 0.f, 0.f)) };
+		check(scheduler.schedule(cam, models) == allFaces(), "first frame renders all faces");
+		for (int frame = 0; frame < 3; ++frame)
+			check(scheduler.schedule(cam, models).empty(), "static scene renders no faces");
+		check(scheduler.getLastUpdateCount() == 0, "static scene update count");
+
+		scheduler.invalidate();
+		check(scheduler.schedule(cam, models) == allFaces(), "invalidate renders all faces");
+		check(scheduler.schedule(cam, models).empty(), "no faces after invalidated frame");
+
+		models.push_back(at(glm::vec3(0.f, 10.f, 0.f)));
+		check(scheduler.schedule(cam, models) == allFaces(), "new object renders all faces");
+	}
+
+	// threshold: a small object at distance 10 in +x only touches face 0
+	{
+		CubeMapScheduler scheduler(2, 1e-3f);
+		scheduler.schedule(cam, { at(glm::vec3(10.f, 0.f, 0.f), 0.1f) });
+		// moves by about 5e-4 radians
+		check(scheduler.schedule(cam, { at(glm::vec3(10.f, 0.005f, 0.f), 0.1f) }).empty(), "move below threshold");
+		// the error is measured against the view of the last rendered frame, not the last frame
+		auto faces = scheduler.schedule(cam, { at(glm::vec3(10.f, 0.015f, 0.f), 0.1f) });
+		check(faces == std::vector<unsigned int>{ 0 }, "move above threshold renders the touched face");
+		check(scheduler.getError(1) == 0.f, "untouched face has no error");
+
+		scheduler.setThreshold(0.1f);
+		check(scheduler.schedule(cam, { at(glm::vec3(10.f, 0.5f, 0.f), 0.1f) }).empty(), "raised threshold");
+		check(scheduler.getError(0) > 0.f && scheduler.getError(0) <= 0.1f, "error below raised threshold");
+	}
+
+	// budget and order: the camera is inside the object, every face shows it
+	{
+		CubeMapScheduler scheduler(2, 1e-3f);
+		scheduler.schedule(cam, { at(glm::vec3(0.5f, 0.f, 0.f)) });
+
+		// each position is at the same angle from all earlier ones, so every face has the same error
+		// and only the frame a face was rendered last decides
+		glm::vec3 positions[3] = { glm::vec3(0.f, 0.5f, 0.f), glm::vec3(0.f, 0.f, 0.5f), glm::vec3(-0.5f) };
+		std::vector<glm::mat4> moved;
+		std::vector<unsigned int> rendered;
+		for (glm::vec3 pos : positions) {
+			moved = { at(pos) };
+			auto faces = scheduler.schedule(cam, moved);
+			check(faces.size() == 2, "face budget per frame");
+			for (unsigned int f : faces) {
+				check(std::find(rendered.begin(), rendered.end(), f) == rendered.end(), "faces waiting longer go first");
+				rendered.push_back(f);
+			}
+		}
+		// the 4 faces rendered at earlier positions are behind now
+		check(scheduler.schedule(cam, moved).size() == 2 && scheduler.schedule(cam, moved).size() == 2, "stale faces within the budget");
+		check(scheduler.schedule(cam, moved).empty(), "all faces caught up");
+
+		scheduler.setFacesPerFrame(10);
+		check(scheduler.getFacesPerFrame() == 6, "face budget is clamped");
+		check(scheduler.schedule(cam, { at(glm::vec3(0.f, 0.f, 0.5f)) }).size() == 6, "budget of 6 renders all dirty faces");
+	}
+
+	// highest error first: object in +x moves more than object in +y
+	{
+		CubeMapScheduler scheduler(1, 1e-3f);
+		scheduler.schedule(cam, { at(glm::vec3(10.f, 0.f, 0.f), 0.1f), at(glm::vec3(0.f, 10.f, 0.f), 0.1f) });
+		std::vector<glm::mat4> moved = { at(glm::vec3(10.f, 0.f, 0.5f), 0.1f), at(glm::vec3(0.f, 10.f, 0.1f), 0.1f) };
+		check(scheduler.schedule(cam, moved) == std::vector<unsigned int>{ 0 }, "highest error face first");
+		check(scheduler.schedule(cam, moved) == std::vector<unsigned int>{ 2 }, "next face in the following frame");
+		check(scheduler.schedule(cam, moved).empty(), "both faces caught up");
+	}
+
+	if (failures) {
+		std::cerr << "[CubeMapSchedulerTest] " << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "[CubeMapSchedulerTest] passed" << std::endl;
+	return 0;
+}
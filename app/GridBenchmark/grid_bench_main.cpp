@@ -0,0 +1,116 @@
+#include <blacktracer/Grid.h>
+#include <blacktracer/FlatHashMap.h>
+#include <helpers/Timer.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+// Microbenchmark of the containers for the grid maps (Grid::CamToCel, Grid::blockLevels)
+// on the keys of a real grid. Usage: GridBenchmark_main [max level] [repetitions]
+
+struct Results {
+	double insert, hit, neighbour, iterate;
+	size_t found;	// keeps the lookups from being optimized away
+};
+
+template <typename Map>
+Results run(std::vector<uint64_t> const& keys, std::vector<glm::dvec2> const& values,
+	std::vector<uint64_t> const& shuffled, std::vector<uint64_t> const& neighbours, int reps)
+{
+	Results res{};
+	Timer tim;
+
+	Map map;
+	tim.start("insert");
+	for (size_t k = 0; k < keys.size(); ++k)
+		map[keys[k]] = values[k];
+	tim.end();
+	res.insert = tim.getLast();
+
+	// random access to existing keys, like fixTvertices and refineCheck
+	tim.start("hit");
+	for (int r = 0; r < reps; ++r) {
+		for (uint64_t key : shuffled) {
+			auto it = map.find(key);
+			res.found += it->second.x >= 0.0;
+		}
+	}
+	tim.end();
+	res.hit = tim.getLast();
+
+	// neighbours of grid points, about half of them are not in the grid (findCel, checkAdjacentBlock)
+	tim.start("neighbour");
+	for (int r = 0; r < reps; ++r) {
+		for (uint64_t key : neighbours) {
+			auto it = map.find(key);
+			if (it != map.end()) res.found++;
+		}
+	}
+	tim.end();
+	res.neighbour = tim.getLast();
+
+	tim.start("iterate");
+	for (int r = 0; r < reps; ++r) {
+		for (auto entry : map)
+			res.found += entry.second.x >= 0.0;
+	}
+	tim.end();
+	res.iterate = tim.getLast();
+
+	return res;
+}
+
+void print(std::string const& name, Results const& res, size_t n, int reps) {
+	auto ns = [](double s, size_t count) { return s * 1e9 / count; };
+	std::cout << std::setw(32) << name << std::fixed << std::setprecision(2)
+		<< std::setw(12) << ns(res.insert, n)
+		<< std::setw(12) << ns(res.hit, n * reps)
+		<< std::setw(12) << ns(res.neighbour, n * reps)
+		<< std::setw(12) << ns(res.iterate, n * reps)
+		<< "    (" << res.found << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+	GridProperties props;
+	props.grid_maxLvl_ = argc > 1 ? std::stoi(argv[1]) : 9;
+	int reps = argc > 2 ? std::stoi(argv[2]) : 10;
+	props.blackHole_a_ = 0.9;
+	props.cam_the_ = 1.3;	// not symmetric
+	props.cam_vel_ = 0.2;
+
+	std::cout << "Computing grid with max level " << props.grid_maxLvl_ << "..." << std::endl;
+	auto grid = std::make_shared<Grid>(props);
+
+	std::vector<uint64_t> keys;
+	std::vector<glm::dvec2> values;
+	for (auto entry : grid->CamToCel) {
+		keys.push_back(entry.first);
+		values.push_back(entry.second);
+	}
+
+	std::mt19937_64 rng(42);
+	std::vector<uint64_t> shuffled = keys;
+	std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+	std::vector<uint64_t> neighbours;
+	for (uint64_t ij : shuffled) {
+		uint64_t i = ij >> 32, j = ij & 0xffffffff;
+		neighbours.push_back((i + 1) << 32 | j);
+		neighbours.push_back(i << 32 | (j + 1));
+	}
+	neighbours.resize(shuffled.size());
+
+	std::cout << keys.size() << " grid points, " << reps << " repetitions, ns per operation" << std::endl;
+	std::cout << std::setw(32) << "container" << std::setw(12) << "insert" << std::setw(12) << "hit"
+		<< std::setw(12) << "neighbour" << std::setw(12) << "iterate" << std::endl;
+
+	print("unordered_map (std::hash)", run<std::unordered_map<uint64_t, glm::dvec2>>(keys, values, shuffled, neighbours, reps), keys.size(), reps);
+	print("unordered_map (splitmix)", run<std::unordered_map<uint64_t, glm::dvec2, SplitMix64>>(keys, values, shuffled, neighbours, reps), keys.size(), reps);
+	print("FlatHashMap (splitmix)", run<FlatHashMap<glm::dvec2>>(keys, values, shuffled, neighbours, reps), keys.size(), reps);
+
+	return 0;
+}
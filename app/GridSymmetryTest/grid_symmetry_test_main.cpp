@@ -0,0 +1,112 @@
+#include <blacktracer/Grid.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+// Traces an equatorial grid with and without grid_useSymmetry_ and checks that the symmetric grid
+// mirrored at the equator matches the full trace. Returns 1 if a point differs.
+// Usage: GridSymmetryTest_main [max level] [tolerance]
+
+static uint64_t key(int64_t i, int64_t j) { return (uint64_t)i << 32 | (uint64_t)j; }
+
+// Points on the edges of leaf blocks that aren't block corners, these are interpolated by
+// fixTvertices from the corners and depend on the neighbouring blocks of each grid.
+static std::unordered_set<uint64_t> getTvertices(Grid const& grid)
+{
+	std::unordered_set<uint64_t> tvertices;
+	for (auto const& [ij, level] : grid.blockLevels) {
+		int64_t gap = (int64_t)1 << (grid.MAXLEVEL_ - level);
+		int64_t i = ij >> 32;
+		int64_t j = (uint32_t)ij;
+		for (int64_t k = 1; k < gap; ++k) {
+			uint64_t edges[4] = { key(i + k, j), key(i + k, (j + gap) % grid.M_), key(i, j + k), key(i + gap, j + k) };
+			for (uint64_t edge : edges)
+				if (grid.CamToCel.find(edge) != grid.CamToCel.end())
+					tvertices.insert(edge);
+		}
+	}
+	return tvertices;
+}
+
+static double distance(glm::dvec2 a, glm::dvec2 b)
+{
+	double dphi = std::abs(a.y - b.y);
+	return std::max(std::abs(a.x - b.x), std::min(dphi, PI2 - dphi));
+}
+
+int main(int argc, char** argv) {
+
+	GridProperties props;
+	props.grid_maxLvl_ = argc > 1 ? std::stoi(argv[1]) : 7;
+	double tolerance = argc > 2 ? std::stod(argv[2]) : 1e-6;
+	props.blackHole_a_ = 0.9;
+	props.cam_vel_ = 0.3;
+	props.cam_the_ = PI1_2;
+
+	props.grid_useSymmetry_ = true;
+	Grid sym(props);
+	props.grid_useSymmetry_ = false;
+	Grid full(props);
+
+	std::cout << "[GridSymmetryTest] level " << props.grid_maxLvl_ << ", symmetric " << sym.getRayCount()
+		<< " rays, full " << full.getRayCount() << " rays" << std::endl;
+	if (sym.equafactor_ || !full.equafactor_ || sym.getFullN() != full.N_ || sym.M_ != full.M_) {
+		std::cerr << "[GridSymmetryTest] grids have different sizes" << std::endl;
+		return 1;
+	}
+
+	auto fullTvertices = getTvertices(full);
+	auto symTvertices = getTvertices(sym);
+	int64_t equator = sym.N_ - 1;
+
+	size_t compared = 0, missing = 0, skipped = 0, failed = 0;
+	double maxError = 0.0;
+	for (auto const& [ij, thphi] : full.CamToCel) {
+		int64_t i = ij >> 32;
+		int64_t j = (uint32_t)ij;
+		int64_t symI = i > equator ? 2 * equator - i : i;
+
+		glm::dvec2 symThphi, mirrorThphi;
+		if (!sym.findCel(i, j, symThphi)) {
+			missing++;
+			continue;
+		}
+		if (fullTvertices.count(ij) || symTvertices.count(key(symI, j))) {
+			skipped++;
+			continue;
+		}
+		// shadow border: one of the rays falls into the black hole
+		if (!(thphi.x >= 0.0) || !(symThphi.x >= 0.0)) {
+			if ((thphi.x >= 0.0) != (symThphi.x >= 0.0))
+				skipped++;
+			continue;
+		}
+		// rays close to the photon orbits are chaotic, the full trace already differs from its own
+		// mirror image there because theta of a point and its mirror point differ by rounding
+		if (full.findCel(2 * equator - i, j, mirrorThphi) && (!(mirrorThphi.x >= 0.0)
+			|| distance(thphi, glm::dvec2(PI - mirrorThphi.x, mirrorThphi.y)) > tolerance)) {
+			skipped++;
+			continue;
+		}
+
+		double error = distance(thphi, symThphi);
+		maxError = std::max(maxError, error);
+		compared++;
+		if (error > tolerance) {
+			if (failed++ < 10)
+				std::cerr << "[GridSymmetryTest] point (" << i << ", " << j << ") differs by " << error << std::endl;
+		}
+	}
+
+	std::cout << "[GridSymmetryTest] compared " << compared << " points, skipped " << skipped
+		<< " (t-vertices, shadow border, chaotic rays), max error " << maxError << std::endl;
+	// the refinement of the chaotic regions can differ as well, but only for a few blocks
+	std::cout << "[GridSymmetryTest] " << missing << " points of the full grid aren't in the symmetric grid" << std::endl;
+	if (failed) std::cerr << "[GridSymmetryTest] " << failed << " points differ" << std::endl;
+	if (failed || missing > full.CamToCel.size() / 100 || compared < full.CamToCel.size() / 2) return 1;
+	std::cout << "[GridSymmetryTest] passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include "frameWriter.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+FrameWriter::FrameWriter(std::string const& directory, size_t maxQueued)
+	: directory_(directory)
+	, maxQueued_(std::max<size_t>(1, maxQueued))
+	, written_(0)
+	, failed_(0)
+	, stop_(false)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory_, error);
+	if (error)
+		std::cerr << "[FrameWriter] can't create " << directory_ << ": " << error.message() << std::endl;
+	thread_ = std::thread(&FrameWriter::writeLoop, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	imageQueued_.notify_all();
+	thread_.join();
+}
+
+void FrameWriter::push(int frame, int width, int height, std::vector<uint8_t>&& pixels)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	imageWritten_.wait(lock, [this]() { return queue_.size() < maxQueued_; });
+	queue_.push_back(Image{ frame, width, height, std::move(pixels) });
+	imageQueued_.notify_one();
+}
+
+size_t FrameWriter::getWrittenCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return written_;
+}
+
+size_t FrameWriter::getFailedCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return failed_;
+}
+
+void FrameWriter::writeLoop()
+{
+	stbi_flip_vertically_on_write(1);
+	while (true) {
+		Image image;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			imageQueued_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+			// the queue is drained before stopping
+			if (queue_.empty()) return;
+			image = std::move(queue_.front());
+			queue_.pop_front();
+		}
+		imageWritten_.notify_one();
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame_%05d.png", image.frame);
+		std::string path = (std::filesystem::path(directory_) / name).string();
+		bool success = stbi_write_png(path.c_str(), image.width, image.height, 4, image.pixels.data(), image.width * 4) != 0;
+		if (!success)
+			std::cerr << "[FrameWriter] can't write " << path << std::endl;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (success) ++written_;
+		else ++failed_;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Writes rendered frames as numbered PNG files (<directory>/frame_00000.png, ...) on a
+/// background thread. The queue is bounded, push blocks while it is full so the renderer
+/// can't run away from the disk.
+/// </summary>
+class FrameWriter {
+public:
+	FrameWriter(std::string const& directory, size_t maxQueued = 4);
+	// writes the queued frames before returning
+	~FrameWriter();
+
+	FrameWriter(FrameWriter const&) = delete;
+	FrameWriter& operator=(FrameWriter const&) = delete;
+
+	// RGBA8 pixels, bottom row first as read by glReadPixels
+	void push(int frame, int width, int height, std::vector<uint8_t>&& pixels);
+
+	size_t getWrittenCount() const;
+	size_t getFailedCount() const;
+	std::string const& getDirectory() const { return directory_; }
+
+private:
+	struct Image {
+		int frame;
+		int width, height;
+		std::vector<uint8_t> pixels;
+	};
+
+	std::string directory_;
+	size_t maxQueued_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable imageQueued_;
+	std::condition_variable imageWritten_;
+	std::deque<Image> queue_;
+	size_t written_;
+	size_t failed_;
+	bool stop_;
+	std::thread thread_;
+
+	void writeLoop();
+};
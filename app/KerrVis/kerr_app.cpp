@@ -4,6 +4,7 @@
 #include <gui/gui_helpers.h>
 
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <format>
 #include <fstream>
@@ -56,13 +57,32 @@ KerrApp::KerrApp(int width, int height)
 	: GLApp(width, height, "Black Hole Vis")
 	, mode_(RenderMode::SKY)
 	, cam_({ 0.f, 0.f, -10.f })
+	, textureLoader_(std::make_shared<TextureLoader>(jobs_))
 	, fboTexture_(std::make_shared<FBOTexture>(width, height))
 	, gpuGrid_(std::make_shared<FBOTexture>(1, 1))
 	, interpolatedGrid_(std::make_shared<FBOTexture>(1, 1))
 	, fboScale_(1)
 	, compute_(false)
-	, gridChange_(false)
+	, compactTables_(false)
+	, currentGridID_(0)
+	, gridPreview_(true)
+	, densePolicy_(std::make_shared<DenseGridPolicy>())
+	, densePhiShift_(0.f)
 	, makeNewGrid_(false)
+	, blendGridID_(-1)
+	, blendWeight_(0.f)
+	, blendedGrid_(std::make_shared<FBOTexture>(1, 1))
+	, phiShift_(0.f)
+	, autoGrid_(false)
+	, gridRequested_(false)
+	, errorMap_(std::make_shared<FBOTexture>(1, 1))
+	, referenceQuality_(false)
+	, referenceUploaded_(false)
+	, animationTexture_(std::make_shared<FBOTexture>(1, 1))
+	, animationFrame_(0)
+	, animationName_("animation")
+	, animationLookAhead_(4)
+	, animationSaveGrids_(false)
 	, aberration_(false)
 	, direction_(1.f, 0.f, 0.f)
 	, speed_(0.5f)
@@ -81,37 +101,25 @@ KerrApp::KerrApp(int width, int height)
 	resizeTextures();
 	initTestSSBO();
 
+	// lattice of the deployment, defaults if there is none
+	if (std::filesystem::exists(ROOT_DIR "resources/grid_quantization.json"))
+		quantizer_.load(ROOT_DIR "resources/grid_quantization.json");
+
 	// init first grid twice because first execution
 	// always fails for some reason
 	GridProperties tmpProps;
 	tmpProps.grid_maxLvl_ = 1;
-	grid_ = std::make_shared<Grid>(tmpProps);
-	resizeGridTextures();
-	initMakeGridSSBO();
-	makeNewGrid_ = true;
-	initPerformanceQueries();
+	addResidentGrid(std::make_shared<Grid>(tmpProps));
 }
 
 void KerrApp::renderContent() 
 {
-	double now = glfwGetTime();
+	double now = getTime();
 	dt_ = now - t0_;
 	t0_ = now;
 	tPassed_ += dt_;
 
-	if (gridChange_) {
-		grid_ = newGrid_;
-		newGrid_ = nullptr;
-		std::cout << "Grid changed!" << std::endl;
-		joinGridThread();
-		resizeGridTextures();
-		initMakeGridSSBO();
-		gridChange_ = false;
-		makeNewGrid_ = true;
-		gridDone_ = true;
-	}
-
-	cam_.processInput(window_.getPtr(), dt_);
+	bool captureFrame = isAnimating() && prepareAnimationFrame();
 
 	if (renderEnvironment_) {
 		currentEnvironmentScene_->render(cam_.getPositionXYZ(), dt_);
@@ -161,7 +169,6 @@ void KerrApp::renderContent()
 		if (makeNewGrid_ || modePerformance_) {
 
 			gpuMakeGrid(true);
-			std::swap(queryFrontBuffer_, queryBackBuffer_);
 			makeNewGrid_ = false;
 		}
 
@@ -172,21 +179,28 @@ void KerrApp::renderContent()
 
 			gpuMakeGrid(false);
 			gpuInterpolate(true);
-			std::swap(queryFrontBuffer_, queryBackBuffer_);
 			makeNewGrid_ = false;
 		}
 
 		fbo = interpolatedGrid_;
 		break;
+	case KerrApp::RenderMode::ERRORMAP:
+		fbo = errorMap_;
+		break;
 	case KerrApp::RenderMode::RENDER:
-		if (makeNewGrid_ || modePerformance_) {
+		if (referenceQuality_ && referenceValid()) {
+			// final quality: per pixel traced map replaces the interpolated grid
+			if (!referenceUploaded_) uploadReference();
+		}
+		else if (makeNewGrid_ || modePerformance_) {
 			gpuMakeGrid(false);
 			gpuInterpolate(false);
-			std::swap(queryFrontBuffer_, queryBackBuffer_);
+			if (blendGridID_ >= 0) gpuBlend();
 
 			makeNewGrid_ = false;
 		}
 
+		profiler_->begin("render");
 		glBindFramebuffer(GL_FRAMEBUFFER, fboTexture_->getFboId());
 		glViewport(0, 0, fboTexture_->getWidth(), fboTexture_->getHeight());
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -211,12 +225,17 @@ void KerrApp::renderContent()
 
 		renderShader_->getShader()->use();
 		quad_.draw(GL_TRIANGLES);
+		profiler_->end();
 
 		break;
 	default:
 		break;
 	}
 
+	if (captureFrame)
+		captureAnimationFrame();
+
+	GpuProfiler::Scope scope(profiler_, "present");
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(0, 0, window_.getWidth(), window_.getHeight());
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -234,7 +253,9 @@ void KerrApp::initShaders() {
 	testShader_ = std::make_shared<Shader>("kerr/sky.vs", "kerr/sky.fs");
 	computeShader_ = std::make_shared<ComputeShader>("kerr/compute.comp");
 	makeGridShader_ = std::make_shared<ComputeShader>("kerr/makeGrid.comp");
+	makeCompactGridShader_ = std::make_shared<ComputeShader>("kerr/makeCompactGrid.comp");
 	interpolateShader_ = std::make_shared<ComputeShader>("kerr/pixInterpolation.comp");
+	blendShader_ = std::make_shared<ComputeShader>("kerr/blendGrids.comp");
 	renderShader_ = std::make_shared<BlackHoleShaderGui>();
 	reloadShaders();
 }
@@ -243,7 +264,9 @@ void KerrApp::reloadShaders()
 {
 	computeShader_->reload();
 	makeGridShader_->reload();
+	makeCompactGridShader_->reload();
 	interpolateShader_->reload();
+	blendShader_->reload();
 	testShader_->reload();
 	testShader_->setBlockBinding("camera", CAMBINDING);
 	makeNewGrid_ = true;
@@ -291,13 +314,23 @@ void KerrApp::initCubeMaps() {
 		map->setParam(texParametersi);
 		map->setParam(GL_TEXTURE_MAX_ANISOTROPY, 1.0f);
 	}
+
+	// same sky as mwPanorama_, converted on the first start and baked next to the panorama.
+	// The placeholder is shown until update uploads the faces and generates the mip maps.
+	auto panorama = textureLoader_->loadPanorama("milkyway_eso0932a.jpg", 2048, true);
+	panorama.texture->setParam(texParametersi);
+	panorama.texture->setParam(GL_TEXTURE_MAX_ANISOTROPY, 1.0f);
+	cubemaps_.push_back({ "Milky Way Panorama", panorama.texture });
+
 	currentCubeMap_ = cubemaps_.at(0).second;
 	loadStarTextures();
 	cubemaps_.push_back({ "Gaia Sky" , galaxyTexture_ });
 
 	// init scenes
-	environmentScenes_.insert({ "Solar System", std::make_shared<SolarSystemScene>(2048) });
+	environmentScenes_.insert({ "Solar System", std::make_shared<SolarSystemScene>(2048, textureLoader_) });
 	environmentScenes_.insert({ "Checker Sphere", std::make_shared<CheckerSphereScene>(2048) });
+	for (auto const& [name, scene] : environmentScenes_)
+		scene->setProfiler(profiler_);
 	currentEnvironmentScene_ = environmentScenes_["Solar System"];
 
 }
@@ -377,8 +410,17 @@ void KerrApp::loadStarTextures() {
 		"pos-z", "neg-z"
 	};
 
+	struct Tile {
+		int level, ti, tj, face, tileSize;
+		std::string path;
+		std::vector<unsigned int> data;
+		JobHandle read;
+	};
+	std::vector<std::shared_ptr<Tile>> tiles;
+
 	Timer tim;
 	tim.start("Created star textures in ");
+	// the tiles are read in parallel and uploaded in order as they arrive
 	// loop over the mipmap levels
 	// loops up until level 4 because levels 4 and higher
 	// are stored in a single file
@@ -394,21 +436,26 @@ void KerrApp::loadStarTextures() {
 			// iterate over all tiles
 			for (int tj = 0; tj < numTiles; ++tj) {
 				for (int ti = 0; ti < numTiles; ++ti) {
-					GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
-					std::string path = std::format("{}{}-{}-{}-{}.dat",
-						baseDir, faces.at(face), level, ti, tj);
-					loadStarTile(level, ti, tj, face, faceSize, tileSize, target, path);
-					//std::cout << "Loaded " << path << std::endl;
+					auto tile = std::make_shared<Tile>(Tile{ level, ti, tj, face, tileSize,
+						std::format("{}{}-{}-{}-{}.dat", baseDir, faces.at(face), level, ti, tj) });
+					tile->read = jobs_->submit([tile](CancellationToken const&) {
+						tile->data = readFile<unsigned int>(tile->path);
+					}, JobPriority::HIGH);
+					tiles.push_back(tile);
 				}
 			}
 		}
 	}
+	for (auto const& tile : tiles) {
+		tile->read.wait();
+		loadStarTile(tile->level, tile->ti, tile->tj, tile->face, tile->tileSize, tile->data);
+		tile->data = {};
+	}
 	tim.end();
 	tim.printLast();
 }
 
-void KerrApp::loadStarTile(int level, int ti, int tj, int face, int faceSize, int tileSize, GLenum target, std::string path) {
-	std::vector<unsigned int> tileData = readFile<unsigned int>(path);
+void KerrApp::loadStarTile(int level, int ti, int tj, int face, int tileSize, std::vector<unsigned int> const& tileData) {
 	int start = 0;
 	int currentLevel = level;
 	// loop is only necessary because multiple levels are stored in level-4 tiles
@@ -440,8 +487,13 @@ void KerrApp::resizeTextures() {
 }
 
 void KerrApp::resizeGridTextures(){
-	gpuGrid_->resize(grid_->M_, grid_->N_);
-	interpolatedGrid_->resize(grid_->M_, grid_->N_);
+	// symmetric grids are mirrored to the full sky on the gpu.
+	// A dense upload stays valid as long as the size doesn't change
+	if (gpuGrid_->getWidth() != grid_->M_ || gpuGrid_->getHeight() != grid_->getFullN()) {
+		gpuGrid_->resize(grid_->M_, grid_->getFullN());
+		denseGrid_ = nullptr;
+	}
+	interpolatedGrid_->resize(grid_->M_, grid_->getFullN());
 
 	glGetProgramiv(makeGridShader_->getID(), GL_COMPUTE_WORK_GROUP_SIZE, glm::value_ptr(makeGridWorkGroups_));
 	makeGridWorkGroups_.x = std::ceil(gpuGrid_->getWidth() / (float)makeGridWorkGroups_.x);
@@ -470,44 +522,410 @@ void KerrApp::initTestSSBO() {
 }
 
 void KerrApp::initMakeGridSSBO(){
-	// Table sizes
-	std::vector<int> tableSizes{grid_->hasher.hashTableWidth, grid_->hasher.offsetTableWidth};
-	tableSizeSSBO_ = std::make_shared<SSBO>(sizeof(int)*tableSizes.size(), tableSizes.data());
+	gridPack_.clear();
+	compactPack_.clear();
+	if (compactTables_) {
+		// encode new grids, drop the tables of evicted ones
+		std::unordered_map<Grid const*, std::shared_ptr<CompactGrid>> compactGrids;
+		for (auto const& grid : residentGrids_) {
+			auto it = compactGrids_.find(grid.get());
+			compactGrids[grid.get()] = it != compactGrids_.end() ? it->second : std::make_shared<CompactGrid>(*grid);
+			compactPack_.add(*compactGrids[grid.get()]);
+		}
+		compactGrids_ = std::move(compactGrids);
+
+		tableDirectorySSBO_ = std::make_shared<SSBO>(sizeof(glm::ivec4) * compactPack_.directory.size(), compactPack_.directory.data());
+		hashTableSSBO_ = std::make_shared<SSBO>(sizeof(uint32_t) * compactPack_.values.size(), compactPack_.values.data());
+		hashPosSSBO_ = std::make_shared<SSBO>(sizeof(uint32_t) * compactPack_.tags.size(), compactPack_.tags.data());
+		offsetTableSSBO_ = std::make_shared<SSBO>(sizeof(uint32_t) * compactPack_.offsetTable.size(), compactPack_.offsetTable.data());
+		levelScaleSSBO_ = std::make_shared<SSBO>(sizeof(glm::vec2) * compactPack_.levelScales.size(), compactPack_.levelScales.data());
+
+		std::cout << "SSBO sizes (" << compactPack_.size() << " compact grids): " <<
+			"values " << sizeof(uint32_t) * compactPack_.values.size() / 1000 << " KB, " <<
+			"tags " << sizeof(uint32_t) * compactPack_.tags.size() / 1000 << " KB, " <<
+			"offsetTable " << sizeof(uint32_t) * compactPack_.offsetTable.size() / 1000 << " KB" << std::endl;
+		return;
+	}
+	compactGrids_.clear();
+	for (auto const& grid : residentGrids_)
+		gridPack_.add(grid->hasher);
+
+	// Table directory
+	std::vector<glm::ivec4>& directory = gridPack_.directory;
+	tableDirectorySSBO_ = std::make_shared<SSBO>(sizeof(glm::ivec4) * directory.size(), directory.data());
 
 	// Hash Table
-	std::vector<float> &hashTable = grid_->hasher.hashTable;
+	std::vector<float> &hashTable = gridPack_.hashTable;
 	hashTableSSBO_ = std::make_shared<SSBO>(sizeof(float)*hashTable.size(), hashTable.data());
 
 	// Hash Pos Tag Table
-	std::vector<int>& hashPosTag = grid_->hasher.hashPosTag;
+	std::vector<int>& hashPosTag = gridPack_.hashPosTag;
 	hashPosSSBO_ = std::make_shared<SSBO>(sizeof(int) * hashPosTag.size(), hashPosTag.data());
 
 	// Offset Table
-	std::vector<int>& offsetTable = grid_->hasher.offsetTable;
+	std::vector<int>& offsetTable = gridPack_.offsetTable;
 	offsetTableSSBO_ = std::make_shared<SSBO>(sizeof(int) * offsetTable.size(), offsetTable.data());
 
-	std::cout << "SSBO sizes: " <<
+	std::cout << "SSBO sizes (" << gridPack_.size() << " grids): " <<
 		"hashTable " << sizeof(float) * hashTable.size() / 1000 << " KB, " <<
 		"hashPosSSBO " << sizeof(int) * hashPosTag.size() / 1000 << " KB, " <<
 		"offsetTableSSBO " << sizeof(int) * offsetTable.size() / 1000 << " KB" << std::endl;
 }
 
-void KerrApp::makeGrid() {
+void KerrApp::setCompactTables(bool compact) {
+	compactTables_ = compact;
+	std::shared_ptr<Grid> blendGrid = blendGridID_ >= 0 ? residentGrids_[blendGridID_] : nullptr;
+	// the shown grids stay resident
+	for (auto it = residentGrids_.begin(); residentGrids_.size() > getMaxResidentGrids() && it != residentGrids_.end();)
+		it = (*it == grid_ || *it == blendGrid) ? it + 1 : residentGrids_.erase(it);
+
+	// -1 for a dense upload that isn't resident yet
+	currentGridID_ = indexOfResidentGrid(grid_);
+	blendGridID_ = indexOfResidentGrid(blendGrid);
+	initMakeGridSSBO();
+	makeNewGrid_ = true;
+}
+
+void KerrApp::addResidentGrid(std::shared_ptr<Grid> grid) {
+	// a grid with the same configuration is already on the gpu
+	int id = findResidentGrid(grid->getProperties());
+	if (id >= 0) {
+		selectGrid(id);
+		return;
+	}
+
+	residentGrids_.push_back(grid);
+	// evict the oldest grid
+	while (residentGrids_.size() > getMaxResidentGrids())
+		residentGrids_.erase(residentGrids_.begin());
+	initMakeGridSSBO();
+	selectGrid(residentGrids_.size() - 1);
+}
+
+void KerrApp::keepResidentGrid(std::shared_ptr<Grid> grid) {
+	if (findResidentGrid(grid->getProperties()) >= 0) return;
+
+	std::shared_ptr<Grid> blendGrid = blendGridID_ >= 0 ? residentGrids_[blendGridID_] : nullptr;
+	residentGrids_.push_back(grid);
+	// evict the oldest grid that isn't shown
+	for (auto it = residentGrids_.begin(); residentGrids_.size() > getMaxResidentGrids() && it != residentGrids_.end();)
+		it = (*it == grid_ || *it == blendGrid || *it == grid) ? it + 1 : residentGrids_.erase(it);
+
+	currentGridID_ = indexOfResidentGrid(grid_);
+	blendGridID_ = indexOfResidentGrid(blendGrid);
+	initMakeGridSSBO();
+	makeNewGrid_ = true;
+}
+
+int KerrApp::findResidentGrid(GridProperties const& props) const {
+	std::string name = Grid::getFileNameFromConfig(props);
+	for (int i = 0; i < residentGrids_.size(); ++i) {
+		// the preview has the name of the grid it will become
+		if (residentGrids_[i] == previewGrid_) continue;
+		if (residentGrids_[i]->getFileNameFromConfig() == name)
+			return i;
+	}
+	return -1;
+}
+
+int KerrApp::indexOfResidentGrid(std::shared_ptr<Grid> const& grid) const {
+	auto it = std::find(residentGrids_.begin(), residentGrids_.end(), grid);
+	return grid && it != residentGrids_.end() ? (int)(it - residentGrids_.begin()) : -1;
+}
+
+void KerrApp::selectGrid(int id) {
+	// only switches the table directory entry, the packed tables stay on the gpu
+	grid_ = residentGrids_.at(id);
+	currentGridID_ = id;
+	resizeGridTextures();
+	makeNewGrid_ = true;
+	deflectionError_ = nullptr;
+
+	// the grid as it is, without blending or rotation
+	blendGridID_ = -1;
+	phiShift_ = 0.f;
+	gridSelection_ = GridQuantizer::Selection();
+	gridSelection_.target = grid_->getProperties();
+	gridSelection_.grids = { { grid_->getProperties() } };
+	gridSelection_.cached = true;
+}
+
+void KerrApp::requestGrid() {
+	GridQuantizer::Selection selection = quantizer_.select(properties_, [this](GridProperties const& props) {
+		return findResidentGrid(props) >= 0 || Grid::hasFile(props);
+	});
+
+	std::vector<std::shared_ptr<Grid>> grids;
+	bool resident = true;
+	for (auto const& candidate : selection.grids) {
+		int id = findResidentGrid(candidate.props);
+		grids.push_back(id >= 0 ? residentGrids_[id] : nullptr);
+		resident = resident && id >= 0;
+	}
+	// the running build was requested for older properties
+	if (gridBuild_) gridBuild_->job.cancel();
+
+	// cache hit on the gpu, no job needed
+	if (resident) {
+		if (gridBuild_) gridBuild_->superseded = true;
+		gridRequested_ = false;
+		applyGridSelection(selection, grids);
+		gridDone_ = true;
+		return;
+	}
+
+	// one build at a time: the progress bar, the preview snapshots and the dense upload follow
+	// gridBuild_, and a cancelled build whose dense grid is shown still becomes resident once it
+	// returned. A cancelled trace returns after one ray batch, then updateGridBuild starts the latest request
+	if (gridBuild_) {
+		gridRequested_ = true;
+		return;
+	}
+
+	makeNewGrid_ = false;
+	gridDone_ = false;
+	auto build = std::make_shared<GridBuild>();
+	build->selection = selection;
+	build->grids = grids;
+	build->progress = std::make_shared<GridProgress>(gridPreview_);
+	gridProgress_ = build->progress;
+	std::shared_ptr<DenseGridPolicy> densePolicy = densePolicy_;
+	build->job = jobs_->submit([build, densePolicy](CancellationToken const& token) {
+		makeGrids(*build, *densePolicy, token);
+	});
+	gridBuild_ = build;
+}
+
+void KerrApp::makeGrids(GridBuild& build, DenseGridPolicy& densePolicy, CancellationToken const& token) {
+	using Clock = std::chrono::steady_clock;
+	auto seconds = [](Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); };
 
-	Grid::saveToFile(grid_);
-	std::shared_ptr<Grid> tmpGrid = std::make_shared<Grid>();
 	Timer tim;
 	tim.start("Grid Computation");
-	Grid::makeGrid(tmpGrid, properties_);
+	for (size_t i = 0; i < build.grids.size() && !token.isCancelled(); ++i) {
+		if (build.grids[i]) continue;
+		auto grid = std::make_shared<Grid>();
+		bool loaded = Grid::makeGrid(grid, build.selection.grids[i].props, token, build.progress);
+		build.grids[i] = grid;
+		if (grid->isCancelled()) break;
+
+		// a single grid is shown as soon as it is expanded, blended grids need the hash for makeGrid.comp
+		if (build.grids.size() == 1 && densePolicy.useDense(*grid)) {
+			auto start = Clock::now();
+			build.dense = std::make_shared<DenseGrid>(*grid, (float)build.selection.phiShift);
+			densePolicy.addExpandTiming(build.dense->getTexels().size(), seconds(start));
+			build.denseReady = true;
+		}
+		// the grid becomes resident (and is saved) with its hash
+		if (grid->hasher.n == 0) {
+			auto start = Clock::now();
+			grid->saveAsGpuHash();
+			if (grid->hasher.n > 0) densePolicy.addHashTiming(grid->CamToCel.size(), seconds(start));
+		}
+		// new grids are written right away, later requests find them on disk
+		if (!loaded) Grid::saveToFile(grid);
+	}
 	tim.end();
 	tim.printLast();
-	newGrid_ = tmpGrid;
-	gridChange_ = true;
 }
 
-void KerrApp::joinGridThread() {
-	if (gridThread_) gridThread_->join();
-	gridThread_ = nullptr;
+void KerrApp::updateGridBuild() {
+	if (!gridBuild_) return;
+	if (!gridBuild_->job.isDone()) {
+		if (gridBuild_->job.isCancelled() || gridBuild_->denseShown) return;
+		// the finished grid while its hash is built
+		if (gridBuild_->denseReady) {
+			showDenseGrid(*gridBuild_);
+			return;
+		}
+		// coarse levels of the running build
+		std::shared_ptr<Grid> snapshot = gridBuild_->progress->takeSnapshot();
+		if (snapshot)
+			showPreviewGrid(snapshot, gridBuild_->selection);
+		return;
+	}
+
+	std::shared_ptr<GridBuild> build = gridBuild_;
+	gridBuild_ = nullptr;
+	// a shown grid was complete, it becomes resident even if a newer request cancelled the build.
+	// The newer request may have selected cached grids already, then it's kept without showing it
+	if (build->superseded) {
+		if (build->denseShown) keepResidentGrid(build->grids[0]);
+	}
+	else if (!build->job.isCancelled() || build->denseShown) {
+		std::cout << "Grid changed!" << std::endl;
+		applyGridSelection(build->selection, build->grids);
+		gridDone_ = true;
+	}
+	// properties changed while the grid was built
+	if (gridRequested_) {
+		gridRequested_ = false;
+		requestGrid();
+	}
+}
+
+void KerrApp::showPreviewGrid(std::shared_ptr<Grid> snapshot, GridQuantizer::Selection const& selection) {
+	// the preview replaces the previous one instead of evicting cached grids
+	auto it = std::find(residentGrids_.begin(), residentGrids_.end(), previewGrid_);
+	if (previewGrid_ && it != residentGrids_.end()) {
+		*it = snapshot;
+	}
+	else {
+		residentGrids_.push_back(snapshot);
+		while (residentGrids_.size() > getMaxResidentGrids())
+			residentGrids_.erase(residentGrids_.begin());
+	}
+	previewGrid_ = snapshot;
+	initMakeGridSSBO();
+	selectGrid(std::find(residentGrids_.begin(), residentGrids_.end(), snapshot) - residentGrids_.begin());
+
+	// the grids of the selection share their phi, so the preview is rotated like them
+	phiShift_ = (float)selection.phiShift;
+	gridSelection_.target = selection.target;
+	gridSelection_.error = selection.error;
+	gridSelection_.cached = false;
+}
+
+void KerrApp::showDenseGrid(GridBuild& build) {
+	build.denseShown = true;
+	dropPreviewGrid();
+
+	// like selectGrid, but the grid has no table directory entry yet
+	grid_ = build.grids[0];
+	currentGridID_ = -1;
+	resizeGridTextures();
+	// one upload replaces the hash tables and the makeGrid pass
+	DenseGrid const& dense = *build.dense;
+	glTextureSubImage2D(gpuGrid_->getTexId(), 0, 0, 0, dense.getWidth(), dense.getHeight(),
+		GL_RGBA, GL_FLOAT, dense.getTexels().data());
+	denseGrid_ = grid_;
+	densePhiShift_ = dense.getPhiShift();
+	makeNewGrid_ = true;
+	deflectionError_ = nullptr;
+
+	blendGridID_ = -1;
+	gridSelection_ = build.selection;
+	phiShift_ = (float)build.selection.phiShift;
+	std::cout << "[Kerr] uploaded dense grid (" << dense.byteSize() / 1000 << " KB), hash follows" << std::endl;
+}
+
+void KerrApp::dropPreviewGrid() {
+	if (!previewGrid_) return;
+	auto it = std::find(residentGrids_.begin(), residentGrids_.end(), previewGrid_);
+	previewGrid_ = nullptr;
+	// evicted already
+	if (it == residentGrids_.end()) return;
+	residentGrids_.erase(it);
+	initMakeGridSSBO();
+}
+
+void KerrApp::applyGridSelection(GridQuantizer::Selection const& selection, std::vector<std::shared_ptr<Grid>> const& grids) {
+	dropPreviewGrid();
+	// the heavier grid is added last and becomes the current grid
+	for (size_t i = grids.size(); i-- > 0;)
+		addResidentGrid(grids[i]);
+
+	gridSelection_ = selection;
+	phiShift_ = (float)selection.phiShift;
+	if (grids.size() < 2) return;
+
+	int id = findResidentGrid(grids[1]->getProperties());
+	// blending needs deflection maps of the same size and layout, the second grid may also have been evicted
+	if (id < 0 || grids[1]->M_ != grid_->M_ || grids[1]->getFullN() != grid_->getFullN()
+		|| grids[1]->equafactor_ != grid_->equafactor_) {
+		std::cerr << "[Kerr] can't blend grids, using the nearer one" << std::endl;
+		GridProperties target = selection.target;
+		// phi is rotated exactly
+		target.cam_phi_ = grid_->getProperties().cam_phi_;
+		gridSelection_.grids.resize(1);
+		gridSelection_.error = GridQuantizer::estimateError(target, grid_->getProperties());
+		return;
+	}
+	blendGridID_ = id;
+	blendWeight_ = (float)selection.grids[1].weight;
+	blendedGrid_->resize(interpolatedGrid_->getWidth(), interpolatedGrid_->getHeight());
+}
+
+void KerrApp::cancelGridBuild() {
+	gridRequested_ = false;
+	if (!gridBuild_) return;
+	gridBuild_->job.cancel();
+	gridBuild_->job.wait();
+	gridBuild_ = nullptr;
+}
+
+void KerrApp::traceReference() {
+	joinReferenceThread(true);
+	deflectionError_ = nullptr;
+	referenceUploaded_ = false;
+
+	// trace at the resolution of the interpolated grid to compare both pixel by pixel,
+	// for the requested camera to include the error of a quantised grid
+	reference_ = std::make_shared<ReferenceTracer>(gridSelection_.target);
+	std::shared_ptr<ReferenceTracer> reference = reference_;
+	int width = grid_->M_;
+	int height = grid_->getFullN();
+	referenceThread_ = std::make_shared<std::thread>([reference, width, height]() {
+		reference->trace(width, height);
+	});
+}
+
+void KerrApp::joinReferenceThread(bool cancel) {
+	if (cancel && reference_) reference_->cancel();
+	if (referenceThread_) referenceThread_->join();
+	referenceThread_ = nullptr;
+}
+
+bool KerrApp::referenceValid() const {
+	return reference_ && reference_->isDone()
+		&& reference_->getWidth() == interpolatedGrid_->getWidth()
+		&& reference_->getHeight() == interpolatedGrid_->getHeight();
+}
+
+void KerrApp::uploadReference() {
+	std::vector<glm::vec2> const& map = reference_->getMap();
+	glTextureSubImage2D(interpolatedGrid_->getTexId(), 0, 0, 0,
+		reference_->getWidth(), reference_->getHeight(), GL_RG, GL_FLOAT, map.data());
+	referenceUploaded_ = true;
+}
+
+void KerrApp::computeDeflectionError() {
+	if (!referenceValid()) {
+		std::cerr << "[KerrApp] can't compute error: reference map missing or size doesn't match grid" << std::endl;
+		return;
+	}
+
+	// raw (not printable) interpolated map of the current grid
+	gpuMakeGrid(false);
+	gpuInterpolate(false);
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	int width = interpolatedGrid_->getWidth();
+	int height = interpolatedGrid_->getHeight();
+	std::vector<glm::vec2> interpolated((size_t)width * height);
+	glGetTextureImage(interpolatedGrid_->getTexId(), 0, GL_RG, GL_FLOAT,
+		sizeof(glm::vec2) * interpolated.size(), interpolated.data());
+
+	deflectionError_ = std::make_shared<DeflectionError>(reference_->getMap(), interpolated, width, height, grid_);
+	deflectionError_->print();
+
+	// error relative to the max error (sqrt for visibility), shadow mismatches in magenta
+	std::vector<float> const& errors = deflectionError_->getErrorMap();
+	double maxError = deflectionError_->getTotal().maxError;
+	std::vector<glm::vec4> pixels(errors.size());
+	for (size_t q = 0; q < errors.size(); ++q) {
+		if (errors[q] < 0.f) {
+			pixels[q] = { 1.f, 0.f, 1.f, 1.f };
+		}
+		else {
+			float e = maxError > 0.0 ? std::sqrt(errors[q] / (float)maxError) : 0.f;
+			pixels[q] = { e, e, e, 1.f };
+		}
+	}
+	errorMap_->resize(width, height);
+	glTextureSubImage2D(errorMap_->getTexId(), 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, pixels.data());
+
+	makeNewGrid_ = true;
 }
 
 void KerrApp::uploadCameraVectors() {
@@ -555,52 +973,175 @@ void KerrApp::uploadCameraVectors() {
 
 }
 
-void KerrApp::gpuMakeGrid(bool print){
+void KerrApp::startAnimation() {
+	stopAnimation();
+	if (path_.empty()) {
+		std::cerr << "[Kerr] can't start the animation: the camera path has no keyframes" << std::endl;
+		return;
+	}
+
+	// the prefetcher gets the workers, and a finished interactive build would replace the frame's grid
+	cancelGridBuild();
+	// the reference map belongs to the grid it was traced for
+	referenceQuality_ = false;
+	mode_ = RenderMode::RENDER;
+	animationFrame_ = 0;
+	prefetcher_ = std::make_shared<GridPrefetcher>(jobs_, path_.getFrameGrids(properties_),
+		animationLookAhead_, animationSaveGrids_);
+	frameWriter_ = std::make_shared<FrameWriter>(ROOT_DIR "data/animation/" + animationName_ + "/");
+	std::cout << "[Kerr] rendering " << prefetcher_->getFrameCount() << " frames to "
+		<< frameWriter_->getDirectory() << std::endl;
+}
+
+void KerrApp::stopAnimation() {
+	if (!isAnimating()) return;
+	std::cout << "[Kerr] animation stopped after " << animationFrame_ << " / " << prefetcher_->getFrameCount()
+		<< " frames, " << prefetcher_->getBuiltCount() << " grids built in " << prefetcher_->getBuildSeconds()
+		<< "s worker time" << std::endl;
+	// waits for the grids being built and the queued images
+	prefetcher_ = nullptr;
+	frameWriter_ = nullptr;
+}
+
+bool KerrApp::prepareAnimationFrame() {
+	std::shared_ptr<Grid> grid = prefetcher_->tryGet(animationFrame_);
+	if (!grid) return false;
+
+	// frames sharing a grid select the resident one
+	addResidentGrid(grid);
+	mode_ = RenderMode::RENDER;
+	// the grid carries the camera position, the camera only the view direction
+	cam_.setViewDirTP(glm::vec2(path_.sample(path_.getFrameTime(animationFrame_)).viewDirTP));
+	return true;
+}
+
+void KerrApp::captureAnimationFrame() {
+	int width = fboTexture_->getWidth();
+	int height = fboTexture_->getHeight();
+	if (animationTexture_->getWidth() != width || animationTexture_->getHeight() != height)
+		animationTexture_->resize(width, height);
+
+	// same pass as the presentation, but at offscreen resolution
+	GpuProfiler::Scope scope(profiler_, "capture");
+	glBindFramebuffer(GL_FRAMEBUFFER, animationTexture_->getFboId());
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT);
+	sQuadShader_->getShader()->use();
+	glActiveTexture(GL_TEXTURE0);
+	fboTexture_->bind();
+	quad_.draw(GL_TRIANGLES);
+
+	std::vector<uint8_t> pixels((size_t)width * height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	frameWriter_->push((int)animationFrame_, width, height, std::move(pixels));
+
+	if (++animationFrame_ == prefetcher_->getFrameCount())
+		stopAnimation();
+}
+
+void KerrApp::gpuMakeGrid(bool print, int gridID){
+	// the current grid was uploaded expanded
+	if (gridID < 0 && !print && denseGrid_ == grid_ && densePhiShift_ == phiShift_) return;
+	gridID = gridID >= 0 ? gridID : currentGridID_;
+	// not resident yet, gpuGrid_ keeps the dense upload
+	if (gridID < 0) return;
+	denseGrid_ = nullptr;
+	if (compactTables_) {
+		gpuMakeCompactGrid(print, gridID);
+		return;
+	}
+	// the blend grid has the size of grid_, but is expanded with its own layout
+	Grid const& grid = *residentGrids_[gridID];
+
 	makeGridShader_->use();
 	gpuGrid_->bindImageTex(0, GL_WRITE_ONLY);
 	hashTableSSBO_->bindBase(1);
 	hashPosSSBO_->bindBase(2);
 	offsetTableSSBO_->bindBase(3);
-	tableSizeSSBO_->bindBase(4);
+	tableDirectorySSBO_->bindBase(4);
 
-	makeGridShader_->setUniform("GM", grid_->M_);
-	makeGridShader_->setUniform("GN", grid_->N_);
-	makeGridShader_->setUniform("GN1", grid_->N_);
+	makeGridShader_->setUniform("in_gridID", gridID);
+	makeGridShader_->setUniform("phiShift", phiShift_);
+	makeGridShader_->setUniform("GM", grid.M_);
+	makeGridShader_->setUniform("GN", grid.N_);
+	makeGridShader_->setUniform("GN1", grid.getFullN());
+	makeGridShader_->setUniform("sym", grid.equafactor_ == 0);
 	makeGridShader_->setUniform("print", print);
 
-#ifdef COMPUTE_PERFORMANCE
-	glBeginQuery(GL_TIME_ELAPSED, queryIDs_[queryBackBuffer_][MAKEGRID_QUERY]);
-#endif
-
+	GpuProfiler::Scope scope(profiler_, "makeGrid");
 	glDispatchCompute(makeGridWorkGroups_.x, makeGridWorkGroups_.y, 1);
+}
 
-#ifdef COMPUTE_PERFORMANCE
-	glEndQuery(GL_TIME_ELAPSED);
-	makeGridTime_ = getPerformanceQuery(MAKEGRID_QUERY) * 1e-6;
-#endif
+void KerrApp::gpuMakeCompactGrid(bool print, int gridID) {
+	Grid const& grid = *residentGrids_[gridID];
+	makeCompactGridShader_->use();
+	// differences are decoded against the points of the earlier levels in gpuGrid_
+	gpuGrid_->bindImageTex(0, GL_READ_WRITE);
+	hashTableSSBO_->bindBase(1);
+	hashPosSSBO_->bindBase(2);
+	offsetTableSSBO_->bindBase(3);
+	tableDirectorySSBO_->bindBase(4);
+	levelScaleSSBO_->bindBase(5);
+
+	makeCompactGridShader_->setUniform("in_gridID", gridID);
+	makeCompactGridShader_->setUniform("phiShift", phiShift_);
+	makeCompactGridShader_->setUniform("GM", grid.M_);
+	makeCompactGridShader_->setUniform("GN", grid.N_);
+	makeCompactGridShader_->setUniform("GN1", grid.getFullN());
+	makeCompactGridShader_->setUniform("sym", grid.equafactor_ == 0);
+	makeCompactGridShader_->setUniform("startLevel", grid.getProperties().grid_strtLvl_);
+	makeCompactGridShader_->setUniform("maxLevel", grid.MAXLEVEL_);
+
+	glm::ivec3 workGroupSize;
+	glGetProgramiv(makeCompactGridShader_->getID(), GL_COMPUTE_WORK_GROUP_SIZE, glm::value_ptr(workGroupSize));
+
+	GpuProfiler::Scope scope(profiler_, "makeGrid");
+	// levels finer than a snapshot's are decoded too, they overwrite the texels of the previous grid
+	for (int level = grid.getProperties().grid_strtLvl_; level <= grid.MAXLEVEL_; ++level) {
+		int gap = 1 << (grid.MAXLEVEL_ - level);
+		makeCompactGridShader_->setUniform("level", level);
+		glDispatchCompute((GLuint)std::ceil(std::ceil(grid.M_ / (float)gap) / workGroupSize.x),
+			(GLuint)std::ceil(((grid.N_ - 1) / gap + 1) / (float)workGroupSize.y), 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	if (print) {
+		makeCompactGridShader_->setUniform("level", -1);
+		glDispatchCompute(makeGridWorkGroups_.x, makeGridWorkGroups_.y, 1);
+	}
 }
 
-void KerrApp::gpuInterpolate(bool print){
+void KerrApp::gpuInterpolate(bool print, std::shared_ptr<FBOTexture> target){
 	interpolateShader_->use();
-	interpolatedGrid_->bindImageTex(0, GL_WRITE_ONLY);
+	(target ? target : interpolatedGrid_)->bindImageTex(0, GL_WRITE_ONLY);
 	gpuGrid_->bindImageTex(1, GL_READ_ONLY);
 
 	interpolateShader_->setUniform("Gr", 1);
 	interpolateShader_->setUniform("GM", grid_->M_);
-	interpolateShader_->setUniform("GN", grid_->N_);
+	interpolateShader_->setUniform("GN", grid_->getFullN());
 	interpolateShader_->setUniform("GmaxLvl", grid_->MAXLEVEL_);
 	interpolateShader_->setUniform("print", print);
+	referenceUploaded_ = false;
 
-#ifdef COMPUTE_PERFORMANCE
-	glBeginQuery(GL_TIME_ELAPSED, queryIDs_[queryBackBuffer_][INTERPOLATE_QUERY]);
-#endif
-
+	GpuProfiler::Scope scope(profiler_, "interpolate");
 	glDispatchCompute(interpolateWorkGroups_.x, interpolateWorkGroups_.y, 1);
+}
+
+void KerrApp::gpuBlend() {
+	// the second grid goes through the same passes into its own deflection map
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	gpuMakeGrid(false, blendGridID_);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	gpuInterpolate(false, blendedGrid_);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-#ifdef COMPUTE_PERFORMANCE
-	glEndQuery(GL_TIME_ELAPSED);
-	interpolateTime_ = getPerformanceQuery(INTERPOLATE_QUERY) * 1e-6;
-#endif
+	blendShader_->use();
+	interpolatedGrid_->bindImageTex(0, GL_READ_WRITE);
+	blendedGrid_->bindImageTex(1, GL_READ_ONLY);
+	blendShader_->setUniform("weight", blendWeight_);
+
+	GpuProfiler::Scope scope(profiler_, "blend");
+	glDispatchCompute(interpolateWorkGroups_.x, interpolateWorkGroups_.y, 1);
 }
 
 void KerrApp::renderGui() {
@@ -608,11 +1149,11 @@ void KerrApp::renderGui() {
 	if (showFps_)
 		renderFPSWindow();
 
-#ifdef COMPUTE_PERFORMANCE
 	static bool showPerf_ = false;
 	if (showPerf_)
 		renderPerfWindow();
-#endif // COMPUTE_PERFORMANCE
+	if (showProfiler_)
+		profiler_->renderWindow(&showProfiler_);
 
 	ImGui::Begin("Application Options");
 	if (ImGui::BeginTabBar("Options")) {
@@ -645,12 +1186,13 @@ void KerrApp::renderGui() {
 				glfwSwapInterval((int)vSync_);
 
 			ImGui::Checkbox("Show FPS", &showFps_);
-#ifdef COMPUTE_PERFORMANCE
 			ImGui::Checkbox("Show Compute Performance", &showPerf_);
-#endif // COMPUTE_PERFORMANCE
+			ImGui::Checkbox("Show GPU Profiler", &showProfiler_);
 			ImGui::Spacing();
 			if (ImGui::Button("Debug Print"))
 				printDebug();
+			ImGui::Separator();
+			recorder_.renderGui();
 			ImGui::EndTabItem();
 		}
 		if (ImGui::BeginTabItem("Shader Settings")) {
@@ -665,6 +1207,10 @@ void KerrApp::renderGui() {
 			renderGridTab();
 			ImGui::EndTabItem();
 		}
+		if (ImGui::BeginTabItem("Grid Statistics")) {
+			renderGridStatsTab();
+			ImGui::EndTabItem();
+		}
 		if (ImGui::BeginTabItem("Sky Settings")) {
 			renderSkyTab();
 			ImGui::EndTabItem();
@@ -673,6 +1219,10 @@ void KerrApp::renderGui() {
 			renderSceneTab();
 			ImGui::EndTabItem();
 		}
+		if (ImGui::BeginTabItem("Animation")) {
+			renderAnimationTab();
+			ImGui::EndTabItem();
+		}
 	}
 	ImGui::EndTabBar();
 	ImGui::End();
@@ -729,6 +1279,9 @@ void KerrApp::renderShaderTab() {
 		mode_ = RenderMode::RENDER;
 		makeNewGrid_ = true;
 	}
+	if (ImGui::RadioButton("ERROR MAP", &m, 5)) {
+		mode_ = RenderMode::ERRORMAP;
+	}
 	
 	if (mode_ == RenderMode::COMPUTE) {
 		static int checkerSize = 10;
@@ -796,42 +1349,252 @@ void KerrApp::renderGridTab() {
 
 	ImGui::Text("Grid Properties");
 	imgui_helpers::sliderDouble("Black Hole Spin", properties_.blackHole_a_, 0.001, 0.999);
-	imgui_helpers::sliderDouble("Cam Rad", properties_.cam_rad_, 3.0, 20.0);
-	imgui_helpers::sliderDouble("Cam Theta", properties_.cam_the_, 0.0, PI);
-	imgui_helpers::sliderDouble("Cam Phi", properties_.cam_phi_, 0.0, PI2);
-	imgui_helpers::sliderDouble("Cam Speed", properties_.cam_vel_, 0.0, 0.9);
+	bool cameraChanged = imgui_helpers::sliderDouble("Cam Rad", properties_.cam_rad_, 3.0, 20.0);
+	cameraChanged |= imgui_helpers::sliderDouble("Cam Theta", properties_.cam_the_, 0.0, PI);
+	cameraChanged |= imgui_helpers::sliderDouble("Cam Phi", properties_.cam_phi_, 0.0, PI2);
+	cameraChanged |= imgui_helpers::sliderDouble("Cam Speed", properties_.cam_vel_, 0.0, 0.9);
+	// a build for older properties is cancelled
+	if (cameraChanged && autoGrid_)
+		requestGrid();
 
 	ImGui::SliderInt("Grid Start Level", &properties_.grid_strtLvl_, 1, 10);
 	ImGui::SliderInt("Grid Max Level", &properties_.grid_maxLvl_, properties_.grid_strtLvl_+1, 20);
+	ImGui::Checkbox("Use Equatorial Symmetry", &properties_.grid_useSymmetry_);
+	if (properties_.grid_useSymmetry_) {
+		ImGui::SameLine();
+		ImGui::Text(Grid::isSymmetric(properties_) ? "(half grid)" : "(camera not on equator)");
+	}
+
+	ImGui::Text("Refinement");
+	static const char* refinementModes[] = { "Threshold (squared diagonal)", "Hermite error estimate" };
+	if (ImGui::Combo("Refinement Policy", &properties_.grid_refinement_, refinementModes, IM_ARRAYSIZE(refinementModes)))
+		properties_.grid_threshold_ = RefinementPolicy::defaultThreshold((RefinementMode)properties_.grid_refinement_);
+	float threshold = (float)properties_.grid_threshold_;
+	if (ImGui::SliderFloat("Threshold", &threshold, 1e-5f, 1.f, "%.2e", ImGuiSliderFlags_Logarithmic))
+		properties_.grid_threshold_ = threshold;
+	ImGui::SliderInt("Force Refinement below Level", &properties_.grid_forceLvl_, 0, properties_.grid_maxLvl_);
+	if (ImGui::InputInt("Ray Budget (0 = unlimited)", &properties_.grid_rayBudget_, 1000, 10000))
+		properties_.grid_rayBudget_ = std::max(0, properties_.grid_rayBudget_);
 
 	ImGui::Separator();
 
-	if (ImGui::Button("Make Grid (Load or Compute)")) {
-		makeNewGrid_ = false;
-		gridDone_ = false;
-		joinGridThread();
-		gridThread_ = std::make_shared<std::thread>(&KerrApp::makeGrid, this);
+	if (ImGui::Button("Make Grid (Load or Compute)"))
+		requestGrid();
+	ImGui::SameLine();
+	ImGui::Checkbox("Update on Camera Change", &autoGrid_);
+	ImGui::SameLine();
+	ImGui::Checkbox("Preview Coarse Levels", &gridPreview_);
+	ImGui::Checkbox("Dense Upload of New Grids", &densePolicy_->enabled_);
+	ImGui::SameLine();
+	ImGui::Text("(expand %.1f ns / texel, hash %.2f us / point)",
+		densePolicy_->getExpandSecondsPerTexel() * 1e9, densePolicy_->getHashSecondsPerPoint() * 1e6);
+	if (gridBuild_) {
+		ImGui::SameLine();
+		ImGui::Text(gridRequested_ ? "Cancelling outdated build..." : "Building grid...");
 	}
-	if (gridDone_) {
+	else if (gridDone_) {
 		ImGui::SameLine();
 		ImGui::Text("Grid Computation Finished!");
+		if (grid_->getRayCount() > 0)
+			ImGui::Text("Rays traced: %zu", grid_->getRayCount());
 	}
+	if (gridProgress_)
+		renderGridProgress(*gridProgress_);
+
+	ImGui::Text("Grid Quantisation");
+	GridQuantizer::Settings& lattice = quantizer_.settings_;
+	ImGui::Checkbox("Snap Camera to Lattice", &lattice.enabled);
+	ImGui::SameLine();
+	ImGui::Checkbox("Rotate Phi", &lattice.rotatePhi);
+	ImGui::SameLine();
+	ImGui::Checkbox("Blend Grids", &lattice.blend);
+	imgui_helpers::sliderDouble("Radius Step (relative, 0 = exact)", lattice.radiusStep, 0.0, 0.2);
+	imgui_helpers::sliderDouble("Theta Step (0 = exact)", lattice.thetaStep, 0.0, 0.2);
+	imgui_helpers::sliderDouble("Speed Step (0 = exact)", lattice.velocityStep, 0.0, 0.1);
+	imgui_helpers::sliderDouble("Max Error (rad)", lattice.maxError, 0.0, 0.1);
+	if (ImGui::Button("Save as Deployment Settings"))
+		quantizer_.save(ROOT_DIR "resources/grid_quantization.json");
+	ImGui::Text("Current: %s, %s, estimated error %.2e rad, phi rotated by %.2f",
+		gridSelection_.cached ? "cache hit" : "new grid",
+		gridSelection_.grids.size() > 1 ? std::format("blend {:.2f}", blendWeight_).c_str() : "single grid",
+		gridSelection_.error, phiShift_);
 	
 
-	static int printLvl = 0;
-	if (ImGui::Button("Print Grid")) {
-		if (grid_) {
-			std::cout << "grid dims: M=" << grid_->M_ << ", N=" << grid_->N_ << std::endl;
-			grid_->printGridCam(printLvl);
+	bool compactTables = compactTables_;
+	if (ImGui::Checkbox("Compact Grid Tables (16 bit)", &compactTables))
+		setCompactTables(compactTables);
+	ImGui::Text("Resident Grids (%d / %d, %zu KB)", (int)residentGrids_.size(), getMaxResidentGrids(),
+		(compactTables_ ? compactPack_.byteSize() : gridPack_.byteSize()) / 1000);
+	if (ImGui::BeginListBox("##resident", ImVec2(-FLT_MIN, ImGui::GetTextLineHeightWithSpacing() * getMaxResidentGrids()))) {
+		for (int i = 0; i < residentGrids_.size(); ++i) {
+			std::string name = std::filesystem::path(residentGrids_[i]->getFileNameFromConfig()).filename().string();
+			if (residentGrids_[i]->getSnapshotLevel() >= 0)
+				name += std::format(" (preview, level {})", residentGrids_[i]->getSnapshotLevel());
+			ImGui::PushID(i);
+			if (ImGui::Selectable(name.c_str(), i == currentGridID_) && i != currentGridID_)
+				selectGrid(i);
+			ImGui::PopID();
 		}
-		else
-			std::cerr << "[Kerr] can't print grid: not initialized" << std::endl;
+		ImGui::EndListBox();
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Reference (per pixel CPU trace)");
+
+	bool tracing = reference_ && referenceThread_ && !reference_->isDone();
+	if (ImGui::Button("Trace Reference Map"))
+		traceReference();
+	if (tracing) {
+		ImGui::SameLine();
+		ImGui::ProgressBar(reference_->getProgress());
+	}
+	else if (reference_ && reference_->isDone()) {
+		ImGui::SameLine();
+		ImGui::Text("%dx%d in %.0f ms", reference_->getWidth(), reference_->getHeight(), reference_->getTraceTime());
+	}
+
+	if (ImGui::Checkbox("Final quality (render reference map)", &referenceQuality_)) {
+		referenceUploaded_ = false;
+		makeNewGrid_ = true;
+	}
+	if (referenceQuality_ && !referenceValid())
+		ImGui::Text("No matching reference map, rendering interpolated grid.");
+
+	if (ImGui::Button("Compute Error Map"))
+		computeDeflectionError();
+
+	if (deflectionError_ && ImGui::BeginTable("Deflection Error", 5)) {
+		ImGui::TableSetupColumn("level");
+		ImGui::TableSetupColumn("pixels");
+		ImGui::TableSetupColumn("shadow diff");
+		ImGui::TableSetupColumn("max [deg]");
+		ImGui::TableSetupColumn("mean [deg]");
+		ImGui::TableHeadersRow();
+
+		auto row = [](std::string const& name, LevelError const& stats) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text(name.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%zu", stats.pixels);
+			ImGui::TableNextColumn(); ImGui::Text("%zu", stats.shadowMismatch);
+			ImGui::TableNextColumn(); ImGui::Text("%.4f", stats.maxError * 180.0 / PI);
+			ImGui::TableNextColumn(); ImGui::Text("%.4f", stats.meanError * 180.0 / PI);
+		};
+		for (auto const& [level, stats] : deflectionError_->getLevels())
+			row(level < 0 ? "?" : std::to_string(level), stats);
+		row("total", deflectionError_->getTotal());
+		ImGui::EndTable();
 	}
-	ImGui::SameLine(); ImGui::SliderInt("Print level", &printLvl, 0, 8);
 
 	ImGui::Separator();
 }
 
+void KerrApp::renderGridProgress(GridProgress const& progress) {
+	std::vector<GridProgress::Level> levels = progress.getLevels();
+	if (levels.empty()) return;
+
+	double eta = progress.getEta();
+	if (progress.isDone())
+		ImGui::Text("Last build: %zu rays in %.2f s", progress.getTracedCount(), progress.getSeconds());
+	else if (eta >= 0.0)
+		ImGui::Text("%zu rays in %.1f s, about %.1f s left", progress.getTracedCount(), progress.getSeconds(), eta);
+	else
+		ImGui::Text("%zu rays in %.1f s", progress.getTracedCount(), progress.getSeconds());
+
+	if (ImGui::BeginTable("Grid Progress", 4)) {
+		ImGui::TableSetupColumn("level");
+		ImGui::TableSetupColumn("rays");
+		ImGui::TableSetupColumn("traced");
+		ImGui::TableSetupColumn("ms");
+		ImGui::TableHeadersRow();
+		for (auto const& level : levels) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%d", level.level);
+			ImGui::TableNextColumn(); ImGui::Text("%zu", level.queued);
+			ImGui::TableNextColumn(); ImGui::ProgressBar(level.queued ? (float)level.traced / level.queued : 1.f);
+			ImGui::TableNextColumn(); ImGui::Text("%.0f", level.seconds * 1e3);
+		}
+		ImGui::EndTable();
+	}
+}
+
+void KerrApp::renderGridStatsTab() {
+	if (!grid_) {
+		ImGui::Text("No grid");
+		return;
+	}
+	// a dense upload is still hashed by the build job
+	if (currentGridID_ < 0) {
+		ImGui::Text("Statistics follow once the grid is resident");
+		return;
+	}
+	if (!gridStats_ || gridStatsSource_.lock() != grid_) {
+		gridStats_ = std::make_shared<GridStats>(grid_->getStats());
+		gridStatsSource_ = grid_;
+	}
+	GridStats const& stats = *gridStats_;
+
+	ImGui::Text("%s", stats.name.c_str());
+	ImGui::Text("%d x %d%s, %zu points, shadow %.1f %%, %zu failed rays", stats.width, stats.height,
+		stats.symmetric ? " (symmetric)" : "", stats.points, stats.getShadowFraction() * 100.0, stats.failedPoints);
+	ImGui::Text("Hash: %zu entries in %zu slots (load %.2f), offset table %zu slots",
+		stats.hashEntries, stats.hashSlots, stats.getHashLoadFactor(), stats.offsetSlots);
+	if (stats.phases.total > 0.0)
+		ImGui::Text("Build %.2f s: trace %.2f s, refine %.2f s, previews %.2f s, T-vertices %.2f s, hash %.2f s",
+			stats.phases.total, stats.phases.trace, stats.phases.refine, stats.phases.snapshots,
+			stats.phases.fixTvertices, stats.phases.hash);
+	else
+		ImGui::Text("Loaded from file, no build counters");
+
+	if (ImGui::Button("Export JSON")) {
+		std::error_code error;
+		std::filesystem::create_directories(ROOT_DIR "data/grid_stats/", error);
+		std::string path = ROOT_DIR "data/grid_stats/" + std::filesystem::path(stats.name).stem().string() + ".json";
+		if (stats.save(path))
+			std::cout << "[Kerr] wrote grid statistics to " << path << std::endl;
+	}
+
+	if (ImGui::BeginTable("Grid Statistics", 8)) {
+		ImGui::TableSetupColumn("level");
+		ImGui::TableSetupColumn("rays");
+		ImGui::TableSetupColumn("steps / ray");
+		ImGui::TableSetupColumn("trace ms");
+		ImGui::TableSetupColumn("checked");
+		ImGui::TableSetupColumn("refined");
+		ImGui::TableSetupColumn("leaf blocks");
+		ImGui::TableSetupColumn("2pi crossings");
+		ImGui::TableHeadersRow();
+
+		auto row = [](std::string const& name, GridStats::Level const& level) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text(name.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%zu", level.rays);
+			ImGui::TableNextColumn(); ImGui::Text("%.1f", level.getStepsPerRay());
+			ImGui::TableNextColumn(); ImGui::Text("%.1f", level.traceSeconds * 1e3);
+			ImGui::TableNextColumn(); ImGui::Text("%zu", level.checkedBlocks);
+			ImGui::TableNextColumn(); ImGui::Text("%.1f %%", level.getRefinementRatio() * 100.0);
+			ImGui::TableNextColumn(); ImGui::Text("%zu", level.leafBlocks);
+			ImGui::TableNextColumn(); ImGui::Text("%zu", level.crossingBlocks);
+		};
+		for (auto const& level : stats.levels) {
+			// below the start level
+			if (level.rays == 0 && level.checkedBlocks == 0 && level.leafBlocks == 0) continue;
+			row(std::to_string(level.level), level);
+		}
+		row("total", stats.getTotal());
+		ImGui::EndTable();
+	}
+
+	// block level histogram
+	std::vector<float> leafBlocks;
+	for (auto const& level : stats.levels)
+		leafBlocks.push_back((float)level.leafBlocks);
+	static ImPlotAxisFlags flags = ImPlotAxisFlags_AutoFit;
+	if (!leafBlocks.empty() && ImPlot::BeginPlot("Leaf Blocks per Level", NULL, NULL, ImVec2(-1, 150), 0, flags, flags)) {
+		ImPlot::PlotBars("blocks", leafBlocks.data(), (int)leafBlocks.size());
+		ImPlot::EndPlot();
+	}
+}
+
 void KerrApp::renderSceneTab()
 {
 	ImGui::Checkbox("Render Environment Scene", &renderEnvironment_);
@@ -852,22 +1615,109 @@ void KerrApp::renderSceneTab()
 	}
 }
 
+void KerrApp::renderAnimationTab()
+{
+	static std::string pathName = "path";
+	ImGui::Text("Camera Path (saves/kerr/<name>.path.json)");
+	ImGui::PushItemWidth(ImGui::GetFontSize() * 7);
+	ImGui::InputText("path name", &pathName);
+	ImGui::PopItemWidth();
+	ImGui::SameLine();
+	if (ImGui::Button("Save")) {
+		std::error_code error;
+		std::filesystem::create_directories(ROOT_DIR "saves/kerr/", error);
+		path_.save(ROOT_DIR "saves/kerr/" + pathName + ".path.json");
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Load") && !isAnimating())
+		path_.load(ROOT_DIR "saves/kerr/" + pathName + ".path.json");
+
+	ImGui::BeginDisabled(isAnimating());
+	static float keyframeTime = 0.f;
+	ImGui::InputFloat("keyframe time s", &keyframeTime, 0.5f, 1.f);
+	if (ImGui::Button("Add Keyframe (grid position, camera view)")) {
+		CameraKeyframe keyframe;
+		keyframe.time = keyframeTime;
+		keyframe.positionRTP = { properties_.cam_rad_, properties_.cam_the_, properties_.cam_phi_ };
+		// phi is unwrapped along the path, move the shortest way from the previous keyframe
+		if (!path_.empty()) {
+			double previous = path_.getKeyframes().back().positionRTP.z;
+			keyframe.positionRTP.z += PI2 * std::round((previous - keyframe.positionRTP.z) / PI2);
+		}
+		keyframe.viewDirTP = cam_.getViewDirTP();
+		keyframe.speed = properties_.cam_vel_;
+		path_.add(keyframe);
+		keyframeTime += 1.f;
+	}
+
+	int removed = -1;
+	std::vector<CameraKeyframe> const& keyframes = path_.getKeyframes();
+	if (ImGui::BeginListBox("##keyframes", ImVec2(-FLT_MIN, ImGui::GetTextLineHeightWithSpacing() * 6))) {
+		for (int i = 0; i < keyframes.size(); ++i) {
+			CameraKeyframe const& k = keyframes[i];
+			ImGui::PushID(i);
+			if (ImGui::SmallButton("x")) removed = i;
+			ImGui::SameLine();
+			ImGui::Text("%.2fs: r %.2f, theta %.2f, phi %.2f, view (%.2f, %.2f), speed %.2f", k.time,
+				k.positionRTP.x, k.positionRTP.y, k.positionRTP.z, k.viewDirTP.x, k.viewDirTP.y, k.speed);
+			ImGui::PopID();
+		}
+		ImGui::EndListBox();
+	}
+	if (removed >= 0) path_.remove(removed);
+	if (ImGui::Button("Clear Path")) path_.clear();
+
+	ImGui::Separator();
+	ImGui::Text("Rendering (grid settings from the Grid tab)");
+	float fps = (float)path_.fps_;
+	if (ImGui::InputFloat("fps", &fps, 1.f, 10.f))
+		path_.fps_ = std::max(1.f, fps);
+	ImGui::SliderInt("look-ahead grids", &animationLookAhead_, 1, 32);
+	ImGui::Checkbox("Save grids", &animationSaveGrids_);
+	ImGui::PushItemWidth(ImGui::GetFontSize() * 7);
+	ImGui::InputText("output (data/animation/<name>/)", &animationName_);
+	ImGui::PopItemWidth();
+	ImGui::Text("%zu frames, %.2fs", path_.getFrameCount(), path_.getDuration());
+	ImGui::EndDisabled();
+
+	if (!isAnimating()) {
+		if (ImGui::Button("Render Animation"))
+			startAnimation();
+		return;
+	}
+
+	if (ImGui::Button("Stop")) {
+		stopAnimation();
+		return;
+	}
+	size_t frames = prefetcher_->getFrameCount();
+	ImGui::SameLine();
+	ImGui::ProgressBar(animationFrame_ / (float)frames);
+	ImGui::Text("rendered %zu / %zu frames, written %zu", animationFrame_, frames, frameWriter_->getWrittenCount());
+	ImGui::Text("grids built %zu / %zu, %zu ahead of the cursor, %.1fs worker time", prefetcher_->getBuiltCount(),
+		prefetcher_->getGridCount(), prefetcher_->getQueuedCount(), prefetcher_->getBuildSeconds());
+}
+
 void KerrApp::renderPerfWindow()
 {
+	// last measured frame, a few frames behind
+	double makeGridTime = profiler_->getStats("makeGrid").last;
+	double interpolateTime = profiler_->getStats("interpolate").last;
+
 	double weight = 0.05;
 	static double makeGridSum = 0, makeGridWeight = 0;
 	static double interpolateSum = 0, interpolateWeight = 0;
 
-	makeGridSum = (1.0 - weight) * makeGridSum + weight * makeGridTime_;
+	makeGridSum = (1.0 - weight) * makeGridSum + weight * makeGridTime;
 	makeGridWeight = (1.0 - weight) * makeGridWeight + weight;
-	interpolateSum = (1.0 - weight) * interpolateSum + weight * interpolateTime_;
+	interpolateSum = (1.0 - weight) * interpolateSum + weight * interpolateTime;
 	interpolateWeight = (1.0 - weight) * interpolateWeight + weight;
 
 	static std::string  makeGridText = "", interpolateText = "", makeGridTextAvg = "", interpolateTextAvg = "";
 	if (ImGui::Button("Get last compute time")) {
 
-		makeGridText = std::format("makeGrid took {:.3f} ms", makeGridTime_).c_str();
-		interpolateText = std::format("interpolate  took {:.3f} ms", interpolateTime_).c_str();
+		makeGridText = std::format("makeGrid took {:.3f} ms", makeGridTime).c_str();
+		interpolateText = std::format("interpolate  took {:.3f} ms", interpolateTime).c_str();
 	}
 	ImGui::Text(makeGridText.c_str());
 	ImGui::Text(interpolateText.c_str());
@@ -944,24 +1794,7 @@ void KerrApp::renderCameraTab() {
 }
 
 
-void KerrApp::initPerformanceQueries()
-{
-	glGenQueries(PERF_QUERY_COUNT, queryIDs_[queryBackBuffer_]);
-	glGenQueries(PERF_QUERY_COUNT, queryIDs_[queryFrontBuffer_]);
-	//glQueryCounter(queryIDs_[queryFrontBuffer_][1], GL_TIMESTAMP);
-}
-
-unsigned int KerrApp::getPerformanceQuery(int count)
-{
-	if (count >= PERF_QUERY_COUNT) return 0;
-	GLuint64 result;
-	glGetQueryObjectui64v(queryIDs_[queryFrontBuffer_][count], GL_QUERY_RESULT, &result);
-	return result;
-}
-
-void KerrApp::dumpState(std::string const& file) {
-	boost::json::object configuration;
-
+void KerrApp::storeState(boost::json::object& configuration) {
 	configuration["blackHole_a"] = properties_.blackHole_a_;
 	configuration["cam_rad"] = properties_.cam_rad_;
 	configuration["cam_the"] = properties_.cam_the_;
@@ -969,7 +1802,48 @@ void KerrApp::dumpState(std::string const& file) {
 	configuration["cam_vel"] = properties_.cam_vel_;
 	configuration["grid_strtLvl"] = properties_.grid_strtLvl_;
 	configuration["grid_maxLvl"] = properties_.grid_maxLvl_;
-	
+	configuration["grid_useSymmetry"] = properties_.grid_useSymmetry_;
+	configuration["grid_refinement"] = properties_.grid_refinement_;
+	configuration["grid_threshold"] = properties_.grid_threshold_;
+	configuration["grid_forceLvl"] = properties_.grid_forceLvl_;
+	configuration["grid_rayBudget"] = properties_.grid_rayBudget_;
+	configuration["mode"] = (int)mode_;
+	configuration["modePerformance"] = modePerformance_;
+	configuration["aberration"] = aberration_;
+	configuration["speed"] = speed_;
+	configuration["direction"] = { direction_.x, direction_.y, direction_.z };
+}
+
+void KerrApp::loadState(boost::json::object& configuration) {
+	jhelper::getValue(configuration, "blackHole_a", properties_.blackHole_a_);
+	jhelper::getValue(configuration, "cam_rad", properties_.cam_rad_);
+	jhelper::getValue(configuration, "cam_the", properties_.cam_the_);
+	jhelper::getValue(configuration, "cam_phi", properties_.cam_phi_);
+	jhelper::getValue(configuration, "cam_vel", properties_.cam_vel_);
+	jhelper::getValue(configuration, "grid_strtLvl", properties_.grid_strtLvl_);
+	jhelper::getValue(configuration, "grid_maxLvl", properties_.grid_maxLvl_);
+	jhelper::getValue(configuration, "grid_useSymmetry", properties_.grid_useSymmetry_);
+	jhelper::getValue(configuration, "grid_refinement", properties_.grid_refinement_);
+	jhelper::getValue(configuration, "grid_threshold", properties_.grid_threshold_);
+	jhelper::getValue(configuration, "grid_forceLvl", properties_.grid_forceLvl_);
+	jhelper::getValue(configuration, "grid_rayBudget", properties_.grid_rayBudget_);
+	int mode = (int)mode_;
+	if (jhelper::getValue(configuration, "mode", mode))
+		mode_ = (RenderMode)mode;
+	jhelper::getValue(configuration, "modePerformance", modePerformance_);
+	jhelper::getValue(configuration, "aberration", aberration_);
+	jhelper::getValue(configuration, "speed", speed_);
+	jhelper::getValue(configuration, "direction", direction_);
+}
+
+void KerrApp::dumpState(std::string const& file) {
+	boost::json::object configuration;
+	storeState(configuration);
+
+	boost::json::object cameraConfiguration;
+	cam_.storeConfig(cameraConfiguration);
+	configuration["camera"] = cameraConfiguration;
+
 	std::string json = boost::json::serialize(configuration);
 	std::ofstream outFile(ROOT_DIR "saves/kerr/" + file);
 	outFile << json;
@@ -995,17 +1869,24 @@ void KerrApp::readState(std::string const& file) {
 	}
 
 	boost::json::object configuration = v.get_object();
-	jhelper::getValue(configuration, "blackHole_a", properties_.blackHole_a_);
-	jhelper::getValue(configuration, "cam_rad", properties_.cam_rad_);
-	jhelper::getValue(configuration, "cam_the", properties_.cam_the_);
-	jhelper::getValue(configuration, "cam_phi", properties_.cam_phi_);
-	jhelper::getValue(configuration, "cam_vel", properties_.cam_vel_);
-	jhelper::getValue(configuration, "grid_strtLvl", properties_.grid_strtLvl_);
-	jhelper::getValue(configuration, "grid_maxLvl", properties_.grid_maxLvl_);
+	loadState(configuration);
+
+	boost::json::object cameraConfiguration;
+	if (jhelper::getValue(configuration, "camera", cameraConfiguration))
+		cam_.loadConfig(cameraConfiguration);
 
 	return;
 }
 
+void KerrApp::updateContent() {
+	updateGridBuild();
+	textureLoader_->update();
+
+	// runs while the gpu renders the previous frame
+	if (!isReplaying() && !isAnimating())
+		cam_.processInput(window_.getPtr(), dt_);
+}
+
 void KerrApp::processKeyboardInput() {
 
 	auto win = window_.getPtr();
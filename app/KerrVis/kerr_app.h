@@ -2,31 +2,38 @@
 
 #include <thread>
 #include <iostream>
+#include <unordered_map>
 
 #include <app/app.h>
 #include <helpers/uboBindings.h>
 #include <helpers/json_helper.h>
 #include <blacktracer/Const.h>
 #include <blacktracer/Grid.h>
+#include <blacktracer/PSHTablePack.h>
+#include <blacktracer/ReferenceTracer.h>
+#include <blacktracer/DeflectionError.h>
+#include <blacktracer/CameraPath.h>
+#include <blacktracer/GridPrefetcher.h>
+#include <blacktracer/GridQuantizer.h>
+#include <blacktracer/DenseGrid.h>
+#include <blacktracer/CompactGrid.h>
 
 #include <rendering/shader.h>
 #include <rendering/schwarzschildCamera.h>
 #include <rendering/window.h>
 #include <rendering/texture.h>
+#include <rendering/textureLoader.h>
 #include <rendering/buffers.h>
 #include <rendering/mesh.h>
 #include <cubeMapScene/SolarSystemScene.h>
 #include <cubeMapScene/CheckerSphereScene.h>
 #include <gui/gui.h>
 #include "guiElements.h"
+#include "frameWriter.h"
 
 #define MAX_STAR_LOD 6
-
-#define COMPUTE_PERFORMANCE
-#define PERF_QUERY_BUFFERS 2
-#define PERF_QUERY_COUNT 2
-#define MAKEGRID_QUERY 0
-#define INTERPOLATE_QUERY 1
+// number of grids whose hash tables are kept on the gpu at the same time, twice as many with compact tables
+#define MAX_RESIDENT_GRIDS 4
 
 
 class KerrApp : public GLApp{
@@ -35,6 +42,7 @@ class KerrApp : public GLApp{
 		COMPUTE,
 		MAKEGRID,
 		INTERPOLATE,
+		ERRORMAP,
 		RENDER
 	};
 
@@ -42,13 +50,20 @@ public:
 	
 	KerrApp(int width, int height);
 	~KerrApp() {
-		joinGridThread();
+		stopAnimation();
+		cancelGridBuild();
+		joinReferenceThread(true);
 	}
 
 private:
+	void updateContent() override;
 	void renderContent() override;
 	void renderGui() override;
 	void processKeyboardInput() override;
+	void storeCamera(boost::json::object& obj) override { cam_.storeConfig(obj); }
+	void loadCamera(boost::json::object& obj) override { cam_.loadConfig(obj); }
+	void storeState(boost::json::object& obj) override;
+	void loadState(boost::json::object& obj) override;
 
 	RenderMode mode_;
 
@@ -61,22 +76,28 @@ private:
 	std::shared_ptr<CubeMap> starTexture_;	// for "manual" rendering as point light sources
 	std::shared_ptr<CubeMap> starTexture2_;	// for default sampling at high LOD values
 	std::shared_ptr<Texture2D> mwPanorama_;
+	// decodes image files in the background, the textures are placeholders until uploaded
+	std::shared_ptr<TextureLoader> textureLoader_;
 	std::shared_ptr<FBOTexture> fboTexture_;
 	std::shared_ptr<FBOTexture> gpuGrid_;
 	std::shared_ptr<FBOTexture> interpolatedGrid_;
 	int fboScale_;
 
 	std::shared_ptr<SSBO> testSSBO_;
-	// SSBOs for makeGrid shader
+	// SSBOs for makeGrid shader, hold the packed tables of all resident grids
 	std::shared_ptr<SSBO> hashTableSSBO_;
 	std::shared_ptr<SSBO> hashPosSSBO_;
 	std::shared_ptr<SSBO> offsetTableSSBO_;
-	std::shared_ptr<SSBO> tableSizeSSBO_;
+	std::shared_ptr<SSBO> tableDirectorySSBO_;
+	// level scales of the compact tables
+	std::shared_ptr<SSBO> levelScaleSSBO_;
 	
 	bool compute_;
 	std::shared_ptr<ComputeShader> computeShader_;
 	std::shared_ptr<ComputeShader> makeGridShader_;
+	std::shared_ptr<ComputeShader> makeCompactGridShader_;
 	std::shared_ptr<ComputeShader> interpolateShader_;
+	std::shared_ptr<ComputeShader> blendShader_;
 	std::shared_ptr<BlackHoleShaderGui> renderShader_;
 	glm::ivec3 testWorkGroups_;
 	glm::ivec3 makeGridWorkGroups_;
@@ -87,10 +108,78 @@ private:
 	std::shared_ptr<ShaderBase> testShader_;
 
 	std::shared_ptr<Grid> grid_;
-	std::atomic<std::shared_ptr<Grid>> newGrid_;
-	std::atomic<bool> gridChange_;
+	// grids with hash tables on the gpu, index = id in gridPack_
+	std::vector<std::shared_ptr<Grid>> residentGrids_;
+	PSHTablePack gridPack_;
+	// resident grids as 16 bit tables (CompactGrid) instead of gridPack_
+	bool compactTables_;
+	CompactTablePack compactPack_;
+	// encoded tables of the resident grids, kept while they stay resident
+	std::unordered_map<Grid const*, std::shared_ptr<CompactGrid>> compactGrids_;
+	int currentGridID_;
+	// grids of a selection built as job, applied once the job is done
+	struct GridBuild {
+		GridQuantizer::Selection selection;
+		// nullptr for the grids to build, written by the job
+		std::vector<std::shared_ptr<Grid>> grids;
+		std::shared_ptr<GridProgress> progress;
+		JobHandle job;
+		// expansion of a single new grid, ready before its hash is built
+		std::shared_ptr<DenseGrid> dense;
+		std::atomic<bool> denseReady{ false };
+		bool denseShown = false;
+		// a newer request was served from the cached grids, the build must not replace them
+		bool superseded = false;
+	};
+	std::shared_ptr<GridBuild> gridBuild_;
+	// rays per level of the running or last build
+	std::shared_ptr<GridProgress> gridProgress_;
+	// snapshot of the running build, resident until the build is applied
+	std::shared_ptr<Grid> previewGrid_;
+	// show the coarse levels of a build while it refines
+	bool gridPreview_;
+	// dense upload or hash for new grids, shared with the build jobs
+	std::shared_ptr<DenseGridPolicy> densePolicy_;
+	// grid whose DenseGrid is in gpuGrid_ (rotated by densePhiShift_), makeGrid.comp is skipped for it
+	std::shared_ptr<Grid> denseGrid_;
+	float densePhiShift_;
 	bool makeNewGrid_;
-	std::shared_ptr<std::thread> gridThread_;
+
+	// snaps properties_ to a lattice of reusable grids, settings from resources/grid_quantization.json
+	GridQuantizer quantizer_;
+	GridQuantizer::Selection gridSelection_;
+	// second resident grid blended into the deflection map of the current grid (-1 = none)
+	int blendGridID_;
+	float blendWeight_;
+	std::shared_ptr<FBOTexture> blendedGrid_;
+	// camera phi - grid phi
+	float phiShift_;
+	// request a grid when properties_ change, after the running build if there is one
+	bool autoGrid_;
+	// a build is requested once the cancelled one returned
+	bool gridRequested_;
+
+	// per pixel reference deflection map
+	std::shared_ptr<ReferenceTracer> reference_;
+	std::shared_ptr<std::thread> referenceThread_;
+	std::shared_ptr<DeflectionError> deflectionError_;
+	// statistics of the current grid, computed once it is resident (immutable then)
+	std::shared_ptr<GridStats> gridStats_;
+	std::weak_ptr<Grid> gridStatsSource_;
+	std::shared_ptr<FBOTexture> errorMap_;
+	bool referenceQuality_;		// render with the reference map instead of the interpolated grid
+	bool referenceUploaded_;
+
+	// offline animation along path_, renders one path frame per window frame once its grid is built
+	CameraPath path_;
+	std::shared_ptr<GridPrefetcher> prefetcher_;
+	std::shared_ptr<FrameWriter> frameWriter_;
+	// presented frame at offscreen resolution for the image files
+	std::shared_ptr<FBOTexture> animationTexture_;
+	size_t animationFrame_;
+	std::string animationName_;
+	int animationLookAhead_;
+	bool animationSaveGrids_;
 
 	bool aberration_;
 	glm::vec3 direction_;
@@ -104,14 +193,9 @@ private:
 	double t0_, dt_;
 	float tPassed_;
 
-	double makeGridTime_, interpolateTime_;
-
 	bool vSync_;
 	bool modePerformance_;
 
-	unsigned int queryIDs_[PERF_QUERY_BUFFERS][PERF_QUERY_COUNT];
-	unsigned int queryBackBuffer_ = 0, queryFrontBuffer_ = 1;
-
 	void initShaders();
 	void reloadShaders();
 	void initCubeMaps();
@@ -119,30 +203,66 @@ private:
 	void resizeTextures();
 	void resizeGridTextures();
 	void loadStarTextures();
-	void loadStarTile(int level, int ti, int tj, int face, int faceSize, int tileSize, GLenum target, std::string path);
+	void loadStarTile(int level, int ti, int tj, int face, int tileSize, std::vector<unsigned int> const& tileData);
 
 	void initTestSSBO();
 	void initMakeGridSSBO();
+	int getMaxResidentGrids() const { return compactTables_ ? 2 * MAX_RESIDENT_GRIDS : MAX_RESIDENT_GRIDS; }
+	// switches the table format of the resident grids, evicts the oldest ones that don't fit
+	void setCompactTables(bool compact);
+	void addResidentGrid(std::shared_ptr<Grid> grid);
+	// adds the grid without selecting it, the shown grids aren't evicted
+	void keepResidentGrid(std::shared_ptr<Grid> grid);
+	int findResidentGrid(GridProperties const& props) const;
+	// index in residentGrids_, -1 if it isn't resident
+	int indexOfResidentGrid(std::shared_ptr<Grid> const& grid) const;
+	void selectGrid(int id);
 	void updateMakeGridSSBO();
 
-	void makeGrid();
-	void joinGridThread();
+	// selects the grids for properties_, builds missing ones as job and cancels outdated builds
+	void requestGrid();
+	static void makeGrids(GridBuild& build, DenseGridPolicy& densePolicy, CancellationToken const& token);
+	// applies the finished build, starts the requested one after a cancelled build
+	void updateGridBuild();
+	void applyGridSelection(GridQuantizer::Selection const& selection, std::vector<std::shared_ptr<Grid>> const& grids);
+	void showPreviewGrid(std::shared_ptr<Grid> snapshot, GridQuantizer::Selection const& selection);
+	// uploads the expanded grid of the build, it becomes resident once the build is done
+	void showDenseGrid(GridBuild& build);
+	void dropPreviewGrid();
+	void cancelGridBuild();
+
+	void traceReference();
+	void joinReferenceThread(bool cancel = false);
+	bool referenceValid() const;
+	void uploadReference();
+	void computeDeflectionError();
 
 	void uploadCameraVectors();
 
-	void gpuMakeGrid(bool print);
-	void gpuInterpolate(bool print);
+	void startAnimation();
+	void stopAnimation();
+	bool isAnimating() const { return prefetcher_ != nullptr; }
+	// selects grid and camera of the current animation frame, false if its grid isn't built yet
+	bool prepareAnimationFrame();
+	void captureAnimationFrame();
+
+	// gridID -1 = current grid, target nullptr = interpolatedGrid_
+	void gpuMakeGrid(bool print, int gridID = -1);
+	// makeGrid pass of the compact tables, one dispatch per level
+	void gpuMakeCompactGrid(bool print, int gridID);
+	void gpuInterpolate(bool print, std::shared_ptr<FBOTexture> target = nullptr);
+	void gpuBlend();
 
 	void renderShaderTab();
 	void renderCameraTab();
 	void renderSkyTab();
 	void renderGridTab();
+	void renderGridProgress(GridProgress const& progress);
+	void renderGridStatsTab();
 	void renderSceneTab();
+	void renderAnimationTab();
 	void renderPerfWindow();
 
-	void initPerformanceQueries();
-	unsigned int getPerformanceQuery(int count);
-
 	void dumpState(std::string const& file);
 	void readState(std::string const& file);
 	void printDebug();
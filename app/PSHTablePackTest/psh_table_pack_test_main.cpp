@@ -0,0 +1,89 @@
+#include <blacktracer/Grid.h>
+#include <blacktracer/PSHTablePack.h>
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Packs the hash tables of several grids like the resident grids of KerrApp and checks that
+// PSHTablePack::lookup (the CPU version of makeGrid.comp) finds every point of each grid,
+// also after the oldest grid is evicted and the pack is rebuilt. Returns 1 if a lookup fails.
+// Usage: PSHTablePackTest_main
+
+static int failures = 0;
+
+static void check(bool ok, std::string const& what)
+{
+	if (!ok) {
+		if (failures < 10) std::cerr << "[PSHTablePackTest] failed: " << what << std::endl;
+		failures++;
+	}
+}
+
+static bool same(float a, float b) { return a == b || (std::isnan(a) && std::isnan(b)); }
+
+static void checkGrid(PSHTablePack const& pack, int id, Grid const& grid, std::string const& name)
+{
+	// grids without refinement aren't hashed, their dummy entry matches no key
+	bool hashed = !grid.hasher.hashTable.empty();
+	size_t found = 0;
+	for (auto const& [ij, thphi] : grid.CamToCel) {
+		glm::ivec2 key{ (int)(ij >> 32), (int)(uint32_t)ij };
+		glm::vec2 value = pack.lookup(id, key);
+		bool ok = hashed ? same(value.x, (float)thphi.x) && same(value.y, (float)thphi.y) : value == glm::vec2(-2.f);
+		found += ok;
+		check(ok, name + " point (" + std::to_string(key.x) + ", " + std::to_string(key.y) + ")");
+	}
+	// a point between the points of the coarsest level that wasn't refined
+	glm::ivec2 missing{ -1, -1 };
+	for (auto const& [ij, level] : grid.blockLevels) {
+		if (level != grid.getProperties().grid_strtLvl_) continue;
+		missing = { (int)(ij >> 32) + 1, (int)(uint32_t)ij + 1 };
+		break;
+	}
+	if (missing.x >= 0 && hashed)
+		check(pack.lookup(id, missing) == glm::vec2(-2.f), name + " point not in the grid");
+	std::cout << "[PSHTablePackTest] " << name << " (id " << id << "): " << found << " of "
+		<< grid.CamToCel.size() << (hashed ? " points found" : " points not hashed") << std::endl;
+}
+
+int main() {
+	// a symmetric, a full and a grid without refinement (no hash, dummy entry)
+	std::vector<std::shared_ptr<Grid>> grids;
+	std::vector<std::string> names = { "symmetric", "full", "unrefined", "full finer" };
+	for (int g = 0; g < 4; ++g) {
+		GridProperties props;
+		props.blackHole_a_ = 0.9;
+		props.cam_vel_ = 0.3;
+		props.cam_the_ = g == 0 ? PI1_2 : PI1_2 - 0.2;
+		props.grid_maxLvl_ = g == 2 ? props.grid_strtLvl_ : (g == 3 ? 7 : 6);
+		auto grid = std::make_shared<Grid>(props);
+		grid->saveAsGpuHash();
+		grids.push_back(grid);
+	}
+
+	PSHTablePack pack;
+	for (int g = 0; g < 3; ++g)
+		check(pack.add(grids[g]->hasher) == g, "ids in order of adding");
+	check(pack.size() == 3, "pack size");
+	for (int g = 0; g < 3; ++g)
+		checkGrid(pack, g, *grids[g], names[g]);
+	check(pack.lookup(3, { 0, 0 }) == glm::vec2(-2.f), "id out of range");
+
+	// the oldest grid is evicted, the rest keeps its order (KerrApp::initMakeGridSSBO)
+	pack.clear();
+	check(pack.size() == 0 && pack.byteSize() == 0, "cleared pack");
+	for (int g = 1; g < 4; ++g)
+		pack.add(grids[g]->hasher);
+	for (int g = 1; g < 4; ++g)
+		checkGrid(pack, g - 1, *grids[g], names[g]);
+
+	if (failures) {
+		std::cerr << "[PSHTablePackTest] " << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "[PSHTablePackTest] passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include <helpers/profilerStats.h>
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Checks the GL free bookkeeping of GpuProfiler: the frame ring of the queries in flight and the
+// statistics of the sample history. Returns 1 if a check fails. Usage: ProfilerStatsTest_main
+
+static int failures = 0;
+
+static void check(bool ok, std::string const& what)
+{
+	if (!ok) {
+		std::cerr << "[ProfilerStatsTest] failed: " << what << std::endl;
+		failures++;
+	}
+}
+
+static bool near(double a, double b) { return std::abs(a - b) < 1e-12; }
+
+static void testFrameRing()
+{
+	FrameRing ring(3);
+	// the GPU keeps up: every frame is read the frame after it was recorded
+	for (int frame = 0; frame < 10; ++frame) {
+		int slot = ring.begin();
+		check(slot == frame % 3 && ring.isRecording(), "slots in turn");
+		ring.end();
+		std::vector<int> read;
+		int count = ring.collect([](int) { return true; }, [&read](int slot) { read.push_back(slot); });
+		check(count == 1 && read == std::vector<int>{ slot }, "ready frame is read");
+	}
+	check(ring.getDroppedCount() == 0 && ring.getPendingCount() == 0, "no frames dropped");
+
+	// the GPU is behind: nothing is ready, the oldest pending frame is dropped for its slot
+	FrameRing behind(3);
+	for (int frame = 0; frame < 3; ++frame) {
+		behind.begin();
+		behind.end();
+	}
+	check(behind.getPendingCount() == 3 && behind.getDroppedCount() == 0, "depth frames pending");
+	int slot = behind.begin();
+	check(slot == 0 && behind.getDroppedCount() == 1 && behind.getPendingCount() == 2, "oldest pending slot dropped");
+	behind.end();
+	behind.begin();
+	behind.end();
+	check(behind.getDroppedCount() == 2 && behind.getFrameCount() == 5, "frame and drop counts");
+
+	// pending slots are 2, 0, 1 (oldest first). Only slot 2 and 1 are ready, reading stops at slot 0
+	std::vector<int> read;
+	auto readSlot = [&read](int slot) { read.push_back(slot); };
+	int count = behind.collect([](int slot) { return slot != 0; }, readSlot);
+	check(count == 1 && read == std::vector<int>{ 2 }, "collect stops at the oldest slot that isn't ready");
+	count = behind.collect([](int) { return true; }, readSlot);
+	check(count == 2 && read == std::vector<int>{ 2, 0, 1 }, "collect reads oldest first");
+	check(behind.collect([](int) { return true; }, readSlot) == 0, "slots are read once");
+
+	// end without begin is ignored
+	FrameRing idle(2);
+	idle.end();
+	check(idle.getPendingCount() == 0 && idle.getFrameCount() == 0, "end without begin");
+}
+
+static void testSampleHistory()
+{
+	SampleHistory history(5);
+	check(history.getStats().count == 0, "empty history");
+
+	// 7 samples wrap the ring, 3 4 5 6 7 are kept in this order
+	for (double sample : { 100.0, 200.0, 3.0, 7.0, 5.0, 4.0, 6.0 })
+		history.add(sample);
+	check(history.size() == 5, "size is capped at the capacity");
+	check(history.getSamples() == std::vector<double>{ 3.0, 7.0, 5.0, 4.0, 6.0 }, "samples oldest first");
+
+	SampleHistory::Stats stats = history.getStats();
+	check(stats.count == 5, "count");
+	check(stats.last == 6.0, "last is the newest sample");
+	check(stats.min == 3.0, "min");
+	check(stats.median == 5.0, "median");
+	// rank 0.95 * 4 = 3.8 between 6 and 7
+	check(near(stats.p95, 6.8), "p95");
+	check(near(stats.mean, 5.0), "mean");
+
+	// even count: median between the middle ranks
+	check(near(SampleHistory::percentile({ 1.0, 2.0, 4.0, 8.0 }, 0.5), 3.0), "median of an even count");
+	check(SampleHistory::percentile({ 2.0 }, 0.95) == 2.0, "percentile of one sample");
+
+	history.clear();
+	history.add(1.0);
+	check(history.getSamples() == std::vector<double>{ 1.0 } && history.getStats().last == 1.0, "clear");
+}
+
+int main() {
+	testFrameRing();
+	testSampleHistory();
+
+	if (failures) {
+		std::cerr << "[ProfilerStatsTest] " << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "[ProfilerStatsTest] passed" << std::endl;
+	return 0;
+}
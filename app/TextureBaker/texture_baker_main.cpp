@@ -0,0 +1,72 @@
+#include <rendering/textureBaker.h>
+#include <rendering/panoramaConverter.h>
+#include <helpers/RootDir.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Bakes image files into <file>.ktx2, which the TextureLoader uses instead of the file.
+// Directories are searched recursively for .jpg, .png and .hdr files, default is TEX_DIR.
+// With --cube n the files are equirectangular panoramas, converted to cube maps with n x n faces
+// (TextureLoader::loadPanorama).
+// Usage: TextureBaker_main [--box] [--uncompressed] [--srgb] [--no-mipmaps] [--threads n] [--cube n] [files or directories]
+
+static bool isImage(std::filesystem::path const& path) {
+	std::string ext = path.extension().string();
+	return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".hdr";
+}
+
+int main(int argc, char** argv) {
+	TextureBaker baker;
+	int cubeSize = 0;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--box") baker.filter_ = TextureBaker::Filter::Box;
+		else if (arg == "--uncompressed") baker.compress_ = false;
+		else if (arg == "--srgb") baker.srgb_ = true;
+		else if (arg == "--no-mipmaps") baker.mipmaps_ = false;
+		else if (arg == "--threads" && i + 1 < argc) baker.threads_ = std::stoi(argv[++i]);
+		else if (arg == "--cube" && i + 1 < argc) cubeSize = std::stoi(argv[++i]);
+		else if (arg.rfind("--", 0) == 0) {
+			std::cout << "Usage: " << argv[0] << " [--box] [--uncompressed] [--srgb] [--no-mipmaps] [--threads n] [--cube n] [files or directories]" << std::endl;
+			return 1;
+		}
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty()) inputs.push_back(TEX_DIR);
+
+	std::vector<std::string> files;
+	for (auto const& input : inputs) {
+		if (std::filesystem::is_directory(input)) {
+			for (auto const& entry : std::filesystem::recursive_directory_iterator(input)) {
+				if (entry.is_regular_file() && isImage(entry.path()))
+					files.push_back(entry.path().string());
+			}
+		}
+		else {
+			files.push_back(input);
+		}
+	}
+
+	int failed = 0;
+	double time = 0.0;
+	for (auto const& file : files) {
+		if (cubeSize > 0) {
+			PanoramaConverter converter(baker.threads_);
+			if (converter.bake(file, cubeSize, baker)) time += converter.getConvertTime();
+			else failed++;
+		}
+		else if (baker.bake(file)) {
+			time += baker.getBakeTime();
+		}
+		else {
+			failed++;
+		}
+	}
+	std::cout << "[TextureBaker] baked " << files.size() - failed << " of " << files.size() << " textures in " << time << "ms" << std::endl;
+
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+#include <rendering/textureLoader.h>
+#include <helpers/RootDir.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Runs TextureLoader with a decoder that sleeps for a random time and an uploader that records
+// the GL side, so no GL context is needed. Checks that images are uploaded in request and face
+// order, also when the staging memory is used up, that failed decodes don't block later requests,
+// and finish(). Returns 1 if a check fails. Usage: TextureLoaderTest_main [rounds]
+
+static int failures = 0;
+
+static void check(bool ok, std::string const& what)
+{
+	if (!ok) {
+		if (failures < 10) std::cerr << "[TextureLoaderTest] failed: " << what << std::endl;
+		failures++;
+	}
+}
+
+// logs the calls of the loader, every failEvery-th upload reports full staging memory
+class RecordingUploader : public TextureUploader {
+public:
+	RecordingUploader(int failEvery) : failEvery_(failEvery) {}
+
+	std::shared_ptr<Texture2D> createPlaceholder(GLenum target) override { return nullptr; }
+	bool upload(Texture2D* texture, GLenum target, DecodedImage const& image, bool srgb) override {
+		if (failEvery_ && ++uploads_ % failEvery_ == 0) {
+			retries++;
+			return false;
+		}
+		log.push_back(image.path.substr(std::string(TEX_DIR).size()) + "@" + std::to_string(target));
+		return true;
+	}
+	void finish(Texture2D* texture, bool mipmaps) override { log.push_back(mipmaps ? "finish mipmaps" : "finish"); }
+
+	std::vector<std::string> log;
+	int retries = 0;
+
+private:
+	int failEvery_;
+	int uploads_ = 0;
+};
+
+static void runRound(unsigned int seed, int failEvery)
+{
+	auto uploader = std::make_shared<RecordingUploader>(failEvery);
+	std::atomic<int> decodes = 0;
+	auto decoder = [&decodes, seed](std::string const& path, DecodedImage& image) {
+		std::mt19937 gen(seed + (unsigned int)std::hash<std::string>()(path));
+		std::this_thread::sleep_for(std::chrono::microseconds(gen() % 3000));
+		decodes++;
+		if (path.find("bad") != std::string::npos) return false;
+		image.path = path;
+		image.width = image.height = 4;
+		image.components = 3;
+		image.pixels = std::shared_ptr<unsigned char>((unsigned char*)std::malloc(48), std::free);
+		return true;
+	};
+
+	std::string round = " (seed " + std::to_string(seed) + ")";
+	{
+		TextureLoader loader(uploader, 4, decoder);
+		// at most one image per update
+		loader.uploadBudget_ = 1;
+
+		int readyCalls = 0;
+		auto a = loader.load("a.png", false, true, [&readyCalls] { readyCalls++; });
+		auto cube = loader.loadCubeMap({ "f0.png", "f1.png", "f2.png", "f3.png", "f4.png", "f5.png" });
+		auto bad = loader.load("bad.png");
+		auto c = loader.load("c.png");
+		check(!a.isReady(), "nothing is uploaded before update" + round);
+
+		while (loader.getPendingCount() > 0) {
+			loader.update();
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		check(a.ready.get() && readyCalls == 1, "onReady called once" + round);
+		check(cube.ready.get() && c.ready.get(), "requests after a failed one are uploaded" + round);
+		check(!bad.ready.get(), "failed decode is reported" + round);
+		check(decodes == 9, "every image is decoded once" + round);
+
+		auto d = loader.load("d.png");
+		loader.finish();
+		check(d.isReady() && d.ready.get(), "finish uploads all requests" + round);
+		check(loader.getPendingCount() == 0, "nothing pending after finish" + round);
+
+		// destroyed while the decode may still run, the handle reports failure then
+		loader.load("e.png");
+	}
+
+	std::vector<std::string> expected = { "a.png@" + std::to_string(GL_TEXTURE_2D), "finish mipmaps" };
+	for (int face = 0; face < 6; ++face)
+		expected.push_back("f" + std::to_string(face) + ".png@" + std::to_string(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face));
+	expected.push_back("finish");
+	for (std::string name : { "c.png", "d.png" }) {
+		expected.push_back(name + "@" + std::to_string(GL_TEXTURE_2D));
+		expected.push_back("finish");
+	}
+	check(uploader->log == expected, "upload order" + round);
+	if (failEvery) check(uploader->retries > 0, "staging retries" + round);
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::stoi(argv[1]) : 30;
+	std::mt19937 gen(1);
+	for (int r = 0; r < rounds; ++r)
+		runRound(gen(), r % 3 == 0 ? 4 : 0);
+
+	if (failures) {
+		std::cerr << "[TextureLoaderTest] " << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "[TextureLoaderTest] " << rounds << " rounds passed" << std::endl;
+	return 0;
+}
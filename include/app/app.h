@@ -1,6 +1,12 @@
 #include <gui/gui.h>
 #include <rendering/window.h>
 #include <helpers/Timer.hpp>
+#include <rendering/shaderWatcher.h>
+#include <rendering/gpuProfiler.h>
+#include <app/frameRecorder.h>
+#include <helpers/jobSystem.h>
+
+#include <boost/json.hpp>
 
 class GLApp {
 public:
@@ -14,13 +20,39 @@ protected:
 	GLWindow window_;
 	Gui gui_;
 	FrameTimer frameTimer_;
+	// reloads shaders when their files are saved
+	ShaderWatcher shaderWatcher_;
+	// GPU times of the frame, hand to the components to measure their passes
+	std::shared_ptr<GpuProfiler> profiler_;
+	// records sessions and replays them as benchmarks
+	FrameRecorder recorder_;
+	// worker threads for background work (grid builds, tile loading, texture decode)
+	std::shared_ptr<JobSystem> jobs_;
 
 	bool showGui_;
 	bool showFps_;
+	bool showProfiler_;
 
 
 	virtual void renderContent() = 0;
 	virtual void processKeyboardInput() {}
+	// cpu work of the next frame (input, camera, finished jobs), runs while the gpu renders the previous one
+	virtual void updateContent() {}
 	virtual void renderGui();
 	virtual void renderFPSWindow();
+
+	// camera and parameters of a frame for recording and replaying, see FrameRecorder
+	virtual void storeCamera(boost::json::object& obj) {}
+	virtual void loadCamera(boost::json::object& obj) {}
+	virtual void storeState(boost::json::object& obj) {}
+	virtual void loadState(boost::json::object& obj) {}
+
+	// time in s for the animation of the frame, use instead of glfwGetTime to be replayable
+	double getTime() { return recorder_.getTime(glfwGetTime()); }
+	// the camera is set from the log, don't process its input
+	bool isReplaying() const { return recorder_.isReplaying(); }
+
+private:
+	void loadFrame(FrameLog::Frame const& frame);
+	void recordFrame();
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <helpers/frameLog.h>
+#include <helpers/profilerStats.h>
+#include <rendering/gpuProfiler.h>
+
+/// <summary>
+/// Records the frames of an interactive session into a FrameLog (saves/<name>.bhvlog) and
+/// replays it as a benchmark. The replay runs with a fixed timestep (or the recorded one) as fast
+/// as the application renders and measures the frame, CPU and GPU time of every frame.
+/// The results are written to data/<name>.replay.csv (per frame) and data/<name>.passes.csv
+/// (per GPU pass). GPU times arrive a few frames late, so both modes finish a few frames after
+/// the last frame. The application hands in the camera and state JSON, see GLApp.
+/// </summary>
+class FrameRecorder {
+public:
+	enum class Mode {
+		IDLE,
+		RECORDING,
+		REPLAYING,
+		// waiting for the GPU times of the last frames
+		FINISHING
+	};
+
+	FrameRecorder(std::shared_ptr<GpuProfiler> profiler);
+	~FrameRecorder();
+
+	FrameRecorder(FrameRecorder const&) = delete;
+	FrameRecorder& operator=(FrameRecorder const&) = delete;
+
+	void startRecording(std::string const& name);
+	// timestep in s, <= 0 replays with the recorded frame times
+	bool startReplay(std::string const& name, double timestep);
+	void stop();
+
+	/// <summary>
+	/// Call at the start of every frame. Returns the frame to replay, nullptr if not replaying.
+	/// </summary>
+	FrameLog::Frame const* beginFrame();
+	// call before the buffer swap, camera and state are only used when recording
+	void endFrame(std::string const& camera, std::string const& state);
+
+	/// <summary>
+	/// Application time for the wall clock time clock in s. While replaying, the time advances
+	/// by the timestep per frame, afterwards it continues from the replayed time.
+	/// </summary>
+	double getTime(double clock);
+
+	Mode getMode() const { return mode_; }
+	bool isRecording() const { return mode_ == Mode::RECORDING; }
+	bool isReplaying() const { return mode_ == Mode::REPLAYING; }
+
+	// statistics of the last replay in ms
+	SampleHistory::Stats getFrameStats() const { return frameStats_; }
+	SampleHistory::Stats getCpuStats() const { return cpuStats_; }
+	SampleHistory::Stats getGpuStats() const { return gpuStats_; }
+
+	// controls for the options window of the application
+	void renderGui();
+
+	static std::string getLogPath(std::string const& name);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// measured times of a replayed frame in ms
+	struct Sample {
+		double time = 0.0;
+		double frameMs = 0.0;
+		double cpuMs = 0.0;
+		double gpuMs = 0.0;
+	};
+
+	std::shared_ptr<GpuProfiler> profiler_;
+	Mode mode_;
+	// mode before FINISHING
+	Mode finishing_;
+	std::string name_;
+
+	FrameLog log_;
+	// current frame in log_ / samples_
+	size_t frame_;
+	int finishFrames_;
+	Clock::time_point frameStart_;
+	bool frameStarted_;
+
+	// recording, JSON of the last stored frame
+	std::string lastCamera_;
+	std::string lastState_;
+
+	// replaying
+	double timestep_;
+	double replayTime_;
+	std::vector<Sample> samples_;
+	std::vector<std::string> passes_;
+	std::map<std::string, SampleHistory> passHistory_;
+	SampleHistory::Stats frameStats_, cpuStats_, gpuStats_;
+
+	// profiler frame index to frame_ of the frames waiting for their GPU times
+	std::map<uint64_t, size_t> gpuFrames_;
+
+	// application time
+	double offset_;
+	double lastClock_;
+	double lastTime_;
+
+	// GUI
+	std::string guiName_;
+	float guiTimestepMs_;
+	bool guiRecordedTimestep_;
+
+	void onGpuFrame(uint64_t frame, std::map<std::string, double> const& times);
+	void finish();
+	void finishRecording();
+	void finishReplay();
+	bool writeResults() const;
+};
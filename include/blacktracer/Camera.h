@@ -44,6 +44,16 @@ public:
 	/// <returns></returns>
 	std::vector<float> getParamArray();;
 
+	/// <summary>
+	/// Traces a single ray leaving the camera in the camera sky direction (theta, phi).
+	/// On return theta and phi hold the celestial sky coordinates of the ray,
+	/// or -1 if the ray falls into the black hole.
+	/// </summary>
+	/// <param name="theta">Camera sky theta in, celestial theta out.</param>
+	/// <param name="phi">Camera sky phi in, celestial phi out.</param>
+	/// <param name="step">Number of integration steps taken.</param>
+	void traceRay(double& theta, double& phi, int& step) const;
+
 	~Camera(){};
 };
 
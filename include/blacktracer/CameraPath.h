@@ -0,0 +1,67 @@
+#pragma once
+
+#include <blacktracer/Grid.h>
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Camera state at a point in time of an animation.
+/// </summary>
+struct CameraKeyframe {
+	// s from the start of the animation
+	double time = 0.0;
+	// radius, theta, phi of the camera (see SchwarzschildCamera::getPositionRTP)
+	glm::dvec3 positionRTP = { 10.0, PI1_2, 0.0 };
+	// view direction in the local frame of the camera (see SchwarzschildCamera::getViewDirTP)
+	glm::dvec2 viewDirTP = { PI1_2, PI1_2 };
+	// camera speed for the grid, see GridProperties::cam_vel_
+	double speed = 0.0;
+};
+
+/// <summary>
+/// Keyframed camera path for offline animations. Positions are interpolated with a
+/// Catmull-Rom spline (phi is unwrapped, so paths can orbit the black hole several times),
+/// view direction and speed linearly. Stored as JSON:
+/// { "fps": 30, "keyframes": [ { "time": 0, "positionRTP": [r, theta, phi], "viewDirTP": [theta, phi], "speed": 0 }, ... ] }
+/// </summary>
+class CameraPath
+{
+public:
+	CameraPath(double fps = 30.0);
+
+	// keeps the keyframes sorted by time
+	void add(CameraKeyframe const& keyframe);
+	void remove(size_t index);
+	void clear() { keyframes_.clear(); }
+
+	std::vector<CameraKeyframe> const& getKeyframes() const { return keyframes_; }
+	bool empty() const { return keyframes_.empty(); }
+	double getDuration() const;
+	// frames from the first to the last keyframe at fps_, both included
+	size_t getFrameCount() const;
+	double getFrameTime(size_t frame) const;
+
+	/// <summary>
+	/// Camera at time t, clamped to the first and last keyframe.
+	/// </summary>
+	CameraKeyframe sample(double t) const;
+
+	/// <summary>
+	/// Grid of the camera at time t: base with the camera position and speed of the path,
+	/// phi wrapped to [0, 2pi).
+	/// </summary>
+	GridProperties getGridProperties(double t, GridProperties const& base) const;
+	// the grid of every frame
+	std::vector<GridProperties> getFrameGrids(GridProperties const& base) const;
+
+	bool save(std::string const& path) const;
+	bool load(std::string const& path);
+
+	double fps_;
+
+private:
+	std::vector<CameraKeyframe> keyframes_;
+};
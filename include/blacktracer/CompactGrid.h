@@ -0,0 +1,99 @@
+#pragma once
+
+#include <blacktracer/Grid.h>
+#include <blacktracer/FlatHashMap.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// entries per grid in the level scale table, positions of deeper grids don't fit into 16 bit tags anyway
+#define COMPACT_MAX_LEVELS 16
+
+/// <summary>
+/// Perfect hash of a grid with 32 bits per entry instead of 128 (decoded by makeCompactGrid.comp).
+/// Tags hold i and j in 16 bits each, the offsets their two components in 16 bits each.
+/// Values hold theta in the low and phi in the high 16 bits, bit 0 tells the mode:
+/// - absolute (0): theta in 15 bits (0 .. 32766 over [0, pi], 32767 = shadow), phi in 16 bits over [0, 2 pi).
+///   Used for the points of the start level and where no parent is outside the shadow.
+/// - difference (1): signed theta (15 bits) and phi (16 bits) in units of the scale of the point's level,
+///   relative to the prediction from the decoded parents: mean of the 2 edge or 4 block corners of the
+///   block the point splits, phi the short way around. The scale of a level is chosen for the
+///   smallest mean error, the differences that don't fit are stored absolute.
+/// Both angles are off by at most half the absolute resolution (see getErrorBound), in smooth regions
+/// by half the level scale. Failed rays (NaN) are stored as shadow.
+/// Decoding runs level by level, the parents of a point are decoded before it.
+/// </summary>
+class CompactGrid
+{
+public:
+	CompactGrid() {}
+	// needs the hash of the grid (Grid::saveAsGpuHash), grids without hash get an empty table
+	CompactGrid(Grid const& grid);
+
+	bool empty() const { return values.empty(); }
+	size_t byteSize() const;
+
+	/// <summary>
+	/// CPU reader, decodes all points like makeCompactGrid.comp (without phi rotation and mirroring).
+	/// Keys are i << 32 | j as in Grid::CamToCel, shadow is (-1, -1).
+	/// </summary>
+	void decode(FlatHashMap<glm::vec2>& decoded) const;
+
+	/// <summary>
+	/// Max error of theta and phi per level of the decoded grid against the grid it was encoded from,
+	/// shadow and failed rays excluded.
+	/// </summary>
+	std::vector<glm::dvec2> measureError(Grid const& grid) const;
+
+	// max error of theta and phi for any point
+	static glm::dvec2 getErrorBound();
+
+	static uint32_t packTag(glm::ivec2 key) { return (uint32_t)key.x | (uint32_t)key.y << 16; }
+	static glm::ivec2 unpackTag(uint32_t tag) { return { (int)(tag & 0xffff), (int)(tag >> 16) }; }
+	// level at which the point key is traced first
+	static int getPointLevel(glm::ivec2 key, int startLevel, int maxLevel);
+
+	std::vector<uint32_t> values;
+	std::vector<uint32_t> tags;
+	std::vector<uint32_t> offsetTable;
+	int hashTableWidth = 0;
+	int offsetTableWidth = 0;
+
+	int startLevel = 0;
+	int maxLevel = 0;
+	// grid width, j wraps around
+	int width = 0;
+	// unit of the differences per level (theta, phi)
+	std::vector<glm::vec2> levelScales;
+
+private:
+	// hash table index of key
+	size_t getSlot(glm::ivec2 key) const;
+};
+
+/// <summary>
+/// Packs the compact tables of several grids for the SSBOs of makeCompactGrid.comp, like PSHTablePack.
+/// The directory holds one entry per table: x = hash table width, y = offset table width,
+/// z = start of the hash table, w = start of the offset table. The scales of table id start at
+/// id * COMPACT_MAX_LEVELS.
+/// </summary>
+class CompactTablePack
+{
+public:
+	CompactTablePack() {}
+
+	// empty tables get a dummy entry that never matches a key
+	int add(CompactGrid const& grid);
+	void clear();
+
+	int size() const { return (int)directory.size(); }
+	size_t byteSize() const;
+
+	std::vector<uint32_t> values;
+	std::vector<uint32_t> tags;
+	std::vector<uint32_t> offsetTable;
+	std::vector<glm::ivec4> directory;
+	std::vector<glm::vec2> levelScales;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <blacktracer/Grid.h>
+
+#include <map>
+#include <vector>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Angular error statistics of all pixels belonging to grid blocks of one level.
+/// </summary>
+struct LevelError {
+	size_t pixels = 0;
+	// pixels where both maps hit the black hole
+	size_t shadow = 0;
+	// pixels where exactly one of both maps hits the black hole
+	size_t shadowMismatch = 0;
+	// angular error on the celestial sky in radians
+	double maxError = 0.0;
+	double meanError = 0.0;
+};
+
+/// <summary>
+/// Compares an approximated deflection map (e.g. the interpolated grid) against
+/// a reference map (e.g. from the ReferenceTracer) and reports the angular error
+/// per grid block level. Both maps hold (theta, phi) per pixel and (-1, -1) for shadow.
+/// </summary>
+class DeflectionError
+{
+public:
+	DeflectionError(std::vector<glm::vec2> const& reference, std::vector<glm::vec2> const& approximation,
+		int width, int height, std::shared_ptr<Grid> grid = nullptr);
+
+	/// <summary>
+	/// Great circle distance between two celestial sky positions (theta, phi).
+	/// </summary>
+	static double angularDistance(glm::dvec2 const& a, glm::dvec2 const& b);
+
+	// statistics per block level, level -1 collects pixels with unknown level
+	std::map<int, LevelError> const& getLevels() const { return levels_; }
+	LevelError const& getTotal() const { return total_; }
+	// per pixel angular error in radians, -1 for shadow mismatch, 0 if both are in shadow
+	std::vector<float> const& getErrorMap() const { return errorMap_; }
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+
+	void print() const;
+
+private:
+	int width_, height_;
+	std::map<int, LevelError> levels_;
+	LevelError total_;
+	std::vector<float> errorMap_;
+
+	static void addPixel(LevelError& stats, double error);
+	static void finish(LevelError& stats, double errorSum);
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <blacktracer/Grid.h>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Grid expanded on the CPU to the image makeGrid.comp computes from the perfect hash:
+/// M x fullN texels (row = theta index), symmetric grids mirrored to the full sky and phi rotated by phiShift.
+/// x, y = celestial theta, phi (-1 in the shadow, -2 where the grid has no point),
+/// z = level of the block whose top left corner is the point in the traced grid (0 if none).
+/// Uploaded with one texture update, it replaces the hash, its SSBOs and the makeGrid pass.
+/// </summary>
+class DenseGrid
+{
+public:
+	DenseGrid() {}
+	DenseGrid(Grid const& grid, float phiShift = 0.f);
+
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+	float getPhiShift() const { return phiShift_; }
+	// rgba32f, staging data of the upload
+	std::vector<glm::vec4> const& getTexels() const { return texels_; }
+	size_t byteSize() const { return texels_.size() * sizeof(glm::vec4); }
+
+	// size of the expanded grid without expanding it
+	static size_t byteSize(Grid const& grid);
+
+private:
+	int width_ = 0;
+	int height_ = 0;
+	float phiShift_ = 0.f;
+	std::vector<glm::vec4> texels_;
+};
+
+/// <summary>
+/// Chooses how a new grid gets to the GPU: expanded on the CPU (DenseGrid) or as perfect hash
+/// expanded by makeGrid.comp. The hash is built anyway for the resident grids and the grid file,
+/// the dense path only shows the grid before. It is used if the expansion fits into maxBytes_ and
+/// is expected to be faster than the hash, from the timings of the grids built so far.
+/// Thread safe, the timings are added by the grid jobs.
+/// </summary>
+class DenseGridPolicy
+{
+public:
+	DenseGridPolicy() {}
+
+	bool useDense(Grid const& grid) const;
+
+	// measured times of hashing points grid points and expanding texels texels
+	void addHashTiming(size_t points, double seconds);
+	void addExpandTiming(size_t texels, double seconds);
+
+	double getHashSecondsPerPoint() const;
+	double getExpandSecondsPerTexel() const;
+
+	bool enabled_ = true;
+	size_t maxBytes_ = 256 << 20;
+
+private:
+	mutable std::mutex mutex_;
+	// moving averages, initialised with the rates of a desktop CPU
+	double hashSecondsPerPoint_ = 2e-6;
+	double expandSecondsPerTexel_ = 2e-8;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <iterator>
+
+/// <summary>
+/// splitmix64 finalizer, same as Grid::hashing_func2.
+/// </summary>
+struct SplitMix64 {
+	uint64_t operator()(uint64_t x) const {
+		x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+		x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+		return x ^ (x >> 31);
+	}
+};
+
+/// <summary>
+/// Open addressing hash map for 64 bit grid keys (i << 32 | j) with linear probing.
+/// Keys and values are stored in separate arrays, so probing only touches the key array
+/// and usually stays within one cache line. Entries can't be erased.
+/// The interface covers what Grid needs from std::unordered_map
+/// (find, operator[], iteration over (key, value) pairs).
+/// </summary>
+template <typename V, typename Hash = SplitMix64>
+class FlatHashMap
+{
+public:
+	// never a valid grid key, i and j are at most 2^31
+	static constexpr uint64_t EMPTY = ~UINT64_C(0);
+
+	template <bool Const>
+	class Iterator {
+		using Map = std::conditional_t<Const, FlatHashMap const, FlatHashMap>;
+		using Value = std::conditional_t<Const, V const, V>;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using difference_type = std::ptrdiff_t;
+		using value_type = std::pair<uint64_t, V>;
+		using reference = std::pair<uint64_t, Value&>;
+
+		struct Pointer {
+			reference ref;
+			reference* operator->() { return &ref; }
+		};
+		using pointer = Pointer;
+
+		Iterator(Map* map, size_t slot) : map_(map), slot_(slot) { skipEmpty(); }
+
+		reference operator*() const { return { map_->keys_[slot_], map_->values_[slot_] }; }
+		Pointer operator->() const { return { **this }; }
+
+		Iterator& operator++() { ++slot_; skipEmpty(); return *this; }
+		bool operator==(Iterator const& other) const { return slot_ == other.slot_; }
+		bool operator!=(Iterator const& other) const { return slot_ != other.slot_; }
+
+	private:
+		Map* map_;
+		size_t slot_;
+
+		void skipEmpty() {
+			while (slot_ < map_->keys_.size() && map_->keys_[slot_] == EMPTY) ++slot_;
+		}
+	};
+
+	using iterator = Iterator<false>;
+	using const_iterator = Iterator<true>;
+
+	FlatHashMap() {}
+
+	iterator begin() { return { this, 0 }; }
+	iterator end() { return { this, keys_.size() }; }
+	const_iterator begin() const { return { this, 0 }; }
+	const_iterator end() const { return { this, keys_.size() }; }
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	size_t capacity() const { return keys_.size(); }
+
+	void clear() {
+		keys_.clear();
+		values_.clear();
+		size_ = 0;
+	}
+
+	/// <summary>
+	/// Makes room for n entries without rehashing.
+	/// </summary>
+	void reserve(size_t n) {
+		size_t cap = 16;
+		while (cap * MAX_LOAD_NUM < n * MAX_LOAD_DEN) cap *= 2;
+		if (cap > keys_.size()) rehash(cap);
+	}
+
+	iterator find(uint64_t key) {
+		size_t slot = findSlot(key);
+		return { this, slot };
+	}
+
+	const_iterator find(uint64_t key) const {
+		size_t slot = findSlot(key);
+		return { this, slot };
+	}
+
+	size_t count(uint64_t key) const { return findSlot(key) != keys_.size(); }
+
+	V& operator[](uint64_t key) {
+		if ((size_ + 1) * MAX_LOAD_DEN > keys_.size() * MAX_LOAD_NUM) reserve(size_ + 1);
+		size_t slot = probe(key);
+		if (keys_[slot] == EMPTY) {
+			keys_[slot] = key;
+			values_[slot] = V();
+			size_++;
+		}
+		return values_[slot];
+	}
+
+	/// <summary>
+	/// Inserts or overwrites n entries, rehashing at most once.
+	/// </summary>
+	void insert(uint64_t const* keys, V const* values, size_t n) {
+		reserve(size_ + n);
+		for (size_t k = 0; k < n; ++k) {
+			size_t slot = probe(keys[k]);
+			if (keys_[slot] == EMPTY) {
+				keys_[slot] = keys[k];
+				size_++;
+			}
+			values_[slot] = values[k];
+		}
+	}
+
+private:
+	// rehash above a load factor of 1/2, misses (neighbour lookups outside the grid) are common
+	static constexpr size_t MAX_LOAD_NUM = 1;
+	static constexpr size_t MAX_LOAD_DEN = 2;
+
+	std::vector<uint64_t> keys_;
+	std::vector<V> values_;
+	size_t size_ = 0;
+
+	// slot of key or of the empty slot where key would be inserted, capacity has to be > 0
+	size_t probe(uint64_t key) const {
+		size_t mask = keys_.size() - 1;
+		size_t slot = Hash()(key) & mask;
+		while (keys_[slot] != key && keys_[slot] != EMPTY)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	// slot of key or capacity if key is not in the map
+	size_t findSlot(uint64_t key) const {
+		if (keys_.empty()) return 0;
+		size_t slot = probe(key);
+		return keys_[slot] == key ? slot : keys_.size();
+	}
+
+	void rehash(size_t cap) {
+		std::vector<uint64_t> oldKeys(cap, EMPTY);
+		std::vector<V> oldValues(cap);
+		std::swap(oldKeys, keys_);
+		std::swap(oldValues, values_);
+		for (size_t s = 0; s < oldKeys.size(); ++s) {
+			if (oldKeys[s] == EMPTY) continue;
+			size_t slot = probe(oldKeys[s]);
+			keys_[slot] = oldKeys[s];
+			values_[slot] = std::move(oldValues[s]);
+		}
+	}
+};
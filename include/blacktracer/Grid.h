@@ -11,6 +11,11 @@
 #include <blacktracer/BlackHole.h>
 
 #include <blacktracer/PSHOffsetTable.h>
+#include <blacktracer/RefinementPolicy.h>
+#include <blacktracer/FlatHashMap.h>
+#include <blacktracer/GridProgress.h>
+#include <blacktracer/GridStats.h>
+#include <helpers/jobSystem.h>
 
 #include <vector>
 #include <string>
@@ -27,6 +32,8 @@
 
 struct GridProperties {
 
+	// refinement settings are not serialized (kept compatible with existing grid files),
+	// they are part of the file name instead
 	template < class Archive >
 	void serialize(Archive& ar)
 	{
@@ -42,6 +49,15 @@ struct GridProperties {
 
 	int grid_strtLvl_ = 1;
 	int grid_maxLvl_ = 10;
+
+	// trace only the upper half of the camera sky if the camera is on the equatorial plane
+	bool grid_useSymmetry_ = true;
+
+	int grid_refinement_ = (int)RefinementMode::THRESHOLD;
+	double grid_threshold_ = PRECCELEST;
+	int grid_forceLvl_ = FORCE_REFINE_LVL;
+	// max number of rays, highest error blocks are refined first (0 = unlimited)
+	int grid_rayBudget_ = 0;
 };
 
 class Grid
@@ -53,6 +69,8 @@ class Grid
 	void serialize(Archive& ar)
 	{
 		ar(MAXLEVEL_, N_, M_, hasher, props_);
+		// symmetry is not stored explicitly, M = 2 * (N - 1) only for full grids
+		equafactor_ = (M_ == 2 * (N_ - 1)) ? 1 : 0;
 	}
 
 #pragma endregion
@@ -92,8 +110,9 @@ public:
 
 	/// <summary>
 	/// 1 if rotation axis != camera axis, 0 otherwise
+	/// 0 means the grid is symmetric to the equatorial plane and only contains the upper half
 	/// </summary>
-	int equafactor_;
+	int equafactor_ = 1;
 
 	/// <summary>
 	/// N = max vertical rays, M = max horizontal rays.
@@ -106,25 +125,27 @@ public:
 	/// <summary>
 	/// Mapping from camera sky position to celestial angle.
 	/// </summary>
-	std::unordered_map <uint64_t, glm::dvec2, hashing_func2> CamToCel;
+	FlatHashMap<glm::dvec2, hashing_func2> CamToCel;
 
-	std::vector<int> steps;
-
-	std::unordered_map <uint64_t, glm::dvec2, hashing_func2> CamToAD;
+	FlatHashMap<glm::dvec2, hashing_func2> CamToAD;
 
 	PSHOffsetTable hasher;
 
 	/// <summary>
 	/// Mapping from block position to level at that point.
 	/// </summary>
-	std::unordered_map <uint64_t, int, hashing_func2> blockLevels;
+	FlatHashMap<int, hashing_func2> blockLevels;
 
 	/// <summary>
 	/// Initializes an empty new instance of the <see cref="Grid"/> class.
 	/// </summary>
 	Grid() {};
 
-	Grid(GridProperties props);
+	/// <summary>
+	/// Traces a new grid. The token is checked per level and per batch of rays, a cancelled
+	/// grid returns early and stays incomplete (see isCancelled). progress is updated per batch.
+	/// </summary>
+	Grid(GridProperties props, CancellationToken const& token = CancellationToken(), std::shared_ptr<GridProgress> progress = nullptr);
 
 	/// <summary>
 	/// Initializes a new instance of the <see cref="Grid"/> class.
@@ -139,20 +160,58 @@ public:
 	// create grid and save in outGrid
 	// loads from file if possible, else creates new grid
 	// returns true if read from file
-	static bool makeGrid(std::shared_ptr<Grid>& outGrid, GridProperties props);
+	static bool makeGrid(std::shared_ptr<Grid>& outGrid, GridProperties props,
+		CancellationToken const& token = CancellationToken(), std::shared_ptr<GridProgress> progress = nullptr);
 	static bool loadFromFile(std::shared_ptr<Grid>& outGrid, std::string filename);
 	static bool loadFromFile(std::shared_ptr<Grid>& outGrid, GridProperties props);
 	static bool saveToFile(std::shared_ptr<Grid> inGrid);
+	// true if a grid file for props exists
+	static bool hasFile(GridProperties const& props);
 	static std::string getFileNameFromConfig(GridProperties const& props);
 	std::string getFileNameFromConfig() const;
 
+	// builds hasher from CamToCel if it isn't built yet, needed to make the grid resident on the gpu or to save it
 	void saveAsGpuHash();
 
 	/// <summary>
-	/// Prints the grid cam.
+	/// Statistics of the grid: the counters of its build and the block levels, shadow,
+	/// 2 pi crossings and hash load of the grid as it is now (see GridStats).
 	/// </summary>
-	/// <param name="level">The level.</param>
-	void printGridCam(int level);
+	GridStats getStats() const;
+
+	GridProperties const& getProperties() const { return props_; }
+
+	/// <summary>
+	/// Height of the full grid (N for full grids, 2 * (N - 1) + 1 for symmetric grids).
+	/// </summary>
+	int getFullN() const { return equafactor_ ? N_ : 2 * (N_ - 1) + 1; }
+
+	/// <summary>
+	/// True if a camera at the given position sees a sky symmetric to the equatorial plane.
+	/// </summary>
+	static bool isSymmetric(GridProperties const& props);
+
+	/// <summary>
+	/// Returns the level of the finest block containing the camera sky position (theta, phi),
+	/// or -1 if the block levels are unknown (e.g. grid was loaded from file).
+	/// </summary>
+	int getBlockLevel(double theta, double phi) const;
+
+	/// <summary>
+	/// Looks up the celestial sky position of grid point (i, j). Indices outside of the grid
+	/// are continued over the poles (and mirrored at the equator for symmetric grids), j wraps around.
+	/// </summary>
+	/// <returns>False if the point is not in the grid.</returns>
+	bool findCel(int64_t i, int64_t j, glm::dvec2& thphi) const;
+
+	// number of rays traced for this grid (0 if loaded from file)
+	size_t getRayCount() const { return rayCount_; }
+	// the build was cancelled, the grid is incomplete and must not be used or saved
+	bool isCancelled() const { return cancelled_; }
+	// level traced so far if this is a preview snapshot of a running build, -1 for complete grids
+	int getSnapshotLevel() const { return snapshotLevel_; }
+	// level at which point (i, j) is traced first
+	int getPointLevel(uint32_t i, uint32_t j) const;
 
 	/// <summary>
 	/// Finalizes an instance of the <see cref="Grid"/> class.
@@ -166,6 +225,14 @@ private:
 	std::shared_ptr<Metric> metric_;
 	std::shared_ptr<Camera> cam_;
 	double blackHoleA_;
+	std::shared_ptr<RefinementPolicy> refinement_;
+	size_t rayCount_ = 0;
+	CancellationToken token_;
+	std::shared_ptr<GridProgress> progress_;
+	bool cancelled_ = false;
+	int snapshotLevel_ = -1;
+	// build counters, the rest of the statistics is computed by getStats
+	GridStats stats_;
 
 	//std::shared_ptr<BlackHole> black;
 
@@ -173,6 +240,10 @@ private:
 	std::unordered_set<uint64_t, hashing_func2> checkblocks;
 
 	void init();
+	// polls the token, true once the build is cancelled
+	bool checkCancelled();
+	// copy of the blocks traced up to level, post processed like a finished grid
+	std::shared_ptr<Grid> makeSnapshot(int level) const;
 
 	/** ------------------------------ POST PROCESSING ------------------------------ **/
 
@@ -193,6 +264,11 @@ private:
 	/// <param name="block">The block to check and fix.</param>
 	void fixTvertices(std::pair<uint64_t, int> block);
 
+	/// <summary>
+	/// Fixes the t-vertices of all blocks in blockLevels.
+	/// </summary>
+	void fixAllTvertices();
+
 	/// <summary>
 	/// Recursively checks the edge of a block for adjacent smaller blocks causing t-vertices.
 	/// Adjusts the value of smaller block vertices positioned on the edge to be halfway
@@ -291,6 +367,13 @@ private:
 	/// <param name="level">The current level.</param>
 	void adaptiveBlockIntegration(int level);
 
+	/// <summary>
+	/// Raytraces the grid by refining the blocks with the highest error estimate first,
+	/// until all blocks are fine enough or the ray budget is spent.
+	/// </summary>
+	/// <param name="level">The current level.</param>
+	void budgetBlockIntegration(int level);
+
 	/// <summary>
 	/// Raytraces the rays starting in camera sky from the theta, phi positions defined
 	/// in the provided vectors.
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <blacktracer/Grid.h>
+#include <helpers/jobSystem.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// Builds the grids of an animation ahead of the render cursor as low priority jobs.
+/// Consecutive frames with the same grid file name share one grid. At most lookAhead grids
+/// ahead of the cursor are submitted, grids behind the cursor are released and their jobs
+/// cancelled, so memory stays bounded for long animations. Every grid traces with its own metric,
+/// so the builds of several frames run concurrently.
+/// </summary>
+class GridPrefetcher
+{
+public:
+	GridPrefetcher(std::shared_ptr<JobSystem> jobs, std::vector<GridProperties> const& frames, int lookAhead = 4, bool saveGrids = false);
+	// cancels the jobs and waits for the running ones
+	~GridPrefetcher();
+
+	GridPrefetcher(GridPrefetcher const&) = delete;
+	GridPrefetcher& operator=(GridPrefetcher const&) = delete;
+
+	/// <summary>
+	/// Grid of frame, nullptr if it isn't built yet. Moves the cursor to frame, frames are
+	/// expected in increasing order.
+	/// </summary>
+	std::shared_ptr<Grid> tryGet(size_t frame);
+	// waits until the grid of frame is built
+	std::shared_ptr<Grid> get(size_t frame);
+
+	size_t getFrameCount() const { return frameJobs_.size(); }
+	// distinct grids of all frames
+	size_t getGridCount() const { return jobs_.size(); }
+	size_t getBuiltCount() const;
+	// grids built or being built ahead of the cursor
+	size_t getQueuedCount() const;
+	// summed build time of all jobs in s
+	double getBuildSeconds() const;
+
+private:
+	struct Job {
+		GridProperties props;
+		std::shared_ptr<Grid> grid;
+		bool done = false;
+		JobHandle handle;
+	};
+
+	std::shared_ptr<JobSystem> jobSystem_;
+	// job of every frame
+	std::vector<size_t> frameJobs_;
+	std::vector<Job> jobs_;
+	size_t lookAhead_;
+	bool saveGrids_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable gridBuilt_;
+	// next job to submit, job of the render cursor
+	size_t next_;
+	size_t cursor_;
+	size_t built_;
+	double buildSeconds_;
+
+	void moveCursor(size_t job);
+	// submits the jobs up to lookAhead_ ahead of the cursor, mutex_ has to be locked
+	void submitJobs();
+	void build(size_t index, CancellationToken const& token);
+};
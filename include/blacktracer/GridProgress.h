@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Grid;
+
+/// <summary>
+/// Progress of a grid build, written by the building thread after every batch of rays
+/// and read by the GUI. A grid traces one level after the other; the ray count of the
+/// coming levels is extrapolated from the growth of the last level to estimate the time left.
+/// With snapshots enabled the build also publishes a usable grid after every level
+/// (T-vertices fixed and hashed), so a preview can be shown while it refines.
+/// </summary>
+class GridProgress
+{
+public:
+	struct Level {
+		int level = 0;
+		// rays queued for the level and traced so far
+		size_t queued = 0;
+		size_t traced = 0;
+		double seconds = 0.0;
+	};
+
+	GridProgress(bool snapshots = false) : snapshots_(snapshots) {}
+
+	std::vector<Level> getLevels() const;
+	size_t getTracedCount() const;
+	// since start
+	double getSeconds() const;
+	/// <summary>
+	/// Estimated seconds until all levels are traced, negative while unknown
+	/// (before the first rays are traced and until the growth of the levels is known).
+	/// </summary>
+	double getEta() const;
+	bool isDone() const;
+
+	bool wantsSnapshots() const { return snapshots_; }
+	// the latest snapshot if it wasn't taken yet, else nullptr
+	std::shared_ptr<Grid> takeSnapshot();
+
+	// called by the building grid, start resets the progress
+	void start(int maxLevel, size_t rayBudget);
+	void beginLevel(int level);
+	void queueRays(size_t rays);
+	void addTracedRays(size_t rays);
+	void finish();
+	// replaces a snapshot that wasn't taken
+	void publishSnapshot(std::shared_ptr<Grid> snapshot);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	mutable std::mutex mutex_;
+	std::vector<Level> levels_;
+	int maxLevel_ = 0;
+	size_t rayBudget_ = 0;
+	Clock::time_point start_;
+	Clock::time_point levelStart_;
+	bool done_ = false;
+	bool snapshots_;
+	std::shared_ptr<Grid> snapshot_;
+
+	double getSecondsLocked() const;
+};
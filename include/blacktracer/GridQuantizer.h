@@ -0,0 +1,86 @@
+#pragma once
+
+#include <blacktracer/Grid.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Snaps the camera of GridProperties to a lattice so that nearby cameras share grids:
+/// log spaced radius, uniform theta (anchored at the equator, symmetric grids stay symmetric)
+/// and uniform speed. Phi needs no grid of its own, the metric is axisymmetric, so a grid for
+/// phi = 0 is exact for any phi after rotating the celestial phi by the camera phi.
+/// A request is served by the cached lattice grid (or blend of two) with the smallest error,
+/// else by the nearest lattice grid, else by the exact grid if the lattice error exceeds the bound.
+/// </summary>
+class GridQuantizer
+{
+public:
+	// lattice and error bound, stored as JSON (see load / save)
+	struct Settings {
+		bool enabled = true;
+		// relative radius step, r = (1 + radiusStep)^k (0 = exact radius)
+		double radiusStep = 0.02;
+		// theta = pi / 2 + k * thetaStep (0 = exact theta)
+		double thetaStep = 0.02;
+		// speed = k * velocityStep (0 = exact speed)
+		double velocityStep = 0.01;
+		// grids at phi = 0, rotated on the gpu
+		bool rotatePhi = true;
+		// interpolate between two cached grids along one lattice axis
+		bool blend = true;
+		// max estimated shift of the lensed sky in radians, see estimateError
+		double maxError = 0.02;
+	};
+
+	struct Candidate {
+		GridProperties props;
+		double weight = 1.0;
+	};
+
+	struct Selection {
+		// requested grid
+		GridProperties target;
+		// one grid, or two grids to blend with their weights
+		std::vector<Candidate> grids;
+		// added to the celestial phi of the grids
+		double phiShift = 0.0;
+		// estimated error in radians
+		double error = 0.0;
+		// all grids were cached
+		bool cached = false;
+	};
+
+	GridQuantizer() {}
+	GridQuantizer(Settings const& settings) : settings_(settings) {}
+
+	/// <summary>
+	/// Grids to render the camera of target with. isCached tells if a grid is on the gpu or on disk.
+	/// </summary>
+	Selection select(GridProperties const& target, std::function<bool(GridProperties const&)> const& isCached) const;
+
+	// nearest lattice grid of props
+	GridProperties snap(GridProperties const& props) const;
+
+	/// <summary>
+	/// First order shift of the lensed sky in radians when rendering camera a with the grid of camera b:
+	/// moving on the camera sphere rotates the sky by the angle moved, the radius changes the angular
+	/// size of the shadow (~ 3 sqrt(3) / r) and the speed the aberration (~ asin(v)).
+	/// Infinite if the grids differ in anything but the camera.
+	/// </summary>
+	static double estimateError(GridProperties const& a, GridProperties const& b);
+
+	bool load(std::string const& path);
+	bool save(std::string const& path) const;
+
+	Settings settings_;
+
+private:
+	// lattice coordinate of props along axis (0 radius, 1 theta, 2 speed) and back
+	double toLattice(GridProperties const& props, int axis) const;
+	void fromLattice(GridProperties& props, int axis, double k) const;
+	double getStep(int axis) const;
+	// props with the phi the grid is built for
+	GridProperties alignPhi(GridProperties props) const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+/// <summary>
+/// Statistics of a grid for tuning the refinement and catching regressions of the grid build
+/// (see Grid::getStats). The build counters (rays, steps, refinement, phase times) are collected
+/// while the grid is traced and stay zero for grids loaded from file; the rest is computed from
+/// the finished grid. Loaded grids only have their hash, so the points are counted from its
+/// entries and the block counts stay zero. Rays are counted at the level of their point, the first level whose
+/// lattice contains it.
+/// </summary>
+class GridStats
+{
+public:
+	struct Level {
+		int level = 0;
+		size_t rays = 0;
+		// integration steps of the rays
+		size_t steps = 0;
+		double traceSeconds = 0.0;
+		// blocks of the level checked for refinement and refined into 4 blocks of the next level
+		size_t checkedBlocks = 0;
+		size_t refinedBlocks = 0;
+		// leaf blocks of the level (block level histogram) and those whose corners cross phi = 2 pi
+		size_t leafBlocks = 0;
+		size_t crossingBlocks = 0;
+
+		double getRefinementRatio() const { return checkedBlocks ? (double)refinedBlocks / checkedBlocks : 0.0; }
+		double getStepsPerRay() const { return rays ? (double)steps / rays : 0.0; }
+	};
+
+	// seconds per phase of the build, trace = integration of the rays,
+	// total includes the hash once it is built (Grid::saveAsGpuHash)
+	struct Phases {
+		double trace = 0.0;
+		double refine = 0.0;
+		double snapshots = 0.0;
+		double fixTvertices = 0.0;
+		double hash = 0.0;
+		double total = 0.0;
+	};
+
+	std::string name;
+	int width = 0;
+	int height = 0;
+	bool symmetric = false;
+
+	// index = level, up to the max level of the grid
+	std::vector<Level> levels;
+	Phases phases;
+
+	// grid points, points in the shadow and rays that failed (NaN)
+	size_t points = 0;
+	size_t shadowPoints = 0;
+	size_t failedPoints = 0;
+
+	// entries and slots of the perfect hash (0 if it isn't built)
+	size_t hashEntries = 0;
+	size_t hashSlots = 0;
+	size_t offsetSlots = 0;
+
+	Level& getLevel(int level);
+	Level getTotal() const;
+	double getShadowFraction() const { return points ? (double)shadowPoints / points : 0.0; }
+	double getHashLoadFactor() const { return hashSlots ? (double)hashEntries / hashSlots : 0.0; }
+
+	boost::json::object toJson() const;
+	bool save(std::string const& path) const;
+};
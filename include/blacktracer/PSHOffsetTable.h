@@ -68,7 +68,7 @@ public:
 	int hashTableWidth;
 	int n;
 
-	glm::ivec2 hashFunc(glm::ivec2 key);
+	glm::ivec2 hashFunc(glm::ivec2 key) const;
 
 	PSHOffsetTable():n(0) {};
 
@@ -78,6 +78,9 @@ public:
 
 	void writeToFile(std::string const& fileName) const;
 
+	// keys and values of the filled slots, also for tables loaded from file (n isn't stored)
+	void getEntries(std::vector<glm::ivec2>& keys, std::vector<glm::vec2>& values) const;
+
 private:
 
 	std::vector<glm::ivec2> elements;
@@ -111,9 +114,9 @@ private:
 
 	bool OffsetWorks(OffsetBucket bucket, glm::ivec2 offset);
 
-	glm::ivec2 hash1(glm::ivec2 key);
+	glm::ivec2 hash1(glm::ivec2 key) const;
 
-	glm::ivec2 hash0(glm::ivec2 key);
+	glm::ivec2 hash0(glm::ivec2 key) const;
 
 	glm::ivec2 hashFunc(glm::ivec2 key, glm::ivec2 offset);
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <blacktracer/PSHOffsetTable.h>
+
+#include <vector>
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Packs the perfect spatial hash tables of several grids into one set of tables,
+/// so that all of them can be resident in the same SSBOs (see makeGrid.comp).
+/// The directory holds one entry per table:
+/// x = hash table width, y = offset table width,
+/// z = start of the hash table, w = start of the offset table (in table entries, not bytes).
+/// </summary>
+class PSHTablePack
+{
+public:
+	PSHTablePack() {}
+
+	/// <summary>
+	/// Appends a table to the pack and returns its id (index into the directory).
+	/// Empty tables (grids without refinement) get a dummy entry that never matches a key.
+	/// </summary>
+	int add(PSHOffsetTable const& table);
+	void clear();
+
+	int size() const { return (int)directory.size(); }
+	size_t byteSize() const;
+
+	/// <summary>
+	/// CPU version of hashLookup in makeGrid.comp.
+	/// Returns the stored value of key in table id or (-2, -2) if key is not in the table.
+	/// </summary>
+	glm::vec2 lookup(int id, glm::ivec2 key) const;
+
+	std::vector<float> hashTable;	// vec2 per entry
+	std::vector<int> hashPosTag;	// ivec2 per entry
+	std::vector<int> offsetTable;	// ivec2 per entry
+	std::vector<glm::ivec4> directory;
+};
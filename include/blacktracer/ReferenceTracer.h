@@ -0,0 +1,60 @@
+#pragma once
+
+#include <blacktracer/Grid.h>
+#include <blacktracer/Camera.h>
+#include <blacktracer/MetricClass.h>
+
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Brute-force per-pixel tracer. Integrates one ray for every pixel of a deflection map
+/// instead of interpolating an adaptive grid, using all available cores.
+/// Used as ground truth for grid interpolation and as a final quality render mode.
+/// </summary>
+class ReferenceTracer
+{
+public:
+	ReferenceTracer(GridProperties props);
+
+	/// <summary>
+	/// Traces a deflection map of size width x height with the same pixel layout
+	/// as the interpolated grid (see pixInterpolation.comp). Blocks until done or cancelled.
+	/// </summary>
+	/// <param name="threads">Number of worker threads, 0 = hardware concurrency.</param>
+	void trace(int width, int height, int threads = 0);
+
+	/// <summary>
+	/// Maps a deflection map pixel to its camera sky position (theta, phi).
+	/// </summary>
+	static glm::dvec2 pixelToCamSky(int x, int y, int width, int height);
+
+	void cancel() { cancel_ = true; }
+	bool isDone() const { return done_; }
+	float getProgress() const;
+
+	GridProperties const& getProperties() const { return props_; }
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+	// traced celestial sky coordinates (theta, phi) per pixel, (-1, -1) for rays ending in the black hole
+	std::vector<glm::vec2> const& getMap() const { return map_; }
+	// time of the last trace in ms
+	double getTraceTime() const { return traceTime_; }
+
+private:
+	GridProperties props_;
+	std::shared_ptr<Metric> metric_;
+	std::shared_ptr<Camera> cam_;
+
+	int width_, height_;
+	std::vector<glm::vec2> map_;
+	double traceTime_;
+
+	std::atomic<int> nextRow_, rowsDone_;
+	std::atomic<bool> done_, cancel_;
+
+	void traceRows();
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+class Grid;
+struct GridProperties;
+
+// default squared diagonal threshold of the threshold policy
+#define PRECCELEST 0.015
+// default deviation (radians) between hermite and linear edge midpoints of the hermite policy
+#define PRECHERMITE 0.001
+// blocks below this level are refined if they are not constant
+#define FORCE_REFINE_LVL 6
+
+enum class RefinementMode {
+	THRESHOLD = 0,	// squared diagonal of the block on the celestial sky
+	HERMITE = 1		// deviation of hermite interpolation from linear interpolation
+};
+
+/// <summary>
+/// Decides which grid blocks need to be refined. The error estimate of a block
+/// is also used as priority when refining with a limited ray budget.
+/// </summary>
+class RefinementPolicy
+{
+public:
+	RefinementPolicy(double threshold, int forceLevel)
+		: threshold_(threshold), forceLevel_(forceLevel) {}
+	virtual ~RefinementPolicy() {}
+
+	static std::shared_ptr<RefinementPolicy> create(GridProperties const& props);
+	static double defaultThreshold(RefinementMode mode);
+	static std::string getName(RefinementMode mode);
+
+	/// <summary>
+	/// Estimates the error of the block with top left corner (i, j) and size gap.
+	/// All four corners of the block have to be traced already.
+	/// </summary>
+	virtual double estimate(Grid const& grid, uint32_t i, uint32_t j, uint32_t gap) const = 0;
+
+	/// <summary>
+	/// Returns true if a block with the given error estimate needs to be refined.
+	/// </summary>
+	bool refine(double error, int level) const {
+		if (level < forceLevel_ && error > 1E-10) return true;
+		return error > threshold_;
+	}
+
+protected:
+	double threshold_;
+	int forceLevel_;
+};
+
+/// <summary>
+/// Refines if the max squared diagonal of the block on the celestial sky exceeds the threshold.
+/// </summary>
+class ThresholdRefinement : public RefinementPolicy
+{
+public:
+	ThresholdRefinement(double threshold = PRECCELEST, int forceLevel = FORCE_REFINE_LVL)
+		: RefinementPolicy(threshold, forceLevel) {}
+
+	double estimate(Grid const& grid, uint32_t i, uint32_t j, uint32_t gap) const override;
+};
+
+/// <summary>
+/// Estimates the interpolation error of a block from its neighbours: for each block edge,
+/// the midpoint predicted by a hermite spline through the neighbouring grid points is
+/// compared with the linear midpoint. Large deviations mean high curvature of the mapping.
+/// Blocks on the shadow border are always refined.
+/// </summary>
+class HermiteRefinement : public RefinementPolicy
+{
+public:
+	HermiteRefinement(double threshold = PRECHERMITE, int forceLevel = FORCE_REFINE_LVL)
+		: RefinementPolicy(threshold, forceLevel) {}
+
+	double estimate(Grid const& grid, uint32_t i, uint32_t j, uint32_t gap) const override;
+
+private:
+	double edgeError(Grid const& grid, int64_t i, int64_t j, int64_t di, int64_t dj) const;
+};
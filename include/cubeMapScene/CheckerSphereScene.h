@@ -23,6 +23,9 @@ private:
 	std::shared_ptr<ShaderBase> sphereShader_;
 	std::shared_ptr<ShaderBase> cubeShader_;
 	std::shared_ptr<ShaderBase> skyShader_;
+	std::shared_ptr<ShaderBase> sphereLayeredShader_;
+	std::shared_ptr<ShaderBase> cubeLayeredShader_;
+	std::shared_ptr<ShaderBase> skyLayeredShader_;
 
 	glm::vec3 sphereColor_;
 	glm::vec3 spherePos_, cubePos_;
@@ -32,4 +35,6 @@ private:
 	void loadTextures();
 	void loadShaders();
 	void reloadShaders();
+	void renderFaces(std::vector<unsigned int> const& faces, std::vector<glm::mat4> const& models);
+	void renderLayered(std::vector<unsigned int> const& faces, std::vector<glm::mat4> const& models);
 };
\ No newline at end of file
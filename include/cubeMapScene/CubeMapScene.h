@@ -7,6 +7,9 @@
 #include <rendering/texture.h>
 #include <rendering/window.h>
 #include <rendering/simpleCamera.h>
+#include <rendering/buffers.h>
+#include <rendering/gpuProfiler.h>
+#include <cubeMapScene/CubeMapScheduler.h>
 
 
 class CubeMapScene {
@@ -23,16 +26,54 @@ public:
 	GLuint getEnvId() const { return envMap_->getTexId(); }
 	GLuint getDepthId() const { return depthMap_->getTexId(); }
 
+	// layered: render all six faces in one pass (geometry shader), else one pass per face
+	void setLayered(bool layered) { layered_ = layered; }
+	bool isLayered() const { return layered_; }
+
+	// rendering is measured as "cubeMap" scope
+	void setProfiler(std::shared_ptr<GpuProfiler> profiler) { profiler_ = profiler; }
+
 protected:
+	// view projection matrices of all faces, "cubeCamera" block in layered.gs
+	struct CubeCameraData {
+		glm::mat4 projectionView_[6];
+		glm::mat4 projectionViewInverse_[6];
+		glm::vec4 camPos_;
+	};
 
 	int size_;
 	GLuint fboID_;
+	GLuint layeredFboID_;
+	GLuint cubeCameraUBO_;
+	bool layered_;
+	// lazy: only render faces whose content changed noticeably (see CubeMapScheduler)
+	bool lazyUpdates_;
+	CubeMapScheduler scheduler_;
+	// model matrices of the scene objects for the layered shaders, indexed by object_id
+	std::shared_ptr<SSBO> modelSSBO_;
+	size_t modelCount_;
 
 	std::shared_ptr<CubeMap> envMap_;
 	std::shared_ptr<CubeMap> depthMap_;
 	std::vector<std::shared_ptr<SimpleCamera>> envCameras_;
+	std::shared_ptr<GpuProfiler> profiler_;
 
 	void initCameras();
 	void initEnvMap();
+	void initLayered();
 	void updateCameras(glm::vec3 camPos);
+
+	// faces to render this frame, all faces if lazy updates are disabled
+	std::vector<unsigned int> scheduleFaces(glm::vec3 camPos, std::vector<glm::mat4> const& models,
+		std::vector<float> const& radii = {});
+	static unsigned int faceMask(std::vector<unsigned int> const& faces);
+	void renderSchedulerGui();
+
+	// bind fbo, attach face (or all faces if layered), clear and bind the cameras
+	void beginFace(unsigned int face);
+	// only the faces in faceMask are cleared, the layered shaders skip the other faces ("face_mask")
+	void beginLayered(unsigned int faceMask = 0x3f);
+	void end();
+
+	void uploadModelMatrices(std::vector<glm::mat4> const& models);
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <glm/glm.hpp>
+
+/// <summary>
+/// Decides which faces of a dynamic environment cube map have to be rendered in a frame.
+/// For every face the view of the scene objects at the time the face was rendered is kept.
+/// A face is dirty if the objects it shows moved (seen from the current camera position) by more than
+/// the threshold angle. At most facesPerFrame dirty faces are rendered per frame, highest error first.
+/// Objects are given by their model matrix, the mesh is assumed to fit into a sphere of the given radius.
+/// The sky is at infinity, so camera movement alone only changes the view of the objects.
+/// </summary>
+class CubeMapScheduler
+{
+public:
+	// view of one object from the camera
+	struct ObjectView {
+		glm::vec3 dir;			// normalized direction from camera to object center
+		float angularRadius;	// radians, pi if the camera is inside the bounding sphere
+		glm::mat3 rotation;		// orientation of the object without scale
+	};
+
+	CubeMapScheduler(int facesPerFrame = 2, float threshold = 1e-3f);
+
+	/// <summary>
+	/// Returns the faces (0 - 5 = +x, -x, +y, -y, +z, -z) to render this frame and marks them as up to date.
+	/// Faces that were never rendered (or invalidated) are always returned.
+	/// </summary>
+	/// <param name="radii">Bounding radius of each object mesh, 1 if empty.</param>
+	std::vector<unsigned int> schedule(glm::vec3 camPos, std::vector<glm::mat4> const& models,
+		std::vector<float> const& radii = {});
+
+	// render all faces in the next frame, e.g. after changing object colors
+	void invalidate();
+
+	void setFacesPerFrame(int faces) { facesPerFrame_ = glm::clamp(faces, 1, 6); }
+	int getFacesPerFrame() const { return facesPerFrame_; }
+	// max angular error in radians before a face is re-rendered
+	void setThreshold(float threshold) { threshold_ = threshold; }
+	float getThreshold() const { return threshold_; }
+
+	// error of face at the last schedule call, infinity if it was never rendered
+	float getError(unsigned int face) const { return faces_[face].error; }
+	// number of faces rendered in the last frame
+	int getLastUpdateCount() const { return lastUpdates_; }
+
+	static ObjectView objectView(glm::mat4 const& model, float radius, glm::vec3 camPos);
+	// angular error (radians) of showing the object as in view a instead of view b
+	static float objectError(ObjectView const& a, ObjectView const& b);
+	// conservative test if any part of the object is visible in the face
+	static bool touchesFace(ObjectView const& view, unsigned int face);
+
+private:
+	struct FaceState {
+		bool valid = false;
+		float error = std::numeric_limits<float>::infinity();
+		size_t lastFrame = 0;
+		std::vector<ObjectView> objects;	// object views when the face was rendered
+	};
+
+	int facesPerFrame_;
+	float threshold_;
+	size_t frame_;
+	int lastUpdates_;
+	FaceState faces_[6];
+
+	float faceError(FaceState const& face, std::vector<ObjectView> const& objects, unsigned int index) const;
+};
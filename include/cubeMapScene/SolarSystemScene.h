@@ -5,6 +5,8 @@
 
 #include <rendering/mesh.h>
 #include <rendering/shader.h>
+#include <rendering/instancedSpheres.h>
+#include <rendering/textureLoader.h>
 
 class SolarSystemScene : public CubeMapScene {
 public:
@@ -31,8 +33,19 @@ public:
 		glm::vec3 color_;
 	};
 
+	// small body on a circular orbit in the belt between mars and jupiter
+	struct Asteroid {
+		float dist_;
+		float size_;
+		float phase_;
+		float orbitSpeed_;
+		float inclination_;
+		float node_;
+	};
+
 	SolarSystemScene();
-	SolarSystemScene(int size);
+	// textures are loaded with loader in the background, without a loader the constructor waits for them
+	SolarSystemScene(int size, std::shared_ptr<TextureLoader> loader = nullptr);
 
 	void render(glm::vec3 camPos, float dt) override;
 	void renderGui() override;
@@ -45,21 +58,41 @@ private:
 	std::map<Objects, std::shared_ptr<Texture2D>> meshTextures_;
 	std::map<Objects, PlanetProperties> planets_;
 	std::map<Objects, glm::mat4> modelMatrices_;
+	std::vector<Asteroid> asteroids_;
+	std::vector<glm::mat4> asteroidMatrices_;
 
 	std::shared_ptr<ShaderBase> meshShader_;
 	std::shared_ptr<ShaderBase> skyShader_;
+	std::shared_ptr<ShaderBase> meshLayeredShader_;
+	std::shared_ptr<ShaderBase> skyLayeredShader_;
+	std::shared_ptr<ShaderBase> instancedShader_;
+	std::shared_ptr<ShaderBase> instancedLayeredShader_;
+
+	// all bodies in one indirect draw, planet textures are layers of one texture array
+	bool instanced_;
+	std::shared_ptr<InstancedSpheres> instancedSpheres_;
+	std::map<Objects, int> textureLayers_;
+	int pendingTextures_;
+	int asteroidCount_;
 
 	float rotationSpeedScale_;
 	float distScale_;
 	float sizeScale_;
 	float maxSize_;
 
-	void loadTextures();
+	void loadTextures(std::shared_ptr<TextureLoader> loader);
+	void onTextureLoaded();
+	void updateTextureArray();
 	void loadShaders();
 	void initModelTransforms();
 	void initPlanets();
+	void initAsteroids();
 	void updateModelTransforms(float dt);
 	void reloadShaders();
+	void renderFaces(std::vector<unsigned int> const& faces);
+	void renderLayered(std::vector<unsigned int> const& faces, std::vector<glm::mat4> const& models);
+	void drawPlanets(std::shared_ptr<ShaderBase> const& shader, bool layered);
+	void updateInstances(glm::vec3 camPos);
 	std::string objToString(Objects obj);
 
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Frames of a recorded session: the timing of every frame and the camera and application
+/// state as JSON whenever they changed. Stored as a compact binary file:
+/// "BHVLOG", version (u16), frame count (u32), then per frame dt, cpu ms, gpu ms (f32),
+/// a flags byte and the changed JSON strings, each prefixed with its length (u32).
+/// Numbers are stored little endian.
+/// </summary>
+class FrameLog {
+public:
+	struct Frame {
+		// wall clock time of the frame in s
+		float dt = 0.f;
+		float cpuMs = 0.f;
+		// 0 if not measured
+		float gpuMs = 0.f;
+		// JSON objects, empty if unchanged since the previous frame
+		std::string camera;
+		std::string state;
+	};
+
+	static const uint16_t VERSION = 1;
+
+	void clear() { frames_.clear(); }
+	void add(Frame const& frame) { frames_.push_back(frame); }
+
+	size_t size() const { return frames_.size(); }
+	bool empty() const { return frames_.empty(); }
+	Frame const& at(size_t i) const { return frames_.at(i); }
+	Frame& at(size_t i) { return frames_.at(i); }
+	// sum of the recorded dt in s
+	double getDuration() const;
+
+	bool write(std::string const& path) const;
+	bool read(std::string const& path);
+
+private:
+	std::vector<Frame> frames_;
+};
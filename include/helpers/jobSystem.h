@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Shared flag to abandon work that is no longer needed. Copies share the flag, a job
+/// checks it between steps and returns early once it is set.
+/// </summary>
+class CancellationToken {
+public:
+	CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void cancel() const { *cancelled_ = true; }
+	bool isCancelled() const { return *cancelled_; }
+
+private:
+	std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// queues of the job system, a worker takes the oldest job of the highest non empty one
+enum class JobPriority {
+	HIGH,	// needed for the next frames (texture decode, tiles)
+	NORMAL,
+	LOW		// speculative work (prefetched grids)
+};
+
+/// <summary>
+/// Handle of a submitted job. Done once the job returned, or was dropped because its token
+/// was cancelled before it started.
+/// </summary>
+class JobHandle {
+public:
+	JobHandle() {}
+
+	bool valid() const { return done_.valid(); }
+	bool isDone() const { return valid() && done_.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+	void wait() const { if (valid()) done_.wait(); }
+
+	// cancels the token, which may be shared with other jobs
+	void cancel() const { token_.cancel(); }
+	bool isCancelled() const { return token_.isCancelled(); }
+	CancellationToken const& getToken() const { return token_; }
+
+private:
+	friend class JobSystem;
+	JobHandle(std::shared_future<void> done, CancellationToken const& token) : done_(done), token_(token) {}
+
+	std::shared_future<void> done_;
+	CancellationToken token_;
+};
+
+/// <summary>
+/// Pool of worker threads for the background work of the applications: grid builds, tile
+/// loading and texture decode. Jobs run in priority order, FIFO within a priority.
+/// Jobs whose token is cancelled before they start are dropped, running jobs have to check
+/// the token themselves. GL calls are not allowed in jobs, results go back to the GL thread
+/// through the job's own state (poll the handle from the render loop).
+/// </summary>
+class JobSystem {
+public:
+	using Job = std::function<void(CancellationToken const& token)>;
+
+	// threads = 0: one thread less than the hardware concurrency, the GL thread has work too
+	JobSystem(int threads = 0);
+	// drops the queued jobs, cancels the running ones and waits for them
+	~JobSystem();
+
+	JobSystem(JobSystem const&) = delete;
+	JobSystem& operator=(JobSystem const&) = delete;
+
+	JobHandle submit(Job job, JobPriority priority = JobPriority::NORMAL, CancellationToken const& token = CancellationToken());
+
+	size_t getThreadCount() const { return workers_.size(); }
+	// jobs waiting for a worker, including cancelled ones not dropped yet
+	size_t getQueuedCount() const;
+	size_t getRunningCount() const;
+
+private:
+	struct Entry {
+		Job job;
+		CancellationToken token;
+		std::shared_ptr<std::promise<void>> done;
+	};
+
+	static const int PRIORITIES = 3;
+
+	mutable std::mutex mutex_;
+	std::condition_variable jobAvailable_;
+	std::deque<Entry> queues_[PRIORITIES];
+	// tokens of the running jobs by worker, cancelled on shutdown
+	std::vector<std::shared_ptr<CancellationToken>> running_;
+	bool stop_;
+	std::vector<std::thread> workers_;
+
+	void workerLoop(size_t worker);
+};
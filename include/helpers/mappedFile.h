@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// <summary>
+/// Read only memory mapping of a whole file, pages are loaded by the OS on first access.
+/// </summary>
+class MappedFile {
+public:
+	MappedFile(std::string const& path);
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	bool isOpen() const { return data_ != nullptr; }
+	unsigned char const* data() const { return data_; }
+	size_t size() const { return size_; }
+
+	// reads one byte of every page, so later accesses don't wait for the disk
+	void prefetch() const;
+
+private:
+	unsigned char const* data_;
+	size_t size_;
+#ifdef _WIN32
+	void* file_;
+	void* mapping_;
+#endif
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <functional>
+
+/// <summary>
+/// Calls rowFunc once for every row in [0, rows). Rows are handed out one at a time to up
+/// to threads threads (0 = hardware concurrency), the calling thread works too.
+/// Small images run on the calling thread only.
+/// Not meant for JobSystem jobs that wait on other jobs, the row threads are its own.
+/// </summary>
+void parallelRows(int rows, int threads, std::function<void(int)> const& rowFunc);
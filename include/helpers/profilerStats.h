@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/// <summary>
+/// Rolling window of the last capacity samples of one measured pass.
+/// </summary>
+class SampleHistory {
+public:
+	struct Stats {
+		size_t count = 0;
+		double last = 0.0;
+		double min = 0.0;
+		double median = 0.0;
+		double p95 = 0.0;
+		double mean = 0.0;
+	};
+
+	SampleHistory(size_t capacity = 256);
+
+	void add(double sample);
+	void clear();
+
+	size_t size() const { return samples_.size(); }
+	size_t getCapacity() const { return capacity_; }
+	// oldest first
+	std::vector<double> getSamples() const;
+	Stats getStats() const;
+
+	// linear interpolation between the closest ranks, p in [0,1], sorted must not be empty
+	static double percentile(std::vector<double> const& sorted, double p);
+
+private:
+	size_t capacity_;
+	// ring buffer, next_ is the oldest sample once full
+	std::vector<double> samples_;
+	size_t next_;
+};
+
+/// <summary>
+/// Bookkeeping of the frames whose GPU queries are in flight. A frame is recorded into one of
+/// depth slots and stays pending until its results are available. Pending frames are read
+/// oldest first and only once they are ready, so reading never waits for the GPU. If the GPU
+/// is more than depth frames behind, the oldest pending frame is dropped instead.
+/// </summary>
+class FrameRing {
+public:
+	FrameRing(int depth = 4);
+
+	// slot to record the next frame into
+	int begin();
+	// the recorded slot becomes pending
+	void end();
+
+	/// <summary>
+	/// Calls read(slot) for the pending slots, oldest first, as long as ready(slot) holds.
+	/// Returns the number of read slots.
+	/// </summary>
+	template<typename Ready, typename Read>
+	int collect(Ready ready, Read read) {
+		int count = 0;
+		while (!pending_.empty() && ready(pending_.front())) {
+			int slot = pending_.front();
+			pending_.pop_front();
+			read(slot);
+			++count;
+		}
+		return count;
+	}
+
+	int getDepth() const { return depth_; }
+	bool isRecording() const { return recording_ >= 0; }
+	size_t getPendingCount() const { return pending_.size(); }
+	uint64_t getFrameCount() const { return frames_; }
+	uint64_t getDroppedCount() const { return dropped_; }
+
+private:
+	int depth_;
+	int recording_;
+	uint64_t frames_;
+	uint64_t dropped_;
+	std::deque<int> pending_;
+};
@@ -3,4 +3,5 @@
 // binding index UBOs
 constexpr auto BLHBINDING = 1;
 constexpr auto CAMBINDING = 2;
-constexpr auto DISKBINDING = 3;
\ No newline at end of file
+constexpr auto DISKBINDING = 3;
+constexpr auto CUBECAMBINDING = 4;
\ No newline at end of file
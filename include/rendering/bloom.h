@@ -3,9 +3,14 @@
 #include <rendering/mesh.h>
 #include <rendering/shader.h>
 #include <rendering/texture.h>
+#include <rendering/buffers.h>
+#include <rendering/gpuProfiler.h>
 
 #include <boost/json.hpp>
 
+// the compute downsample writes all levels but 0 through one image unit each
+#define BLOOM_MAX_COMPUTE_LEVELS 9
+
 class Bloom {
 public:
 	Bloom(){}
@@ -19,12 +24,18 @@ public:
 	int getLevel() const { return maxLevels_; }
 	void setLevel(int level);
 
+	// the passes are measured as "bloom/..." scopes
+	void setProfiler(std::shared_ptr<GpuProfiler> profiler) { profiler_ = profiler; }
+
 	void storeConfig(boost::json::object& obj);
 	void loadConfig(boost::json::object& obj);
 
 	float intensity_;
 	float exposure_;
 	bool highContrast_;
+	// use the compute shader path (single dispatch downsample, fused blur + upsample)
+	// instead of one draw per level and pass, falls back to raster for more than BLOOM_MAX_COMPUTE_LEVELS levels
+	bool compute_;
 
 private:
 	int maxLevels_;
@@ -34,10 +45,16 @@ private:
 	std::vector<glm::vec2> levelSizes_;
 
 	Quad quad_;
+	std::shared_ptr<GpuProfiler> profiler_;
 
 	std::shared_ptr<ShaderBase> upsampleShader_;
 	std::shared_ptr<ShaderBase> bloomShader_;
 	std::shared_ptr<ShaderBase> renderShader_;
+	std::shared_ptr<ShaderBase> downsampleComputeShader_;
+	std::shared_ptr<ShaderBase> upsampleComputeShader_;
+
+	// counts finished workgroups of the downsample pass
+	std::shared_ptr<SSBO> spdCounter_;
 
 	std::shared_ptr<FBOTexture> source_;
 	std::shared_ptr<FBOTexture> filters_;
@@ -46,4 +63,7 @@ private:
 	void initFBOS();
 	void initLevels();
 
+	void renderRaster();
+	void renderCompute();
+
 };
\ No newline at end of file
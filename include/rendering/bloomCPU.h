@@ -0,0 +1,85 @@
+#pragma  once
+
+#include <vector>
+
+#include <boost/json.hpp>
+
+/// <summary>
+/// CPU implementation of the Bloom filter chain (bloom.frag, bloom_upsample.frag, bloom_render.frag)
+/// on linear float RGBA images. Doesn't need a GL context, so it can be used offline as
+/// reference for the bloom shaders and as post process of a headless renderer.
+/// Uses the same config keys as Bloom.
+/// </summary>
+class BloomCPU {
+public:
+	BloomCPU(int level = 9, int threads = 0);
+
+	/// <summary>
+	/// Applies bloom and tone mapping to a linear HDR image with 4 floats per pixel.
+	/// Returns the tone mapped image in the same layout. Row order doesn't matter, the chain is symmetric.
+	/// </summary>
+	std::vector<float> render(float const* source, int width, int height);
+	std::vector<float> render(std::vector<float> const& source, int width, int height) {
+		return render(source.data(), width, height);
+	}
+
+	int getLevel() const { return maxLevels_; }
+	void setLevel(int level) { maxLevels_ = level; }
+
+	int getThreads() const { return threads_; }
+	// 0 = hardware concurrency
+	void setThreads(int threads) { threads_ = threads; }
+
+	// time of the last render in ms
+	double getRenderTime() const { return renderTime_; }
+	// source pixels per second of the last render
+	double getMPixelsPerSecond() const;
+
+	void storeConfig(boost::json::object& obj);
+	void loadConfig(boost::json::object& obj);
+
+	/// <summary>
+	/// Largest absolute difference of the color channels of two RGBA images,
+	/// e.g. of render() and the read back Bloom output.
+	/// </summary>
+	static float maxDifference(std::vector<float> const& a, std::vector<float> const& b);
+
+	float intensity_;
+	float exposure_;
+	// stored for Bloom config compatibility, bloom_render.frag doesn't use it either
+	bool highContrast_;
+
+private:
+	struct Level {
+		int width = 0, height = 0;
+		std::vector<float> pixels;
+
+		float const* row(int y) const { return pixels.data() + (size_t)y * width * 4; }
+		float* row(int y) { return pixels.data() + (size_t)y * width * 4; }
+	};
+
+	// texels and weights of bilinear samples (clamp to edge) at the pixel centers
+	// of a dst sized axis, the same for every row so they are computed once per pass
+	struct Taps {
+		std::vector<int> t0, t1;
+		std::vector<float> w;
+	};
+	static Taps bilinearTaps(int srcSize, int dstSize);
+
+	int maxLevels_;
+	int threads_;
+	int width_, height_;
+	double renderTime_;
+
+	// source mip chain, the same as generateMipMap
+	std::vector<Level> mips_;
+	// bloom filter levels, level 0 is unused like in Bloom
+	std::vector<Level> filters_;
+
+	void initLevels(float const* source);
+
+	void downsampleRow(Level const& src, Level& dst, int y) const;
+	void gaussRow(Level const& src, Level& dst, int y) const;
+	void upsampleRow(Level const& coarse, Level& fine, Taps const& tapsX, Taps const& tapsY, int y) const;
+	void compositeRow(Level const& filter, float* out, Taps const& tapsX, Taps const& tapsY, int y) const;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <helpers/profilerStats.h>
+
+/// <summary>
+/// GPU times of named passes with GL_TIMESTAMP queries. Scopes nest, a pass is identified by
+/// the names of its enclosing scopes joined with '/'. The queries of the last depth frames are
+/// kept in flight and read once available (see FrameRing), the last historySize times of every
+/// pass are kept for the statistics (see SampleHistory). Only use it on the GL thread.
+/// </summary>
+class GpuProfiler {
+public:
+	/// <summary>
+	/// Measures from construction to destruction, does nothing without a profiler.
+	/// </summary>
+	class Scope {
+	public:
+		Scope(std::shared_ptr<GpuProfiler> const& profiler, std::string const& name);
+		~Scope();
+
+		Scope(Scope const&) = delete;
+		Scope& operator=(Scope const&) = delete;
+
+	private:
+		GpuProfiler* profiler_;
+	};
+
+	GpuProfiler(int depth = 4, size_t historySize = 256);
+	~GpuProfiler();
+
+	GpuProfiler(GpuProfiler const&) = delete;
+	GpuProfiler& operator=(GpuProfiler const&) = delete;
+
+	// called with the index of a frame and the times of its passes in ms once they are read
+	using FrameCallback = std::function<void(uint64_t frame, std::map<std::string, double> const& times)>;
+
+	// reads the finished frames and starts the "frame" pass
+	void beginFrame();
+	void endFrame();
+	// true between beginFrame and endFrame if enabled
+	bool isMeasuring() const { return current_ >= 0; }
+	// index of the measured frame, the frames are counted from 0
+	uint64_t getFrameIndex() const { return ring_.getFrameCount(); }
+	void setFrameCallback(FrameCallback callback) { frameCallback_ = callback; }
+
+	// false if not measured (disabled or outside of a frame), end() is then ignored as well
+	bool begin(std::string const& name);
+	void end();
+
+	// passes in order of their first appearance
+	std::vector<std::string> getPasses() const { return passes_; }
+	// times in ms, empty stats for unknown passes
+	SampleHistory::Stats getStats(std::string const& pass) const;
+	SampleHistory const* getHistory(std::string const& pass) const;
+	uint64_t getDroppedFrames() const { return ring_.getDroppedCount(); }
+	void clear();
+
+	// pass, count, last, min, median, p95, mean in ms
+	bool exportCSV(std::string const& path) const;
+	// the statistics and the samples of every pass
+	bool exportJSON(std::string const& path) const;
+
+	void renderWindow(bool* open = nullptr);
+
+	bool enabled_;
+
+private:
+	struct Record {
+		std::string pass;
+		// indices into the query objects of the slot
+		size_t begin, end;
+	};
+
+	struct Slot {
+		std::vector<GLuint> queries;
+		size_t used = 0;
+		std::vector<Record> records;
+		uint64_t frame = 0;
+	};
+
+	FrameRing ring_;
+	std::vector<Slot> slots_;
+	int current_;
+	size_t historySize_;
+	// indices into the records of the current slot
+	std::vector<size_t> stack_;
+	// nesting of the measured scopes, false for the ignored ones
+	std::vector<bool> measured_;
+
+	std::vector<std::string> passes_;
+	std::map<std::string, SampleHistory> history_;
+	FrameCallback frameCallback_;
+
+	size_t queryCounter(Slot& slot);
+	bool isReady(int slot) const;
+	void readSlot(int slot);
+};
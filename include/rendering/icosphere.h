@@ -0,0 +1,16 @@
+#pragma once
+
+#include <rendering/mesh.h>
+
+/// <summary>
+/// Unit sphere made from a subdivided icosahedron, poles on the y axis.
+/// The uv mapping is the same as sphere.obj (u = longitude, v = latitude), vertices on the
+/// u seam and the poles are duplicated so equirectangular textures wrap correctly.
+/// </summary>
+class Icosphere : public Mesh {
+public:
+	// 20 * 4^subdivisions triangles
+	Icosphere(int subdivisions);
+
+	static void generate(int subdivisions, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+};
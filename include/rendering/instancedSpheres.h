@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include <rendering/shader.h>
+#include <rendering/texture.h>
+
+// shader storage bindings of the instance data, see cubeMapScene/instanced.vs
+#define INSTANCE_BINDING 1
+#define DRAW_COMMAND_BINDING 2
+#define VISIBLE_INSTANCE_BINDING 3
+
+/// <summary>
+/// Draws any number of spheres with one indirect draw call.
+/// Every frame a compute pass (instanceLod.comp) selects the icosphere detail level of each
+/// instance from its projected size and culls instances smaller than a fraction of a pixel.
+/// The visible instances are appended per level to a buffer that feeds a per instance
+/// vertex attribute, so one glMultiDrawElementsIndirect draws all levels.
+/// Textures are copied into one texture array, instances reference them by layer.
+/// </summary>
+class InstancedSpheres {
+public:
+	// std430 layout of the instance buffer
+	struct Instance {
+		glm::mat4 model_;
+		// rgb color, a = texture layer or -1 for color only
+		glm::vec4 color_;
+		// world space center and radius, used for the level selection
+		glm::vec4 sphere_;
+	};
+
+	// lodCount levels, level 0 is the finest with maxSubdivisions
+	InstancedSpheres(int lodCount = 5, int maxSubdivisions = 5);
+	~InstancedSpheres();
+
+	// unit sphere instance with a model matrix
+	static Instance makeInstance(glm::mat4 const& model, glm::vec3 color, int textureLayer = -1);
+
+	void setInstances(std::vector<Instance> const& instances);
+	size_t getInstanceCount() const { return instanceCount_; }
+
+	/// <summary>
+	/// Copies the textures into a texture array of the given size, layer i = textures[i].
+	/// </summary>
+	void setTextures(std::vector<std::shared_ptr<Texture2D>> const& textures, int width = 2048, int height = 1024);
+
+	/// <summary>
+	/// Selects the detail levels for a camera at camPos. pixelScale converts the tangent of the
+	/// angular radius to pixels (half the target size for a 90 degree field of view).
+	/// </summary>
+	void update(glm::vec3 camPos, float pixelScale);
+	void draw() const;
+
+	void reloadShaders();
+
+	int getLodCount() const { return (int)lods_.size(); }
+	// visible instances per level of the last update, reads back the draw commands
+	std::vector<unsigned int> getLodInstanceCounts() const;
+
+	// an instance uses level i if its projected radius is larger than lodPixels_[i] pixels
+	std::vector<float> lodPixels_;
+	// instances below this projected radius are culled
+	float minPixels_;
+
+private:
+	// same layout as DrawElementsIndirectCommand
+	struct DrawCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct Lod {
+		int subdivisions;
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+	};
+
+	std::vector<Lod> lods_;
+	size_t instanceCount_;
+	size_t instanceCapacity_;
+
+	GLuint vao_, vbo_, ebo_;
+	GLuint instanceBuffer_, commandBuffer_, visibleBuffer_;
+	GLuint textureArray_;
+
+	std::shared_ptr<ShaderBase> lodShader_;
+
+	void initMeshes(int maxSubdivisions);
+	void resizeInstanceBuffers(size_t capacity);
+	std::vector<DrawCommand> emptyCommands() const;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Vulkan format numbers used by the baked textures
+#define VK_FORMAT_R8G8B8A8_UNORM 37
+#define VK_FORMAT_R8G8B8A8_SRGB 43
+#define VK_FORMAT_R16G16B16A16_SFLOAT 97
+#define VK_FORMAT_BC6H_UFLOAT_BLOCK 143
+#define VK_FORMAT_BC7_UNORM_BLOCK 145
+#define VK_FORMAT_BC7_SRGB_BLOCK 146
+
+/// <summary>
+/// KTX2 container for single 2D textures with a mip chain. Header and level index follow the
+/// KTX2 specification, the data format descriptor is left out, so the files are read by this
+/// loader only. Levels are stored smallest first and 16 byte aligned.
+/// </summary>
+class Ktx2 {
+public:
+	struct Level {
+		int width, height;
+		// relative to the start of the file
+		size_t offset;
+		size_t size;
+	};
+
+	struct GLFormat {
+		GLenum internalFormat;
+		// format and type of uncompressed data
+		GLenum format;
+		GLenum type;
+		bool compressed;
+	};
+
+	uint32_t vkFormat = 0;
+	int width = 0;
+	int height = 0;
+	// level 0 is the full size
+	std::vector<Level> levels;
+
+	/// <summary>
+	/// Reads header and level index of a file in memory, false if it isn't a valid texture.
+	/// </summary>
+	bool parse(unsigned char const* data, size_t size);
+
+	/// <summary>
+	/// Writes a texture with the given levels (level 0 first) to path.
+	/// </summary>
+	static bool write(std::string const& path, uint32_t vkFormat, int width, int height,
+		std::vector<std::vector<unsigned char>> const& levels);
+
+	// GL format of a supported vkFormat, srgb selects the sRGB variant of 8 bit formats
+	static bool getGLFormat(uint32_t vkFormat, bool srgb, GLFormat& format);
+	static bool isCompressed(uint32_t vkFormat);
+	// bytes of a level with the given size
+	static size_t getLevelSize(uint32_t vkFormat, int width, int height);
+};
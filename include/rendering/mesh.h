@@ -19,6 +19,7 @@ public:
 
 	Mesh(std::vector<glm::vec3> pos, std::vector<glm::vec2> uv, std::vector<unsigned int> indxs);
 	Mesh(std::vector<Vertex> verts, std::vector<unsigned int> indxs);
+	// loads resources/meshes/<filename> (.obj), through a binary cache next to the file
 	Mesh(std::string filename);
 	Mesh();
 	~Mesh();
@@ -26,7 +27,16 @@ public:
 protected:
 	// vertex array object, vertex buffer object, element buffer object
 	GLuint VAO_, VBO_, EBO_;
+	// GL_UNSIGNED_SHORT if all vertices can be indexed with 16 bit, else GL_UNSIGNED_INT
+	GLenum indexType_;
 	void createMesh();
+
+	// import obj file with deduplicated vertices
+	bool loadObj(std::string const& path);
+	// reorder indices and vertices for the vertex cache
+	void optimize();
+	bool loadCache(std::string const& path);
+	void storeCache(std::string const& path) const;
 };
 
 class Quad : public Mesh {
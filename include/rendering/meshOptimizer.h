@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+/// <summary>
+/// Index buffer reordering for triangle lists, independent of the vertex format.
+/// </summary>
+class MeshOptimizer {
+public:
+	/// <summary>
+	/// Reorders the triangles for the post transform vertex cache
+	/// (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation").
+	/// </summary>
+	static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+	/// <summary>
+	/// Renumbers the vertices in the order they are first used by the index buffer
+	/// and returns the new position of each old vertex. Unused vertices are dropped,
+	/// the number of used vertices is returned in usedCount.
+	/// </summary>
+	static std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, size_t vertexCount, size_t& usedCount);
+
+	/// <summary>
+	/// Average number of vertex shader invocations per triangle for a FIFO cache of cacheSize
+	/// vertices (between 0.5 and 3, lower is better).
+	/// </summary>
+	static double computeACMR(std::vector<unsigned int> const& indices, size_t vertexCount, int cacheSize = 16);
+};
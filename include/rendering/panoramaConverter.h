@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <rendering/textureBaker.h>
+
+/// <summary>
+/// Converts equirectangular panoramas (.hdr or 8 bit images) into cube map faces on the CPU.
+/// Every face texel averages samples x samples bilinear taps weighted by their solid angle.
+/// The panorama is box filtered first to the tap spacing, horizontally wider towards the poles
+/// where a tap covers many panorama pixels, so the result is an area weighted average of the panorama.
+/// Orientation: the top row is +y, the center column is +z, the same sky as the
+/// MWPANORAMA lookup of kerr/render.frag for a camera with right +x, up +y and front +z.
+/// </summary>
+class PanoramaConverter {
+public:
+	PanoramaConverter(int threads = 0);
+
+	bool load(std::string const& path);
+	void setPanorama(TextureBaker::Image const& panorama, bool hdr);
+
+	/// <summary>
+	/// The six faces with faceSize x faceSize texels, face order as CubeMap (+x, -x, +y, -y, +z, -z).
+	/// </summary>
+	std::vector<TextureBaker::Image> convert(int faceSize) const;
+
+	/// <summary>
+	/// Loads the panorama at path, converts it and bakes the faces with mip levels
+	/// into getCachePath(path, faceSize, face).
+	/// </summary>
+	bool bake(std::string const& path, int faceSize, TextureBaker& baker);
+
+	// cache file of one face, read by TextureLoader::loadPanorama
+	static std::string getCachePath(std::string const& path, int faceSize, int face);
+
+	bool isHDR() const { return hdr_; }
+	// time of the last convert in ms
+	double getConvertTime() const { return convertTime_; }
+
+	// taps per texel and axis, 0 = from the panorama and face resolution
+	int samples_;
+	// 0 = hardware concurrency
+	int threads_;
+
+private:
+	TextureBaker::Image panorama_;
+	bool hdr_;
+	mutable double convertTime_;
+
+	int getSamples(int faceSize) const;
+	TextureBaker::Image prefilterRows(float tapAngle) const;
+};
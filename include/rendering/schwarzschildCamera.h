@@ -28,6 +28,7 @@ public:
 	CameraData getData() const { return data_; }
 	glm::vec3 getPositionXYZ() const { return positionXYZ_; }
 	glm::vec3 getPositionRTP() const { return positionRTP_; }
+	glm::vec2 getViewDirTP() const { return viewDirTP_; }
 	glm::vec4 getFront() const { return front_; }
 	glm::vec4 getUp() const { return up_; }
 	glm::vec4 getRight() const { return right_; }
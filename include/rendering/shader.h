@@ -5,14 +5,23 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+/// <summary>
+/// Shader files are read from resources/shaders/. A line #include "file" is replaced by the file,
+/// looked up next to the including file first and then in resources/shaders/. Every file is
+/// included once per stage, #line directives keep the line numbers of the compile errors.
+/// All files a program is built from are its dependencies, see ShaderWatcher.
+/// </summary>
 class ShaderBase {
 public:
-	ShaderBase() : ID_(0) {};
+	ShaderBase();
+	ShaderBase(ShaderBase const& other);
+	virtual ~ShaderBase();
 	// set uniforms
 	void setUniform(const std::string& name, bool value);
 	void setUniform(const std::string& name, int value);
@@ -34,6 +43,12 @@ public:
 
 	unsigned int getID() const { return ID_; }
 
+	// shader files including the #included ones, relative to resources/shaders/
+	std::set<std::string> const& getDependencies() const { return dependencies_; }
+
+	// all shader objects alive, only created and used on the GL thread
+	static std::set<ShaderBase*> const& getInstances();
+
 	void use();
 
 protected:
@@ -41,7 +56,7 @@ protected:
 
 	virtual void compile() = 0;
 
-	std::string readShaderFiles(std::vector<std::string> paths) const;
+	std::string readShaderFiles(std::vector<std::string> paths);
 	bool checkCompileErrors(int shader, std::string name);
 	bool checkLinkErrors(int shader);
 
@@ -50,6 +65,14 @@ protected:
 	std::map<std::string, bool> preprocessorFlags_;				// #define FLAG
 	std::map<std::string, std::string> preprocessorValues_;		// #define VAL 42
 	std::string createPreprocessorCommands() const;
+
+private:
+	std::set<std::string> dependencies_;
+	// files by source string number of the #line directives
+	std::vector<std::string> sourceNames_;
+
+	bool readShaderFile(std::string const& path, std::set<std::string>& included, std::string& code);
+	int getSourceNumber(std::string const& path);
 };
 class Shader : public ShaderBase {
 public:
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+/// <summary>
+/// Watches resources/shaders/ for saved files and reloads only the programs depending on them,
+/// see ShaderBase::getDependencies. Changes are collected on a background thread with inotify
+/// on Linux, elsewhere it polls the modification times. The programs are reloaded in update(),
+/// which has to be called on the GL thread.
+/// </summary>
+class ShaderWatcher {
+public:
+	ShaderWatcher();
+	~ShaderWatcher();
+
+	ShaderWatcher(ShaderWatcher const&) = delete;
+	ShaderWatcher& operator=(ShaderWatcher const&) = delete;
+
+	/// <summary>
+	/// Reloads the programs affected by the files changed since the last call.
+	/// Returns the number of reloaded programs.
+	/// </summary>
+	int update();
+
+	// changes stay queued while disabled
+	bool enabled_;
+
+private:
+	std::thread thread_;
+	std::atomic<bool> stop_;
+
+	std::mutex mutex_;
+	// changed files relative to resources/shaders/
+	std::set<std::string> changed_;
+
+	void notify(std::string const& path);
+	void watchLoop();
+
+#ifdef __linux__
+	int inotifyFd_;
+	// wakes the thread up on destruction
+	int stopFd_;
+	// watch descriptor to directory relative to resources/shaders/
+	std::map<int, std::string> directories_;
+
+	void addWatch(std::string const& directory);
+#else
+	std::mutex stopMutex_;
+	std::condition_variable stopCondition_;
+#endif
+};
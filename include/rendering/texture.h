@@ -75,6 +75,12 @@ public:
 	int getWidth() const { return width_; }
 	int getHeight() const { return height_; }
 
+	// replace the image (or the cube map face params.target), the texture id stays the same
+	// params.data is an offset if a pixel unpack buffer is bound
+	void setImage(TextureParams const& params);
+	// same for block compressed data of imageSize bytes, params.internalFormat is the compressed format
+	void setCompressedImage(TextureParams const& params, GLsizei imageSize);
+
 protected:
 	int width_, height_;
 
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Offline preparation of textures for the TextureLoader. Builds the mip chain on the CPU,
+/// optionally block compresses it (BC7 for 8 bit images, BC6H for .hdr images) and stores it
+/// as <source>.ktx2 next to the source, see Ktx2. Filtering, encoding and mip levels run on
+/// all cores, the GL context isn't needed.
+/// </summary>
+class TextureBaker {
+public:
+	enum class Filter { Box, Kaiser };
+
+	// linear float RGBA image
+	struct Image {
+		int width = 0, height = 0;
+		std::vector<float> pixels;
+
+		float const* row(int y) const { return pixels.data() + (size_t)y * width * 4; }
+		float* row(int y) { return pixels.data() + (size_t)y * width * 4; }
+	};
+
+	TextureBaker(int threads = 0);
+
+	/// <summary>
+	/// Bakes the image file source into target (source.ktx2 if empty).
+	/// </summary>
+	bool bake(std::string const& source, std::string const& target = "");
+	// bakes an image, hdr images are stored as BC6H / RGBA16F
+	bool bake(Image const& base, bool hdr, std::string const& target);
+
+	/// <summary>
+	/// Loads an image file as RGBA floats, .hdr files unchanged, 8 bit files in [0,1]
+	/// (linearized if srgb). hdr is set for .hdr files.
+	/// </summary>
+	static bool loadImage(std::string const& path, Image& image, bool& hdr, bool srgb = false);
+
+	/// <summary>
+	/// Mip chain down to 1x1, level 0 is a copy of base.
+	/// </summary>
+	std::vector<Image> buildMipChain(Image const& base) const;
+
+	// 16 bytes per 4x4 block, rows of blocks from the top, values are clamped to [0,1]
+	std::vector<unsigned char> encodeBC7(Image const& image) const;
+	// unsigned half floats, negative values are clamped to 0
+	std::vector<unsigned char> encodeBC6H(Image const& image) const;
+	static std::vector<unsigned char> toRGBA8(Image const& image);
+	static std::vector<unsigned char> toRGBA16F(Image const& image);
+
+	// cache file of an image file, read by TextureLoader::decodeFile
+	static std::string getCachePath(std::string const& path) { return path + ".ktx2"; }
+
+	// time of the last bake in ms
+	double getBakeTime() const { return bakeTime_; }
+
+	Filter filter_;
+	// block compress the levels, else RGBA8 / RGBA16F
+	bool compress_;
+	// 8 bit images are sRGB encoded, filtered in linear space
+	bool srgb_;
+	bool mipmaps_;
+	// 0 = hardware concurrency
+	int threads_;
+
+private:
+	struct Weights {
+		// per destination pixel the first source pixel and the number of taps
+		std::vector<int> first;
+		std::vector<int> count;
+		// count weights per destination pixel, maxTaps apart
+		std::vector<float> weights;
+		int maxTaps = 0;
+	};
+
+	double bakeTime_;
+
+	Weights filterWeights(int srcSize, int dstSize) const;
+	Image downsample(Image const& src, int width, int height) const;
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rendering/texture.h>
+#include <helpers/jobSystem.h>
+
+/// <summary>
+/// Image decoded by a worker thread, either 8 bit pixels from stbi or the
+/// mip chain of a baked texture (see TextureBaker).
+/// </summary>
+struct DecodedImage {
+	struct Level {
+		int width, height;
+		// relative to pixels
+		size_t offset;
+		size_t size;
+	};
+
+	std::string path;
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	// freed with the decoders deleter (stbi_image_free, unmap of the baked file) once the image is uploaded
+	std::shared_ptr<unsigned char> pixels;
+	// format and levels of a baked texture, level 0 first, vkFormat = 0 for stbi images
+	uint32_t vkFormat = 0;
+	std::vector<Level> levels;
+
+	size_t size() const {
+		if (levels.empty()) return (size_t)width * height * components;
+		size_t bytes = 0;
+		for (auto const& level : levels) bytes += level.size;
+		return bytes;
+	}
+};
+
+/// <summary>
+/// GL side of the TextureLoader, all functions are called from the GL thread.
+/// Replace it with a mock to test the loader without a GL context.
+/// </summary>
+class TextureUploader {
+public:
+	virtual ~TextureUploader() {}
+
+	// texture shown until the images are uploaded, target is GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+	virtual std::shared_ptr<Texture2D> createPlaceholder(GLenum target) = 0;
+	// copy one image into the texture (target = cube map face or GL_TEXTURE_2D),
+	// false if the staging memory is used up, the image is retried on the next update
+	virtual bool upload(Texture2D* texture, GLenum target, DecodedImage const& image, bool srgb) = 0;
+	// all images of the texture are uploaded, mipmaps: the mip levels have to be generated
+	virtual void finish(Texture2D* texture, bool mipmaps) = 0;
+	// start of a TextureLoader update
+	virtual void beginUpdate() {}
+};
+
+/// <summary>
+/// Uploads through a persistent mapped pixel unpack buffer used as ring buffer.
+/// The copy into the buffer is a memcpy, the transfer to the texture runs asynchronously
+/// on the GPU. Regions are reused once the fence of their transfer is signaled.
+/// </summary>
+class PBOTextureUploader : public TextureUploader {
+public:
+	PBOTextureUploader(size_t stagingSize = 64 << 20);
+	~PBOTextureUploader();
+
+	std::shared_ptr<Texture2D> createPlaceholder(GLenum target) override;
+	bool upload(Texture2D* texture, GLenum target, DecodedImage const& image, bool srgb) override;
+	void finish(Texture2D* texture, bool mipmaps) override;
+	void beginUpdate() override;
+
+private:
+	struct Transfer {
+		size_t offset;
+		size_t size;
+		GLsync fence;
+	};
+
+	GLuint pbo_;
+	unsigned char* mapped_;
+	size_t size_;
+	size_t head_;
+	// in flight transfers, oldest first
+	std::deque<Transfer> transfers_;
+
+	bool allocate(size_t size, size_t& offset);
+	// all levels of a baked texture
+	bool uploadLevels(Texture2D* texture, GLenum target, DecodedImage const& image, bool srgb);
+};
+
+template <class T>
+struct TextureHandle {
+	// placeholder until the images are uploaded, nullptr if the uploader has no placeholders
+	std::shared_ptr<T> texture;
+	// true once the images are uploaded, false if an image failed to load
+	std::shared_future<bool> ready;
+
+	bool isReady() const {
+		return ready.valid() && ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+};
+
+/// <summary>
+/// Decodes image files as jobs of a JobSystem and uploads them from the GL thread.
+/// load returns immediately with a placeholder texture, update has to be called on the GL thread
+/// (once per frame) to upload the decoded images. Uploads happen in request order, an image is
+/// uploaded as soon as it and all images of earlier requests are decoded.
+/// Baked textures (see TextureBaker) are used instead of the image files when present,
+/// their mip levels are uploaded as stored.
+/// </summary>
+class TextureLoader {
+public:
+	// decodes the file at path into image, false on error
+	using Decoder = std::function<bool(std::string const& path, DecodedImage& image)>;
+
+	// own job system, threads = 0: one thread less than the hardware concurrency, the GL thread has work too
+	TextureLoader(std::shared_ptr<TextureUploader> uploader = nullptr, int threads = 0, Decoder decoder = nullptr);
+	// decodes as high priority jobs of a shared job system
+	TextureLoader(std::shared_ptr<JobSystem> jobs, std::shared_ptr<TextureUploader> uploader = nullptr, Decoder decoder = nullptr);
+	// cancels the decode jobs that didn't start and waits for the running ones
+	~TextureLoader();
+
+	TextureLoader(TextureLoader const&) = delete;
+	TextureLoader& operator=(TextureLoader const&) = delete;
+
+	/// <summary>
+	/// Loads a texture relative to TEX_DIR, like Texture2D(filename, srgb).
+	/// onReady is called from update after the upload.
+	/// </summary>
+	TextureHandle<Texture2D> load(std::string const& filename, bool srgb = false, bool mipmaps = false,
+		std::function<void()> onReady = nullptr);
+
+	/// <summary>
+	/// Loads a cube map, face order as CubeMap(faces). The faces are decoded in parallel.
+	/// </summary>
+	TextureHandle<CubeMap> loadCubeMap(std::vector<std::string> const& faces, bool mipmaps = false,
+		std::function<void()> onReady = nullptr);
+
+	/// <summary>
+	/// Loads an equirectangular panorama relative to TEX_DIR as cube map with faceSize texels.
+	/// The faces are converted and baked once (see PanoramaConverter), later loads use the baked faces.
+	/// </summary>
+	TextureHandle<CubeMap> loadPanorama(std::string const& filename, int faceSize, bool mipmaps = false,
+		std::function<void()> onReady = nullptr);
+
+	// GL thread: upload decoded images, up to uploadBudget_ bytes (at least one image)
+	void update();
+	// GL thread: wait for and upload all requests
+	void finish();
+
+	// requests that are not completely uploaded
+	size_t getPendingCount() const;
+
+	// stbi decoder, keeps the components of the file. Uses the baked texture <path>.ktx2
+	// instead if it isn't older than the file
+	static bool decodeFile(std::string const& path, DecodedImage& image);
+	// maps a baked texture and reads it into memory
+	static bool decodeBaked(std::string const& path, DecodedImage& image);
+	// the six baked faces of a panorama, converted first if they are missing or older than the panorama
+	static bool decodePanorama(std::string const& path, int faceSize, std::vector<DecodedImage>& faces);
+
+	// bytes uploaded per update, limits the frame time spent on uploads
+	size_t uploadBudget_;
+
+private:
+	struct Request {
+		std::shared_ptr<Texture2D> texture;
+		GLenum target;
+		bool srgb;
+		bool mipmaps;
+		std::vector<std::string> paths;
+		std::vector<DecodedImage> images;
+		// guarded by mutex_
+		std::vector<bool> decoded;
+		std::vector<bool> failed;
+		// images uploaded, in order
+		size_t uploaded = 0;
+		std::promise<bool> promise;
+		std::function<void()> onReady;
+		// decodes all images in one job instead of one job per path
+		std::function<bool(std::vector<DecodedImage>&)> decodeAll;
+	};
+
+	struct DecodeJob {
+		std::shared_ptr<Request> request;
+		size_t image;
+	};
+
+	std::shared_ptr<TextureUploader> uploader_;
+	Decoder decoder_;
+
+	// requests in order, only touched by the GL thread
+	std::deque<std::shared_ptr<Request>> requests_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable imageDecoded_;
+
+	std::shared_ptr<JobSystem> jobs_;
+	// shared by all decode jobs of the loader
+	CancellationToken token_;
+	// jobs not known to be done, only touched by the GL thread
+	std::vector<JobHandle> handles_;
+
+	void submit(std::shared_ptr<Request> const& request);
+	void decode(DecodeJob const& job);
+	// returns false if the budget or the staging memory is used up
+	bool uploadRequest(Request& request, size_t& budget);
+};
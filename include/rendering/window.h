@@ -28,6 +28,8 @@ public:
 	}
 	bool shouldClose();
 	void endFrame();
+	void pollEvents();
+	void swapBuffers();
 
 private:
 
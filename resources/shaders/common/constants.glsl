@@ -0,0 +1,4 @@
+const float PI = 3.14159265359;
+const float I_PI = 1.0/PI;
+const float PI2 = 2*PI;
+const float I_PI2 = 1.0/PI2;
@@ -0,0 +1,15 @@
+
+in vec2 uv;
+// rgb color, a = texture layer or negative for color only
+flat in vec4 color;
+
+layout(binding = 0) uniform sampler2DArray mesh_textures;
+
+out vec4 FragColor;
+
+void main() {
+   if (color.a >= 0)
+      FragColor = vec4(texture(mesh_textures, vec3(uv, color.a)).xyz, 1);
+   else
+      FragColor = vec4(color.rgb, 1);
+}
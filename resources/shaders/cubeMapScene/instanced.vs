@@ -0,0 +1,34 @@
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aUV;
+// index into the instance buffer, one per instance (see InstancedSpheres)
+layout (location = 2) in uint aInstance;
+
+struct Instance {
+    mat4 model;
+    vec4 color;
+    vec4 sphere;
+};
+
+layout (std430, binding = 1) readonly buffer instances
+{
+    Instance instance[];
+};
+
+layout (std140) uniform camera
+{
+    mat4 projectionView;
+    mat4 projectionViewInverse;
+    vec3 camPos;
+};
+
+out vec2 uv;
+flat out vec4 color;
+
+void main()
+{
+    Instance inst = instance[aInstance];
+    uv = vec2(aUV.x, 1-aUV.y);
+    color = inst.color;
+    gl_Position = projectionView * inst.model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,30 @@
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aUV;
+// index into the instance buffer, one per instance (see InstancedSpheres)
+layout (location = 2) in uint aInstance;
+
+struct Instance {
+    mat4 model;
+    vec4 color;
+    vec4 sphere;
+};
+
+layout (std430, binding = 1) readonly buffer instances
+{
+    Instance instance[];
+};
+
+out vec3 vs_worldPos;
+out vec3 vs_modelPos;
+out vec2 vs_uv;
+flat out vec4 vs_color;
+
+void main()
+{
+    Instance inst = instance[aInstance];
+    vs_modelPos = aPos;
+    vs_uv = vec2(aUV.x, 1-aUV.y);
+    vs_color = inst.color;
+    vs_worldPos = (inst.model * vec4(aPos, 1.0)).xyz;
+}
@@ -0,0 +1,49 @@
+
+// one invocation per cube map face, gl_Layer selects the face of the layered fbo
+layout (triangles, invocations = 6) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+layout (std140) uniform cubeCamera
+{
+    mat4 faceProjectionView[6];
+    mat4 faceProjectionViewInverse[6];
+    vec4 camPos;
+};
+
+// bit i set = render face i
+uniform int face_mask = 63;
+
+in vec3 vs_worldPos[];
+in vec3 vs_modelPos[];
+in vec2 vs_uv[];
+flat in vec4 vs_color[];
+
+out vec3 modelPos;
+out vec2 uv;
+// instance color, see instancedLayered.vs
+flat out vec4 color;
+
+void main()
+{
+    if ((face_mask & (1 << gl_InvocationID)) == 0) return;
+
+    vec4 clip[3];
+    for (int i = 0; i < 3; ++i)
+        clip[i] = faceProjectionView[gl_InvocationID] * vec4(vs_worldPos[i], 1.0);
+
+    // skip triangles that are completely outside of one face frustum plane
+    for (int c = 0; c < 3; ++c) {
+        if (clip[0][c] > clip[0].w && clip[1][c] > clip[1].w && clip[2][c] > clip[2].w) return;
+        if (clip[0][c] < -clip[0].w && clip[1][c] < -clip[1].w && clip[2][c] < -clip[2].w) return;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        gl_Layer = gl_InvocationID;
+        gl_Position = clip[i];
+        modelPos = vs_modelPos[i];
+        uv = vs_uv[i];
+        color = vs_color[i];
+        EmitVertex();
+    }
+    EndPrimitive();
+}
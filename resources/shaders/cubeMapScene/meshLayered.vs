@@ -0,0 +1,25 @@
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aUV;
+
+// model matrices of all scene objects
+layout (std430, binding = 0) buffer objects
+{
+    mat4 modelMatrices[];
+};
+
+uniform int object_id;
+
+out vec3 vs_worldPos;
+out vec3 vs_modelPos;
+out vec2 vs_uv;
+// only used by the instanced shaders
+flat out vec4 vs_color;
+
+void main()
+{
+    vs_modelPos = aPos;
+    vs_uv = vec2(aUV.x, 1-aUV.y);
+    vs_color = vec4(1);
+    vs_worldPos = (modelMatrices[object_id] * vec4(aPos, 1.0)).xyz;
+}
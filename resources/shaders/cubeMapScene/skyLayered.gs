@@ -0,0 +1,33 @@
+
+// screen filling quad in every cube map face, see sky.vs
+layout (triangles, invocations = 6) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+layout (std140) uniform cubeCamera
+{
+    mat4 faceProjectionView[6];
+    mat4 faceProjectionViewInverse[6];
+    vec4 camPos;
+};
+
+// bit i set = render face i
+uniform int face_mask = 63;
+
+in vec3 vs_pos[];
+
+out vec3 viewDir;
+
+void main()
+{
+    if ((face_mask & (1 << gl_InvocationID)) == 0) return;
+
+    for (int i = 0; i < 3; ++i) {
+        vec4 invPos = faceProjectionViewInverse[gl_InvocationID] * vec4(vs_pos[i], 1.0);
+
+        gl_Layer = gl_InvocationID;
+        gl_Position = vec4(vs_pos[i].xy, 0.99, 1.0);
+        viewDir = invPos.xyz / invPos.w - camPos.xyz;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
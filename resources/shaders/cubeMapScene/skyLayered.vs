@@ -0,0 +1,9 @@
+
+layout (location = 0) in vec3 aPos;
+
+out vec3 vs_pos;
+
+void main()
+{
+    vs_pos = aPos;
+}
@@ -239,28 +239,7 @@ vec3 pixelColor(vec3 dir) {
 
 }
 
-// functions for rotation using quaternions
-// from https://gist.github.com/nkint/7449c893fb7d6b5fa83118b8474d7dcb
-vec4 setAxisAngle (vec3 axis, float rad) {
-  rad = rad * 0.5;
-  float s = sin(rad);
-  return vec4(s * axis.x, s * axis.y, s * axis.z, cos(rad));
-}
-
-vec4 multQuat(vec4 q1, vec4 q2) {
-  return vec4(
-    q1.w * q2.x + q1.x * q2.w + q1.z * q2.y - q1.y * q2.z,
-    q1.w * q2.y + q1.y * q2.w + q1.x * q2.z - q1.z * q2.x,
-    q1.w * q2.z + q1.z * q2.w + q1.y * q2.x - q1.x * q2.y,
-    q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z
-  );
-}
-
-vec3 rotateVector( vec4 quat, vec3 vec ) {
-  // https://twistedpairdevelopment.wordpress.com/2013/02/11/rotating-a-vector-by-a-quaternion-in-glsl/
-  vec4 qv = multQuat( quat, vec4(vec, 0.0) );
-  return multQuat( qv, vec4(-quat.x, -quat.y, -quat.z, quat.w) ).xyz;
-}
+#include "common/quaternion.glsl"
 
 void main()
 {    
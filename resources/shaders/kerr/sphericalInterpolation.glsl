@@ -0,0 +1,134 @@
+// Interpolation of theta, phi grid positions, shared by the kerr grid shaders.
+
+#include "common/constants.glsl"
+
+// Checks and corrects phi values for 2-pi crossings.
+bool piCheckTot(vec2[4] tp, float factor, int size) {
+	float factor1 = PI2*(1.0 - factor);
+	bool check = false;
+	for (int q = 0; q < size; q++) {
+		if (tp[q].y > factor1) {
+			check = true;
+			break;
+		}
+	}
+	if (!check) return false;
+	check = false;
+	float factor2 = PI2 * factor;
+	for (int q = 0; q < size; q++) {
+		if (tp[q].y < factor2) {
+			tp[q].y += PI2;
+			check = true;
+		}
+	}
+	return check;
+}
+
+// Checks and corrects phi values for 2-pi crossings.
+bool piCheckTot(vec2[2] tp, float factor, int size) {
+	float factor1 = PI2*(1.0 - factor);
+	bool check = false;
+	for (int q = 0; q < size; q++) {
+		if (tp[q].y > factor1) {
+			check = true;
+			break;
+		}
+	}
+	if (!check) return false;
+	check = false;
+	float factor2 = PI2 * factor;
+	for (int q = 0; q < size; q++) {
+		if (tp[q].y < factor2) {
+			tp[q].y += PI2;
+			check = true;
+		}
+	}
+	return check;
+}
+
+// Checks and corrects phi values for 2-pi crossings.
+bool piCheckTot(vec2[12] tp, float factor, int size) {
+	float factor1 = PI2*(1.0 - factor);
+	bool check = false;
+	for (int q = 0; q < size; q++) {
+		if (tp[q].y > factor1) {
+			check = true;
+			break;
+		}
+	}
+	if (!check) return false;
+	check = false;
+	float factor2 = PI2 * factor;
+	for (int q = 0; q < size; q++) {
+		if (tp[q].y < factor2) {
+			tp[q].y += PI2;
+			check = true;
+		}
+	}
+	return check;
+}
+
+
+// Checks and corrects phi values for 2-pi crossings.
+bool piCheck(float[4] p, float factor) {
+	float factor1 = PI2*(1.0 - factor);
+	bool check = false;
+
+	for (int q = 0; q < 4; q++) {
+		if (p[q] > factor1) {
+			check = true;
+			break;
+		}
+	}
+	if (!check) return false;
+	check = false;
+	float factor2 = PI2 * factor;
+
+	for (int q = 0; q < 4; q++) {
+		if (p[q] < factor2) {
+			p[q] += PI2;
+			check = true;
+		}
+	}
+	return check;
+}
+
+void wrapToPi(inout vec2 thphi) {
+	thphi.x = mod(thphi.x, PI2);
+	while (thphi.x < 0.0) thphi.x += PI2;
+	if (thphi.x > PI) {
+		thphi.x -= 2.0 * (thphi.x - PI);
+		thphi.y += PI;
+	}
+	while (thphi.y < 0.0) thphi.y += PI2;
+	thphi.y = mod(thphi.y, PI2);
+}
+
+vec2 hermite(float aValue, vec2 aX0, vec2 aX1, vec2 aX2, vec2 aX3,
+	float aTension, float aBias) {
+	/* Source:
+	* http://paulbourke.net/miscellaneous/interpolation/
+	*/
+
+	const float v = aValue;
+	const float v2 = v*v;
+	const float v3 = v*v2;
+
+	const float aa = (1.0 + aBias)*(1.0 - aTension) / 2.0;
+	const float bb = (1.0 - aBias)*(1.0 - aTension) / 2.0;
+
+	const float m0T = aa * (aX1.x - aX0.x) + bb * (aX2.x - aX1.x);
+	const float m0P = aa * (aX1.y - aX0.y) + bb * (aX2.y - aX1.y);
+
+	const float m1T = aa * (aX2.x - aX1.x) + bb * (aX3.x - aX2.x);
+	const float m1P = aa * (aX2.y - aX1.y) + bb * (aX3.y - aX2.y);
+
+	const float u0 = 2.0 *v3 - 3.0*v2 + 1.0;
+	const float u1 = v3 - 2.0*v2 + v;
+	const float u2 = v3 - v2;
+	const float u3 = -2.0*v3 + 3.0*v2;
+
+	return vec2( 
+		u0*aX1.x + u1*m0T + u2*m1T + u3*aX2.x, 
+		u0*aX1.y + u1*m0P + u2*m1P + u3*aX2.y );
+}
@@ -1,18 +1,41 @@
 #include <app/app.h>
 
+#include <iostream>
+
+// the JSON object in s, empty if it isn't one
+static boost::json::object parseObject(std::string const& s)
+{
+	boost::json::error_code error;
+	boost::json::value v = boost::json::parse(s, error);
+	if (error || v.kind() != boost::json::kind::object) {
+		std::cerr << "[GLApp] Error parsing replayed frame" << std::endl;
+		return {};
+	}
+	return v.get_object();
+}
+
 GLApp::GLApp(int width, int height, std::string const& name)
 	: window_(width, height, name)
 	, gui_(window_.getPtr())
+	, profiler_(std::make_shared<GpuProfiler>())
+	, recorder_(profiler_)
+	, jobs_(std::make_shared<JobSystem>())
 	, showGui_(false)
 	, showFps_(false)
+	, showProfiler_(false)
 {
 }
 
 void GLApp::renderLoop()
 {
+	processKeyboardInput();
+	updateContent();
 	while (!window_.shouldClose())
 	{
-		processKeyboardInput();
+		FrameLog::Frame const* replayed = recorder_.beginFrame();
+		shaderWatcher_.update();
+		profiler_->beginFrame();
+		if (replayed) loadFrame(*replayed);
 		if (showGui_) {
 
 			gui_.newFrame();
@@ -22,8 +45,19 @@ void GLApp::renderLoop()
 
 		renderContent();
 
-		if (showGui_) gui_.renderEnd();
-		window_.endFrame();
+		if (showGui_) {
+			GpuProfiler::Scope scope(profiler_, "gui");
+			gui_.renderEnd();
+		}
+		recordFrame();
+		profiler_->endFrame();
+
+		// the gpu starts on this frame while the next one is prepared, the swap waits for it
+		glFlush();
+		window_.pollEvents();
+		processKeyboardInput();
+		updateContent();
+		window_.swapBuffers();
 		frameTimer_.measure();
 	}
 }
@@ -31,12 +65,43 @@ void GLApp::renderLoop()
 void GLApp::renderGui() {
 	if (showFps_)
 		renderFPSWindow();
+	if (showProfiler_)
+		profiler_->renderWindow(&showProfiler_);
 
 	ImGui::Begin("Application Options");
 	ImGui::Checkbox("Show FPS", &showFps_);
+	ImGui::Checkbox("Show GPU Profiler", &showProfiler_);
+	ImGui::Checkbox("Reload Changed Shaders", &shaderWatcher_.enabled_);
+	ImGui::Separator();
+	recorder_.renderGui();
 	ImGui::End();
 }
 
+void GLApp::loadFrame(FrameLog::Frame const& frame)
+{
+	if (!frame.state.empty()) {
+		boost::json::object state = parseObject(frame.state);
+		loadState(state);
+	}
+	if (!frame.camera.empty()) {
+		boost::json::object camera = parseObject(frame.camera);
+		loadCamera(camera);
+	}
+}
+
+void GLApp::recordFrame()
+{
+	std::string camera, state;
+	if (recorder_.isRecording()) {
+		boost::json::object cameraObject, stateObject;
+		storeCamera(cameraObject);
+		storeState(stateObject);
+		if (!cameraObject.empty()) camera = boost::json::serialize(cameraObject);
+		if (!stateObject.empty()) state = boost::json::serialize(stateObject);
+	}
+	recorder_.endFrame(camera, state);
+}
+
 void GLApp::renderFPSWindow() {
 	ImGui::Begin("FPS");
 	double avgTime = frameTimer_.getAvg();
@@ -0,0 +1,317 @@
+#include <app/frameRecorder.h>
+
+#include <helpers/RootDir.h>
+#include <gui/gui.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+// frames to wait for outstanding GPU times, more than the profiler keeps in flight
+static const int MAX_FINISH_FRAMES = 16;
+
+static std::string getResultPath(std::string const& name, std::string const& suffix)
+{
+	return ROOT_DIR "data/" + name + suffix;
+}
+
+FrameRecorder::FrameRecorder(std::shared_ptr<GpuProfiler> profiler)
+	: profiler_(profiler)
+	, mode_(Mode::IDLE)
+	, finishing_(Mode::IDLE)
+	, frame_(0)
+	, finishFrames_(0)
+	, frameStarted_(false)
+	, timestep_(0.0)
+	, replayTime_(0.0)
+	, offset_(0.0)
+	, lastClock_(0.0)
+	, lastTime_(0.0)
+	, guiName_("benchmark")
+	, guiTimestepMs_(1000.f / 60.f)
+	, guiRecordedTimestep_(false)
+{
+	if (profiler_) {
+		profiler_->setFrameCallback([this](uint64_t frame, std::map<std::string, double> const& times) {
+			onGpuFrame(frame, times);
+		});
+	}
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	if (profiler_) profiler_->setFrameCallback(nullptr);
+	// don't lose a recording when the window is closed
+	if (mode_ != Mode::IDLE) {
+		stop();
+		finish();
+	}
+}
+
+std::string FrameRecorder::getLogPath(std::string const& name)
+{
+	return ROOT_DIR "saves/" + name + ".bhvlog";
+}
+
+void FrameRecorder::startRecording(std::string const& name)
+{
+	if (mode_ != Mode::IDLE) stop();
+	if (mode_ == Mode::FINISHING) finish();
+
+	name_ = name;
+	log_.clear();
+	gpuFrames_.clear();
+	lastCamera_.clear();
+	lastState_.clear();
+	frame_ = 0;
+	frameStarted_ = false;
+	mode_ = Mode::RECORDING;
+	std::cout << "[FrameRecorder] recording " << name_ << std::endl;
+}
+
+bool FrameRecorder::startReplay(std::string const& name, double timestep)
+{
+	if (mode_ != Mode::IDLE) stop();
+	if (mode_ == Mode::FINISHING) finish();
+
+	if (!log_.read(getLogPath(name)) || log_.empty()) {
+		std::cerr << "[FrameRecorder] no frames to replay in " << getLogPath(name) << std::endl;
+		return false;
+	}
+
+	name_ = name;
+	timestep_ = timestep;
+	replayTime_ = lastTime_;
+	samples_.assign(log_.size(), Sample());
+	passes_.clear();
+	passHistory_.clear();
+	gpuFrames_.clear();
+	frame_ = 0;
+	frameStarted_ = false;
+	mode_ = Mode::REPLAYING;
+	std::cout << "[FrameRecorder] replaying " << log_.size() << " frames of " << name_ << std::endl;
+	return true;
+}
+
+void FrameRecorder::stop()
+{
+	if (mode_ != Mode::RECORDING && mode_ != Mode::REPLAYING) return;
+	if (mode_ == Mode::REPLAYING) {
+		// only the replayed frames count, including a frame stopped from the GUI
+		samples_.resize(frame_ + (frameStarted_ ? 1 : 0));
+		offset_ = lastTime_ - lastClock_;
+	}
+	finishing_ = mode_;
+	finishFrames_ = 0;
+	mode_ = Mode::FINISHING;
+}
+
+FrameLog::Frame const* FrameRecorder::beginFrame()
+{
+	Clock::time_point now = Clock::now();
+	double frameMs = std::chrono::duration<double, std::milli>(now - frameStart_).count();
+	// the previous frame lasted until now
+	if (frameStarted_ && frame_ > 0) {
+		if (mode_ == Mode::RECORDING || finishing_ == Mode::RECORDING)
+			log_.at(frame_ - 1).dt = (float)(frameMs * 1e-3);
+		else if (frame_ <= samples_.size())
+			samples_[frame_ - 1].frameMs = frameMs;
+	}
+	frameStart_ = now;
+	frameStarted_ = false;
+
+	if (mode_ == Mode::FINISHING) {
+		// the frame time of the last frame is known now
+		if (gpuFrames_.empty() || ++finishFrames_ > MAX_FINISH_FRAMES)
+			finish();
+		return nullptr;
+	}
+
+	if (mode_ == Mode::REPLAYING && frame_ == log_.size()) {
+		stop();
+		return nullptr;
+	}
+
+	frameStarted_ = mode_ != Mode::IDLE;
+	if (mode_ != Mode::REPLAYING) return nullptr;
+
+	// the first frame advances as much as the next one
+	double step = timestep_ > 0.0 ? timestep_ : log_.at(frame_ > 0 ? frame_ - 1 : 0).dt;
+	replayTime_ += step;
+	samples_[frame_].time = replayTime_;
+	return &log_.at(frame_);
+}
+
+void FrameRecorder::endFrame(std::string const& camera, std::string const& state)
+{
+	if (!frameStarted_) return;
+	double cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart_).count();
+
+	if (profiler_ && profiler_->isMeasuring())
+		gpuFrames_[profiler_->getFrameIndex()] = frame_;
+
+	if (mode_ == Mode::RECORDING || finishing_ == Mode::RECORDING) {
+		FrameLog::Frame frame;
+		frame.cpuMs = (float)cpuMs;
+		// only changes are stored
+		if (camera != lastCamera_) frame.camera = lastCamera_ = camera;
+		if (state != lastState_) frame.state = lastState_ = state;
+		log_.add(frame);
+	}
+	else if (frame_ < samples_.size()) {
+		samples_[frame_].cpuMs = cpuMs;
+	}
+	++frame_;
+}
+
+double FrameRecorder::getTime(double clock)
+{
+	double time = mode_ == Mode::REPLAYING ? replayTime_ : clock + offset_;
+	lastClock_ = clock;
+	lastTime_ = time;
+	return time;
+}
+
+void FrameRecorder::onGpuFrame(uint64_t frame, std::map<std::string, double> const& times)
+{
+	auto it = gpuFrames_.find(frame);
+	if (it == gpuFrames_.end()) return;
+	size_t index = it->second;
+	gpuFrames_.erase(it);
+
+	auto total = times.find("frame");
+	double gpuMs = total == times.end() ? 0.0 : total->second;
+
+	bool recording = mode_ == Mode::RECORDING || (mode_ == Mode::FINISHING && finishing_ == Mode::RECORDING);
+	if (recording) {
+		if (index < log_.size()) log_.at(index).gpuMs = (float)gpuMs;
+		return;
+	}
+	if (index >= samples_.size()) return;
+
+	samples_[index].gpuMs = gpuMs;
+	for (auto const& [pass, time] : times) {
+		if (passHistory_.find(pass) == passHistory_.end()) {
+			passes_.push_back(pass);
+			passHistory_.emplace(pass, SampleHistory(log_.size()));
+		}
+		passHistory_.at(pass).add(time);
+	}
+}
+
+void FrameRecorder::finish()
+{
+	if (finishing_ == Mode::RECORDING) finishRecording();
+	else if (finishing_ == Mode::REPLAYING) finishReplay();
+	gpuFrames_.clear();
+	finishing_ = Mode::IDLE;
+	mode_ = Mode::IDLE;
+}
+
+void FrameRecorder::finishRecording()
+{
+	std::error_code error;
+	std::filesystem::create_directories(ROOT_DIR "saves/", error);
+	if (log_.write(getLogPath(name_)))
+		std::cout << "[FrameRecorder] recorded " << log_.size() << " frames (" << log_.getDuration()
+			<< "s) to " << getLogPath(name_) << std::endl;
+}
+
+void FrameRecorder::finishReplay()
+{
+	SampleHistory frameTimes(std::max<size_t>(samples_.size(), 1));
+	SampleHistory cpuTimes(frameTimes.getCapacity());
+	SampleHistory gpuTimes(frameTimes.getCapacity());
+	for (auto const& sample : samples_) {
+		frameTimes.add(sample.frameMs);
+		cpuTimes.add(sample.cpuMs);
+		// frames without GPU time (profiler disabled or dropped) don't count
+		if (sample.gpuMs > 0.0) gpuTimes.add(sample.gpuMs);
+	}
+	frameStats_ = frameTimes.getStats();
+	cpuStats_ = cpuTimes.getStats();
+	gpuStats_ = gpuTimes.getStats();
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "[FrameRecorder] replayed " << samples_.size() << " of " << log_.size() << " frames of " << name_ << std::endl;
+	for (auto const& [label, stats] : { std::pair{ "frame", frameStats_ }, { "cpu", cpuStats_ }, { "gpu", gpuStats_ } }) {
+		std::cout << "[FrameRecorder] " << label << " ms: median " << stats.median << ", p95 " << stats.p95
+			<< ", mean " << stats.mean << ", min " << stats.min << " (" << stats.count << " frames)" << std::endl;
+	}
+	std::cout << std::defaultfloat;
+	writeResults();
+}
+
+bool FrameRecorder::writeResults() const
+{
+	std::error_code error;
+	std::filesystem::create_directories(ROOT_DIR "data/", error);
+
+	std::ofstream frames(getResultPath(name_, ".replay.csv"));
+	std::ofstream passes(getResultPath(name_, ".passes.csv"));
+	if (!frames || !passes) {
+		std::cerr << "[FrameRecorder] can't write the results of " << name_ << " to " ROOT_DIR "data/" << std::endl;
+		return false;
+	}
+
+	frames << "frame,time_s,frame_ms,cpu_ms,gpu_ms,recorded_frame_ms,recorded_cpu_ms,recorded_gpu_ms\n";
+	frames << std::fixed << std::setprecision(4);
+	for (size_t i = 0; i < samples_.size(); ++i) {
+		Sample const& sample = samples_[i];
+		FrameLog::Frame const& recorded = log_.at(i);
+		frames << i << "," << sample.time << "," << sample.frameMs << "," << sample.cpuMs << "," << sample.gpuMs << ","
+			<< recorded.dt * 1e3 << "," << recorded.cpuMs << "," << recorded.gpuMs << "\n";
+	}
+
+	passes << "pass,count,min_ms,median_ms,p95_ms,mean_ms\n";
+	passes << std::fixed << std::setprecision(4);
+	for (auto const& pass : passes_) {
+		SampleHistory::Stats stats = passHistory_.at(pass).getStats();
+		passes << pass << "," << stats.count << "," << stats.min << "," << stats.median << ","
+			<< stats.p95 << "," << stats.mean << "\n";
+	}
+
+	std::cout << "[FrameRecorder] results written to " << getResultPath(name_, ".replay.csv")
+		<< " and " << getResultPath(name_, ".passes.csv") << std::endl;
+	return (bool)frames && (bool)passes;
+}
+
+void FrameRecorder::renderGui()
+{
+	ImGui::Text("Benchmark Recording");
+	ImGui::PushItemWidth(ImGui::GetFontSize() * 7);
+	ImGui::InputText("log name", &guiName_);
+	ImGui::PopItemWidth();
+
+	switch (mode_) {
+	case Mode::IDLE:
+		if (ImGui::Button("Record")) startRecording(guiName_);
+		ImGui::SameLine();
+		if (ImGui::Button("Replay"))
+			startReplay(guiName_, guiRecordedTimestep_ ? 0.0 : guiTimestepMs_ * 1e-3);
+		ImGui::Checkbox("Recorded timestep", &guiRecordedTimestep_);
+		if (!guiRecordedTimestep_)
+			ImGui::InputFloat("timestep ms", &guiTimestepMs_, 1.f, 10.f);
+		break;
+	case Mode::RECORDING:
+		ImGui::Text("recording frame %zu", frame_);
+		ImGui::SameLine();
+		if (ImGui::Button("Stop")) stop();
+		break;
+	case Mode::REPLAYING:
+		ImGui::Text("replaying frame %zu / %zu", frame_, log_.size());
+		ImGui::SameLine();
+		if (ImGui::Button("Stop")) stop();
+		break;
+	case Mode::FINISHING:
+		ImGui::Text("waiting for GPU times");
+		break;
+	}
+
+	if (frameStats_.count > 0) {
+		ImGui::Text("last replay (median / p95 ms)");
+		ImGui::Text("frame %.3f / %.3f, cpu %.3f / %.3f, gpu %.3f / %.3f", frameStats_.median, frameStats_.p95,
+			cpuStats_.median, cpuStats_.p95, gpuStats_.median, gpuStats_.p95);
+	}
+}
@@ -61,3 +61,39 @@ std::vector<float> Camera::getParamArray()
 	return camera;
 }
 
+
+void Camera::traceRay(double& theta, double& phi, int& step) const
+{
+	double xCam = sin(theta) * cos(phi);
+	double yCam = sin(theta) * sin(phi);
+	double zCam = cos(theta);
+
+	double yFido = (-yCam + speed) / (1 - speed * yCam);
+	double xFido = -sqrtf(1 - speed * speed) * xCam / (1 - speed * yCam);
+	double zFido = -sqrtf(1 - speed * speed) * zCam / (1 - speed * yCam);
+
+	double k = sqrt(1 - btheta * btheta);
+	double rFido = xFido * bphi / k + br * yFido + br * btheta / k * zFido;
+	double thetaFido = btheta * yFido - k * zFido;
+	double phiFido = -xFido * br / k + bphi * yFido + bphi * btheta / k * zFido;
+	//double rFido = xFido;
+	//double thetaFido = -zFido;
+	//double phiFido = yFido;
+
+	double eF = 1. / (alpha + w * wbar * phiFido);
+
+	double pR = eF * ro * rFido / sqrtf(Delta);
+	double pTheta = eF * ro * thetaFido;
+	double pPhi = eF * wbar * phiFido;
+
+	double b = pPhi;
+	double q = pTheta * pTheta + cos(this->theta) * cos(this->theta) * (b * b / (sin(this->theta) * sin(this->theta)) - metric_->asq());
+
+	theta = -1;
+	phi = -1;
+	step = 0;
+
+	if (metric_->checkCelest(pR, r, this->theta, b, q)) {
+		metric_->rkckIntegrate1(r, this->theta, this->phi, pR, b, q, pTheta, theta, phi, step);
+	}
+}
@@ -0,0 +1,181 @@
+#include <blacktracer/CameraPath.h>
+#include <helpers/json_helper.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <boost/json.hpp>
+
+// cubic hermite between p1 at t1 and p2 at t2, tangents from the neighbouring keys (catmull-rom)
+template <typename T>
+static T catmullRom(double t, double t0, T const& p0, double t1, T const& p1, double t2, T const& p2, double t3, T const& p3)
+{
+	double dt = t2 - t1;
+	if (dt <= 0.0) return p2;
+	T m1 = (p2 - p0) / std::max(t2 - t0, 1e-9);
+	T m2 = (p3 - p1) / std::max(t3 - t1, 1e-9);
+
+	double u = (t - t1) / dt;
+	double u2 = u * u, u3 = u2 * u;
+	return (2 * u3 - 3 * u2 + 1) * p1 + (u3 - 2 * u2 + u) * dt * m1
+		+ (-2 * u3 + 3 * u2) * p2 + (u3 - u2) * dt * m2;
+}
+
+CameraPath::CameraPath(double fps)
+	: fps_(fps)
+{}
+
+void CameraPath::add(CameraKeyframe const& keyframe)
+{
+	auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), keyframe.time,
+		[](double time, CameraKeyframe const& k) { return time < k.time; });
+	keyframes_.insert(it, keyframe);
+}
+
+void CameraPath::remove(size_t index)
+{
+	if (index < keyframes_.size())
+		keyframes_.erase(keyframes_.begin() + index);
+}
+
+double CameraPath::getDuration() const
+{
+	return keyframes_.empty() ? 0.0 : keyframes_.back().time - keyframes_.front().time;
+}
+
+size_t CameraPath::getFrameCount() const
+{
+	if (keyframes_.empty() || fps_ <= 0.0) return 0;
+	// the last keyframe is a frame of its own
+	return (size_t)std::floor(getDuration() * fps_ + 1e-6) + 1;
+}
+
+double CameraPath::getFrameTime(size_t frame) const
+{
+	double start = keyframes_.empty() ? 0.0 : keyframes_.front().time;
+	return start + frame / fps_;
+}
+
+CameraKeyframe CameraPath::sample(double t) const
+{
+	if (keyframes_.empty()) return CameraKeyframe();
+	if (t <= keyframes_.front().time) return keyframes_.front();
+	if (t >= keyframes_.back().time) return keyframes_.back();
+
+	// segment i to i + 1 containing t
+	size_t i = std::upper_bound(keyframes_.begin(), keyframes_.end(), t,
+		[](double time, CameraKeyframe const& k) { return time < k.time; }) - keyframes_.begin() - 1;
+	CameraKeyframe const& k0 = keyframes_[i > 0 ? i - 1 : i];
+	CameraKeyframe const& k1 = keyframes_[i];
+	CameraKeyframe const& k2 = keyframes_[i + 1];
+	CameraKeyframe const& k3 = keyframes_[std::min(i + 2, keyframes_.size() - 1)];
+
+	CameraKeyframe result;
+	result.time = t;
+	result.positionRTP = catmullRom(t, k0.time, k0.positionRTP, k1.time, k1.positionRTP,
+		k2.time, k2.positionRTP, k3.time, k3.positionRTP);
+	// the spline overshoots, keep the camera off the poles and outside of the black hole
+	result.positionRTP.x = std::max(result.positionRTP.x, std::min(k1.positionRTP.x, k2.positionRTP.x) * 0.5);
+	result.positionRTP.y = std::clamp(result.positionRTP.y, 1e-3, PI - 1e-3);
+
+	double u = (t - k1.time) / (k2.time - k1.time);
+	result.viewDirTP = glm::mix(k1.viewDirTP, k2.viewDirTP, u);
+	result.speed = glm::mix(k1.speed, k2.speed, u);
+	return result;
+}
+
+GridProperties CameraPath::getGridProperties(double t, GridProperties const& base) const
+{
+	CameraKeyframe camera = sample(t);
+	GridProperties props = base;
+	props.cam_rad_ = camera.positionRTP.x;
+	props.cam_the_ = camera.positionRTP.y;
+	props.cam_phi_ = camera.positionRTP.z - PI2 * std::floor(camera.positionRTP.z / PI2);
+	props.cam_vel_ = camera.speed;
+	return props;
+}
+
+std::vector<GridProperties> CameraPath::getFrameGrids(GridProperties const& base) const
+{
+	std::vector<GridProperties> grids(getFrameCount());
+	for (size_t frame = 0; frame < grids.size(); ++frame)
+		grids[frame] = getGridProperties(getFrameTime(frame), base);
+	return grids;
+}
+
+bool CameraPath::save(std::string const& path) const
+{
+	boost::json::array keyframes;
+	for (auto const& k : keyframes_) {
+		boost::json::object keyframe;
+		keyframe["time"] = k.time;
+		keyframe["positionRTP"] = { k.positionRTP.x, k.positionRTP.y, k.positionRTP.z };
+		keyframe["viewDirTP"] = { k.viewDirTP.x, k.viewDirTP.y };
+		keyframe["speed"] = k.speed;
+		keyframes.push_back(keyframe);
+	}
+
+	boost::json::object configuration;
+	configuration["fps"] = fps_;
+	configuration["keyframes"] = keyframes;
+
+	std::ofstream outFile(path);
+	if (!outFile) {
+		std::cerr << "[CameraPath] can't write " << path << std::endl;
+		return false;
+	}
+	outFile << boost::json::serialize(configuration);
+	return (bool)outFile;
+}
+
+bool CameraPath::load(std::string const& path)
+{
+	std::ifstream inFile(path);
+	if (!inFile) {
+		std::cerr << "[CameraPath] file " << path << " not found" << std::endl;
+		return false;
+	}
+	std::ostringstream sstr;
+	sstr << inFile.rdbuf();
+
+	boost::json::error_code error;
+	boost::json::value v = boost::json::parse(sstr.str(), error);
+	if (error || v.kind() != boost::json::kind::object || !v.get_object().contains("keyframes")
+		|| v.get_object().at("keyframes").kind() != boost::json::kind::array) {
+		std::cerr << "[CameraPath] Error parsing camera path " << path << std::endl;
+		return false;
+	}
+
+	boost::json::object const& configuration = v.get_object();
+	double fps = fps_;
+	jhelper::getValue(configuration, "fps", fps);
+
+	std::vector<CameraKeyframe> keyframes;
+	for (auto const& value : configuration.at("keyframes").get_array()) {
+		if (value.kind() != boost::json::kind::object) continue;
+		boost::json::object const& keyframe = value.get_object();
+		CameraKeyframe k;
+		glm::vec3 position = k.positionRTP;
+		glm::vec2 viewDir = k.viewDirTP;
+		jhelper::getValue(keyframe, "time", k.time);
+		jhelper::getValue(keyframe, "positionRTP", position);
+		jhelper::getValue(keyframe, "viewDirTP", viewDir);
+		jhelper::getValue(keyframe, "speed", k.speed);
+		k.positionRTP = position;
+		k.viewDirTP = viewDir;
+		keyframes.push_back(k);
+	}
+	if (keyframes.empty()) {
+		std::cerr << "[CameraPath] no keyframes in " << path << std::endl;
+		return false;
+	}
+
+	fps_ = fps;
+	keyframes_.clear();
+	for (auto const& k : keyframes)
+		add(k);
+	return true;
+}
@@ -0,0 +1,313 @@
+#include <blacktracer/CompactGrid.h>
+#include <blacktracer/Const.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iostream>
+
+// all in float, the same operations as makeCompactGrid.comp
+static const float F_PI = (float)PI;
+static const float F_PI2 = (float)PI2;
+// absolute resolution of theta and phi
+static const float THETA_UNIT = (float)(PI / 32766.0);
+static const float PHI_UNIT = (float)(PI2 / 65536.0);
+static const uint32_t SHADOW = 32767;
+// largest differences in units of the level scale
+static const int MAX_THETA_STEPS = 16383;
+static const int MAX_PHI_STEPS = 32767;
+// shares of the differences a level scale is fitted to, see chooseScale
+static const double SCALE_QUANTILES[] = { 0.25, 0.5, 0.6, 0.7, 0.8, 0.9, 0.95, 0.99 };
+
+static float modPi2(float phi) { return phi - F_PI2 * std::floor(phi / F_PI2); }
+static float wrapPi(float dPhi) { return dPhi - F_PI2 * std::floor(dPhi / F_PI2 + 0.5f); }
+static uint64_t toKey(glm::ivec2 key) { return (uint64_t)key.x << 32 | (uint32_t)key.y; }
+
+/// <summary>
+/// Prediction of point key of level (gap = 1 << (maxLevel - level)) from its decoded parents,
+/// false if all of them are missing or in the shadow.
+/// </summary>
+static bool predict(glm::ivec2 key, int gap, int width, FlatHashMap<glm::vec2> const& decoded, glm::vec2& prediction)
+{
+	glm::ivec2 parents[4];
+	int count = 2;
+	if (key.x % (2 * gap) == 0) {
+		// on a horizontal edge
+		parents[0] = key - glm::ivec2(0, gap);
+		parents[1] = key + glm::ivec2(0, gap);
+	}
+	else if (key.y % (2 * gap) == 0) {
+		// on a vertical edge
+		parents[0] = key - glm::ivec2(gap, 0);
+		parents[1] = key + glm::ivec2(gap, 0);
+	}
+	else {
+		// block center
+		parents[0] = key + glm::ivec2(-gap, -gap);
+		parents[1] = key + glm::ivec2(-gap, gap);
+		parents[2] = key + glm::ivec2(gap, -gap);
+		parents[3] = key + glm::ivec2(gap, gap);
+		count = 4;
+	}
+
+	int valid = 0;
+	glm::vec2 sum(0.f);
+	float phi0 = 0.f;
+	for (int k = 0; k < count; ++k) {
+		glm::ivec2 parent = parents[k];
+		parent.y = (parent.y + width) % width;
+		auto it = decoded.find(toKey(parent));
+		if (it == decoded.end() || !((*it).second.x >= 0.f)) continue;
+		glm::vec2 value = (*it).second;
+		if (valid == 0) phi0 = value.y;
+		sum += glm::vec2(value.x, wrapPi(value.y - phi0));
+		++valid;
+	}
+	if (valid == 0) return false;
+	prediction = { sum.x / (float)valid, modPi2(phi0 + sum.y / (float)valid) };
+	return true;
+}
+
+/// <summary>
+/// Scale for the differences of a level. Differences that don't fit are stored absolute, so a small scale
+/// trades precision of the small differences against the number of absolute points. Returns the
+/// scale with the smallest mean error, estimated as quantile * scale / 2 + (1 - quantile) * unit / 2.
+/// </summary>
+static float chooseScale(std::vector<float>& differences, int steps, float unit)
+{
+	if (differences.empty()) return unit;
+	std::sort(differences.begin(), differences.end());
+	float best = unit;
+	double bestError = 0.5 * unit;
+	for (double quantile : SCALE_QUANTILES) {
+		float scale = std::clamp(differences[(size_t)((differences.size() - 1) * quantile)] / (float)steps, 1e-9f, unit);
+		double error = 0.5 * (quantile * scale + (1.0 - quantile) * unit);
+		if (error < bestError) {
+			best = scale;
+			bestError = error;
+		}
+	}
+	return best;
+}
+
+static bool isDifference(uint32_t code) { return (code & 1) != 0; }
+
+static glm::vec2 decodeValue(uint32_t code, glm::vec2 prediction, glm::vec2 scale)
+{
+	uint32_t theta = code & 0xffff;
+	if (isDifference(code)) {
+		// sign extension of 15 and 16 bits
+		int dTheta = (int)(theta << 16) >> 17;
+		int dPhi = (int)code >> 16;
+		return { prediction.x + (float)dTheta * scale.x, modPi2(prediction.y + (float)dPhi * scale.y) };
+	}
+	if ((theta >> 1) == SHADOW) return { -1.f, -1.f };
+	return { (float)(theta >> 1) * THETA_UNIT, (float)(code >> 16) * PHI_UNIT };
+}
+
+static uint32_t encodeAbsolute(glm::vec2 value)
+{
+	if (!(value.x >= 0.f) || !std::isfinite(value.y)) return SHADOW << 1;
+	uint32_t theta = (uint32_t)std::clamp((int)std::lround(value.x / THETA_UNIT), 0, (int)SHADOW - 1);
+	uint32_t phi = (uint32_t)std::lround(modPi2(value.y) / PHI_UNIT) & 0xffff;
+	return theta << 1 | phi << 16;
+}
+
+CompactGrid::CompactGrid(Grid const& grid)
+{
+	PSHOffsetTable const& hasher = grid.hasher;
+	if (hasher.hashTable.empty()) return;
+	if (grid.M_ > 0x10000) {
+		std::cerr << "[CompactGrid] grid positions don't fit into 16 bit tags" << std::endl;
+		return;
+	}
+
+	hashTableWidth = hasher.hashTableWidth;
+	offsetTableWidth = hasher.offsetTableWidth;
+	offsetTable.resize(hasher.offsetTable.size() / 2);
+	for (size_t q = 0; q < offsetTable.size(); ++q) {
+		int x = hasher.offsetTable[2 * q], y = hasher.offsetTable[2 * q + 1];
+		if (std::max(std::abs(x), std::abs(y)) > 0x7fff) {
+			std::cerr << "[CompactGrid] hash offsets don't fit into 16 bits" << std::endl;
+			*this = CompactGrid();
+			return;
+		}
+		offsetTable[q] = ((uint32_t)x & 0xffff) | (uint32_t)y << 16;
+	}
+	values.resize((size_t)hashTableWidth * hashTableWidth, 0);
+	// empty slots keep a tag no key has
+	tags.resize(values.size(), 0xffffffff);
+
+	startLevel = grid.getProperties().grid_strtLvl_;
+	maxLevel = grid.MAXLEVEL_;
+	width = grid.M_;
+	levelScales.assign(COMPACT_MAX_LEVELS, glm::vec2(0.f));
+
+	// grids loaded from file only keep the hash, its float values are all there is to encode
+	FlatHashMap<glm::vec2> source;
+	if (grid.CamToCel.empty()) {
+		std::vector<glm::ivec2> keys;
+		std::vector<glm::vec2> data;
+		hasher.getEntries(keys, data);
+		source.reserve(keys.size());
+		for (size_t q = 0; q < keys.size(); ++q)
+			source[toKey(keys[q])] = data[q];
+	}
+	else {
+		source.reserve(grid.CamToCel.size());
+		for (auto const& [ij, thphi] : grid.CamToCel)
+			source[ij] = { (float)thphi.x, (float)thphi.y };
+	}
+
+	// points by the level they are traced at, sorted to be independent of the map order
+	std::vector<std::vector<uint64_t>> levels(maxLevel + 1);
+	for (auto const& [ij, thphi] : source) {
+		glm::ivec2 key = { (int)(ij >> 32), (int)(uint32_t)ij };
+		if (key.x >= grid.N_ || key.y >= width) continue;
+		levels[getPointLevel(key, startLevel, maxLevel)].push_back(ij);
+	}
+
+	// differences against the decoded parents, so the errors don't add up over the levels
+	FlatHashMap<glm::vec2> decoded;
+	decoded.reserve(source.size());
+	for (int level = startLevel; level <= maxLevel; ++level) {
+		std::vector<uint64_t>& keys = levels[level];
+		std::sort(keys.begin(), keys.end());
+		int gap = 1 << (maxLevel - level);
+
+		std::vector<glm::vec2> points(keys.size());
+		std::vector<glm::vec2> predictions(keys.size());
+		std::vector<bool> predicted(keys.size(), false);
+		std::vector<float> dThetas, dPhis;
+		for (size_t q = 0; q < keys.size(); ++q) {
+			points[q] = (*source.find(keys[q])).second;
+			if (level == startLevel || !(points[q].x >= 0.f) || !std::isfinite(points[q].y)) continue;
+			glm::ivec2 key = { (int)(keys[q] >> 32), (int)(uint32_t)keys[q] };
+			predicted[q] = predict(key, gap, width, decoded, predictions[q]);
+			if (!predicted[q]) continue;
+			dThetas.push_back(std::abs(points[q].x - predictions[q].x));
+			dPhis.push_back(std::abs(wrapPi(points[q].y - predictions[q].y)));
+		}
+
+		glm::vec2 scale = { chooseScale(dThetas, MAX_THETA_STEPS, THETA_UNIT), chooseScale(dPhis, MAX_PHI_STEPS, PHI_UNIT) };
+		if (level < COMPACT_MAX_LEVELS) levelScales[level] = scale;
+
+		for (size_t q = 0; q < keys.size(); ++q) {
+			glm::ivec2 key = { (int)(keys[q] >> 32), (int)(uint32_t)keys[q] };
+			uint32_t code = encodeAbsolute(points[q]);
+			if (predicted[q]) {
+				long dTheta = std::lround((points[q].x - predictions[q].x) / scale.x);
+				long dPhi = std::lround(wrapPi(points[q].y - predictions[q].y) / scale.y);
+				if (std::abs(dTheta) <= MAX_THETA_STEPS && std::abs(dPhi) <= MAX_PHI_STEPS)
+					code = ((uint32_t)dTheta & 0x7fff) << 1 | 1 | ((uint32_t)dPhi & 0xffff) << 16;
+			}
+			size_t slot = getSlot(key);
+			values[slot] = code;
+			tags[slot] = packTag(key);
+			decoded[keys[q]] = decodeValue(code, predictions[q], scale);
+		}
+	}
+}
+
+size_t CompactGrid::getSlot(glm::ivec2 key) const
+{
+	// PSHOffsetTable::hashFunc with the 16 bit offsets
+	int hw = hashTableWidth, ow = offsetTableWidth;
+	uint32_t offset = offsetTable[(size_t)((key.x + ow) % ow) * ow + (key.y + ow) % ow];
+	glm::ivec2 add = { (key.x + hw) % hw + (int16_t)(offset & 0xffff), (key.y + hw) % hw + (int16_t)(offset >> 16) };
+	return (size_t)((add.x + hw) % hw) * hw + (add.y + hw) % hw;
+}
+
+int CompactGrid::getPointLevel(glm::ivec2 key, int startLevel, int maxLevel)
+{
+	uint32_t bits = (uint32_t)key.x | (uint32_t)key.y;
+	if (bits == 0) return startLevel;
+	return std::max(startLevel, maxLevel - std::countr_zero(bits));
+}
+
+void CompactGrid::decode(FlatHashMap<glm::vec2>& decoded) const
+{
+	// a slot is used if its tag hashes to it
+	std::vector<std::vector<glm::ivec2>> levels(maxLevel + 1);
+	for (size_t slot = 0; slot < tags.size(); ++slot) {
+		glm::ivec2 key = unpackTag(tags[slot]);
+		if (tags[slot] != 0xffffffff && getSlot(key) == slot)
+			levels[getPointLevel(key, startLevel, maxLevel)].push_back(key);
+	}
+
+	for (int level = startLevel; level <= maxLevel; ++level) {
+		int gap = 1 << (maxLevel - level);
+		glm::vec2 scale = level < COMPACT_MAX_LEVELS ? levelScales[level] : glm::vec2(0.f);
+		for (glm::ivec2 key : levels[level]) {
+			uint32_t code = values[getSlot(key)];
+			glm::vec2 prediction(0.f);
+			if (isDifference(code) && !predict(key, gap, width, decoded, prediction))
+				std::cerr << "[CompactGrid] parents of (" << key.x << ", " << key.y << ") missing" << std::endl;
+			decoded[toKey(key)] = decodeValue(code, prediction, scale);
+		}
+	}
+}
+
+std::vector<glm::dvec2> CompactGrid::measureError(Grid const& grid) const
+{
+	std::vector<glm::dvec2> errors(maxLevel + 1, glm::dvec2(0.0));
+	FlatHashMap<glm::vec2> decoded;
+	decode(decoded);
+	for (auto const& [ij, thphi] : grid.CamToCel) {
+		auto it = decoded.find(ij);
+		if (it == decoded.end() || !(thphi.x >= 0.0) || !std::isfinite(thphi.y)) continue;
+		glm::dvec2 value = { (*it).second.x, (*it).second.y };
+		int level = getPointLevel({ (int)(ij >> 32), (int)(uint32_t)ij }, startLevel, maxLevel);
+		double dPhi = std::abs(value.y - thphi.y);
+		dPhi = std::min(dPhi, PI2 - dPhi);
+		errors[level] = glm::max(errors[level], glm::dvec2(std::abs(value.x - thphi.x), dPhi));
+	}
+	return errors;
+}
+
+glm::dvec2 CompactGrid::getErrorBound()
+{
+	// plus the rounding of the float values
+	return glm::dvec2(0.5 * THETA_UNIT, 0.5 * PHI_UNIT) + 5e-7;
+}
+
+size_t CompactGrid::byteSize() const
+{
+	return sizeof(uint32_t) * (values.size() + tags.size() + offsetTable.size()) + sizeof(glm::vec2) * levelScales.size();
+}
+
+int CompactTablePack::add(CompactGrid const& grid)
+{
+	glm::ivec4 entry{ grid.hashTableWidth, grid.offsetTableWidth, (int)values.size(), (int)offsetTable.size() };
+	if (grid.empty()) {
+		entry.x = entry.y = 1;
+		values.push_back(0);
+		tags.push_back(0xffffffff);
+		offsetTable.push_back(0);
+		levelScales.insert(levelScales.end(), COMPACT_MAX_LEVELS, glm::vec2(0.f));
+	}
+	else {
+		values.insert(values.end(), grid.values.begin(), grid.values.end());
+		tags.insert(tags.end(), grid.tags.begin(), grid.tags.end());
+		offsetTable.insert(offsetTable.end(), grid.offsetTable.begin(), grid.offsetTable.end());
+		levelScales.insert(levelScales.end(), grid.levelScales.begin(), grid.levelScales.end());
+	}
+
+	directory.push_back(entry);
+	return size() - 1;
+}
+
+void CompactTablePack::clear()
+{
+	values.clear();
+	tags.clear();
+	offsetTable.clear();
+	directory.clear();
+	levelScales.clear();
+}
+
+size_t CompactTablePack::byteSize() const
+{
+	return sizeof(uint32_t) * (values.size() + tags.size() + offsetTable.size())
+		+ sizeof(glm::ivec4) * directory.size() + sizeof(glm::vec2) * levelScales.size();
+}
@@ -0,0 +1,104 @@
+#include <blacktracer/DeflectionError.h>
+#include <blacktracer/ReferenceTracer.h>
+#include <blacktracer/Const.h>
+
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+
+DeflectionError::DeflectionError(std::vector<glm::vec2> const& reference, std::vector<glm::vec2> const& approximation,
+	int width, int height, std::shared_ptr<Grid> grid)
+	: width_(width), height_(height)
+{
+	size_t size = (size_t)width * height;
+	if (reference.size() != size || approximation.size() != size) {
+		std::cerr << "[DeflectionError] map sizes don't match " << width << "x" << height << std::endl;
+		width_ = height_ = 0;
+		return;
+	}
+
+	errorMap_ = std::vector<float>(size, 0.f);
+	std::map<int, double> errorSums;
+	double totalSum = 0.0;
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			size_t index = (size_t)y * width + x;
+			glm::vec2 ref = reference[index];
+			glm::vec2 app = approximation[index];
+			bool refShadow = ref.x < 0.f;
+			bool appShadow = app.x < 0.f;
+
+			int level = -1;
+			if (grid) {
+				glm::dvec2 thphi = ReferenceTracer::pixelToCamSky(x, y, width, height);
+				level = grid->getBlockLevel(thphi.x, thphi.y);
+			}
+			LevelError& stats = levels_[level];
+
+			if (refShadow && appShadow) {
+				stats.pixels++;
+				stats.shadow++;
+				total_.pixels++;
+				total_.shadow++;
+				continue;
+			}
+			if (refShadow != appShadow) {
+				stats.pixels++;
+				stats.shadowMismatch++;
+				total_.pixels++;
+				total_.shadowMismatch++;
+				errorMap_[index] = -1.f;
+				continue;
+			}
+
+			double error = angularDistance(glm::dvec2(ref), glm::dvec2(app));
+			errorMap_[index] = (float)error;
+			addPixel(stats, error);
+			addPixel(total_, error);
+			errorSums[level] += error;
+			totalSum += error;
+		}
+	}
+
+	for (auto& [level, stats] : levels_)
+		finish(stats, errorSums[level]);
+	finish(total_, totalSum);
+}
+
+double DeflectionError::angularDistance(glm::dvec2 const& a, glm::dvec2 const& b)
+{
+	glm::dvec3 va{ sin(a.x) * cos(a.y), sin(a.x) * sin(a.y), cos(a.x) };
+	glm::dvec3 vb{ sin(b.x) * cos(b.y), sin(b.x) * sin(b.y), cos(b.x) };
+	// atan2 stays accurate for tiny angles, unlike acos of the dot product
+	return atan2(glm::length(glm::cross(va, vb)), glm::dot(va, vb));
+}
+
+void DeflectionError::print() const
+{
+	std::cout << "[DeflectionError] " << width_ << "x" << height_ << " pixels, angular error in degrees" << std::endl;
+	std::cout << std::setw(8) << "level" << std::setw(12) << "pixels" << std::setw(12) << "shadow"
+		<< std::setw(12) << "shadow diff" << std::setw(14) << "max" << std::setw(14) << "mean" << std::endl;
+
+	auto printRow = [](std::string const& name, LevelError const& stats) {
+		std::cout << std::setw(8) << name << std::setw(12) << stats.pixels << std::setw(12) << stats.shadow
+			<< std::setw(12) << stats.shadowMismatch << std::setw(14)
+			<< stats.maxError * 180.0 / PI << std::setw(14) << stats.meanError * 180.0 / PI << std::endl;
+	};
+	for (auto const& [level, stats] : levels_)
+		printRow(level < 0 ? "?" : std::to_string(level), stats);
+	printRow("total", total_);
+}
+
+void DeflectionError::addPixel(LevelError& stats, double error)
+{
+	stats.pixels++;
+	stats.maxError = std::max(stats.maxError, error);
+}
+
+void DeflectionError::finish(LevelError& stats, double errorSum)
+{
+	// mean over pixels that have a valid error, i.e. not in shadow
+	size_t valid = stats.pixels - stats.shadow - stats.shadowMismatch;
+	stats.meanError = valid > 0 ? errorSum / valid : 0.0;
+}
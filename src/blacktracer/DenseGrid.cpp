@@ -0,0 +1,85 @@
+#include <blacktracer/DenseGrid.h>
+
+#include <algorithm>
+#include <cmath>
+
+DenseGrid::DenseGrid(Grid const& grid, float phiShift)
+	: width_(grid.M_)
+	, height_(grid.getFullN())
+	, phiShift_(phiShift)
+	, texels_((size_t)grid.M_ * grid.getFullN(), glm::vec4(-2.f, -2.f, 0.f, 1.f))
+{
+	// only the traced points are written, scattering them is cheaper than looking up every texel
+	bool sym = grid.equafactor_ == 0;
+	auto texel = [this](int64_t i, int64_t j) -> glm::vec4& { return texels_[i * width_ + j]; };
+
+	for (auto const& [ij, thphi] : grid.CamToCel) {
+		int64_t i = (int64_t)(ij >> 32);
+		int64_t j = (int64_t)(uint32_t)ij;
+		if (i >= grid.N_ || j >= width_) continue;
+
+		glm::vec2 lookup = { (float)thphi.x, (float)thphi.y };
+		// same float math as makeGrid.comp, glsl mod is x - y * floor(x / y)
+		if (lookup.x >= 0.f) {
+			lookup.y += phiShift;
+			lookup.y -= (float)PI2 * std::floor(lookup.y / (float)PI2);
+		}
+		texel(i, j) = glm::vec4(lookup.x, lookup.y, 0.f, 1.f);
+
+		// lower half of a symmetric grid is the upper half mirrored at the equator
+		if (sym && i < grid.N_ - 1)
+			texel(height_ - 1 - i, j) = glm::vec4(lookup.x >= 0.f ? (float)PI - lookup.x : lookup.x, lookup.y, 0.f, 1.f);
+	}
+
+	for (auto const& [ij, level] : grid.blockLevels) {
+		int64_t i = (int64_t)(ij >> 32);
+		int64_t j = (int64_t)(uint32_t)ij;
+		if (i >= grid.N_ || j >= width_) continue;
+		texel(i, j).z = (float)level;
+		if (sym && i < grid.N_ - 1) texel(height_ - 1 - i, j).z = (float)level;
+	}
+}
+
+size_t DenseGrid::byteSize(Grid const& grid)
+{
+	return (size_t)grid.M_ * grid.getFullN() * sizeof(glm::vec4);
+}
+
+bool DenseGridPolicy::useDense(Grid const& grid) const
+{
+	// loaded grids already have their hash
+	if (!enabled_ || grid.hasher.n > 0 || DenseGrid::byteSize(grid) > maxBytes_) return false;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	double texels = (double)grid.M_ * grid.getFullN();
+	return texels * expandSecondsPerTexel_ < (double)grid.CamToCel.size() * hashSecondsPerPoint_;
+}
+
+// weight of a new timing in the moving averages
+static const double TIMING_WEIGHT = 0.25;
+
+void DenseGridPolicy::addHashTiming(size_t points, double seconds)
+{
+	if (points == 0) return;
+	std::lock_guard<std::mutex> lock(mutex_);
+	hashSecondsPerPoint_ += TIMING_WEIGHT * (seconds / points - hashSecondsPerPoint_);
+}
+
+void DenseGridPolicy::addExpandTiming(size_t texels, double seconds)
+{
+	if (texels == 0) return;
+	std::lock_guard<std::mutex> lock(mutex_);
+	expandSecondsPerTexel_ += TIMING_WEIGHT * (seconds / texels - expandSecondsPerTexel_);
+}
+
+double DenseGridPolicy::getHashSecondsPerPoint() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return hashSecondsPerPoint_;
+}
+
+double DenseGridPolicy::getExpandSecondsPerTexel() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return expandSecondsPerTexel_;
+}
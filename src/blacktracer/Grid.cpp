@@ -11,28 +11,41 @@
 #include <blacktracer/Code.h>
 #include <helpers/RootDir.h>
 
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <queue>
+#include <tuple>
 #include <fstream>
 #include <iostream>
-#include <iomanip>
 #include <filesystem>
 #include <format>
 
 #include <cereal/archives/binary.hpp>
 
 
-#define PRECCELEST 0.015
 #define ERROR 0.001//1e-6
+// rays traced between checks of the cancellation token
+#define RAY_BATCH 1024
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
 
 
-bool Grid::makeGrid(std::shared_ptr<Grid>& outGrid, GridProperties props) {
+bool Grid::makeGrid(std::shared_ptr<Grid>& outGrid, GridProperties props,
+	CancellationToken const& token, std::shared_ptr<GridProgress> progress) {
 	if (loadFromFile(outGrid, props)) {
 		std::cout << "[GRID] loaded grid from file." << std::endl;
 		return true;
 	}
 
-	outGrid = std::make_shared<Grid>(props);
-	std::cout << "[GRID] generated new grid." << std::endl;
+	outGrid = std::make_shared<Grid>(props, token, progress);
+	if (outGrid->isCancelled())
+		std::cout << "[GRID] grid build cancelled." << std::endl;
+	else
+		std::cout << "[GRID] generated new grid." << std::endl;
 	return false;
 }
 
@@ -45,16 +58,27 @@ bool Grid::loadFromFile(std::shared_ptr<Grid>& outGrid, std::string filename)
 	}
 	cereal::BinaryInputArchive iarch(ifs);
 	iarch(*outGrid);
+	// the file only keeps the tables, the entry count tells that the grid is hashed
+	std::vector<glm::ivec2> keys;
+	std::vector<glm::vec2> values;
+	outGrid->hasher.getEntries(keys, values);
+	outGrid->hasher.n = (int)keys.size();
 	return true;
 }
 
 bool Grid::loadFromFile(std::shared_ptr<Grid>& outGrid, GridProperties props)
 {
-	return Grid::loadFromFile(outGrid, getFileNameFromConfig(props));
+	if (!Grid::loadFromFile(outGrid, getFileNameFromConfig(props)))
+		return false;
+	// restore settings which are only part of the file name
+	outGrid->props_ = props;
+	return true;
 }
 
 bool Grid::saveToFile(std::shared_ptr<Grid> inGrid) {
 
+	// the file stores the hash, not the map
+	inGrid->saveAsGpuHash();
 	std::string filename = ROOT_DIR "resources/grids/" + inGrid->getFileNameFromConfig();
 	if (std::filesystem::exists(filename)) {
 		std::cout << "[GRID] not writing: already exists." << std::endl;
@@ -67,13 +91,31 @@ bool Grid::saveToFile(std::shared_ptr<Grid> inGrid) {
 	return true;
 }
 
+bool Grid::hasFile(GridProperties const& props) {
+	return std::filesystem::exists(ROOT_DIR "resources/grids/" + getFileNameFromConfig(props));
+}
+
 std::string Grid::getFileNameFromConfig(GridProperties const& props) {
-	return std::format(
-		"rayTraceLvl-strt-{}-max-{}_pos-r-{:.2f}-the-{:.2f}-phi-{:.2f}_vel-{:.2f}_spin-{:.2f}.grid",
+	std::string name = std::format(
+		"rayTraceLvl-strt-{}-max-{}_pos-r-{:.2f}-the-{:.2f}-phi-{:.2f}_vel-{:.2f}_spin-{:.2f}",
 		props.grid_strtLvl_, props.grid_maxLvl_,
 		props.cam_rad_, props.cam_the_, props.cam_phi_, props.cam_vel_,
 		props.blackHole_a_
 	);
+
+	// only non-default refinement settings change the name, existing grid files stay valid
+	GridProperties defaults;
+	if (props.grid_refinement_ != defaults.grid_refinement_
+		|| props.grid_threshold_ != defaults.grid_threshold_
+		|| props.grid_forceLvl_ != defaults.grid_forceLvl_) {
+		name += std::format("_refine-{}-{:.2e}-force-{}",
+			RefinementPolicy::getName((RefinementMode)props.grid_refinement_),
+			props.grid_threshold_, props.grid_forceLvl_);
+	}
+	if (props.grid_rayBudget_ > 0)
+		name += std::format("_budget-{}", props.grid_rayBudget_);
+
+	return name + ".grid";
 }
 
 std::string Grid::getFileNameFromConfig() const {
@@ -95,14 +137,17 @@ Grid::Grid(const int maxLevelPrec, const int startLevel, const bool angle, std::
 };
 */
 
-Grid::Grid(GridProperties props)
-	: equafactor_(1)	// ignore symmetry for now
+Grid::Grid(GridProperties props, CancellationToken const& token, std::shared_ptr<GridProgress> progress)
+	: equafactor_(isSymmetric(props) ? 0 : 1)
 	, MAXLEVEL_(props.grid_maxLvl_)
 	, STARTLVL_(props.grid_strtLvl_)
 	, calcDisk_(false) // ... and disk as well
 	, metric_(std::make_shared<Metric>(props.blackHole_a_))
 	, blackHoleA_(props.blackHole_a_)
 	, props_(props)
+	, refinement_(RefinementPolicy::create(props))
+	, token_(token)
+	, progress_(progress)
 {
 	
 	cam_ = std::make_shared<Camera>(metric_,
@@ -116,24 +161,82 @@ Grid::Grid(GridProperties props)
 	init();
 };
 
+bool Grid::isSymmetric(GridProperties const& props)
+{
+	// camera moves in phi direction, so the equatorial plane is the only symmetry plane
+	return props.grid_useSymmetry_ && std::abs(props.cam_the_ - PI1_2) < 1E-6;
+}
+
 void Grid::init() {
 	N_ = (uint32_t)round(pow(2, MAXLEVEL_) / (2 - equafactor_) + 1);
 	STARTN_ = (uint32_t)round(pow(2, STARTLVL_) / (2 - equafactor_) + 1);
 	M_ = (2 - equafactor_) * 2 * (N_ - 1);
 	STARTM_ = (2 - equafactor_) * 2 * (STARTN_ - 1);
-	steps = std::vector<int>(M_ * N_);
+	if (progress_) progress_->start(MAXLEVEL_, props_.grid_rayBudget_);
+	auto start = std::chrono::steady_clock::now();
 	raytrace();
-	//printGridCam(5);
+	if (cancelled_) return;
+
+	// the hash is built on demand (saveAsGpuHash), a grid uploaded as DenseGrid is shown without it
+	auto fixStart = std::chrono::steady_clock::now();
+	fixAllTvertices();
+	stats_.phases.fixTvertices = secondsSince(fixStart);
+	stats_.phases.total = secondsSince(start);
+	if (progress_) progress_->finish();
+}
 
-	for (auto block : blockLevels) {
+void Grid::fixAllTvertices()
+{
+	// fix coarse blocks first, so corrected vertices propagate to the finer blocks along their edges
+	// (and the result doesn't depend on the iteration order of the map)
+	std::vector<std::pair<uint64_t, int>> blocks(blockLevels.begin(), blockLevels.end());
+	std::sort(blocks.begin(), blocks.end(), [](auto const& a, auto const& b) {
+		return a.second != b.second ? a.second < b.second : a.first < b.first;
+	});
+	for (auto const& block : blocks) {
 		fixTvertices(block);
 	}
-	if (STARTLVL_ != MAXLEVEL_) saveAsGpuHash();
+}
+
+std::shared_ptr<Grid> Grid::makeSnapshot(int level) const
+{
+	// same dimensions as the final grid, the unrefined blocks are just coarser
+	auto snapshot = std::make_shared<Grid>();
+	snapshot->equafactor_ = equafactor_;
+	snapshot->MAXLEVEL_ = MAXLEVEL_;
+	snapshot->N_ = N_;
+	snapshot->M_ = M_;
+	snapshot->STARTN_ = STARTN_;
+	snapshot->STARTM_ = STARTM_;
+	snapshot->STARTLVL_ = STARTLVL_;
+	snapshot->props_ = props_;
+	snapshot->metric_ = metric_;
+	snapshot->rayCount_ = rayCount_;
+	snapshot->snapshotLevel_ = level;
+	snapshot->stats_ = stats_;
+
+	snapshot->CamToCel = CamToCel;
+	snapshot->blockLevels = blockLevels;
+	// blocks to be checked on the next level are leaves for now
+	for (auto ij : checkblocks)
+		snapshot->blockLevels[ij] = level;
+
+	snapshot->fixAllTvertices();
+	snapshot->saveAsGpuHash();
+	return snapshot;
+}
+
+bool Grid::checkCancelled()
+{
+	if (!cancelled_ && token_.isCancelled())
+		cancelled_ = true;
+	return cancelled_;
 }
 
 void Grid::saveAsGpuHash()
 {
-	if (hasher.n > 0) return;
+	// grids without refinement aren't hashed
+	if (hasher.n > 0 || props_.grid_strtLvl_ == props_.grid_maxLvl_) return;
 
 	if (print_) std::cout << "Computing Perfect Hash.." << std::endl;
 
@@ -145,7 +248,11 @@ void Grid::saveAsGpuHash()
 		//FIX: conversion from double to float is narrowing conversion - explicitly cast to float
 		data.push_back({ (float)entry.second.x, (float)entry.second.y });
 	}
+	auto start = std::chrono::steady_clock::now();
 	hasher = PSHOffsetTable(elements, data);
+	stats_.phases.hash = secondsSince(start);
+	// the hash is built after init, so its time is added to the build time here
+	stats_.phases.total += stats_.phases.hash;
 
 	if (print_) std::cout << "Completed Perfect Hash" << std::endl;
 }
@@ -254,86 +361,85 @@ glm::dvec2 const Grid::hermite(double aValue, glm::dvec2 const& aX0, glm::dvec2
 	return u0 * aX1 + u1 * m0 + u2 * m1 + u3 * aX2;
 }
 
-void Grid::printGridCam(int level)
+int Grid::getBlockLevel(double theta, double phi) const
 {
-	if (level > MAXLEVEL_) {
-		std::cerr << "[Grid]: invalid level at printGridCam" << std::endl;
-		return;
-	}
-	
-	if (CamToCel.size() <= 0) {
-		std::cerr << "[Grid]: cannot print empty Grid data (probably because it was loaded from file)" << std::endl;
-		return;
-	}
+	if (blockLevels.empty()) return -1;
 
-	std::cout.precision(2);
-	std::cout << std::endl;
+	// symmetric grids only cover the upper hemisphere
+	if (!equafactor_ && theta > PI1_2) theta = PI - theta;
 
-	int gap = (int)pow(2, MAXLEVEL_ - level);
-	for (uint32_t i = 0; i < N_; i += gap) {
-		for (uint32_t j = 0; j < M_; j += gap) {
-			double val = CamToCel[i_j]_theta;
-			if (val > 1e-10)
-				std::cout << std::setw(4) << val / PI;
-			else
-				std::cout << std::setw(4) << 0.0;
-		}
-		std::cout << std::endl;
-	}
+	uint32_t i = (uint32_t)std::clamp(theta / PI * (2 - equafactor_) * (N_ - 1), 0.0, N_ - 2.0);
+	uint32_t j = (uint32_t)std::clamp(phi / PI2 * M_, 0.0, M_ - 1.0);
 
-	std::cout << std::endl;
-	for (uint32_t i = 0; i < N_; i += gap) {
-		for (uint32_t j = 0; j < M_; j += gap) {
-			double val = CamToCel[i_j]_phi;
-			if (val > 1e-10)
-				std::cout << std::setw(4) << val / PI;
-			else
-				std::cout << std::setw(4) << 0.0;
-		}
-		std::cout << std::endl;
+	// blocks sharing a top left corner with a refined parent are leaves on a finer level,
+	// so the first level with a matching entry holds the leaf containing (i, j)
+	for (int level = STARTLVL_; level <= MAXLEVEL_; level++) {
+		uint32_t gap = (uint32_t)pow(2, MAXLEVEL_ - level);
+		uint64_t ij = (uint64_t)(i / gap * gap) << 32 | (j / gap * gap);
+		auto it = blockLevels.find(ij);
+		if (it != blockLevels.end() && it->second == level) return level;
 	}
-	std::cout << std::endl;
+	return -1;
+}
 
-	std::cout << std::endl;
-	for (uint32_t i = 0; i < N_; i += gap) {
-		for (uint32_t j = 0; j < M_; j += gap) {
-			double val = steps[i * M_ + j];
-			std::cout << std::setw(4) << val;
-		}
-		std::cout << std::endl;
+int Grid::getPointLevel(uint32_t i, uint32_t j) const
+{
+	// points of a level lie on its lattice, gap = 2^(MAXLEVEL_ - level).
+	// STARTLVL_ isn't stored in grid files
+	int startLevel = props_.grid_strtLvl_;
+	uint32_t bits = i | j;
+	if (bits == 0) return startLevel;
+	return std::max(startLevel, MAXLEVEL_ - std::countr_zero(bits));
+}
+
+GridStats Grid::getStats() const
+{
+	GridStats stats = stats_;
+	stats.name = std::filesystem::path(getFileNameFromConfig()).filename().string();
+	stats.width = M_;
+	stats.height = getFullN();
+	stats.symmetric = equafactor_ == 0;
+	stats.getLevel(MAXLEVEL_);
+
+	auto countPoint = [&stats](double theta) {
+		stats.points++;
+		if (std::isnan(theta)) stats.failedPoints++;
+		else if (theta < 0) stats.shadowPoints++;
+	};
+	for (auto const& [ij, thphi] : CamToCel)
+		countPoint(thphi.x);
+	// grids loaded from file only keep the hash, which has an entry for every point
+	if (CamToCel.empty() && hasher.n > 0) {
+		std::vector<glm::ivec2> keys;
+		std::vector<glm::vec2> values;
+		hasher.getEntries(keys, values);
+		for (glm::vec2 const& thphi : values)
+			countPoint(thphi.x);
 	}
-	std::cout << std::endl;
-
-	int sum = 0;
-	int sumnotnull = 0;
-	int countnotnull = 0;
-	std::ofstream myfile;
-	myfile.open("steps.txt");
-	for (int i = 0; i < N_ * M_; i++) {
-		sum += steps[i];
-		if (steps[i] > 0) {
-			sumnotnull += steps[i];
-			countnotnull++;
+
+	for (auto const& [ij, level] : blockLevels) {
+		GridStats::Level& levelStats = stats.getLevel(level);
+		levelStats.leafBlocks++;
+
+		// corners on both sides of phi = 2 pi, same bounds as Metric::correct2PIcross with factor 5
+		int64_t gap = (int64_t)1 << (MAXLEVEL_ - level);
+		bool low = false, high = false;
+		for (int64_t di : { (int64_t)0, gap }) {
+			for (int64_t dj : { (int64_t)0, gap }) {
+				glm::dvec2 thphi;
+				if (!findCel((int64_t)i_32 + di, (int64_t)j_32 + dj, thphi) || !(thphi.x >= 0)) continue;
+				low |= thphi.y < PI2 / 5.;
+				high |= thphi.y > PI2 * (1. - 1. / 5.);
+			}
 		}
-		myfile << steps[i] << "\n";
+		if (low && high) levelStats.crossingBlocks++;
 	}
-	myfile.close();
-	std::cout << "steeeeps" << sum << std::endl;
-	std::cout << "steeeepsnotnull" << sumnotnull << std::endl;
-
-	std::cout << "ave" << (float)sum / (float)(M_ * (N_ + 1)) << std::endl;
-	std::cout << "avenotnull" << (float)sumnotnull / (float)(countnotnull) << std::endl;
-
-	//for (uint32_t i = 0; i < N; i += gap) {
-	//	for (uint32_t j = 0; j < M; j += gap) {
-	//		int val = CamToAD[i_j];
-	//		std::cout << std::setw(4) << val;
-	//	}
-	//	std::cout << std::endl;
-	//}
-	//std::cout << std::endl;
 
-	std::cout.precision(10);
+	stats.hashEntries = hasher.n;
+	stats.hashSlots = (size_t)hasher.hashTableWidth * hasher.hashTableWidth;
+	stats.offsetSlots = (size_t)hasher.offsetTableWidth * hasher.offsetTableWidth;
+	if (hasher.n == 0) stats.hashSlots = stats.offsetSlots = 0;
+	return stats;
 }
 
 void Grid::raytrace()
@@ -347,23 +453,26 @@ void Grid::raytrace()
 	if (equafactor_) ijstart[1] = (uint64_t)(N_ - 1) << 32;
 
 	if (print_) std::cout << "Computing Level " << STARTLVL_ << "..." << std::endl;
+	if (progress_) progress_->beginLevel(STARTLVL_);
 	callKernel(ijstart);
+	if (cancelled_) return;
 
 	for (uint32_t j = 0; j < M_; j += gap) {
 		uint32_t i, l, k;
 		i = l = k = 0;
-		CamToCel[i_j] = CamToCel[k_l];
-		steps[i * M_ + j] = steps[0];
+		// copy first, inserting i_j may rehash the map
+		glm::dvec2 pole = CamToCel[k_l];
+		CamToCel[i_j] = pole;
 		checkblocks.insert(i_j);
 		if (equafactor_) {
 			i = k = N_ - 1;
-			CamToCel[i_j] = CamToCel[k_l];
-			steps[i * M_ + j] = steps[0];
-
+			pole = CamToCel[k_l];
+			CamToCel[i_j] = pole;
 		}
 	}
 
 	integrateFirst(gap);
+	if (cancelled_) return;
 	adaptiveBlockIntegration(STARTLVL_);
 }
 
@@ -385,12 +494,12 @@ void Grid::integrateFirst(const int gap)
 
 void Grid::fillGridCam(const std::vector<uint64_t>& ijvals, const size_t s, std::vector<double>& thetavals, std::vector<double>& phivals, std::vector<double>& hitr, std::vector<double>& hitphi, std::vector<int>& step)
 {
+	std::vector<glm::dvec2> cel(s);
 	for (int k = 0; k < s; k++) {
-		CamToCel[ijvals[k]] = glm::dvec2(thetavals[k], phivals[k]);
-		uint64_t ij = ijvals[k];
-		steps[i_32 * M_ + j_32] = step[k];
+		cel[k] = glm::dvec2(thetavals[k], phivals[k]);
 		//if (disk) CamToAD[ijvals[k]] = glm::dvec2(hitr[k], hitphi[k]);
 	}
+	CamToCel.insert(ijvals.data(), cel.data(), s);
 }
 
 void Grid::callKernel(std::vector<uint64_t>& ijvec)
@@ -405,20 +514,58 @@ void Grid::callKernel(std::vector<uint64_t>& ijvec)
 	}
 
 	auto start_time = std::chrono::high_resolution_clock::now();
+	if (progress_) progress_->queueRays(s);
 	integration_wrapper(theta, phi, s, step);
+	// the rays after the cancelling batch are not traced
+	if (cancelled_) return;
 	std::vector<double> e1, e2;
 	fillGridCam(ijvec, s, theta, phi, e1, e2, step);
 	auto end_time = std::chrono::high_resolution_clock::now();
+	rayCount_ += s;
+
+	// the rays of a call belong to one level, except with a ray budget: the time is split by ray count
+	double seconds = std::chrono::duration<double>(end_time - start_time).count();
+	stats_.phases.trace += seconds;
+	for (int q = 0; q < s; q++) {
+		uint64_t ij = ijvec[q];
+		GridStats::Level& level = stats_.getLevel(getPointLevel(i_32, j_32));
+		level.rays++;
+		level.steps += step[q];
+		level.traceSeconds += seconds / s;
+	}
 	int count = 0;
 	for (int q = 0; q < s; q++) if (step[q] != 0) count++;
 	std::cout << "CPU: " << count << "rays in " << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << "ms!" << std::endl << std::endl;
 	//}
 }
 
+bool Grid::findCel(int64_t i, int64_t j, glm::dvec2& thphi) const
+{
+	bool mirror = false;
+	int64_t iMax = N_ - 1;
+	// continue over the poles on the opposite side of the sky
+	if (i < 0) {
+		i = -i;
+		j += M_ / 2;
+	}
+	if (i > iMax) {
+		i = 2 * iMax - i;
+		if (equafactor_) j += M_ / 2;
+		else mirror = true;
+	}
+	if (i < 0 || i > iMax) return false;
+	j = (j % M_ + M_) % M_;
+
+	auto it = CamToCel.find((uint64_t)i << 32 | (uint64_t)j);
+	if (it == CamToCel.end()) return false;
+	thphi = it->second;
+	// symmetric grid: lower half is the upper half mirrored at the equator
+	if (mirror && thphi.x >= 0) thphi.x = PI - thphi.x;
+	return true;
+}
+
 bool Grid::refineCheck(const uint32_t i, const uint32_t j, const int gap, const int level)
 {
-	uint32_t k = i + gap;
-	uint32_t l = (j + gap) % M_;
 	/*
 	if (disk) {
 		double a = CamToAD[i_j].x;
@@ -431,23 +578,8 @@ bool Grid::refineCheck(const uint32_t i, const uint32_t j, const int gap, const
 	}
 	*/
 
-	double th1 = CamToCel[i_j]_theta;
-	double th2 = CamToCel[k_j]_theta;
-	double th3 = CamToCel[i_l]_theta;
-	double th4 = CamToCel[k_l]_theta;
-
-	double ph1 = CamToCel[i_j]_phi;
-	double ph2 = CamToCel[k_j]_phi;
-	double ph3 = CamToCel[i_l]_phi;
-	double ph4 = CamToCel[k_l]_phi;
-
-	double diag = (th1 - th4) * (th1 - th4) + (ph1 - ph4) * (ph1 - ph4);
-	double diag2 = (th2 - th3) * (th2 - th3) + (ph2 - ph3) * (ph2 - ph3);
-
-	double max = std::max(diag, diag2);
-
-	if (level < 6 && max>1E-10) return true;
-	if (max > PRECCELEST) return true;
+	double error = refinement_->estimate(*this, i, j, gap);
+	if (refinement_->refine(error, level)) return true;
 
 	// If no refinement necessary, save level at position.
 	blockLevels[i_j] = level;
@@ -466,16 +598,25 @@ void Grid::fillVector(std::vector<uint64_t>& toIntIJ, uint32_t i, uint32_t j)
 
 void Grid::adaptiveBlockIntegration(int level)
 {
+	if (props_.grid_rayBudget_ > 0) {
+		budgetBlockIntegration(level);
+		return;
+	}
+
 	while (level < MAXLEVEL_) {
-		if (level < 5 && print_) printGridCam(level);
+		if (checkCancelled()) return;
 		if (print_) std::cout << "Computing level " << level + 1 << "..." << std::endl;
 
 		if (checkblocks.size() == 0) return;
+		if (progress_) progress_->beginLevel(level + 1);
 
 		std::unordered_set<uint64_t, hashing_func2> todo;
 		std::vector<uint64_t> toIntIJ;
+		GridStats::Level& levelStats = stats_.getLevel(level);
+		auto refineStart = std::chrono::steady_clock::now();
 
 		for (auto ij : checkblocks) {
+			levelStats.checkedBlocks++;
 
 			uint32_t gap = (uint32_t)pow(2, MAXLEVEL_ - level);
 			uint32_t i = i_32;
@@ -494,61 +635,113 @@ void Grid::adaptiveBlockIntegration(int level)
 				todo.insert(k_j);
 				todo.insert(k_l);
 				todo.insert(i_l);
+				levelStats.refinedBlocks++;
 			}
 
 		}
+		stats_.phases.refine += secondsSince(refineStart);
 		callKernel(toIntIJ);
+		if (cancelled_) return;
 		level++;
 		checkblocks = todo;
+
+		// the last level is published as the finished grid
+		if (progress_ && progress_->wantsSnapshots() && level < MAXLEVEL_ && !checkCancelled()) {
+			auto snapshotStart = std::chrono::steady_clock::now();
+			progress_->publishSnapshot(makeSnapshot(level));
+			stats_.phases.snapshots += secondsSince(snapshotStart);
+		}
 	}
 
 	for (auto ij : checkblocks)
 		blockLevels[ij] = level;
 }
 
-void Grid::integration_wrapper(std::vector<double>& theta, std::vector<double>& phi, const int n, std::vector<int>& step)
+void Grid::budgetBlockIntegration(int level)
 {
-	double thetaS = cam_->theta;
-	double phiS = cam_->phi;
-	double rS = cam_->r;
-	double sp = cam_->speed;
-
-#pragma loop(hint_parallel(8))
-#pragma loop(ivdep)
-	for (int i = 0; i < n; i++) {
-
-		double xCam = sin(theta[i]) * cos(phi[i]);
-		double yCam = sin(theta[i]) * sin(phi[i]);
-		double zCam = cos(theta[i]);
+	// (error estimate, block, level), highest error on top
+	using Block = std::tuple<double, uint64_t, int>;
+	std::priority_queue<Block> queue;
+
+	auto push = [&](uint64_t ij, int lvl) {
+		uint32_t gap = (uint32_t)pow(2, MAXLEVEL_ - lvl);
+		double error = refinement_->estimate(*this, i_32, j_32, gap);
+		if (lvl < MAXLEVEL_) stats_.getLevel(lvl).checkedBlocks++;
+		if (lvl < MAXLEVEL_ && refinement_->refine(error, lvl))
+			queue.push({ error, ij, lvl });
+		else
+			blockLevels[ij] = lvl;
+	};
+	// everything but tracing the rays is refinement
+	auto start = std::chrono::steady_clock::now();
+	double traceStart = stats_.phases.trace;
 
-		double yFido = (-yCam + sp) / (1 - sp * yCam);
-		double xFido = -sqrtf(1 - sp * sp) * xCam / (1 - sp * yCam);
-		double zFido = -sqrtf(1 - sp * sp) * zCam / (1 - sp * yCam);
+	for (auto ij : checkblocks)
+		push(ij, level);
+	checkblocks.clear();
+	// blocks of all levels are refined together, the progress has a single level
+	if (progress_) progress_->beginLevel(level + 1);
+
+	size_t budget = props_.grid_rayBudget_;
+	while (!queue.empty() && rayCount_ < budget) {
+		if (checkCancelled()) return;
+		// refine in batches to keep kernel calls large,
+		// each refined block adds at most 5 new rays
+		size_t batch = std::clamp<size_t>((budget - rayCount_) / 5, 1, 4096);
+
+		std::vector<std::pair<uint64_t, int>> children;
+		std::vector<uint64_t> toIntIJ;
+		while (!queue.empty() && children.size() < 4 * batch) {
+			auto [error, ij, lvl] = queue.top();
+			queue.pop();
 
-		double k = sqrt(1 - cam_->btheta * cam_->btheta);
-		double rFido = xFido * cam_->bphi / k + cam_->br * yFido + cam_->br * cam_->btheta / k * zFido;
-		double thetaFido = cam_->btheta * yFido - k * zFido;
-		double phiFido = -xFido * cam_->br / k + cam_->bphi * yFido + cam_->bphi * cam_->btheta / k * zFido;
-		//double rFido = xFido;
-		//double thetaFido = -zFido;
-		//double phiFido = yFido;
+			uint32_t gap = (uint32_t)pow(2, MAXLEVEL_ - lvl);
+			uint32_t i = i_32;
+			uint32_t j = j_32;
+			uint32_t k = i + gap / 2;
+			uint32_t l = j + gap / 2;
 
-		double eF = 1. / (cam_->alpha + cam_->w * cam_->wbar * phiFido);
+			fillVector(toIntIJ, k, j);
+			fillVector(toIntIJ, k, l);
+			fillVector(toIntIJ, i, l);
+			fillVector(toIntIJ, i + gap, l);
+			fillVector(toIntIJ, k, (j + gap) % M_);
+			children.push_back({ i_j, lvl + 1 });
+			children.push_back({ k_j, lvl + 1 });
+			children.push_back({ k_l, lvl + 1 });
+			children.push_back({ i_l, lvl + 1 });
+			stats_.getLevel(lvl).refinedBlocks++;
+		}
+		callKernel(toIntIJ);
+		if (cancelled_) return;
 
-		double pR = eF * cam_->ro * rFido / sqrtf(cam_->Delta);
-		double pTheta = eF * cam_->ro * thetaFido;
-		double pPhi = eF * cam_->wbar * phiFido;
+		for (auto const& [ij, lvl] : children)
+			push(ij, lvl);
+	}
 
-		double b = pPhi;
-		double q = pTheta * pTheta + cos(thetaS) * cos(thetaS) * (b * b / (sin(thetaS) * sin(thetaS)) - metric_->asq());
+	if (print_ && !queue.empty())
+		std::cout << "Ray budget spent, " << queue.size() << " blocks left unrefined" << std::endl;
 
-		theta[i] = -1;
-		phi[i] = -1;
-		step[i] = 0;
+	// out of budget: remaining blocks keep their current level
+	while (!queue.empty()) {
+		auto [error, ij, lvl] = queue.top();
+		blockLevels[ij] = lvl;
+		queue.pop();
+	}
+	stats_.phases.refine += secondsSince(start) - (stats_.phases.trace - traceStart);
+}
 
-		if (metric_->checkCelest(pR, rS, thetaS, b, q)) {
-			metric_->rkckIntegrate1(rS, thetaS, phiS, pR, b, q, pTheta, theta[i], phi[i], step[i]);
+void Grid::integration_wrapper(std::vector<double>& theta, std::vector<double>& phi, const int n, std::vector<int>& step)
+{
+	// in batches, a cancelled build returns after at most one batch
+	for (int start = 0; start < n; start += RAY_BATCH) {
+		if (checkCancelled()) return;
+		int end = std::min(n, start + RAY_BATCH);
+#pragma loop(hint_parallel(8))
+#pragma loop(ivdep)
+		for (int i = start; i < end; i++) {
+			cam_->traceRay(theta[i], phi[i], step[i]);
 		}
+		if (progress_) progress_->addTracedRays(end - start);
 	}
 }
-
@@ -0,0 +1,130 @@
+#include <blacktracer/GridPrefetcher.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+GridPrefetcher::GridPrefetcher(std::shared_ptr<JobSystem> jobs, std::vector<GridProperties> const& frames, int lookAhead, bool saveGrids)
+	: jobSystem_(jobs ? jobs : std::make_shared<JobSystem>())
+	, lookAhead_(std::max(1, lookAhead))
+	, saveGrids_(saveGrids)
+	, next_(0)
+	, cursor_(0)
+	, built_(0)
+	, buildSeconds_(0.0)
+{
+	std::string previous;
+	for (auto const& props : frames) {
+		std::string name = Grid::getFileNameFromConfig(props);
+		if (jobs_.empty() || name != previous) {
+			jobs_.push_back(Job{ props });
+			previous = name;
+		}
+		frameJobs_.push_back(jobs_.size() - 1);
+	}
+	std::cout << "[GridPrefetcher] " << frames.size() << " frames need " << jobs_.size() << " grids" << std::endl;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	submitJobs();
+}
+
+GridPrefetcher::~GridPrefetcher()
+{
+	std::vector<JobHandle> handles;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto const& job : jobs_) {
+			job.handle.cancel();
+			handles.push_back(job.handle);
+		}
+	}
+	// the jobs reference the prefetcher
+	for (auto const& handle : handles)
+		handle.wait();
+}
+
+std::shared_ptr<Grid> GridPrefetcher::tryGet(size_t frame)
+{
+	if (frame >= frameJobs_.size()) return nullptr;
+	std::lock_guard<std::mutex> lock(mutex_);
+	moveCursor(frameJobs_[frame]);
+	Job const& job = jobs_[cursor_];
+	return job.done ? job.grid : nullptr;
+}
+
+std::shared_ptr<Grid> GridPrefetcher::get(size_t frame)
+{
+	if (frame >= frameJobs_.size()) return nullptr;
+	std::unique_lock<std::mutex> lock(mutex_);
+	moveCursor(frameJobs_[frame]);
+	gridBuilt_.wait(lock, [this]() { return jobs_[cursor_].done; });
+	return jobs_[cursor_].grid;
+}
+
+size_t GridPrefetcher::getBuiltCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return built_;
+}
+
+size_t GridPrefetcher::getQueuedCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return next_ > cursor_ ? next_ - cursor_ : 0;
+}
+
+double GridPrefetcher::getBuildSeconds() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return buildSeconds_;
+}
+
+void GridPrefetcher::moveCursor(size_t job)
+{
+	if (job <= cursor_) return;
+	// grids behind the cursor aren't needed anymore, neither are their builds
+	for (size_t i = cursor_; i < job; ++i) {
+		jobs_[i].grid = nullptr;
+		jobs_[i].handle.cancel();
+	}
+	cursor_ = job;
+	next_ = std::max(next_, cursor_);
+	submitJobs();
+}
+
+void GridPrefetcher::submitJobs()
+{
+	for (; next_ < jobs_.size() && next_ < cursor_ + lookAhead_; ++next_) {
+		size_t index = next_;
+		jobs_[index].handle = jobSystem_->submit([this, index](CancellationToken const& token) { build(index, token); },
+			JobPriority::LOW);
+	}
+}
+
+void GridPrefetcher::build(size_t index, CancellationToken const& token)
+{
+	GridProperties props;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		props = jobs_[index].props;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto grid = std::make_shared<Grid>();
+	bool loaded = Grid::makeGrid(grid, props, token);
+	// the frames select the grid from the resident hash tables
+	if (!grid->isCancelled()) grid->saveAsGpuHash();
+	if (saveGrids_ && !loaded && !grid->isCancelled())
+		Grid::saveToFile(grid);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		// the cursor may have passed the job while it was built
+		if (index >= cursor_) jobs_[index].grid = grid;
+		jobs_[index].done = true;
+		++built_;
+		buildSeconds_ += seconds;
+	}
+	gridBuilt_.notify_all();
+}
@@ -0,0 +1,132 @@
+#include <blacktracer/GridProgress.h>
+
+#include <algorithm>
+
+std::vector<GridProgress::Level> GridProgress::getLevels() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<Level> levels = levels_;
+	// the running level up to now
+	if (!done_ && !levels.empty())
+		levels.back().seconds = std::chrono::duration<double>(Clock::now() - levelStart_).count();
+	return levels;
+}
+
+size_t GridProgress::getTracedCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t traced = 0;
+	for (auto const& level : levels_)
+		traced += level.traced;
+	return traced;
+}
+
+double GridProgress::getSeconds() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return getSecondsLocked();
+}
+
+double GridProgress::getSecondsLocked() const
+{
+	if (levels_.empty()) return 0.0;
+	if (done_) {
+		double seconds = 0.0;
+		for (auto const& level : levels_)
+			seconds += level.seconds;
+		return seconds;
+	}
+	return std::chrono::duration<double>(Clock::now() - start_).count();
+}
+
+double GridProgress::getEta() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (done_) return 0.0;
+
+	size_t traced = 0;
+	for (auto const& level : levels_)
+		traced += level.traced;
+	if (traced == 0) return -1.0;
+	double secondsPerRay = getSecondsLocked() / traced;
+
+	// a level that just began has no rays queued yet, extrapolate from the one before
+	size_t last = levels_.size() - 1;
+	if (levels_[last].queued == 0 && last > 0) --last;
+	Level const& current = levels_[last];
+	double remaining = (double)current.queued - (double)current.traced;
+	if (rayBudget_ > 0) {
+		// the budget is spent unless the grid converges before
+		remaining = (double)rayBudget_ - (double)traced;
+	}
+	else if (current.level < maxLevel_) {
+		// every refined block adds up to 4 blocks on the next level
+		if (last == 0 || levels_[last - 1].queued == 0) return -1.0;
+		double growth = std::min(4.0, (double)current.queued / levels_[last - 1].queued);
+		double next = (double)current.queued;
+		for (int level = current.level + 1; level <= maxLevel_; ++level) {
+			next *= growth;
+			remaining += next;
+		}
+	}
+	return std::max(0.0, remaining) * secondsPerRay;
+}
+
+bool GridProgress::isDone() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return done_;
+}
+
+std::shared_ptr<Grid> GridProgress::takeSnapshot()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return std::move(snapshot_);
+}
+
+void GridProgress::publishSnapshot(std::shared_ptr<Grid> snapshot)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	snapshot_ = snapshot;
+}
+
+void GridProgress::start(int maxLevel, size_t rayBudget)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	levels_.clear();
+	maxLevel_ = maxLevel;
+	rayBudget_ = rayBudget;
+	start_ = levelStart_ = Clock::now();
+	done_ = false;
+	snapshot_ = nullptr;
+}
+
+void GridProgress::beginLevel(int level)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Clock::time_point now = Clock::now();
+	if (!levels_.empty())
+		levels_.back().seconds = std::chrono::duration<double>(now - levelStart_).count();
+	levelStart_ = now;
+	levels_.push_back(Level{ level });
+}
+
+void GridProgress::queueRays(size_t rays)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!levels_.empty()) levels_.back().queued += rays;
+}
+
+void GridProgress::addTracedRays(size_t rays)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!levels_.empty()) levels_.back().traced += rays;
+}
+
+void GridProgress::finish()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!levels_.empty())
+		levels_.back().seconds = std::chrono::duration<double>(Clock::now() - levelStart_).count();
+	done_ = true;
+}
@@ -0,0 +1,227 @@
+#include <blacktracer/GridQuantizer.h>
+#include <blacktracer/Const.h>
+#include <helpers/json_helper.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include <boost/json.hpp>
+
+// radius, theta, speed
+static const int AXES = 3;
+
+// copies the lattice axis of from to to
+static void copyAxis(GridProperties& to, GridProperties const& from, int axis)
+{
+	switch (axis) {
+	case 0: to.cam_rad_ = from.cam_rad_; break;
+	case 1: to.cam_the_ = from.cam_the_; break;
+	default: to.cam_vel_ = from.cam_vel_; break;
+	}
+}
+
+double GridQuantizer::getStep(int axis) const
+{
+	switch (axis) {
+	case 0: return settings_.radiusStep;
+	case 1: return settings_.thetaStep;
+	default: return settings_.velocityStep;
+	}
+}
+
+double GridQuantizer::toLattice(GridProperties const& props, int axis) const
+{
+	double step = getStep(axis);
+	switch (axis) {
+	case 0: return std::log(props.cam_rad_) / std::log1p(step);
+	case 1: return (props.cam_the_ - PI1_2) / step;
+	default: return props.cam_vel_ / step;
+	}
+}
+
+void GridQuantizer::fromLattice(GridProperties& props, int axis, double k) const
+{
+	double step = getStep(axis);
+	// lattice points beyond the poles or the speed of light keep the requested value
+	switch (axis) {
+	case 0:
+		props.cam_rad_ = std::exp(k * std::log1p(step));
+		break;
+	case 1:
+		if (PI1_2 + k * step > 0.0 && PI1_2 + k * step < PI)
+			props.cam_the_ = PI1_2 + k * step;
+		break;
+	default:
+		if (k * step >= 0.0 && k * step < 1.0)
+			props.cam_vel_ = k * step;
+		break;
+	}
+}
+
+GridProperties GridQuantizer::alignPhi(GridProperties props) const
+{
+	if (settings_.rotatePhi) props.cam_phi_ = 0.0;
+	return props;
+}
+
+GridProperties GridQuantizer::snap(GridProperties const& props) const
+{
+	GridProperties snapped = alignPhi(props);
+	for (int axis = 0; axis < AXES; ++axis) {
+		if (getStep(axis) > 0.0)
+			fromLattice(snapped, axis, std::round(toLattice(snapped, axis)));
+	}
+	return snapped;
+}
+
+double GridQuantizer::estimateError(GridProperties const& a, GridProperties const& b)
+{
+	if (a.blackHole_a_ != b.blackHole_a_ || a.grid_strtLvl_ != b.grid_strtLvl_ || a.grid_maxLvl_ != b.grid_maxLvl_
+		|| a.grid_useSymmetry_ != b.grid_useSymmetry_ || a.grid_refinement_ != b.grid_refinement_
+		|| a.grid_threshold_ != b.grid_threshold_ || a.grid_forceLvl_ != b.grid_forceLvl_
+		|| a.grid_rayBudget_ != b.grid_rayBudget_)
+		return std::numeric_limits<double>::infinity();
+
+	double dPhi = std::abs(a.cam_phi_ - b.cam_phi_);
+	dPhi = std::min(dPhi, PI2 - dPhi) * std::sin(0.5 * (a.cam_the_ + b.cam_the_));
+	double dTheta = a.cam_the_ - b.cam_the_;
+	double dRadius = 3.0 * std::sqrt(3.0) * (1.0 / a.cam_rad_ - 1.0 / b.cam_rad_);
+	double dVelocity = std::asin(std::min(a.cam_vel_, 1.0)) - std::asin(std::min(b.cam_vel_, 1.0));
+	return std::sqrt(dPhi * dPhi + dTheta * dTheta + dRadius * dRadius + dVelocity * dVelocity);
+}
+
+GridQuantizer::Selection GridQuantizer::select(GridProperties const& target,
+	std::function<bool(GridProperties const&)> const& isCached) const
+{
+	Selection selection;
+	selection.target = target;
+	selection.grids = { Candidate{ target } };
+	selection.cached = isCached(target);
+	// the exact grid can't be beaten
+	if (!settings_.enabled || selection.cached) return selection;
+
+	GridProperties aligned = alignPhi(target);
+	double lo[AXES], hi[AXES];
+	for (int axis = 0; axis < AXES; ++axis) {
+		double k = getStep(axis) > 0.0 ? toLattice(aligned, axis) : 0.0;
+		lo[axis] = std::floor(k);
+		hi[axis] = std::ceil(k);
+	}
+	// lattice points around the camera, bit i selects hi of axis i
+	auto corner = [&](int mask) {
+		GridProperties props = aligned;
+		for (int axis = 0; axis < AXES; ++axis) {
+			if (getStep(axis) > 0.0)
+				fromLattice(props, axis, (mask & (1 << axis)) ? hi[axis] : lo[axis]);
+		}
+		return props;
+	};
+
+	Selection best;
+	best.error = std::numeric_limits<double>::infinity();
+	for (int mask = 0; mask < (1 << AXES); ++mask) {
+		GridProperties props = corner(mask);
+		double error = estimateError(aligned, props);
+		if (error < best.error && error <= settings_.maxError && isCached(props)) {
+			best.grids = { Candidate{ props } };
+			best.error = error;
+		}
+	}
+
+	if (settings_.blend) {
+		for (int mask = 0; mask < (1 << AXES); ++mask) {
+			for (int axis = 0; axis < AXES; ++axis) {
+				if ((mask & (1 << axis)) || getStep(axis) <= 0.0 || lo[axis] == hi[axis]) continue;
+				GridProperties props0 = corner(mask);
+				GridProperties props1 = corner(mask | (1 << axis));
+				if (!isCached(props0) || !isCached(props1)) continue;
+				// a half grid and a full grid don't share the deflection map layout
+				if (Grid::isSymmetric(props0) != Grid::isSymmetric(props1)) continue;
+
+				// along the blend axis the interpolation is taken as exact to first order,
+				// half the error of the nearer grid is left
+				GridProperties onAxis = props0;
+				copyAxis(onAxis, aligned, axis);
+				double errorOther = estimateError(aligned, onAxis);
+				double errorAxis = 0.5 * std::min(estimateError(onAxis, props0), estimateError(onAxis, props1));
+				double error = std::sqrt(errorOther * errorOther + errorAxis * errorAxis);
+				if (error >= best.error || error > settings_.maxError) continue;
+
+				double w1 = toLattice(aligned, axis) - lo[axis];
+				// the heavier grid first
+				if (w1 > 0.5) best.grids = { Candidate{ props1, w1 }, Candidate{ props0, 1.0 - w1 } };
+				else best.grids = { Candidate{ props0, 1.0 - w1 }, Candidate{ props1, w1 } };
+				best.error = error;
+			}
+		}
+	}
+
+	if (best.grids.empty()) {
+		// nothing cached, build the nearest lattice grid for the next requests
+		GridProperties nearest = snap(target);
+		double error = estimateError(aligned, nearest);
+		if (error > settings_.maxError) return selection;
+		best.grids = { Candidate{ nearest } };
+		best.error = error;
+		best.cached = false;
+	}
+	else {
+		best.cached = true;
+	}
+
+	best.target = target;
+	best.phiShift = target.cam_phi_ - aligned.cam_phi_;
+	return best;
+}
+
+bool GridQuantizer::load(std::string const& path)
+{
+	std::ifstream inFile(path);
+	if (!inFile) {
+		std::cerr << "[GridQuantizer] file " << path << " not found" << std::endl;
+		return false;
+	}
+	std::ostringstream sstr;
+	sstr << inFile.rdbuf();
+
+	boost::json::error_code error;
+	boost::json::value v = boost::json::parse(sstr.str(), error);
+	if (error || v.kind() != boost::json::kind::object) {
+		std::cerr << "[GridQuantizer] Error parsing settings " << path << std::endl;
+		return false;
+	}
+
+	boost::json::object const& configuration = v.get_object();
+	jhelper::getValue(configuration, "enabled", settings_.enabled);
+	jhelper::getValue(configuration, "radiusStep", settings_.radiusStep);
+	jhelper::getValue(configuration, "thetaStep", settings_.thetaStep);
+	jhelper::getValue(configuration, "velocityStep", settings_.velocityStep);
+	jhelper::getValue(configuration, "rotatePhi", settings_.rotatePhi);
+	jhelper::getValue(configuration, "blend", settings_.blend);
+	jhelper::getValue(configuration, "maxError", settings_.maxError);
+	return true;
+}
+
+bool GridQuantizer::save(std::string const& path) const
+{
+	boost::json::object configuration;
+	configuration["enabled"] = settings_.enabled;
+	configuration["radiusStep"] = settings_.radiusStep;
+	configuration["thetaStep"] = settings_.thetaStep;
+	configuration["velocityStep"] = settings_.velocityStep;
+	configuration["rotatePhi"] = settings_.rotatePhi;
+	configuration["blend"] = settings_.blend;
+	configuration["maxError"] = settings_.maxError;
+
+	std::ofstream outFile(path);
+	if (!outFile) {
+		std::cerr << "[GridQuantizer] can't write " << path << std::endl;
+		return false;
+	}
+	outFile << boost::json::serialize(configuration);
+	return (bool)outFile;
+}
@@ -0,0 +1,93 @@
+#include <blacktracer/GridStats.h>
+
+#include <fstream>
+#include <iostream>
+
+GridStats::Level& GridStats::getLevel(int level)
+{
+	if (level >= (int)levels.size()) {
+		int size = (int)levels.size();
+		levels.resize(level + 1);
+		for (int l = size; l <= level; ++l)
+			levels[l].level = l;
+	}
+	return levels[level];
+}
+
+GridStats::Level GridStats::getTotal() const
+{
+	Level total;
+	total.level = -1;
+	for (auto const& level : levels) {
+		total.rays += level.rays;
+		total.steps += level.steps;
+		total.traceSeconds += level.traceSeconds;
+		total.checkedBlocks += level.checkedBlocks;
+		total.refinedBlocks += level.refinedBlocks;
+		total.leafBlocks += level.leafBlocks;
+		total.crossingBlocks += level.crossingBlocks;
+	}
+	return total;
+}
+
+static boost::json::object levelToJson(GridStats::Level const& level)
+{
+	boost::json::object obj;
+	obj["level"] = level.level;
+	obj["rays"] = level.rays;
+	obj["steps"] = level.steps;
+	obj["stepsPerRay"] = level.getStepsPerRay();
+	obj["traceSeconds"] = level.traceSeconds;
+	obj["checkedBlocks"] = level.checkedBlocks;
+	obj["refinedBlocks"] = level.refinedBlocks;
+	obj["refinementRatio"] = level.getRefinementRatio();
+	obj["leafBlocks"] = level.leafBlocks;
+	obj["crossingBlocks"] = level.crossingBlocks;
+	return obj;
+}
+
+boost::json::object GridStats::toJson() const
+{
+	boost::json::object stats;
+	stats["name"] = name;
+	stats["width"] = width;
+	stats["height"] = height;
+	stats["symmetric"] = symmetric;
+
+	boost::json::array levelArray;
+	for (auto const& level : levels)
+		levelArray.push_back(levelToJson(level));
+	stats["levels"] = levelArray;
+	stats["total"] = levelToJson(getTotal());
+
+	boost::json::object phaseObj;
+	phaseObj["trace"] = phases.trace;
+	phaseObj["refine"] = phases.refine;
+	phaseObj["snapshots"] = phases.snapshots;
+	phaseObj["fixTvertices"] = phases.fixTvertices;
+	phaseObj["hash"] = phases.hash;
+	phaseObj["total"] = phases.total;
+	stats["phaseSeconds"] = phaseObj;
+
+	stats["points"] = points;
+	stats["shadowPoints"] = shadowPoints;
+	stats["failedPoints"] = failedPoints;
+	stats["shadowFraction"] = getShadowFraction();
+
+	stats["hashEntries"] = hashEntries;
+	stats["hashSlots"] = hashSlots;
+	stats["offsetSlots"] = offsetSlots;
+	stats["hashLoadFactor"] = getHashLoadFactor();
+	return stats;
+}
+
+bool GridStats::save(std::string const& path) const
+{
+	std::ofstream outFile(path);
+	if (!outFile) {
+		std::cerr << "[GridStats] can't write " << path << std::endl;
+		return false;
+	}
+	outFile << boost::json::serialize(toJson());
+	return (bool)outFile;
+}
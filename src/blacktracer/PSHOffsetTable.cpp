@@ -70,7 +70,7 @@ void PSHOffsetTable::writeToFile(std::string const& fileName) const
 	ofs.close();
 }
 
-glm::ivec2 PSHOffsetTable::hashFunc(glm::ivec2 key)
+glm::ivec2 PSHOffsetTable::hashFunc(glm::ivec2 key) const
 {
 	glm::ivec2 index = hash1(key);
 	glm::ivec2 add = { hash0(key).x + offsetTable[(index.x * offsetTableWidth + index.y) * 2],
@@ -78,6 +78,24 @@ glm::ivec2 PSHOffsetTable::hashFunc(glm::ivec2 key)
 	return hash0(add);
 }
 
+void PSHOffsetTable::getEntries(std::vector<glm::ivec2>& keys, std::vector<glm::vec2>& values) const
+{
+	keys.clear();
+	values.clear();
+	if (hashTable.empty()) return;
+	// empty slots are tagged (0, 0), a slot is filled if its tag hashes to it
+	for (int x = 0; x < hashTableWidth; x++) {
+		for (int y = 0; y < hashTableWidth; y++) {
+			int slot = x * hashTableWidth + y;
+			glm::ivec2 key = { hashPosTag[slot * 2], hashPosTag[slot * 2 + 1] };
+			glm::ivec2 hash = hashFunc(key);
+			if (hash.x != x || hash.y != y) continue;
+			keys.push_back(key);
+			values.push_back({ hashTable[slot * 2], hashTable[slot * 2 + 1] });
+		}
+	}
+}
+
 // ------------- private --------------
 
 int PSHOffsetTable::calcHashTableWidth(int size)
@@ -233,12 +251,12 @@ bool PSHOffsetTable::OffsetWorks(OffsetBucket bucket, glm::ivec2 offset)
 	return true;
 }
 
-glm::ivec2 PSHOffsetTable::hash1(glm::ivec2 key)
+glm::ivec2 PSHOffsetTable::hash1(glm::ivec2 key) const
 {
 	return{ (key.x + offsetTableWidth) % offsetTableWidth, (key.y + offsetTableWidth) % offsetTableWidth };
 }
 
-glm::ivec2 PSHOffsetTable::hash0(glm::ivec2 key)
+glm::ivec2 PSHOffsetTable::hash0(glm::ivec2 key) const
 {
 	return{ (key.x + hashTableWidth) % hashTableWidth, (key.y + hashTableWidth) % hashTableWidth };
 }
@@ -0,0 +1,64 @@
+#include <blacktracer/PSHTablePack.h>
+
+#include <iostream>
+
+int PSHTablePack::add(PSHOffsetTable const& table)
+{
+	glm::ivec4 entry{
+		table.hashTableWidth, table.offsetTableWidth,
+		(int)hashTable.size() / 2, (int)offsetTable.size() / 2
+	};
+
+	if (table.hashTable.empty()) {
+		// 1x1 tables with a position tag no key can have
+		entry.x = entry.y = 1;
+		hashTable.insert(hashTable.end(), { -2.f, -2.f });
+		hashPosTag.insert(hashPosTag.end(), { -1, -1 });
+		offsetTable.insert(offsetTable.end(), { 0, 0 });
+	}
+	else {
+		if (table.hashTable.size() != 2 * (size_t)entry.x * entry.x
+			|| table.offsetTable.size() != 2 * (size_t)entry.y * entry.y) {
+			std::cerr << "[PSHTablePack] table sizes don't match table widths" << std::endl;
+			return -1;
+		}
+		hashTable.insert(hashTable.end(), table.hashTable.begin(), table.hashTable.end());
+		hashPosTag.insert(hashPosTag.end(), table.hashPosTag.begin(), table.hashPosTag.end());
+		offsetTable.insert(offsetTable.end(), table.offsetTable.begin(), table.offsetTable.end());
+	}
+
+	directory.push_back(entry);
+	return size() - 1;
+}
+
+void PSHTablePack::clear()
+{
+	hashTable.clear();
+	hashPosTag.clear();
+	offsetTable.clear();
+	directory.clear();
+}
+
+size_t PSHTablePack::byteSize() const
+{
+	return sizeof(float) * hashTable.size() + sizeof(int) * hashPosTag.size()
+		+ sizeof(int) * offsetTable.size() + sizeof(glm::ivec4) * directory.size();
+}
+
+glm::vec2 PSHTablePack::lookup(int id, glm::ivec2 key) const
+{
+	if (id < 0 || id >= size()) return { -2.f, -2.f };
+
+	glm::ivec4 const& entry = directory[id];
+	int hw = entry.x, ow = entry.y;
+
+	glm::ivec2 index{ (key.x + ow) % ow, (key.y + ow) % ow };
+	size_t offsetIndex = 2 * ((size_t)entry.w + index.x * ow + index.y);
+	glm::ivec2 add{ (key.x + hw) % hw + offsetTable[offsetIndex], (key.y + hw) % hw + offsetTable[offsetIndex + 1] };
+	glm::ivec2 hindex{ (add.x + hw) % hw, (add.y + hw) % hw };
+
+	size_t hashIndex = 2 * ((size_t)entry.z + hindex.x * hw + hindex.y);
+	if (hashPosTag[hashIndex] != key.x || hashPosTag[hashIndex + 1] != key.y)
+		return { -2.f, -2.f };
+	return { hashTable[hashIndex], hashTable[hashIndex + 1] };
+}
@@ -0,0 +1,87 @@
+#include <blacktracer/ReferenceTracer.h>
+#include <blacktracer/Const.h>
+
+#include <chrono>
+#include <thread>
+#include <iostream>
+
+ReferenceTracer::ReferenceTracer(GridProperties props)
+	: props_(props)
+	, metric_(std::make_shared<Metric>(props.blackHole_a_))
+	, width_(0), height_(0)
+	, traceTime_(0.0)
+	, nextRow_(0), rowsDone_(0)
+	, done_(false), cancel_(false)
+{
+	cam_ = std::make_shared<Camera>(metric_,
+		props.cam_the_, props.cam_phi_,
+		props.cam_rad_, props.cam_vel_
+	);
+}
+
+void ReferenceTracer::trace(int width, int height, int threads)
+{
+	if (width < 2 || height < 2) {
+		std::cerr << "[ReferenceTracer] invalid map size " << width << "x" << height << std::endl;
+		return;
+	}
+
+	width_ = width;
+	height_ = height;
+	map_ = std::vector<glm::vec2>((size_t)width_ * height_, glm::vec2(-1.f));
+	nextRow_ = 0;
+	rowsDone_ = 0;
+	done_ = false;
+	cancel_ = false;
+
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	auto start_time = std::chrono::high_resolution_clock::now();
+
+	// rows close to the black hole take a lot longer than the rest,
+	// so rows are handed out one by one instead of in fixed chunks
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+		workers.emplace_back(&ReferenceTracer::traceRows, this);
+	for (auto& w : workers)
+		w.join();
+
+	auto end_time = std::chrono::high_resolution_clock::now();
+	traceTime_ = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+
+	if (cancel_) {
+		std::cout << "[ReferenceTracer] cancelled after " << rowsDone_ << " of " << height_ << " rows" << std::endl;
+		return;
+	}
+
+	done_ = true;
+	std::cout << "[ReferenceTracer] traced " << map_.size() << " rays on " << threads << " threads in "
+		<< traceTime_ << "ms" << std::endl;
+}
+
+glm::dvec2 ReferenceTracer::pixelToCamSky(int x, int y, int width, int height)
+{
+	double theta = (1.0 - y / (height - 1.0)) * PI;
+	double phi = x / (width - 1.0) * PI2;
+	return { theta, phi };
+}
+
+float ReferenceTracer::getProgress() const
+{
+	if (height_ == 0) return 0.f;
+	return rowsDone_ / (float)height_;
+}
+
+void ReferenceTracer::traceRows()
+{
+	int y;
+	while (!cancel_ && (y = nextRow_++) < height_) {
+		for (int x = 0; x < width_; ++x) {
+			glm::dvec2 thphi = pixelToCamSky(x, y, width_, height_);
+			int step = 0;
+			cam_->traceRay(thphi.x, thphi.y, step);
+			map_[(size_t)y * width_ + x] = glm::vec2(thphi);
+		}
+		rowsDone_++;
+	}
+}
@@ -0,0 +1,107 @@
+#include <blacktracer/RefinementPolicy.h>
+#include <blacktracer/Grid.h>
+#include <blacktracer/Const.h>
+
+#include <limits>
+#include <algorithm>
+
+std::shared_ptr<RefinementPolicy> RefinementPolicy::create(GridProperties const& props)
+{
+	switch ((RefinementMode)props.grid_refinement_) {
+	case RefinementMode::HERMITE:
+		return std::make_shared<HermiteRefinement>(props.grid_threshold_, props.grid_forceLvl_);
+	case RefinementMode::THRESHOLD:
+	default:
+		return std::make_shared<ThresholdRefinement>(props.grid_threshold_, props.grid_forceLvl_);
+	}
+}
+
+double RefinementPolicy::defaultThreshold(RefinementMode mode)
+{
+	switch (mode) {
+	case RefinementMode::HERMITE:
+		return PRECHERMITE;
+	case RefinementMode::THRESHOLD:
+	default:
+		return PRECCELEST;
+	}
+}
+
+std::string RefinementPolicy::getName(RefinementMode mode)
+{
+	switch (mode) {
+	case RefinementMode::HERMITE:
+		return "hermite";
+	case RefinementMode::THRESHOLD:
+	default:
+		return "threshold";
+	}
+}
+
+double ThresholdRefinement::estimate(Grid const& grid, uint32_t i, uint32_t j, uint32_t gap) const
+{
+	glm::dvec2 ij{ 0.0 }, kj{ 0.0 }, il{ 0.0 }, kl{ 0.0 };
+	grid.findCel(i, j, ij);
+	grid.findCel(i + gap, j, kj);
+	grid.findCel(i, j + gap, il);
+	grid.findCel(i + gap, j + gap, kl);
+
+	glm::dvec2 d1 = ij - kl;
+	glm::dvec2 d2 = kj - il;
+	double diag = d1.x * d1.x + d1.y * d1.y;
+	double diag2 = d2.x * d2.x + d2.y * d2.y;
+
+	return std::max(diag, diag2);
+}
+
+double HermiteRefinement::estimate(Grid const& grid, uint32_t i, uint32_t j, uint32_t gap) const
+{
+	glm::dvec2 corners[4]{ glm::dvec2(0.0), glm::dvec2(0.0), glm::dvec2(0.0), glm::dvec2(0.0) };
+	grid.findCel(i, j, corners[0]);
+	grid.findCel(i + gap, j, corners[1]);
+	grid.findCel(i, j + gap, corners[2]);
+	grid.findCel(i + gap, j + gap, corners[3]);
+
+	int shadow = 0;
+	for (auto const& c : corners)
+		if (c.x < 0) shadow++;
+	if (shadow == 4) return 0.0;
+	// shadow border can't be interpolated, always refine
+	if (shadow > 0) return std::numeric_limits<double>::infinity();
+
+	return std::max({
+		edgeError(grid, i, j, 0, gap),			// up
+		edgeError(grid, i + gap, j, 0, gap),	// down
+		edgeError(grid, i, j, gap, 0),			// left
+		edgeError(grid, i, j + gap, gap, 0)		// right
+	});
+}
+
+double HermiteRefinement::edgeError(Grid const& grid, int64_t i, int64_t j, int64_t di, int64_t dj) const
+{
+	glm::dvec2 a, b, prev, next;
+	grid.findCel(i, j, a);
+	grid.findCel(i + di, j + dj, b);
+	bool hasPrev = grid.findCel(i - di, j - dj, prev) && prev.x >= 0;
+	bool hasNext = grid.findCel(i + 2 * di, j + 2 * dj, next) && next.x >= 0;
+	if (!hasPrev && !hasNext) return 0.0;
+
+	// correct 2pi crossings (same as Metric::correct2PIcross with factor 5)
+	glm::dvec2* pts[4] = { &a, &b, &prev, &next };
+	bool cross = false;
+	for (auto p : pts)
+		if (p->y > PI2 * (1. - 1. / 5.)) cross = true;
+	if (cross) {
+		for (auto p : pts)
+			if (p->y < PI2 / 5.) p->y += PI2;
+	}
+
+	// missing neighbours are extrapolated linearly
+	if (!hasPrev) prev = 2.0 * a - b;
+	if (!hasNext) next = 2.0 * b - a;
+
+	// hermite (tension 0, bias 0) at v = 0.5 is the linear midpoint plus (m0 - m1) / 8
+	glm::dvec2 m0 = 0.5 * (b - prev);
+	glm::dvec2 m1 = 0.5 * (next - a);
+	return glm::length(m0 - m1) / 8.0;
+}
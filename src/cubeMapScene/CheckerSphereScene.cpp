@@ -33,28 +33,37 @@ void CheckerSphereScene::render(glm::vec3 camPos, float dt)
 {
 	updateCameras(camPos);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, fboID_);
-	glViewport(0, 0, envMap_->getWidth(), envMap_->getHeight());
-
-	glEnable(GL_DEPTH_TEST);
-	for (unsigned int i = 0; i < 6; ++i) {
+	// object ids: 0 = sphere, 1 = cube
+	std::vector<glm::mat4> models{
+		glm::translate(spherePos_) * glm::scale(glm::vec3(sphereScale_)) * glm::mat4(1),
+		glm::translate(cubePos_) * glm::scale(glm::vec3(cubeScale_)) * glm::mat4(1)
+	};
+	// cube corners are at distance sqrt(3)
+	std::vector<unsigned int> faces = scheduleFaces(camPos, models, { 1.f, std::sqrt(3.f) });
+	if (faces.empty()) return;
+
+	GpuProfiler::Scope scope(profiler_, "cubeMap");
+	if (layered_)
+		renderLayered(faces, models);
+	else
+		renderFaces(faces, models);
+}
 
-		GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, face, envMap_->getTexId(), 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, face, depthMap_->getTexId(), 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void CheckerSphereScene::renderFaces(std::vector<unsigned int> const& faces, std::vector<glm::mat4> const& models)
+{
+	for (unsigned int i : faces) {
 
-		envCameras_.at(i)->use(envMap_->getWidth(), envMap_->getHeight());
+		beginFace(i);
 
 		sphereShader_->use();
-		sphereShader_->setUniform("modelMatrix", glm::translate(spherePos_) * glm::scale(glm::vec3(sphereScale_)) * glm::mat4(1));
+		sphereShader_->setUniform("modelMatrix", models[0]);
 
 		sphereShader_->setUniform("mesh_color", sphereColor_);
 
 		sphereMesh_->draw(GL_TRIANGLES);
 
 		cubeShader_->use();
-		cubeShader_->setUniform("modelMatrix", glm::translate(cubePos_) * glm::scale(glm::vec3(cubeScale_)) * glm::mat4(1));
+		cubeShader_->setUniform("modelMatrix", models[1]);
 
 		cubeMesh_->draw(GL_TRIANGLES);
 
@@ -67,8 +76,36 @@ void CheckerSphereScene::render(glm::vec3 camPos, float dt)
 		}
 
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glDisable(GL_DEPTH_TEST);
+	end();
+}
+
+void CheckerSphereScene::renderLayered(std::vector<unsigned int> const& faces, std::vector<glm::mat4> const& models)
+{
+	uploadModelMatrices(models);
+
+	unsigned int mask = faceMask(faces);
+	sphereLayeredShader_->setUniform("face_mask", (int)mask);
+	cubeLayeredShader_->setUniform("face_mask", (int)mask);
+	skyLayeredShader_->setUniform("face_mask", (int)mask);
+	beginLayered(mask);
+
+	sphereLayeredShader_->use();
+	sphereLayeredShader_->setUniform("object_id", 0);
+	sphereLayeredShader_->setUniform("mesh_color", sphereColor_);
+	sphereMesh_->draw(GL_TRIANGLES);
+
+	cubeLayeredShader_->use();
+	cubeLayeredShader_->setUniform("object_id", 1);
+	cubeMesh_->draw(GL_TRIANGLES);
+
+	if (drawSky_) {
+		glActiveTexture(GL_TEXTURE0);
+		skyTexture_->bind();
+		skyLayeredShader_->use();
+		quad_.draw(GL_TRIANGLES);
+	}
+
+	end();
 }
 
 void CheckerSphereScene::renderGui()
@@ -78,7 +115,8 @@ void CheckerSphereScene::renderGui()
 		ImGui::Indent();
 		ImGui::SliderFloat("Sphere Size", &sphereScale_, 0.1f, 10);
 		ImGui::SliderFloat3("Sphere Pos", glm::value_ptr(spherePos_), -50.f, 50.f);
-		ImGui::SliderFloat3("Sphere Color", glm::value_ptr(sphereColor_), 0.f, 1.f);
+		if (ImGui::SliderFloat3("Sphere Color", glm::value_ptr(sphereColor_), 0.f, 1.f))
+			scheduler_.invalidate();
 		ImGui::Unindent();
 	}
 	if (ImGui::CollapsingHeader("Cube")) {
@@ -87,7 +125,10 @@ void CheckerSphereScene::renderGui()
 		ImGui::SliderFloat3("Cube Pos", glm::value_ptr(cubePos_), -50.f, 50.f);
 		ImGui::Unindent();
 	}
-	ImGui::Checkbox("Draw Sky", &drawSky_);
+	if (ImGui::Checkbox("Draw Sky", &drawSky_))
+		scheduler_.invalidate();
+	ImGui::Checkbox("Single Pass (layered) Rendering", &layered_);
+	renderSchedulerGui();
 
 	if (ImGui::Button("Reload Shaders"))
 		reloadShaders();
@@ -111,6 +152,9 @@ void CheckerSphereScene::loadShaders()
 	skyShader_ = std::make_shared<Shader>("cubeMapScene/sky.vs", "cubeMapScene/sky.fs");
 	sphereShader_ = std::make_shared<Shader>("cubeMapScene/checkerSphereMesh.vs", "cubeMapScene/checkerSphereMesh.fs");
 	cubeShader_ = std::make_shared<Shader>("cubeMapScene/checkerSphereMesh.vs", "cubeMapScene/cubeMesh.fs");
+	skyLayeredShader_ = std::make_shared<Shader>("cubeMapScene/skyLayered.vs", "cubeMapScene/skyLayered.gs", "cubeMapScene/sky.fs");
+	sphereLayeredShader_ = std::make_shared<Shader>("cubeMapScene/meshLayered.vs", "cubeMapScene/layered.gs", "cubeMapScene/checkerSphereMesh.fs");
+	cubeLayeredShader_ = std::make_shared<Shader>("cubeMapScene/meshLayered.vs", "cubeMapScene/layered.gs", "cubeMapScene/cubeMesh.fs");
 	reloadShaders();
 }
 
@@ -119,7 +163,14 @@ void CheckerSphereScene::reloadShaders()
 	sphereShader_->reload();
 	cubeShader_->reload();
 	skyShader_->reload();
+	sphereLayeredShader_->reload();
+	cubeLayeredShader_->reload();
+	skyLayeredShader_->reload();
 	skyShader_->setBlockBinding("camera", CAMBINDING);
 	sphereShader_->setBlockBinding("camera", CAMBINDING);
 	cubeShader_->setBlockBinding("camera", CAMBINDING);
+	skyLayeredShader_->setBlockBinding("cubeCamera", CUBECAMBINDING);
+	sphereLayeredShader_->setBlockBinding("cubeCamera", CUBECAMBINDING);
+	cubeLayeredShader_->setBlockBinding("cubeCamera", CUBECAMBINDING);
+	scheduler_.invalidate();
 }
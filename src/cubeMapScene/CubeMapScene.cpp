@@ -1,18 +1,28 @@
 #include <cubeMapScene/CubeMapScene.h>
+#include <helpers/uboBindings.h>
+#include <gui/gui.h>
+#include <glm/gtc/constants.hpp>
 
-CubeMapScene::CubeMapScene() : size_(0)
+CubeMapScene::CubeMapScene() : size_(0), fboID_(0), layeredFboID_(0), cubeCameraUBO_(0), layered_(true)
+	, lazyUpdates_(true), modelCount_(0)
 {
 }
 
-CubeMapScene::CubeMapScene(int size) : size_(size)
+CubeMapScene::CubeMapScene(int size) : size_(size), fboID_(0), layeredFboID_(0), cubeCameraUBO_(0), layered_(true)
+	, lazyUpdates_(true), modelCount_(0)
 {
+	// half a texel of a face
+	scheduler_.setThreshold(0.5f * glm::half_pi<float>() / size_);
 	initCameras();
 	initEnvMap();
+	initLayered();
 }
 
 CubeMapScene::~CubeMapScene()
 {
 	glDeleteFramebuffers(1, &fboID_);
+	glDeleteFramebuffers(1, &layeredFboID_);
+	glDeleteBuffers(1, &cubeCameraUBO_);
 }
 
 void CubeMapScene::initCameras()
@@ -61,8 +71,129 @@ void CubeMapScene::initEnvMap() {
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void CubeMapScene::initLayered()
+{
+	// attaching the whole cube map makes the fbo layered, gl_Layer selects the face
+	glCreateFramebuffers(1, &layeredFboID_);
+	glNamedFramebufferTexture(layeredFboID_, GL_COLOR_ATTACHMENT0, envMap_->getTexId(), 0);
+	glNamedFramebufferTexture(layeredFboID_, GL_DEPTH_STENCIL_ATTACHMENT, depthMap_->getTexId(), 0);
+
+	if (glCheckNamedFramebufferStatus(layeredFboID_, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "[CubeMapScene] layered fbo not complete, rendering faces separately" << std::endl;
+		layered_ = false;
+	}
+
+	glGenBuffers(1, &cubeCameraUBO_);
+	glBindBuffer(GL_UNIFORM_BUFFER, cubeCameraUBO_);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CubeCameraData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
 void CubeMapScene::updateCameras(glm::vec3 camPos)
 {
 	for (auto& cam : envCameras_)
 		cam->setPos(camPos);
+
+	if (!layered_) return;
+
+	CubeCameraData data;
+	for (int i = 0; i < 6; ++i) {
+		data.projectionView_[i] = envCameras_.at(i)->getProjectionMatrix(1.f) * envCameras_.at(i)->getViewMatrix();
+		data.projectionViewInverse_[i] = glm::inverse(data.projectionView_[i]);
+	}
+	data.camPos_ = glm::vec4(camPos, 1.f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, cubeCameraUBO_);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CubeCameraData), &data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+std::vector<unsigned int> CubeMapScene::scheduleFaces(glm::vec3 camPos, std::vector<glm::mat4> const& models,
+	std::vector<float> const& radii)
+{
+	if (lazyUpdates_)
+		return scheduler_.schedule(camPos, models, radii);
+	return { 0, 1, 2, 3, 4, 5 };
+}
+
+unsigned int CubeMapScene::faceMask(std::vector<unsigned int> const& faces)
+{
+	unsigned int mask = 0;
+	for (unsigned int face : faces)
+		mask |= 1u << face;
+	return mask;
+}
+
+void CubeMapScene::renderSchedulerGui()
+{
+	if (ImGui::Checkbox("Lazy Updates", &lazyUpdates_))
+		scheduler_.invalidate();
+	if (!lazyUpdates_) return;
+
+	int faces = scheduler_.getFacesPerFrame();
+	if (ImGui::SliderInt("Max Faces per Frame", &faces, 1, 6))
+		scheduler_.setFacesPerFrame(faces);
+
+	float texel = glm::half_pi<float>() / size_;
+	float threshold = scheduler_.getThreshold() / texel;
+	if (ImGui::SliderFloat("Update Threshold (texels)", &threshold, 0.f, 16.f))
+		scheduler_.setThreshold(threshold * texel);
+	ImGui::Text("Faces updated last frame: %d", scheduler_.getLastUpdateCount());
+}
+
+void CubeMapScene::beginFace(unsigned int face)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, fboID_);
+	glViewport(0, 0, envMap_->getWidth(), envMap_->getHeight());
+	glEnable(GL_DEPTH_TEST);
+
+	GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, envMap_->getTexId(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, target, depthMap_->getTexId(), 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	envCameras_.at(face)->use(envMap_->getWidth(), envMap_->getHeight());
+}
+
+void CubeMapScene::beginLayered(unsigned int faceMask)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, layeredFboID_);
+	glViewport(0, 0, envMap_->getWidth(), envMap_->getHeight());
+	glEnable(GL_DEPTH_TEST);
+
+	if (faceMask == 0x3f) {
+		// clears all six faces
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+	else {
+		glm::vec3 color(0.f);
+		GLuint depthStencil = 0xFFFFFF00;	// depth 1, stencil 0
+		for (int face = 0; face < 6; ++face) {
+			if (!(faceMask & (1u << face))) continue;
+			glClearTexSubImage(envMap_->getTexId(), 0, 0, 0, face, size_, size_, 1, GL_RGB, GL_FLOAT, &color);
+			glClearTexSubImage(depthMap_->getTexId(), 0, 0, 0, face, size_, size_, 1,
+				GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, &depthStencil);
+		}
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, CUBECAMBINDING, cubeCameraUBO_);
+}
+
+void CubeMapScene::end()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDisable(GL_DEPTH_TEST);
+}
+
+void CubeMapScene::uploadModelMatrices(std::vector<glm::mat4> const& models)
+{
+	if (!modelSSBO_ || modelCount_ != models.size()) {
+		modelCount_ = models.size();
+		modelSSBO_ = std::make_shared<SSBO>(sizeof(glm::mat4) * modelCount_, GL_DYNAMIC_DRAW);
+	}
+	modelSSBO_->bind();
+	modelSSBO_->subData(0, sizeof(glm::mat4) * modelCount_, (void*)models.data());
+	modelSSBO_->unbind();
+	// "objects" buffer in meshLayered.vs
+	modelSSBO_->bindBase(0);
 }
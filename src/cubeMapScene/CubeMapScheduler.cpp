@@ -0,0 +1,120 @@
+#include <cubeMapScene/CubeMapScheduler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+CubeMapScheduler::CubeMapScheduler(int facesPerFrame, float threshold)
+	: facesPerFrame_(glm::clamp(facesPerFrame, 1, 6))
+	, threshold_(threshold)
+	, frame_(0)
+	, lastUpdates_(0)
+{
+}
+
+std::vector<unsigned int> CubeMapScheduler::schedule(glm::vec3 camPos, std::vector<glm::mat4> const& models,
+	std::vector<float> const& radii)
+{
+	frame_++;
+
+	std::vector<ObjectView> objects;
+	for (size_t i = 0; i < models.size(); ++i)
+		objects.push_back(objectView(models[i], i < radii.size() ? radii[i] : 1.f, camPos));
+
+	std::vector<unsigned int> invalid, dirty;
+	for (unsigned int f = 0; f < 6; ++f) {
+		FaceState& face = faces_[f];
+		if (!face.valid || face.objects.size() != objects.size()) {
+			face.error = std::numeric_limits<float>::infinity();
+			invalid.push_back(f);
+			continue;
+		}
+		face.error = faceError(face, objects, f);
+		if (face.error > threshold_)
+			dirty.push_back(f);
+	}
+
+	// highest error first, faces that waited longer on ties
+	std::sort(dirty.begin(), dirty.end(), [this](unsigned int a, unsigned int b) {
+		if (faces_[a].error != faces_[b].error) return faces_[a].error > faces_[b].error;
+		return faces_[a].lastFrame < faces_[b].lastFrame;
+	});
+	if (dirty.size() > (size_t)facesPerFrame_)
+		dirty.resize(facesPerFrame_);
+
+	std::vector<unsigned int> render = invalid;
+	render.insert(render.end(), dirty.begin(), dirty.end());
+	std::sort(render.begin(), render.end());
+
+	for (unsigned int f : render) {
+		faces_[f].valid = true;
+		faces_[f].error = 0.f;
+		faces_[f].lastFrame = frame_;
+		faces_[f].objects = objects;
+	}
+	lastUpdates_ = (int)render.size();
+	return render;
+}
+
+void CubeMapScheduler::invalidate()
+{
+	for (auto& face : faces_)
+		face.valid = false;
+}
+
+CubeMapScheduler::ObjectView CubeMapScheduler::objectView(glm::mat4 const& model, float radius, glm::vec3 camPos)
+{
+	ObjectView view;
+	glm::vec3 axes[3] = { glm::vec3(model[0]), glm::vec3(model[1]), glm::vec3(model[2]) };
+	float scale = std::max({ glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]) });
+	for (int i = 0; i < 3; ++i)
+		view.rotation[i] = glm::length(axes[i]) > 0.f ? glm::normalize(axes[i]) : glm::vec3(0.f);
+
+	glm::vec3 toObject = glm::vec3(model[3]) - camPos;
+	float dist = glm::length(toObject);
+	float worldRadius = radius * scale;
+	view.dir = dist > 0.f ? toObject / dist : glm::vec3(1.f, 0.f, 0.f);
+	view.angularRadius = dist > worldRadius ? std::asin(worldRadius / dist) : glm::pi<float>();
+	return view;
+}
+
+float CubeMapScheduler::objectError(ObjectView const& a, ObjectView const& b)
+{
+	// movement of the center and change of the apparent size
+	float cosMove = glm::clamp(glm::dot(a.dir, b.dir), -1.f, 1.f);
+	float error = std::acos(cosMove) + std::abs(a.angularRadius - b.angularRadius);
+
+	// rotation around the own axis moves the surface by about angle * apparent radius
+	glm::mat3 rel = glm::transpose(a.rotation) * b.rotation;
+	float cosRot = glm::clamp((rel[0][0] + rel[1][1] + rel[2][2] - 1.f) * 0.5f, -1.f, 1.f);
+	error += std::acos(cosRot) * std::min(a.angularRadius, b.angularRadius);
+
+	return error;
+}
+
+bool CubeMapScheduler::touchesFace(ObjectView const& view, unsigned int face)
+{
+	// the face contains the directions v with v[axis] >= |v[other]| for both other axes.
+	// directions within the angular radius r differ by at most r in each component
+	float r = view.angularRadius;
+	if (r >= glm::pi<float>() * 0.25f) return true;
+
+	int axis = face / 2;
+	float sign = (face % 2) ? -1.f : 1.f;
+	float a = sign * view.dir[axis];
+	float b = std::abs(view.dir[(axis + 1) % 3]);
+	float c = std::abs(view.dir[(axis + 2) % 3]);
+	return a + 2.f * r >= std::max(b, c);
+}
+
+float CubeMapScheduler::faceError(FaceState const& face, std::vector<ObjectView> const& objects, unsigned int index) const
+{
+	float error = 0.f;
+	for (size_t i = 0; i < objects.size(); ++i) {
+		ObjectView const& then = face.objects[i];
+		ObjectView const& now = objects[i];
+		if (!touchesFace(then, index) && !touchesFace(now, index)) continue;
+		error = std::max(error, objectError(then, now));
+	}
+	return error;
+}
@@ -5,20 +5,28 @@
 #include <helpers/uboBindings.h>
 #include <gui/gui.h>
 
+#include <random>
+
 
 SolarSystemScene::SolarSystemScene()
 	: CubeMapScene()
+	, instanced_(false)
+	, asteroidCount_(0)
 	, distScale_(10.f)
 	, sizeScale_(1.f)
 	, rotationSpeedScale_(0.f)
 {}
 
-SolarSystemScene::SolarSystemScene(int size)
+SolarSystemScene::SolarSystemScene(int size, std::shared_ptr<TextureLoader> loader)
 	: CubeMapScene(size)
 	, sphereMesh_(std::make_shared<Mesh>("sphere.obj"))
 	, meshTextures_()
 	, planets_()
 	, modelMatrices_()
+	, instanced_(true)
+	, instancedSpheres_(std::make_shared<InstancedSpheres>())
+	, pendingTextures_(0)
+	, asteroidCount_(2000)
 	, distScale_(4.f)
 	, sizeScale_(0.1f)
 	, maxSize_(20.f)
@@ -26,8 +34,9 @@ SolarSystemScene::SolarSystemScene(int size)
 {
 	initModelTransforms();
 	initPlanets();
+	initAsteroids();
 	loadShaders();
-	loadTextures();
+	loadTextures(loader);
 
 	std::vector<std::pair<GLenum, GLint>> texParametersi = {
 	{GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR},
@@ -46,56 +55,136 @@ void SolarSystemScene::render(glm::vec3 camPos, float dt)
 	updateCameras(camPos);
 	updateModelTransforms(dt);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, fboID_);
-	glViewport(0, 0, envMap_->getWidth(), envMap_->getHeight());
+	std::vector<glm::mat4> models;
+	for (auto const& [planetName, planetTransform] : modelMatrices_)
+		models.push_back(planetTransform);
+	models.insert(models.end(), asteroidMatrices_.begin(), asteroidMatrices_.end());
 
-	glEnable(GL_DEPTH_TEST);
-	for (unsigned int i = 0; i < 6; ++i) {
+	std::vector<unsigned int> faces = scheduleFaces(camPos, models);
+	if (faces.empty()) return;
 
-		GLenum face = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, face, envMap_->getTexId(), 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, face, depthMap_->getTexId(), 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	GpuProfiler::Scope scope(profiler_, "cubeMap");
+	if (instanced_) {
+		GpuProfiler::Scope lodScope(profiler_, "instanceLod");
+		updateInstances(camPos);
+	}
 
-		envCameras_.at(i)->use(envMap_->getWidth(), envMap_->getHeight());
+	if (layered_)
+		renderLayered(faces, models);
+	else
+		renderFaces(faces);
 
-		for (auto const& [planetName, planetTransform] : modelMatrices_) {
+	GpuProfiler::Scope mipmapScope(profiler_, "mipmap");
+	envMap_->generateMipMap();
 
-			meshShader_->use();
-			meshShader_->setUniform("modelMatrix", planetTransform);
-			
-			glActiveTexture(GL_TEXTURE0);
-			bool useTexture = false;
-			if (meshTextures_.contains(planetName)) {
-				meshTextures_[planetName]->bind();
-				useTexture = true;
-			}
-			else if (planets_.contains(planetName)) {
-				meshShader_->setUniform("mesh_color", planets_[planetName].color_);
-			}
-			else {
-				meshShader_->setUniform("mesh_color", glm::vec3(1.f));
-			}
-			meshShader_->setUniform("use_texture", useTexture);
+}
 
-			sphereMesh_->draw(GL_TRIANGLES);
+void SolarSystemScene::renderFaces(std::vector<unsigned int> const& faces)
+{
+	for (unsigned int i : faces) {
+
+		beginFace(i);
 
+		if (instanced_) {
+			instancedShader_->use();
+			instancedSpheres_->draw();
+		}
+		else {
+			drawPlanets(meshShader_, false);
 		}
 
-		
 		glActiveTexture(GL_TEXTURE0);
 		skyTexture_->bind();
 
 		skyShader_->use();
 		quad_.draw(GL_TRIANGLES);
-		
 
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glDisable(GL_DEPTH_TEST);
+	end();
+}
 
-	envMap_->generateMipMap();
+void SolarSystemScene::renderLayered(std::vector<unsigned int> const& faces, std::vector<glm::mat4> const& models)
+{
+	unsigned int mask = faceMask(faces);
+	skyLayeredShader_->setUniform("face_mask", (int)mask);
+	beginLayered(mask);
+
+	if (instanced_) {
+		instancedLayeredShader_->setUniform("face_mask", (int)mask);
+		instancedSpheres_->draw();
+	}
+	else {
+		uploadModelMatrices(models);
+		meshLayeredShader_->setUniform("face_mask", (int)mask);
+		drawPlanets(meshLayeredShader_, true);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	skyTexture_->bind();
 
+	skyLayeredShader_->use();
+	quad_.draw(GL_TRIANGLES);
+
+	end();
+}
+
+void SolarSystemScene::drawPlanets(std::shared_ptr<ShaderBase> const& shader, bool layered)
+{
+	int objectID = 0;
+	for (auto const& [planetName, planetTransform] : modelMatrices_) {
+
+		shader->use();
+		// layered shaders read the model matrix from the model ssbo
+		if (layered)
+			shader->setUniform("object_id", objectID++);
+		else
+			shader->setUniform("modelMatrix", planetTransform);
+
+		glActiveTexture(GL_TEXTURE0);
+		bool useTexture = false;
+		if (meshTextures_.contains(planetName)) {
+			meshTextures_[planetName]->bind();
+			useTexture = true;
+		}
+		else if (planets_.contains(planetName)) {
+			shader->setUniform("mesh_color", planets_[planetName].color_);
+		}
+		else {
+			shader->setUniform("mesh_color", glm::vec3(1.f));
+		}
+		shader->setUniform("use_texture", useTexture);
+
+		sphereMesh_->draw(GL_TRIANGLES);
+
+	}
+
+	// one draw call per asteroid, the baseline for the instanced path
+	shader->setUniform("use_texture", false);
+	shader->setUniform("mesh_color", glm::vec3(0.4f));
+	for (auto const& asteroidTransform : asteroidMatrices_) {
+		if (layered)
+			shader->setUniform("object_id", objectID++);
+		else
+			shader->setUniform("modelMatrix", asteroidTransform);
+		sphereMesh_->draw(GL_TRIANGLES);
+	}
+}
+
+void SolarSystemScene::updateInstances(glm::vec3 camPos)
+{
+	std::vector<InstancedSpheres::Instance> instances;
+	instances.reserve(modelMatrices_.size() + asteroidMatrices_.size());
+	for (auto const& [planetName, planetTransform] : modelMatrices_) {
+		glm::vec3 color = planets_.contains(planetName) ? planets_[planetName].color_ : glm::vec3(1.f);
+		int layer = textureLayers_.contains(planetName) ? textureLayers_[planetName] : -1;
+		instances.push_back(InstancedSpheres::makeInstance(planetTransform, color, layer));
+	}
+	for (auto const& asteroidTransform : asteroidMatrices_)
+		instances.push_back(InstancedSpheres::makeInstance(asteroidTransform, glm::vec3(0.4f)));
+	instancedSpheres_->setInstances(instances);
+
+	// a cube map face has a 90 degree field of view, tan(45) = 1 is half the face size
+	instancedSpheres_->update(camPos, 0.5f * size_);
 }
 
 void SolarSystemScene::renderGui()
@@ -105,27 +194,59 @@ void SolarSystemScene::renderGui()
 	ImGui::SliderFloat("Size Scale", &sizeScale_, 0.f, 1.f);
 	ImGui::SliderFloat("Max Size (relative to Earth)", &maxSize_, 0.f, 20.f);
 	ImGui::SliderFloat("Rotation Speed Scale", &rotationSpeedScale_, 0.f, 1.f);
+	ImGui::Checkbox("Single Pass (layered) Rendering", &layered_);
+	ImGui::Checkbox("Instanced Rendering", &instanced_);
+	if (ImGui::SliderInt("Asteroids", &asteroidCount_, 0, 20000)) {
+		initAsteroids();
+		scheduler_.invalidate();
+	}
+	if (instanced_ && ImGui::TreeNode("Sphere Detail Levels")) {
+		// projected radius in pixels
+		for (int i = 0; i < instancedSpheres_->lodPixels_.size(); ++i) {
+			if (ImGui::SliderFloat(("Level " + std::to_string(i + 1) + " below").c_str(), &instancedSpheres_->lodPixels_[i], 0.f, 512.f, "%.1f px", ImGuiSliderFlags_Logarithmic))
+				scheduler_.invalidate();
+		}
+		if (ImGui::SliderFloat("Cull below", &instancedSpheres_->minPixels_, 0.f, 4.f, "%.2f px"))
+			scheduler_.invalidate();
+		std::vector<unsigned int> counts = instancedSpheres_->getLodInstanceCounts();
+		for (int i = 0; i < counts.size(); ++i)
+			ImGui::Text("Level %d: %u instances", i, counts[i]);
+		ImGui::TreePop();
+	}
+	renderSchedulerGui();
 	if (ImGui::Button("Reload Shaders"))
 		reloadShaders();
 	ImGui::Separator();
 	ImGui::Text("Object Colors");
 	for (auto& [planetName, planetProps] : planets_) {
-		ImGui::SliderFloat3(objToString(planetName).c_str(), glm::value_ptr(planetProps.color_), 0.f, 1.f);
+		if (ImGui::SliderFloat3(objToString(planetName).c_str(), glm::value_ptr(planetProps.color_), 0.f, 1.f))
+			scheduler_.invalidate();
 	}
 	ImGui::Separator();
 }
 
-void SolarSystemScene::loadTextures()
+void SolarSystemScene::loadTextures(std::shared_ptr<TextureLoader> loader)
 {
-	meshTextures_[Objects::MERCURY] = std::make_shared<Texture2D>("planets/mercury.jpg");
-	meshTextures_[Objects::VENUS] = std::make_shared<Texture2D>("planets/venus.jpg");
-	meshTextures_[Objects::EARTH] = std::make_shared<Texture2D>("planets/earth.jpg");
-	meshTextures_[Objects::MOON] = std::make_shared<Texture2D>("planets/moon.jpg");
-	meshTextures_[Objects::MARS] = std::make_shared<Texture2D>("planets/mars.jpg");
-	meshTextures_[Objects::JUPITER] = std::make_shared<Texture2D>("planets/jupiter.jpg");
-	meshTextures_[Objects::SATURN] = std::make_shared<Texture2D>("planets/saturn.jpg");
-	meshTextures_[Objects::URANUS] = std::make_shared<Texture2D>("planets/uranus.jpg");
-	meshTextures_[Objects::NEPTUNE] = std::make_shared<Texture2D>("planets/neptune.jpg");
+	// without a shared loader the textures are still decoded in parallel, but waited for
+	bool wait = !loader;
+	if (wait)
+		loader = std::make_shared<TextureLoader>();
+
+	std::map<Objects, std::string> files{
+		{ Objects::MERCURY, "planets/mercury.jpg" },
+		{ Objects::VENUS, "planets/venus.jpg" },
+		{ Objects::EARTH, "planets/earth.jpg" },
+		{ Objects::MOON, "planets/moon.jpg" },
+		{ Objects::MARS, "planets/mars.jpg" },
+		{ Objects::JUPITER, "planets/jupiter.jpg" },
+		{ Objects::SATURN, "planets/saturn.jpg" },
+		{ Objects::URANUS, "planets/uranus.jpg" },
+		{ Objects::NEPTUNE, "planets/neptune.jpg" }
+	};
+	for (auto const& [obj, file] : files) {
+		meshTextures_[obj] = loader->load(file, false, true, [this]() { onTextureLoaded(); }).texture;
+		pendingTextures_++;
+	}
 
 	std::vector<std::pair<GLenum, GLint>> texParameters{
 		{GL_TEXTURE_WRAP_S, GL_REPEAT},
@@ -135,17 +256,44 @@ void SolarSystemScene::loadTextures()
 	};
 	for (auto& [obj, tex] : meshTextures_) {
 		tex->setParam(texParameters);
-		tex->generateMipMap();
 	}
 
+	// placeholders until the planet textures are loaded
+	updateTextureArray();
+
 	std::vector<std::string> skyFaces = { "milkyway2048/right.png", "milkyway2048/left.png", "milkyway2048/top.png", "milkyway2048/bottom.png", "milkyway2048/front.png", "milkyway2048/back.png" };
-	skyTexture_ = std::make_shared<CubeMap>(skyFaces);
+	skyTexture_ = loader->loadCubeMap(skyFaces, false, [this]() { scheduler_.invalidate(); }).texture;
+
+	if (wait)
+		loader->finish();
+}
+
+void SolarSystemScene::onTextureLoaded()
+{
+	// the texture array copies the planet textures, update it once all are there
+	if (--pendingTextures_ == 0)
+		updateTextureArray();
+	scheduler_.invalidate();
+}
+
+void SolarSystemScene::updateTextureArray()
+{
+	std::vector<std::shared_ptr<Texture2D>> layers;
+	for (auto const& [obj, tex] : meshTextures_) {
+		textureLayers_[obj] = (int)layers.size();
+		layers.push_back(tex);
+	}
+	instancedSpheres_->setTextures(layers);
 }
 
 void SolarSystemScene::loadShaders()
 {
 	skyShader_ = std::make_shared<Shader>("cubeMapScene/sky.vs", "cubeMapScene/sky.fs");
 	meshShader_ = std::make_shared<Shader>("cubeMapScene/mesh.vs", "cubeMapScene/mesh.fs");
+	skyLayeredShader_ = std::make_shared<Shader>("cubeMapScene/skyLayered.vs", "cubeMapScene/skyLayered.gs", "cubeMapScene/sky.fs");
+	meshLayeredShader_ = std::make_shared<Shader>("cubeMapScene/meshLayered.vs", "cubeMapScene/layered.gs", "cubeMapScene/mesh.fs");
+	instancedShader_ = std::make_shared<Shader>("cubeMapScene/instanced.vs", "cubeMapScene/instanced.fs");
+	instancedLayeredShader_ = std::make_shared<Shader>("cubeMapScene/instancedLayered.vs", "cubeMapScene/layered.gs", "cubeMapScene/instanced.fs");
 	reloadShaders();
 }
 
@@ -247,6 +395,31 @@ void SolarSystemScene::initPlanets()
 	
 }
 
+void SolarSystemScene::initAsteroids()
+{
+	// fixed seed, the belt looks the same every time
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<float> distDist(2.2f, 3.3f);
+	std::uniform_real_distribution<float> angleDist(0.f, glm::two_pi<float>());
+	std::normal_distribution<float> inclinationDist(0.f, glm::radians(7.f));
+	std::uniform_real_distribution<float> sizeDist(0.f, 1.f);
+
+	asteroids_.clear();
+	for (int i = 0; i < asteroidCount_; ++i) {
+		Asteroid asteroid;
+		asteroid.dist_ = distDist(gen);
+		// many small ones, few large ones
+		asteroid.size_ = 0.01f + 0.07f * std::pow(sizeDist(gen), 4.f);
+		asteroid.phase_ = angleDist(gen);
+		// kepler's third law, in earth years
+		asteroid.orbitSpeed_ = 1.f / std::pow(asteroid.dist_, 1.5f);
+		asteroid.inclination_ = inclinationDist(gen);
+		asteroid.node_ = angleDist(gen);
+		asteroids_.push_back(asteroid);
+	}
+	asteroidMatrices_.resize(asteroids_.size());
+}
+
 void SolarSystemScene::updateModelTransforms(float dt)
 {
 	static float rotAngle = 0;
@@ -277,6 +450,15 @@ void SolarSystemScene::updateModelTransforms(float dt)
 		glm::scale(glm::vec3(glm::min(maxSize_, moonProps.size_) * sizeScale_)) *
 		glm::mat4(1);;
 
+	for (int i = 0; i < asteroids_.size(); ++i) {
+		Asteroid const& asteroid = asteroids_[i];
+		asteroidMatrices_[i] =
+			glm::rotate(asteroid.node_, glm::vec3(0, 1, 0)) *
+			glm::rotate(asteroid.inclination_, glm::vec3(0, 0, 1)) *
+			glm::rotate(asteroid.phase_ + asteroid.orbitSpeed_ * rotAngle, glm::vec3(0, 1, 0)) *
+			glm::translate(glm::vec3(asteroid.dist_ * distScale_, 0, 0)) *
+			glm::scale(glm::vec3(asteroid.size_ * sizeScale_));
+	}
 }
 
 
@@ -284,8 +466,18 @@ void SolarSystemScene::reloadShaders()
 {
 	meshShader_->reload();
 	skyShader_->reload();
+	meshLayeredShader_->reload();
+	skyLayeredShader_->reload();
+	instancedShader_->reload();
+	instancedLayeredShader_->reload();
+	instancedSpheres_->reloadShaders();
 	skyShader_->setBlockBinding("camera", CAMBINDING);
 	meshShader_->setBlockBinding("camera", CAMBINDING);
+	skyLayeredShader_->setBlockBinding("cubeCamera", CUBECAMBINDING);
+	meshLayeredShader_->setBlockBinding("cubeCamera", CUBECAMBINDING);
+	instancedShader_->setBlockBinding("camera", CAMBINDING);
+	instancedLayeredShader_->setBlockBinding("cubeCamera", CUBECAMBINDING);
+	scheduler_.invalidate();
 }
 
 std::string SolarSystemScene::objToString(Objects obj)
@@ -0,0 +1,127 @@
+#include <helpers/frameLog.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char MAGIC[6] = { 'B', 'H', 'V', 'L', 'O', 'G' };
+
+enum FrameFlags : uint8_t {
+	HAS_CAMERA = 1,
+	HAS_STATE = 2,
+};
+
+static void writeUInt(std::ostream& out, uint32_t value, int bytes) {
+	for (int i = 0; i < bytes; ++i)
+		out.put((char)((value >> (8 * i)) & 0xff));
+}
+
+static bool readUInt(std::istream& in, uint32_t& value, int bytes) {
+	value = 0;
+	for (int i = 0; i < bytes; ++i) {
+		int c = in.get();
+		if (c == EOF) return false;
+		value |= (uint32_t)(unsigned char)c << (8 * i);
+	}
+	return true;
+}
+
+static void writeFloat(std::ostream& out, float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	writeUInt(out, bits, 4);
+}
+
+static bool readFloat(std::istream& in, float& value) {
+	uint32_t bits;
+	if (!readUInt(in, bits, 4)) return false;
+	std::memcpy(&value, &bits, sizeof(value));
+	return true;
+}
+
+static void writeString(std::ostream& out, std::string const& s) {
+	writeUInt(out, (uint32_t)s.size(), 4);
+	out.write(s.data(), s.size());
+}
+
+static bool readString(std::istream& in, std::string& s) {
+	uint32_t length;
+	if (!readUInt(in, length, 4)) return false;
+	s.resize(length);
+	return (bool)in.read(s.data(), length);
+}
+
+double FrameLog::getDuration() const
+{
+	double duration = 0.0;
+	for (auto const& frame : frames_)
+		duration += frame.dt;
+	return duration;
+}
+
+bool FrameLog::write(std::string const& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "[FrameLog] can't write " << path << std::endl;
+		return false;
+	}
+
+	file.write(MAGIC, sizeof(MAGIC));
+	writeUInt(file, VERSION, 2);
+	writeUInt(file, (uint32_t)frames_.size(), 4);
+	for (auto const& frame : frames_) {
+		writeFloat(file, frame.dt);
+		writeFloat(file, frame.cpuMs);
+		writeFloat(file, frame.gpuMs);
+
+		uint8_t flags = (frame.camera.empty() ? 0 : HAS_CAMERA) | (frame.state.empty() ? 0 : HAS_STATE);
+		file.put((char)flags);
+		if (flags & HAS_CAMERA) writeString(file, frame.camera);
+		if (flags & HAS_STATE) writeString(file, frame.state);
+	}
+	return (bool)file;
+}
+
+bool FrameLog::read(std::string const& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "[FrameLog] can't read " << path << std::endl;
+		return false;
+	}
+
+	char magic[sizeof(MAGIC)];
+	uint32_t version, count;
+	if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+		|| !readUInt(file, version, 2)) {
+		std::cerr << "[FrameLog] " << path << " is not a frame log" << std::endl;
+		return false;
+	}
+	if (version != VERSION) {
+		std::cerr << "[FrameLog] " << path << " has version " << version << ", expected " << VERSION << std::endl;
+		return false;
+	}
+	if (!readUInt(file, count, 4)) {
+		std::cerr << "[FrameLog] " << path << " is truncated" << std::endl;
+		return false;
+	}
+
+	std::vector<Frame> frames;
+	for (uint32_t i = 0; i < count; ++i) {
+		Frame frame;
+		int flags = 0;
+		bool ok = readFloat(file, frame.dt) && readFloat(file, frame.cpuMs) && readFloat(file, frame.gpuMs)
+			&& (flags = file.get()) != EOF;
+		if (ok && (flags & HAS_CAMERA)) ok = readString(file, frame.camera);
+		if (ok && (flags & HAS_STATE)) ok = readString(file, frame.state);
+		if (!ok) {
+			std::cerr << "[FrameLog] " << path << " is truncated after " << i << " frames" << std::endl;
+			return false;
+		}
+		frames.push_back(std::move(frame));
+	}
+
+	frames_ = std::move(frames);
+	return true;
+}
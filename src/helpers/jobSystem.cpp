@@ -0,0 +1,106 @@
+#include <helpers/jobSystem.h>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+JobSystem::JobSystem(int threads)
+	: stop_(false)
+{
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+	running_.resize(threads);
+	for (int t = 0; t < threads; ++t)
+		workers_.emplace_back(&JobSystem::workerLoop, this, (size_t)t);
+}
+
+JobSystem::~JobSystem()
+{
+	std::vector<Entry> dropped;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+		for (auto& queue : queues_) {
+			for (auto& entry : queue)
+				dropped.push_back(std::move(entry));
+			queue.clear();
+		}
+		for (auto const& token : running_)
+			if (token) token->cancel();
+	}
+	jobAvailable_.notify_all();
+	for (auto& worker : workers_)
+		worker.join();
+
+	// handles of dropped jobs report done, nobody waits forever
+	for (auto& entry : dropped) {
+		entry.token.cancel();
+		entry.done->set_value();
+	}
+}
+
+JobHandle JobSystem::submit(Job job, JobPriority priority, CancellationToken const& token)
+{
+	auto done = std::make_shared<std::promise<void>>();
+	JobHandle handle(done->get_future().share(), token);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (stop_) {
+			token.cancel();
+			done->set_value();
+			return handle;
+		}
+		queues_[(int)priority].push_back({ std::move(job), token, done });
+	}
+	jobAvailable_.notify_one();
+	return handle;
+}
+
+size_t JobSystem::getQueuedCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t count = 0;
+	for (auto const& queue : queues_)
+		count += queue.size();
+	return count;
+}
+
+size_t JobSystem::getRunningCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return std::count_if(running_.begin(), running_.end(), [](auto const& token) { return token != nullptr; });
+}
+
+void JobSystem::workerLoop(size_t worker)
+{
+	while (true) {
+		Entry entry;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			running_[worker] = nullptr;
+			jobAvailable_.wait(lock, [this]() {
+				return stop_ || std::any_of(std::begin(queues_), std::end(queues_), [](auto const& queue) { return !queue.empty(); });
+			});
+			if (stop_) return;
+			for (auto& queue : queues_) {
+				if (queue.empty()) continue;
+				entry = std::move(queue.front());
+				queue.pop_front();
+				break;
+			}
+			// stale jobs are dropped without running
+			if (!entry.token.isCancelled())
+				running_[worker] = std::make_shared<CancellationToken>(entry.token);
+		}
+
+		if (!entry.token.isCancelled()) {
+			try {
+				entry.job(entry.token);
+			}
+			catch (std::exception const& e) {
+				std::cerr << "[JobSystem] job failed: " << e.what() << std::endl;
+			}
+		}
+		entry.done->set_value();
+	}
+}
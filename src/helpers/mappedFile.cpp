@@ -0,0 +1,82 @@
+#include <helpers/mappedFile.h>
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string const& path)
+	: data_(nullptr)
+	, size_(0)
+	, file_(INVALID_HANDLE_VALUE)
+	, mapping_(nullptr)
+{
+	file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) return;
+	mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping_) {
+		std::cerr << "[MappedFile] can't map " << path << std::endl;
+		return;
+	}
+	data_ = (unsigned char const*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	if (data_) size_ = (size_t)size.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping_) CloseHandle(mapping_);
+	if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(std::string const& path)
+	: data_(nullptr)
+	, size_(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			data_ = (unsigned char const*)data;
+			size_ = (size_t)st.st_size;
+		}
+		else {
+			std::cerr << "[MappedFile] can't map " << path << std::endl;
+		}
+	}
+	// the mapping stays valid without the descriptor
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data_) munmap((void*)data_, size_);
+}
+
+#endif
+
+void MappedFile::prefetch() const
+{
+	volatile unsigned char sink = 0;
+	for (size_t i = 0; i < size_; i += 4096)
+		sink = sink + data_[i];
+}
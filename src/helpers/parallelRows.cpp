@@ -0,0 +1,32 @@
+#include <helpers/parallelRows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+void parallelRows(int rows, int threads, std::function<void(int)> const& rowFunc)
+{
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	// not worth waking threads for small images
+	threads = std::min(threads, rows / 16 + 1);
+
+	if (threads == 1) {
+		for (int y = 0; y < rows; ++y) rowFunc(y);
+		return;
+	}
+
+	std::atomic<int> nextRow = 0;
+	auto worker = [&]() {
+		int y;
+		while ((y = nextRow++) < rows) rowFunc(y);
+	};
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; ++t)
+		workers.emplace_back(worker);
+	worker();
+	for (auto& w : workers)
+		w.join();
+}
@@ -0,0 +1,87 @@
+#include <helpers/profilerStats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+SampleHistory::SampleHistory(size_t capacity)
+	: capacity_(std::max<size_t>(capacity, 1))
+	, next_(0)
+{
+	samples_.reserve(capacity_);
+}
+
+void SampleHistory::add(double sample)
+{
+	if (samples_.size() < capacity_) {
+		samples_.push_back(sample);
+		return;
+	}
+	samples_[next_] = sample;
+	next_ = (next_ + 1) % capacity_;
+}
+
+void SampleHistory::clear()
+{
+	samples_.clear();
+	next_ = 0;
+}
+
+std::vector<double> SampleHistory::getSamples() const
+{
+	std::vector<double> samples(samples_.begin() + next_, samples_.end());
+	samples.insert(samples.end(), samples_.begin(), samples_.begin() + next_);
+	return samples;
+}
+
+SampleHistory::Stats SampleHistory::getStats() const
+{
+	Stats stats;
+	if (samples_.empty()) return stats;
+
+	stats.count = samples_.size();
+	stats.last = samples_[(next_ + samples_.size() - 1) % samples_.size()];
+
+	std::vector<double> sorted = samples_;
+	std::sort(sorted.begin(), sorted.end());
+	stats.min = sorted.front();
+	stats.median = percentile(sorted, 0.5);
+	stats.p95 = percentile(sorted, 0.95);
+	stats.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+	return stats;
+}
+
+double SampleHistory::percentile(std::vector<double> const& sorted, double p)
+{
+	double rank = std::clamp(p, 0.0, 1.0) * (sorted.size() - 1);
+	size_t lower = (size_t)std::floor(rank);
+	size_t upper = std::min(lower + 1, sorted.size() - 1);
+	return sorted[lower] + (rank - lower) * (sorted[upper] - sorted[lower]);
+}
+
+FrameRing::FrameRing(int depth)
+	: depth_(std::max(depth, 1))
+	, recording_(-1)
+	, frames_(0)
+	, dropped_(0)
+{}
+
+int FrameRing::begin()
+{
+	int slot = (int)(frames_ % depth_);
+	// only the oldest pending frame can use this slot
+	if (!pending_.empty() && pending_.front() == slot) {
+		pending_.pop_front();
+		++dropped_;
+	}
+	recording_ = slot;
+	return slot;
+}
+
+void FrameRing::end()
+{
+	if (recording_ < 0) return;
+	pending_.push_back(recording_);
+	recording_ = -1;
+	++frames_;
+}
@@ -5,6 +5,7 @@ Bloom::Bloom(int width, int height, int level)
 	: intensity_(0.5f)
 	, exposure_(1.f)
 	, highContrast_(false)
+	, compute_(false)
 	, maxLevels_(level)
 	, width_(width)
 	, height_(height)
@@ -20,6 +21,32 @@ void Bloom::begin() {
 }
 
 void Bloom::render(int fboId) {
+	GpuProfiler::Scope scope(profiler_, "bloom");
+	if (compute_ && levelSizes_.size() <= BLOOM_MAX_COMPUTE_LEVELS)
+		renderCompute();
+	else
+		renderRaster();
+
+	// final pass
+	GpuProfiler::Scope compositeScope(profiler_, "composite");
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glActiveTexture(GL_TEXTURE0);
+	source_->bind();
+	glActiveTexture(GL_TEXTURE1);
+	//filters_->setParam(GL_TEXTURE_BASE_LEVEL, 0);
+	filters_->bind();
+	glViewport(0, 0, width_, height_);
+	renderShader_->use();
+	renderShader_->setUniform("texDim", glm::vec2(width_, height_));
+	renderShader_->setUniform("intensity", intensity_);
+	renderShader_->setUniform("exposure", exposure_);
+	renderShader_->setUniform("high_contrast", highContrast_);
+
+	quad_.draw(GL_TRIANGLES);
+}
+
+void Bloom::renderRaster() {
+	if (profiler_) profiler_->begin("downsample");
 	source_->generateMipMap();
 	// bloom pass
 	glActiveTexture(GL_TEXTURE0);
@@ -35,8 +62,10 @@ void Bloom::render(int fboId) {
 		bloomShader_->setUniform("texDimLevel", glm::vec3(levelSizes_.at(i), i));
 		quad_.draw(GL_TRIANGLES);
 	}
+	if (profiler_) profiler_->end();
 	
 	// upsample pass
+	GpuProfiler::Scope upsampleScope(profiler_, "upsample");
 	glEnable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
 	glBlendFunc(GL_ONE, GL_ONE);
@@ -50,28 +79,50 @@ void Bloom::render(int fboId) {
 		quad_.draw(GL_TRIANGLES);
 	}
 	glDisable(GL_BLEND);
-	
-	// final pass
-	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+}
+
+void Bloom::renderCompute() {
+	int levels = (int)levelSizes_.size();
+	if (levels < 2) return;
+
+	// downsample pass, replaces generateMipMap
+	if (profiler_) profiler_->begin("downsample");
 	glActiveTexture(GL_TEXTURE0);
 	source_->bind();
+	for (int i = 1; i < levels; ++i)
+		glBindImageTexture(i - 1, source_->getTexId(), i, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	spdCounter_->bindBase(0);
+
+	downsampleComputeShader_->use();
+	downsampleComputeShader_->setUniform("levels", levels - 1);
+	downsampleComputeShader_->setUniform("texDim", glm::vec2(width_, height_));
+	// one workgroup per 32x32 pixels of level 1
+	glm::ivec2 level1(levelSizes_.at(1));
+	glDispatchCompute((level1.x + 31) / 32, (level1.y + 31) / 32, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	if (profiler_) profiler_->end();
+
+	// blur + upsample pass, coarse to fine
+	GpuProfiler::Scope upsampleScope(profiler_, "upsample");
 	glActiveTexture(GL_TEXTURE1);
-	//filters_->setParam(GL_TEXTURE_BASE_LEVEL, 0);
 	filters_->bind();
-	glViewport(0, 0, width_, height_);
-	renderShader_->use();
-	renderShader_->setUniform("texDim", glm::vec2(width_, height_));
-	renderShader_->setUniform("intensity", intensity_);
-	renderShader_->setUniform("exposure", exposure_);
-	renderShader_->setUniform("high_contrast", highContrast_);
-
-	quad_.draw(GL_TRIANGLES);
+	upsampleComputeShader_->use();
+	for (int i = levels - 1; i >= 1; --i) {
+		glm::ivec2 size(levelSizes_.at(i));
+		glBindImageTexture(0, filters_->getTexId(), i, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		upsampleComputeShader_->setUniform("texDimLevel", glm::vec3(levelSizes_.at(i), i));
+		upsampleComputeShader_->setUniform("coarsest", i == levels - 1);
+		glDispatchCompute((size.x + 15) / 16, (size.y + 15) / 16, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
 }
 
 void Bloom::reload() {
 	upsampleShader_->reload();
 	bloomShader_->reload();
 	renderShader_->reload();
+	downsampleComputeShader_->reload();
+	upsampleComputeShader_->reload();
 }
 
 void Bloom::resize(int width, int height) {
@@ -95,6 +146,7 @@ void Bloom::storeConfig(boost::json::object& obj){
 	obj["intensity"] = intensity_;
 	obj["exposure"] = exposure_;
 	obj["highContrast"] = highContrast_;
+	obj["compute"] = compute_;
 	obj["maxLevels"] = maxLevels_;
 	obj["width"] = width_;
 	obj["height"] = height_;
@@ -104,6 +156,7 @@ void Bloom::loadConfig(boost::json::object& obj){
 	jhelper::getValue(obj, "intensity", intensity_);
 	jhelper::getValue(obj, "exposure", exposure_);
 	jhelper::getValue(obj, "highContrast", highContrast_);
+	jhelper::getValue(obj, "compute", compute_);
 	jhelper::getValue(obj, "maxLevels", maxLevels_);
 	jhelper::getValue(obj, "width", width_);
 	jhelper::getValue(obj, "height", height_);
@@ -116,6 +169,11 @@ void Bloom::initShaders() {
 	upsampleShader_ = std::make_shared<Shader>("squad.vs", "bloom_upsample.frag");
 	bloomShader_ = std::make_shared<Shader>("squad.vs", "bloom.frag");
 	renderShader_ = std::make_shared<Shader>("squad.vs", "bloom_render.frag");
+	downsampleComputeShader_ = std::make_shared<ComputeShader>("bloom_downsample.comp");
+	upsampleComputeShader_ = std::make_shared<ComputeShader>("bloom_upsample.comp");
+
+	unsigned int zero = 0;
+	spdCounter_ = std::make_shared<SSBO>(sizeof(unsigned int), &zero, GL_DYNAMIC_COPY);
 }
 
 void Bloom::initFBOS() {
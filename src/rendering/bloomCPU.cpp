@@ -0,0 +1,246 @@
+#include <rendering/bloomCPU.h>
+#include <helpers/json_helper.h>
+#include <helpers/parallelRows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// same kernel as bloom.frag
+static const float gaussWeights[25] = {
+	0.003765f, 0.015019f, 0.023792f, 0.015019f, 0.003765f,
+	0.015019f, 0.059912f, 0.094907f, 0.059912f, 0.015019f,
+	0.023792f, 0.094907f, 0.150342f, 0.094907f, 0.023792f,
+	0.015019f, 0.059912f, 0.094907f, 0.059912f, 0.015019f,
+	0.003765f, 0.015019f, 0.023792f, 0.015019f, 0.003765f
+};
+
+// largest half float, the bloom shaders clamp to it
+static const float maxHalf = 6.55e4f;
+
+// ACES tone map, see bloom_render.frag
+static float toneMapACES(float color) {
+	const float A = 2.51f;
+	const float B = 0.03f;
+	const float C = 2.43f;
+	const float D = 0.59f;
+	const float E = 0.14f;
+	color = (color * (A * color + B)) / (color * (C * color + D) + E);
+	return std::pow(color, 1.f / 2.2f);
+}
+
+BloomCPU::BloomCPU(int level, int threads)
+	: intensity_(0.5f)
+	, exposure_(1.f)
+	, highContrast_(false)
+	, maxLevels_(level)
+	, threads_(threads)
+	, width_(0)
+	, height_(0)
+	, renderTime_(0.0)
+{}
+
+std::vector<float> BloomCPU::render(float const* source, int width, int height) {
+	std::vector<float> out((size_t)width * height * 4, 0.f);
+	if (width < 1 || height < 1) {
+		std::cerr << "[BloomCPU] invalid image size " << width << "x" << height << std::endl;
+		return out;
+	}
+
+	auto start_time = std::chrono::high_resolution_clock::now();
+
+	width_ = width;
+	height_ = height;
+	initLevels(source);
+	int levels = (int)mips_.size();
+
+	// mip chain
+	for (int i = 1; i < levels; ++i)
+		parallelRows(mips_[i].height, threads_, [&](int y) { downsampleRow(mips_[i - 1], mips_[i], y); });
+
+	// bloom pass
+	for (int i = 1; i < levels; ++i)
+		parallelRows(filters_[i].height, threads_, [&](int y) { gaussRow(mips_[i], filters_[i], y); });
+
+	// upsample pass
+	for (int i = levels - 2; i >= 1; --i) {
+		Taps tapsX = bilinearTaps(filters_[i + 1].width, filters_[i].width);
+		Taps tapsY = bilinearTaps(filters_[i + 1].height, filters_[i].height);
+		parallelRows(filters_[i].height, threads_, [&](int y) { upsampleRow(filters_[i + 1], filters_[i], tapsX, tapsY, y); });
+	}
+
+	// final pass
+	Level const& filter = filters_[std::min(1, levels - 1)];
+	Taps tapsX = bilinearTaps(filter.width, width_);
+	Taps tapsY = bilinearTaps(filter.height, height_);
+	parallelRows(height_, threads_, [&](int y) { compositeRow(filter, out.data(), tapsX, tapsY, y); });
+
+	auto end_time = std::chrono::high_resolution_clock::now();
+	renderTime_ = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+
+	return out;
+}
+
+double BloomCPU::getMPixelsPerSecond() const {
+	if (renderTime_ <= 0.0) return 0.0;
+	return (double)width_ * height_ / (renderTime_ * 1e3);
+}
+
+void BloomCPU::storeConfig(boost::json::object& obj) {
+	obj["intensity"] = intensity_;
+	obj["exposure"] = exposure_;
+	obj["highContrast"] = highContrast_;
+	obj["maxLevels"] = maxLevels_;
+}
+
+void BloomCPU::loadConfig(boost::json::object& obj) {
+	jhelper::getValue(obj, "intensity", intensity_);
+	jhelper::getValue(obj, "exposure", exposure_);
+	jhelper::getValue(obj, "highContrast", highContrast_);
+	jhelper::getValue(obj, "maxLevels", maxLevels_);
+}
+
+float BloomCPU::maxDifference(std::vector<float> const& a, std::vector<float> const& b) {
+	if (a.size() != b.size()) {
+		std::cerr << "[BloomCPU] can't compare images of different size" << std::endl;
+		return INFINITY;
+	}
+
+	float diff = 0.f;
+	for (size_t i = 0; i < a.size(); i += 4) {
+		diff = std::max({ diff,
+			std::abs(a[i] - b[i]),
+			std::abs(a[i + 1] - b[i + 1]),
+			std::abs(a[i + 2] - b[i + 2]) });
+	}
+	return diff;
+}
+
+void BloomCPU::initLevels(float const* source) {
+	// same level count as Bloom::initLevels
+	std::vector<std::pair<int, int>> sizes;
+	int level = 0;
+	int w = width_, h = height_;
+	while (h > 2 && w > 2 && level < maxLevels_) {
+		sizes.push_back({ w,h });
+		w = w / 2;
+		h = h / 2;
+		++level;
+	}
+	if (sizes.empty()) sizes.push_back({ width_, height_ });
+
+	// keep allocations between frames of the same size
+	mips_.resize(sizes.size());
+	filters_.resize(sizes.size());
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		for (Level* l : { &mips_[i], &filters_[i] }) {
+			l->width = sizes[i].first;
+			l->height = sizes[i].second;
+			l->pixels.resize((size_t)l->width * l->height * 4);
+		}
+	}
+	filters_[0].pixels.clear();
+	std::copy(source, source + mips_[0].pixels.size(), mips_[0].pixels.begin());
+}
+
+BloomCPU::Taps BloomCPU::bilinearTaps(int srcSize, int dstSize) {
+	Taps taps;
+	taps.t0.resize(dstSize);
+	taps.t1.resize(dstSize);
+	taps.w.resize(dstSize);
+	for (int x = 0; x < dstSize; ++x) {
+		// texel coordinate of the pixel center uv = (x + 0.5) / dstSize
+		float t = (x + 0.5f) / dstSize * srcSize - 0.5f;
+		float f = std::floor(t);
+		taps.t0[x] = std::clamp((int)f, 0, srcSize - 1);
+		taps.t1[x] = std::clamp((int)f + 1, 0, srcSize - 1);
+		taps.w[x] = t - f;
+	}
+	return taps;
+}
+
+void BloomCPU::downsampleRow(Level const& src, Level& dst, int y) const {
+	float const* r0 = src.row(2 * y);
+	float const* r1 = src.row(2 * y + 1);
+	float* out = dst.row(y);
+	for (int x = 0; x < dst.width; ++x) {
+		for (int c = 0; c < 4; ++c) {
+			out[4 * x + c] = 0.25f * (r0[8 * x + c] + r0[8 * x + 4 + c] + r1[8 * x + c] + r1[8 * x + 4 + c]);
+		}
+	}
+}
+
+void BloomCPU::gaussRow(Level const& src, Level& dst, int y) const {
+	int w = src.width;
+	float* __restrict out = dst.row(y);
+	std::fill(out, out + 4 * w, 0.f);
+
+	// the shader samples texel centers, so every tap is a plain fetch with clamp to edge
+	// columns [2, w - 2) don't need clamping, the loop over them is contiguous and vectorises
+	int lo = std::min(2, w), hi = std::max(lo, w - 2);
+	for (int j = 0; j < 5; ++j) {
+		float const* in = src.row(std::clamp(y + j - 2, 0, src.height - 1));
+		for (int i = 0; i < 5; ++i) {
+			float weight = gaussWeights[i * 5 + j];
+			int dx = i - 2;
+
+			float const* __restrict shifted = in + 4 * dx;
+			for (int k = 4 * lo; k < 4 * hi; ++k)
+				out[k] += weight * shifted[k];
+
+			for (int x = 0; x < w; x = (x + 1 == lo) ? hi : x + 1) {
+				int sx = std::clamp(x + dx, 0, w - 1);
+				for (int c = 0; c < 4; ++c)
+					out[4 * x + c] += weight * in[4 * sx + c];
+			}
+		}
+	}
+
+	for (int x = 0; x < w; ++x) {
+		for (int c = 0; c < 3; ++c)
+			out[4 * x + c] = std::min(out[4 * x + c], maxHalf);
+		out[4 * x + 3] = 1.f;
+	}
+}
+
+void BloomCPU::upsampleRow(Level const& coarse, Level& fine, Taps const& tapsX, Taps const& tapsY, int y) const {
+	float* out = fine.row(y);
+	float const* r0 = coarse.row(tapsY.t0[y]);
+	float const* r1 = coarse.row(tapsY.t1[y]);
+	float wy = tapsY.w[y];
+	for (int x = 0; x < fine.width; ++x) {
+		int x0 = 4 * tapsX.t0[x], x1 = 4 * tapsX.t1[x];
+		float wx = tapsX.w[x];
+		for (int c = 0; c < 3; ++c) {
+			float top = r0[x0 + c] * (1.f - wx) + r0[x1 + c] * wx;
+			float bottom = r1[x0 + c] * (1.f - wx) + r1[x1 + c] * wx;
+			// additive blending of the clamped upsample output
+			out[4 * x + c] += std::min(top * (1.f - wy) + bottom * wy, maxHalf);
+		}
+	}
+}
+
+void BloomCPU::compositeRow(Level const& filter, float* out, Taps const& tapsX, Taps const& tapsY, int y) const {
+	float const* src = mips_[0].row(y);
+	out += (size_t)y * width_ * 4;
+	bool hasBloom = !filter.pixels.empty();
+	float const* r0 = hasBloom ? filter.row(tapsY.t0[y]) : nullptr;
+	float const* r1 = hasBloom ? filter.row(tapsY.t1[y]) : nullptr;
+	float wy = tapsY.w[y];
+	for (int x = 0; x < width_; ++x) {
+		int x0 = 4 * tapsX.t0[x], x1 = 4 * tapsX.t1[x];
+		float wx = tapsX.w[x];
+		for (int c = 0; c < 3; ++c) {
+			float bloom = 0.f;
+			if (hasBloom) {
+				float top = r0[x0 + c] * (1.f - wx) + r0[x1 + c] * wx;
+				float bottom = r1[x0 + c] * (1.f - wx) + r1[x1 + c] * wx;
+				bloom = top * (1.f - wy) + bottom * wy;
+			}
+			float color = (src[4 * x + c] * (1.f - intensity_) + bloom * intensity_) * exposure_;
+			out[4 * x + c] = toneMapACES(std::min(color, 10.f));
+		}
+		out[4 * x + 3] = 1.f;
+	}
+}
@@ -0,0 +1,252 @@
+#include <rendering/gpuProfiler.h>
+
+#include <helpers/RootDir.h>
+#include <gui/gui.h>
+
+#include <boost/json.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+GpuProfiler::Scope::Scope(std::shared_ptr<GpuProfiler> const& profiler, std::string const& name)
+	: profiler_(profiler.get())
+{
+	if (profiler_) profiler_->begin(name);
+}
+
+GpuProfiler::Scope::~Scope()
+{
+	if (profiler_) profiler_->end();
+}
+
+GpuProfiler::GpuProfiler(int depth, size_t historySize)
+	: enabled_(true)
+	, ring_(depth)
+	, slots_(ring_.getDepth())
+	, current_(-1)
+	, historySize_(historySize)
+{}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (auto& slot : slots_) {
+		if (!slot.queries.empty())
+			glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+	}
+}
+
+void GpuProfiler::beginFrame()
+{
+	ring_.collect([this](int slot) { return isReady(slot); }, [this](int slot) { readSlot(slot); });
+	if (!enabled_) return;
+
+	current_ = ring_.begin();
+	// a dropped frame is simply overwritten
+	slots_[current_].used = 0;
+	slots_[current_].records.clear();
+	slots_[current_].frame = ring_.getFrameCount();
+	stack_.clear();
+	measured_.clear();
+	begin("frame");
+}
+
+void GpuProfiler::endFrame()
+{
+	if (current_ < 0) return;
+	if (measured_.size() != 1) {
+		std::cerr << "[GpuProfiler] " << measured_.size() - 1 << " scopes not ended in this frame" << std::endl;
+		while (measured_.size() > 1) end();
+	}
+	end();
+	current_ = -1;
+	ring_.end();
+}
+
+bool GpuProfiler::begin(std::string const& name)
+{
+	if (current_ < 0) {
+		measured_.push_back(false);
+		return false;
+	}
+
+	Slot& slot = slots_[current_];
+	Record record;
+	// the passes aren't prefixed with the "frame" pass around them
+	record.pass = stack_.size() <= 1 ? name : slot.records[stack_.back()].pass + "/" + name;
+	record.begin = queryCounter(slot);
+	record.end = record.begin;
+
+	stack_.push_back(slot.records.size());
+	slot.records.push_back(record);
+	measured_.push_back(true);
+	return true;
+}
+
+void GpuProfiler::end()
+{
+	if (measured_.empty()) {
+		std::cerr << "[GpuProfiler] end without begin" << std::endl;
+		return;
+	}
+	bool measured = measured_.back();
+	measured_.pop_back();
+	if (!measured || current_ < 0) return;
+
+	Slot& slot = slots_[current_];
+	slot.records[stack_.back()].end = queryCounter(slot);
+	stack_.pop_back();
+}
+
+SampleHistory::Stats GpuProfiler::getStats(std::string const& pass) const
+{
+	auto it = history_.find(pass);
+	return it == history_.end() ? SampleHistory::Stats() : it->second.getStats();
+}
+
+SampleHistory const* GpuProfiler::getHistory(std::string const& pass) const
+{
+	auto it = history_.find(pass);
+	return it == history_.end() ? nullptr : &it->second;
+}
+
+void GpuProfiler::clear()
+{
+	for (auto& [pass, history] : history_)
+		history.clear();
+}
+
+bool GpuProfiler::exportCSV(std::string const& path) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::cerr << "[GpuProfiler] can't write " << path << std::endl;
+		return false;
+	}
+
+	file << "pass,count,last_ms,min_ms,median_ms,p95_ms,mean_ms\n";
+	file << std::fixed << std::setprecision(4);
+	for (auto const& pass : passes_) {
+		SampleHistory::Stats stats = getStats(pass);
+		file << pass << "," << stats.count << "," << stats.last << "," << stats.min << ","
+			<< stats.median << "," << stats.p95 << "," << stats.mean << "\n";
+	}
+	return (bool)file;
+}
+
+bool GpuProfiler::exportJSON(std::string const& path) const
+{
+	boost::json::array passes;
+	for (auto const& pass : passes_) {
+		SampleHistory::Stats stats = getStats(pass);
+		boost::json::array samples;
+		for (double sample : history_.at(pass).getSamples())
+			samples.push_back(sample);
+
+		boost::json::object object;
+		object["pass"] = pass;
+		object["count"] = stats.count;
+		object["last_ms"] = stats.last;
+		object["min_ms"] = stats.min;
+		object["median_ms"] = stats.median;
+		object["p95_ms"] = stats.p95;
+		object["mean_ms"] = stats.mean;
+		object["samples_ms"] = samples;
+		passes.push_back(object);
+	}
+
+	boost::json::object profile;
+	profile["frames"] = ring_.getFrameCount();
+	profile["dropped_frames"] = ring_.getDroppedCount();
+	profile["passes"] = passes;
+
+	std::ofstream file(path);
+	if (!file) {
+		std::cerr << "[GpuProfiler] can't write " << path << std::endl;
+		return false;
+	}
+	file << boost::json::serialize(profile);
+	return (bool)file;
+}
+
+void GpuProfiler::renderWindow(bool* open)
+{
+	ImGui::Begin("GPU Profiler", open);
+	ImGui::Checkbox("Enabled", &enabled_);
+	ImGui::SameLine();
+	if (ImGui::Button("Clear")) clear();
+	ImGui::SameLine();
+	if (ImGui::Button("Export CSV")) exportCSV(ROOT_DIR "data/gpu_profile.csv");
+	ImGui::SameLine();
+	if (ImGui::Button("Export JSON")) exportJSON(ROOT_DIR "data/gpu_profile.json");
+	ImGui::Text("dropped frames: %llu", (unsigned long long)ring_.getDroppedCount());
+
+	if (ImGui::BeginTable("Passes", 5)) {
+		ImGui::TableSetupColumn("pass");
+		ImGui::TableSetupColumn("last ms");
+		ImGui::TableSetupColumn("min ms");
+		ImGui::TableSetupColumn("median ms");
+		ImGui::TableSetupColumn("p95 ms");
+		ImGui::TableHeadersRow();
+
+		for (auto const& pass : passes_) {
+			SampleHistory::Stats stats = getStats(pass);
+			// indent nested passes by their depth
+			size_t depth = std::count(pass.begin(), pass.end(), '/');
+			std::string name = std::string(2 * depth, ' ') + pass.substr(pass.rfind('/') + 1);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", name.c_str());
+			for (double value : { stats.last, stats.min, stats.median, stats.p95 }) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", value);
+			}
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
+
+size_t GpuProfiler::queryCounter(Slot& slot)
+{
+	if (slot.used == slot.queries.size()) {
+		GLuint query;
+		glGenQueries(1, &query);
+		slot.queries.push_back(query);
+	}
+	glQueryCounter(slot.queries[slot.used], GL_TIMESTAMP);
+	return slot.used++;
+}
+
+bool GpuProfiler::isReady(int slot) const
+{
+	Slot const& s = slots_[slot];
+	if (s.used == 0) return true;
+	// queries finish in order, the last one is the end of the frame
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(s.queries[s.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	return available == GL_TRUE;
+}
+
+void GpuProfiler::readSlot(int slot)
+{
+	Slot const& s = slots_[slot];
+	std::vector<GLuint64> times(s.used);
+	for (size_t i = 0; i < s.used; ++i)
+		glGetQueryObjectui64v(s.queries[i], GL_QUERY_RESULT, &times[i]);
+
+	// a pass measured several times in a frame counts once with the sum
+	std::map<std::string, double> frameTimes;
+	for (auto const& record : s.records) {
+		if (history_.find(record.pass) == history_.end()) {
+			passes_.push_back(record.pass);
+			history_.emplace(record.pass, SampleHistory(historySize_));
+		}
+		frameTimes[record.pass] += (times[record.end] - times[record.begin]) * 1e-6;
+	}
+	for (auto const& [pass, time] : frameTimes)
+		history_.at(pass).add(time);
+	if (frameCallback_) frameCallback_(s.frame, frameTimes);
+}
@@ -0,0 +1,124 @@
+#include <rendering/icosphere.h>
+#include <rendering/meshOptimizer.h>
+
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <unordered_map>
+
+Icosphere::Icosphere(int subdivisions)
+	: Mesh() {
+	has_texCoords_ = true;
+	generate(subdivisions, vertices_, indices_);
+	createMesh();
+}
+
+void Icosphere::generate(int subdivisions, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	// icosahedron with a vertex on each pole and two rings of five vertices
+	std::vector<glm::vec3> positions{ { 0.f, 1.f, 0.f } };
+	float ringY = 1.f / std::sqrt(5.f);
+	float ringR = 2.f / std::sqrt(5.f);
+	for (int ring = 0; ring < 2; ++ring) {
+		for (int i = 0; i < 5; ++i) {
+			float angle = glm::two_pi<float>() * (i + 0.5f * ring) / 5.f;
+			positions.push_back({ ringR * std::cos(angle), ring == 0 ? ringY : -ringY, ringR * std::sin(angle) });
+		}
+	}
+	positions.push_back({ 0.f, -1.f, 0.f });
+
+	std::vector<unsigned int> triangles;
+	for (unsigned int i = 0; i < 5; ++i) {
+		unsigned int upper = 1 + i, upperNext = 1 + (i + 1) % 5;
+		unsigned int lower = 6 + i, lowerNext = 6 + (i + 1) % 5;
+		triangles.insert(triangles.end(), {
+			0, upper, upperNext,
+			upper, lower, upperNext,
+			upperNext, lower, lowerNext,
+			lower, 11, lowerNext
+		});
+	}
+
+	for (int s = 0; s < subdivisions; ++s) {
+		// edge midpoints are shared by the two adjacent triangles
+		std::unordered_map<uint64_t, unsigned int> midpoints;
+		auto midpoint = [&](unsigned int a, unsigned int b) {
+			uint64_t key = (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+			auto it = midpoints.find(key);
+			if (it != midpoints.end()) return it->second;
+			positions.push_back(glm::normalize(positions[a] + positions[b]));
+			unsigned int id = (unsigned int)positions.size() - 1;
+			midpoints.insert({ key, id });
+			return id;
+		};
+
+		std::vector<unsigned int> refined;
+		refined.reserve(triangles.size() * 4);
+		for (size_t t = 0; t < triangles.size(); t += 3) {
+			unsigned int a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+			unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			refined.insert(refined.end(), { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca });
+		}
+		triangles = std::move(refined);
+	}
+
+	// uv mapping of sphere.obj
+	auto uvCoord = [](glm::vec3 const& p) {
+		return glm::vec2(
+			0.5f - std::atan2(p.z, p.x) / glm::two_pi<float>(),
+			0.5f + std::asin(glm::clamp(p.y, -1.f, 1.f)) / glm::pi<float>());
+	};
+
+	vertices.clear();
+	indices.clear();
+	for (auto const& p : positions)
+		vertices.push_back({ p, uvCoord(p) });
+
+	// copies of vertices left of the seam with u + 1
+	std::unordered_map<unsigned int, unsigned int> wrapped;
+	for (size_t t = 0; t < triangles.size(); t += 3) {
+		unsigned int tri[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+
+		// counter clockwise seen from outside
+		glm::vec3 a = positions[tri[0]], b = positions[tri[1]], c = positions[tri[2]];
+		if (glm::dot(glm::cross(b - a, c - a), a + b + c) < 0.f)
+			std::swap(tri[1], tri[2]);
+
+		float uMin = 1.f, uMax = 0.f;
+		for (unsigned int v : tri) {
+			if (std::abs(positions[v].y) > 0.9999f) continue;
+			uMin = std::min(uMin, vertices[v].uvCoord.x);
+			uMax = std::max(uMax, vertices[v].uvCoord.x);
+		}
+		if (uMax - uMin > 0.5f) {
+			for (unsigned int& v : tri) {
+				if (std::abs(positions[v].y) > 0.9999f || vertices[v].uvCoord.x >= 0.5f) continue;
+				auto it = wrapped.find(v);
+				if (it == wrapped.end()) {
+					vertices.push_back({ positions[v], vertices[v].uvCoord + glm::vec2(1.f, 0.f) });
+					it = wrapped.insert({ v, (unsigned int)vertices.size() - 1 }).first;
+				}
+				v = it->second;
+			}
+		}
+
+		// the poles get one vertex per triangle, in the middle of the other two u coordinates
+		for (int k = 0; k < 3; ++k) {
+			unsigned int& v = tri[k];
+			if (std::abs(positions[v].y) <= 0.9999f) continue;
+			float u = 0.5f * (vertices[tri[(k + 1) % 3]].uvCoord.x + vertices[tri[(k + 2) % 3]].uvCoord.x);
+			vertices.push_back({ positions[v], glm::vec2(u, vertices[v].uvCoord.y) });
+			v = (unsigned int)vertices.size() - 1;
+		}
+
+		indices.insert(indices.end(), tri, tri + 3);
+	}
+
+	MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+	size_t used = 0;
+	std::vector<unsigned int> remap = MeshOptimizer::optimizeVertexFetch(indices, vertices.size(), used);
+	std::vector<Vertex> ordered(used);
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		if (remap[v] < used) ordered[remap[v]] = vertices[v];
+	}
+	vertices = std::move(ordered);
+}
@@ -0,0 +1,219 @@
+#include <rendering/instancedSpheres.h>
+#include <rendering/icosphere.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// has to match MAX_LODS in instanceLod.comp
+#define MAX_SPHERE_LODS 8
+
+InstancedSpheres::InstancedSpheres(int lodCount, int maxSubdivisions)
+	: minPixels_(0.25f)
+	, instanceCount_(0)
+	, instanceCapacity_(0)
+	, vao_(0), vbo_(0), ebo_(0)
+	, instanceBuffer_(0), commandBuffer_(0), visibleBuffer_(0)
+	, textureArray_(0)
+{
+	lodCount = glm::clamp(lodCount, 1, std::min(MAX_SPHERE_LODS, maxSubdivisions + 1));
+	for (int i = 0; i < lodCount; ++i)
+		lods_.push_back({ maxSubdivisions - i, 0, 0, 0 });
+
+	// every level has a quarter of the triangles of the previous one,
+	// switch when the triangles get about as small as a few pixels
+	float pixels = 256.f;
+	for (int i = 0; i < lodCount - 1; ++i, pixels /= 4.f)
+		lodPixels_.push_back(pixels);
+
+	initMeshes(maxSubdivisions);
+
+	glCreateBuffers(1, &commandBuffer_);
+	auto commands = emptyCommands();
+	glNamedBufferStorage(commandBuffer_, commands.size() * sizeof(DrawCommand), commands.data(), GL_DYNAMIC_STORAGE_BIT);
+
+	resizeInstanceBuffers(1024);
+
+	lodShader_ = std::make_shared<ComputeShader>("cubeMapScene/instanceLod.comp");
+}
+
+InstancedSpheres::~InstancedSpheres() {
+	glDeleteBuffers(1, &vbo_);
+	glDeleteBuffers(1, &ebo_);
+	glDeleteBuffers(1, &instanceBuffer_);
+	glDeleteBuffers(1, &commandBuffer_);
+	glDeleteBuffers(1, &visibleBuffer_);
+	glDeleteTextures(1, &textureArray_);
+	glDeleteVertexArrays(1, &vao_);
+}
+
+InstancedSpheres::Instance InstancedSpheres::makeInstance(glm::mat4 const& model, glm::vec3 color, int textureLayer) {
+	Instance instance;
+	instance.model_ = model;
+	instance.color_ = glm::vec4(color, (float)textureLayer);
+	float radius = glm::max(glm::length(glm::vec3(model[0])),
+		glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	instance.sphere_ = glm::vec4(glm::vec3(model[3]), radius);
+	return instance;
+}
+
+void InstancedSpheres::setInstances(std::vector<Instance> const& instances) {
+	if (instances.size() > instanceCapacity_) {
+		size_t capacity = instanceCapacity_;
+		while (capacity < instances.size()) capacity *= 2;
+		resizeInstanceBuffers(capacity);
+	}
+	instanceCount_ = instances.size();
+	glNamedBufferSubData(instanceBuffer_, 0, instanceCount_ * sizeof(Instance), instances.data());
+}
+
+void InstancedSpheres::setTextures(std::vector<std::shared_ptr<Texture2D>> const& textures, int width, int height) {
+	glDeleteTextures(1, &textureArray_);
+	textureArray_ = 0;
+	if (textures.empty()) return;
+
+	int levels = 1 + (int)std::floor(std::log2(std::max(width, height)));
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureArray_);
+	glTextureStorage3D(textureArray_, levels, GL_RGBA8, width, height, (GLsizei)textures.size());
+
+	// scale every texture into its layer
+	GLuint fbos[2];
+	glCreateFramebuffers(2, fbos);
+	for (int layer = 0; layer < textures.size(); ++layer) {
+		auto const& tex = textures.at(layer);
+		glNamedFramebufferTexture(fbos[0], GL_COLOR_ATTACHMENT0, tex->getTexId(), 0);
+		glNamedFramebufferTextureLayer(fbos[1], GL_COLOR_ATTACHMENT0, textureArray_, 0, layer);
+		if (glCheckNamedFramebufferStatus(fbos[0], GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE
+			|| glCheckNamedFramebufferStatus(fbos[1], GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "[InstancedSpheres] can't copy texture " << layer << " into the texture array" << std::endl;
+			continue;
+		}
+		glBlitNamedFramebuffer(fbos[0], fbos[1],
+			0, 0, tex->getWidth(), tex->getHeight(),
+			0, 0, width, height,
+			GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+	glDeleteFramebuffers(2, fbos);
+
+	glTextureParameteri(textureArray_, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(textureArray_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(textureArray_, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(textureArray_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenerateTextureMipmap(textureArray_);
+}
+
+void InstancedSpheres::update(glm::vec3 camPos, float pixelScale) {
+	// reset the instance counts, the compute pass appends the visible instances
+	auto commands = emptyCommands();
+	glNamedBufferSubData(commandBuffer_, 0, commands.size() * sizeof(DrawCommand), commands.data());
+	if (instanceCount_ == 0) return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMAND_BINDING, commandBuffer_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_INSTANCE_BINDING, visibleBuffer_);
+
+	lodShader_->use();
+	lodShader_->setUniform("cam_pos", camPos);
+	lodShader_->setUniform("pixel_scale", pixelScale);
+	lodShader_->setUniform("min_pixels", minPixels_);
+	lodShader_->setUniform("instance_count", (int)instanceCount_);
+	lodShader_->setUniform("lod_count", (int)lods_.size());
+	for (int i = 0; i < lodPixels_.size(); ++i)
+		lodShader_->setUniform("lod_pixels[" + std::to_string(i) + "]", lodPixels_.at(i));
+
+	glDispatchCompute(((GLuint)instanceCount_ + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void InstancedSpheres::draw() const {
+	if (instanceCount_ == 0) return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer_);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray_);
+
+	glBindVertexArray(vao_);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer_);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei)lods_.size(), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void InstancedSpheres::reloadShaders() {
+	lodShader_->reload();
+}
+
+std::vector<unsigned int> InstancedSpheres::getLodInstanceCounts() const {
+	std::vector<DrawCommand> commands(lods_.size());
+	glGetNamedBufferSubData(commandBuffer_, 0, commands.size() * sizeof(DrawCommand), commands.data());
+	std::vector<unsigned int> counts;
+	for (auto const& cmd : commands)
+		counts.push_back(cmd.instanceCount);
+	return counts;
+}
+
+void InstancedSpheres::initMeshes(int maxSubdivisions) {
+	// all levels in one vertex and index buffer
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	for (auto& lod : lods_) {
+		std::vector<Vertex> lodVertices;
+		std::vector<unsigned int> lodIndices;
+		Icosphere::generate(lod.subdivisions, lodVertices, lodIndices);
+
+		lod.firstIndex = (GLuint)indices.size();
+		lod.indexCount = (GLuint)lodIndices.size();
+		lod.baseVertex = (GLint)vertices.size();
+		vertices.insert(vertices.end(), lodVertices.begin(), lodVertices.end());
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
+	glCreateVertexArrays(1, &vao_);
+	glCreateBuffers(1, &vbo_);
+	glCreateBuffers(1, &ebo_);
+	glNamedBufferStorage(vbo_, vertices.size() * sizeof(Vertex), vertices.data(), 0);
+	glNamedBufferStorage(ebo_, indices.size() * sizeof(unsigned int), indices.data(), 0);
+
+	glVertexArrayVertexBuffer(vao_, 0, vbo_, 0, sizeof(Vertex));
+	glVertexArrayElementBuffer(vao_, ebo_);
+
+	glEnableVertexArrayAttrib(vao_, 0);
+	glVertexArrayAttribFormat(vao_, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+	glVertexArrayAttribBinding(vao_, 0, 0);
+	glEnableVertexArrayAttrib(vao_, 1);
+	glVertexArrayAttribFormat(vao_, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uvCoord));
+	glVertexArrayAttribBinding(vao_, 1, 0);
+
+	// instance index, advances once per instance starting at the base instance of the draw
+	glEnableVertexArrayAttrib(vao_, 2);
+	glVertexArrayAttribIFormat(vao_, 2, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(vao_, 2, 1);
+	glVertexArrayBindingDivisor(vao_, 1, 1);
+}
+
+void InstancedSpheres::resizeInstanceBuffers(size_t capacity) {
+	glDeleteBuffers(1, &instanceBuffer_);
+	glDeleteBuffers(1, &visibleBuffer_);
+	instanceCapacity_ = capacity;
+
+	glCreateBuffers(1, &instanceBuffer_);
+	glNamedBufferStorage(instanceBuffer_, capacity * sizeof(Instance), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	// one region of capacity indices per level
+	glCreateBuffers(1, &visibleBuffer_);
+	glNamedBufferStorage(visibleBuffer_, lods_.size() * capacity * sizeof(GLuint), nullptr, 0);
+	glVertexArrayVertexBuffer(vao_, 1, visibleBuffer_, 0, sizeof(GLuint));
+
+	auto commands = emptyCommands();
+	glNamedBufferSubData(commandBuffer_, 0, commands.size() * sizeof(DrawCommand), commands.data());
+}
+
+std::vector<InstancedSpheres::DrawCommand> InstancedSpheres::emptyCommands() const {
+	std::vector<DrawCommand> commands;
+	for (int i = 0; i < lods_.size(); ++i) {
+		auto const& lod = lods_.at(i);
+		commands.push_back({ lod.indexCount, 0, lod.firstIndex, lod.baseVertex, (GLuint)(i * instanceCapacity_) });
+	}
+	return commands;
+}
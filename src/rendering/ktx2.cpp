@@ -0,0 +1,165 @@
+#include <rendering/ktx2.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+struct Ktx2Header {
+	unsigned char identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header has to be 80 bytes");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "KTX2 level index entry has to be 24 bytes");
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const size_t KTX2_LEVEL_ALIGNMENT = 16;
+
+static size_t alignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool Ktx2::parse(unsigned char const* data, size_t size)
+{
+	Ktx2Header header;
+	if (size < sizeof(header)) return false;
+	std::memcpy(&header, data, sizeof(header));
+
+	if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0
+		|| header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1
+		|| header.supercompressionScheme != 0 || header.levelCount == 0
+		|| header.pixelWidth == 0 || header.pixelHeight == 0) {
+		return false;
+	}
+	if (getLevelSize(header.vkFormat, 1, 1) == 0) {
+		std::cerr << "[Ktx2] unsupported format " << header.vkFormat << std::endl;
+		return false;
+	}
+	if (size < sizeof(header) + header.levelCount * sizeof(Ktx2LevelIndex)) return false;
+
+	vkFormat = header.vkFormat;
+	width = (int)header.pixelWidth;
+	height = (int)header.pixelHeight;
+	levels.clear();
+	for (uint32_t i = 0; i < header.levelCount; ++i) {
+		Ktx2LevelIndex index;
+		std::memcpy(&index, data + sizeof(header) + i * sizeof(index), sizeof(index));
+
+		Level level;
+		level.width = std::max(1, width >> i);
+		level.height = std::max(1, height >> i);
+		level.offset = (size_t)index.byteOffset;
+		level.size = (size_t)index.byteLength;
+		if (level.size != getLevelSize(vkFormat, level.width, level.height)
+			|| level.offset > size || level.size > size - level.offset) {
+			return false;
+		}
+		levels.push_back(level);
+	}
+	return true;
+}
+
+bool Ktx2::write(std::string const& path, uint32_t vkFormat, int width, int height,
+	std::vector<std::vector<unsigned char>> const& levels)
+{
+	Ktx2Header header{};
+	std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = vkFormat;
+	header.typeSize = vkFormat == VK_FORMAT_R16G16B16A16_SFLOAT ? 2 : 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = (uint32_t)levels.size();
+
+	// the smallest level is stored first
+	std::vector<Ktx2LevelIndex> index(levels.size());
+	size_t offset = sizeof(header) + levels.size() * sizeof(Ktx2LevelIndex);
+	for (size_t i = levels.size(); i-- > 0;) {
+		offset = alignUp(offset, KTX2_LEVEL_ALIGNMENT);
+		index[i] = { offset, levels[i].size(), levels[i].size() };
+		offset += levels[i].size();
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "[Ktx2] can't write " << path << std::endl;
+		return false;
+	}
+	file.write((char const*)&header, sizeof(header));
+	file.write((char const*)index.data(), index.size() * sizeof(Ktx2LevelIndex));
+
+	size_t written = sizeof(header) + index.size() * sizeof(Ktx2LevelIndex);
+	char const padding[KTX2_LEVEL_ALIGNMENT] = {};
+	for (size_t i = levels.size(); i-- > 0;) {
+		file.write(padding, index[i].byteOffset - written);
+		file.write((char const*)levels[i].data(), levels[i].size());
+		written = index[i].byteOffset + levels[i].size();
+	}
+	return (bool)file;
+}
+
+bool Ktx2::getGLFormat(uint32_t vkFormat, bool srgb, GLFormat& format)
+{
+	switch (vkFormat) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		format = { (GLenum)(srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8), GL_RGBA, GL_UNSIGNED_BYTE, false };
+		return true;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		format = { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, false };
+		return true;
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		format = { GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, GL_RGB, GL_FLOAT, true };
+		return true;
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		format = { (GLenum)(srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM),
+			GL_RGBA, GL_UNSIGNED_BYTE, true };
+		return true;
+	}
+	return false;
+}
+
+bool Ktx2::isCompressed(uint32_t vkFormat)
+{
+	return vkFormat == VK_FORMAT_BC6H_UFLOAT_BLOCK || vkFormat == VK_FORMAT_BC7_UNORM_BLOCK
+		|| vkFormat == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+size_t Ktx2::getLevelSize(uint32_t vkFormat, int width, int height)
+{
+	switch (vkFormat) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return (size_t)width * height * 4;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return (size_t)width * height * 8;
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		// 16 bytes per 4x4 block
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+	}
+	return 0;
+}
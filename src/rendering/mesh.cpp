@@ -1,11 +1,30 @@
 #include <rendering/mesh.h>
+#include <rendering/meshOptimizer.h>
 #include <helpers/RootDir.h>
 
 
 #include <tiny_obj_loader.h>
 
 #include <iostream>
-#include <map>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+
+// header of the binary mesh cache, followed by the vertices and the indices (16 or 32 bit)
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t hasTexCoords;
+};
+
+static const char MESH_CACHE_MAGIC[4] = { 'B', 'H', 'V', 'M' };
+// increase when the layout or the import changes
+static const uint32_t MESH_CACHE_VERSION = 1;
 
 Mesh::~Mesh() {
 	glDeleteBuffers(1, &EBO_);
@@ -16,14 +35,16 @@ Mesh::~Mesh() {
 Mesh::Mesh()
 	: VAO_(0)
 	, VBO_(0)
-	, EBO_(0) {}
+	, EBO_(0)
+	, indexType_(GL_UNSIGNED_INT) {}
 
 Mesh::Mesh(std::vector<glm::vec3> pos, std::vector<glm::vec2> uv, std::vector<unsigned int> indxs)
 	: indices_(indxs)
 	, has_texCoords_(true)
 	, VAO_(0)
 	, VBO_(0)
-	, EBO_(0){
+	, EBO_(0)
+	, indexType_(GL_UNSIGNED_INT) {
 	if (pos.size() != uv.size()) {
 		std::cerr << "[Error][Mesh] Number of position vectors must match number of uv coordinates." << std::endl;
 		return;
@@ -39,37 +60,64 @@ Mesh::Mesh(std::vector<Vertex> verts, std::vector<unsigned int> indxs)
 	, has_texCoords_(true)
 	, VAO_(0)
 	, VBO_(0)
-	, EBO_(0) {
+	, EBO_(0)
+	, indexType_(GL_UNSIGNED_INT) {
 
 	createMesh();
 }
 
-// very basic .obj loading using tinyobjloader
-// supports position + uv coordinates
-Mesh::Mesh(std::string filename)
-	: has_texCoords_(true)
+// the imported mesh is stored in <filename>.meshcache, which is used instead
+// of the .obj file as long as it is newer
+Mesh::Mesh(std::string filename)
+	: has_texCoords_(true)
 	, VAO_(0)
 	, VBO_(0)
-	, EBO_(0) {
+	, EBO_(0)
+	, indexType_(GL_UNSIGNED_INT) {
+
+	std::string path = ROOT_DIR "resources/meshes/" + filename;
+	std::string cachePath = path + ".meshcache";
+
+	std::error_code ec;
+	auto objTime = std::filesystem::last_write_time(path, ec);
+	bool cacheValid = !ec && std::filesystem::exists(cachePath, ec)
+		&& std::filesystem::last_write_time(cachePath, ec) >= objTime && !ec;
+
+	if (!cacheValid || !loadCache(cachePath)) {
+		if (!loadObj(path)) return;
+		optimize();
+		storeCache(cachePath);
+	}
+
+	createMesh();
+}
+
+// very basic .obj loading using tinyobjloader
+// supports position + uv coordinates
+bool Mesh::loadObj(std::string const& path) {
+	vertices_.clear();
+	indices_.clear();
+	has_texCoords_ = true;
 
 	tinyobj::attrib_t attributes;
 	std::vector<tinyobj::shape_t> shapes;
 	// materials won't be used
 	std::vector<tinyobj::material_t> materials;
-	std::string err, warn, path = ROOT_DIR "resources/meshes/" + filename;
+	std::string err, warn;
 
 	bool success = tinyobj::LoadObj(&attributes, &shapes, &materials, &warn, &err, path.c_str());
 
 	if (!success) {
 		std::cerr << "[tinyobj] " << err << std::endl;
-		return;
+		return false;
 	}
 
 	if (err.size() > 0) {
 		std::cout << "[tinyobj] " << warn << std::endl;
 	}
 
-	std::map<int, size_t> indexMap;
+	// obj corners with the same position and uv index share a vertex
+	std::unordered_map<uint64_t, unsigned int> indexMap;
 	for (auto const& shape : shapes) {
 		size_t indexOffset = 0;
 		for (size_t const& face : shape.mesh.num_face_vertices) {
@@ -82,16 +130,16 @@ Mesh::Mesh(std::string filename)
 
 				if (idx.vertex_index < 0) {
 					std::cerr << "[mesh] not all vertices have pos coords" << std::endl;
-					return;
+					return false;
 				}
 
-				/*
-				if (indexMap.contains(idx.vertex_index)) {
-					indices_.push_back(indexMap.at(idx.vertex_index));
+				// add vertices only once
+				uint64_t key = (uint64_t)(uint32_t)idx.vertex_index << 32 | (uint32_t)idx.texcoord_index;
+				auto known = indexMap.find(key);
+				if (known != indexMap.end()) {
+					indices_.push_back(known->second);
 					continue;
 				}
-				*/
-				// add vertices only once
 
 				meshVert.position.x = attributes.vertices[3 * size_t(idx.vertex_index) + 0];
 				meshVert.position.y = attributes.vertices[3 * size_t(idx.vertex_index) + 1];
@@ -111,20 +159,105 @@ Mesh::Mesh(std::string filename)
 
 				vertices_.push_back(meshVert);
 				indices_.push_back(vertices_.size() - 1);
-				indexMap.insert({ idx.vertex_index, vertices_.size() - 1 });
+				indexMap.insert({ key, (unsigned int)vertices_.size() - 1 });
 			}
 			indexOffset += face;
 		}
 	}
 
-	createMesh();
+	return true;
+}
+
+void Mesh::optimize() {
+	double acmr = MeshOptimizer::computeACMR(indices_, vertices_.size());
+	MeshOptimizer::optimizeVertexCache(indices_, vertices_.size());
+
+	// vertices in the order they are used
+	size_t used = 0;
+	std::vector<unsigned int> remap = MeshOptimizer::optimizeVertexFetch(indices_, vertices_.size(), used);
+	std::vector<Vertex> vertices(used);
+	for (size_t v = 0; v < vertices_.size(); ++v) {
+		if (remap[v] < used) vertices[remap[v]] = vertices_[v];
+	}
+	vertices_ = std::move(vertices);
+
+	std::cout << "[mesh] imported " << vertices_.size() << " vertices, " << indices_.size() / 3
+		<< " triangles, ACMR " << acmr << " -> " << MeshOptimizer::computeACMR(indices_, vertices_.size()) << std::endl;
+}
+
+bool Mesh::loadCache(std::string const& path) {
+	// single read of the whole file
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) return false;
+	std::vector<char> data((size_t)file.tellg());
+	file.seekg(0);
+	if (!file.read(data.data(), data.size())) return false;
+
+	MeshCacheHeader header;
+	if (data.size() < sizeof(header)) return false;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (std::memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION
+		|| (header.indexSize != 2 && header.indexSize != 4)) {
+		std::cerr << "[mesh] invalid cache " << path << std::endl;
+		return false;
+	}
+
+	size_t vertexBytes = (size_t)header.vertexCount * sizeof(Vertex);
+	size_t indexBytes = (size_t)header.indexCount * header.indexSize;
+	if (data.size() != sizeof(header) + vertexBytes + indexBytes) {
+		std::cerr << "[mesh] invalid cache " << path << std::endl;
+		return false;
+	}
+
+	char const* ptr = data.data() + sizeof(header);
+	vertices_.resize(header.vertexCount);
+	std::memcpy(vertices_.data(), ptr, vertexBytes);
+	ptr += vertexBytes;
+
+	indices_.resize(header.indexCount);
+	if (header.indexSize == 2) {
+		uint16_t const* indices16 = reinterpret_cast<uint16_t const*>(ptr);
+		std::copy(indices16, indices16 + header.indexCount, indices_.begin());
+	}
+	else {
+		std::memcpy(indices_.data(), ptr, indexBytes);
+	}
+	has_texCoords_ = header.hasTexCoords;
+
+	return true;
+}
+
+void Mesh::storeCache(std::string const& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "[mesh] can't write cache " << path << std::endl;
+		return;
+	}
+
+	MeshCacheHeader header;
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+	header.version = MESH_CACHE_VERSION;
+	header.vertexCount = (uint32_t)vertices_.size();
+	header.indexCount = (uint32_t)indices_.size();
+	header.indexSize = vertices_.size() <= UINT16_MAX ? 2 : 4;
+	header.hasTexCoords = has_texCoords_;
+
+	file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	file.write(reinterpret_cast<char const*>(vertices_.data()), vertices_.size() * sizeof(Vertex));
+	if (header.indexSize == 2) {
+		std::vector<uint16_t> indices16(indices_.begin(), indices_.end());
+		file.write(reinterpret_cast<char const*>(indices16.data()), indices16.size() * sizeof(uint16_t));
+	}
+	else {
+		file.write(reinterpret_cast<char const*>(indices_.data()), indices_.size() * sizeof(unsigned int));
+	}
 }
 
 
 
 void Mesh::draw(int drawMode) const {
 	glBindVertexArray(VAO_);
-	glDrawElements(drawMode, indices_.size(), GL_UNSIGNED_INT, 0);
+	glDrawElements(drawMode, indices_.size(), indexType_, 0);
 	glBindVertexArray(0);
 }
 
@@ -137,9 +270,17 @@ void Mesh::createMesh() {
 	// vertices
 	glBindBuffer(GL_ARRAY_BUFFER, VBO_);
 	glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex), vertices_.data(), GL_STATIC_DRAW);
-	// elements (=indices)
+	// elements (=indices), 16 bit if possible
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(unsigned int), indices_.data(), GL_STATIC_DRAW);
+	if (vertices_.size() <= UINT16_MAX) {
+		indexType_ = GL_UNSIGNED_SHORT;
+		std::vector<uint16_t> indices16(indices_.begin(), indices_.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices16.size() * sizeof(uint16_t), indices16.data(), GL_STATIC_DRAW);
+	}
+	else {
+		indexType_ = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(unsigned int), indices_.data(), GL_STATIC_DRAW);
+	}
 	// vertex attributes
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
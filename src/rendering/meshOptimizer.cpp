@@ -0,0 +1,171 @@
+#include <rendering/meshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+
+// parameters from the paper
+static const int CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRI_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static const int VALENCE_TABLE_SIZE = 32;
+
+static float computeVertexScore(int cachePos, unsigned int remaining) {
+	// no triangles left to draw with this vertex
+	if (remaining == 0) return -1.f;
+
+	float score = 0.f;
+	if (cachePos >= 0) {
+		// vertices of the last triangle get a fixed score, so the next triangle doesn't share an edge with it
+		if (cachePos < 3) score = LAST_TRI_SCORE;
+		else score = std::pow(1.f - (cachePos - 3) / float(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	// vertices with few triangles left are preferred, to get rid of them
+	score += VALENCE_BOOST_SCALE * std::pow((float)remaining, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+static float vertexScore(int cachePos, unsigned int remaining) {
+	// scores of the common cases, indexed by [cachePos + 1][remaining]
+	static const auto table = []() {
+		std::vector<float> t((CACHE_SIZE + 1) * VALENCE_TABLE_SIZE);
+		for (int c = -1; c < CACHE_SIZE; ++c)
+			for (int r = 0; r < VALENCE_TABLE_SIZE; ++r)
+				t[(c + 1) * VALENCE_TABLE_SIZE + r] = computeVertexScore(c, r);
+		return t;
+	}();
+
+	if (remaining >= VALENCE_TABLE_SIZE) return computeVertexScore(cachePos, remaining);
+	return table[(cachePos + 1) * VALENCE_TABLE_SIZE + remaining];
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0) return;
+
+	// triangles of each vertex, the first remaining[v] entries are not drawn yet
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int v : indices) remaining[v]++;
+	std::vector<size_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(indices.size());
+	{
+		std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			adjacency[cursor[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<int> cachePos(vertexCount, -1);
+	std::vector<float> vScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) vScore[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> tScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+	auto triangleScore = [&](size_t t) {
+		return vScore[indices[3 * t]] + vScore[indices[3 * t + 1]] + vScore[indices[3 * t + 2]];
+	};
+	for (size_t t = 0; t < triCount; ++t) tScore[t] = triangleScore(t);
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> cache, newCache;
+	cache.reserve(CACHE_SIZE + 3);
+	newCache.reserve(CACHE_SIZE + 3);
+
+	size_t best = std::max_element(tScore.begin(), tScore.end()) - tScore.begin();
+	size_t scanCursor = 0;
+	while (true) {
+		emitted[best] = true;
+		newCache.clear();
+		for (int k = 0; k < 3; ++k) {
+			unsigned int v = indices[3 * best + k];
+			result.push_back(v);
+			if (std::find(newCache.begin(), newCache.end(), v) != newCache.end()) continue;
+			newCache.push_back(v);
+
+			// remove the triangle from the vertex
+			unsigned int* begin = adjacency.data() + offsets[v];
+			unsigned int* end = begin + remaining[v];
+			unsigned int* it = std::find(begin, end, (unsigned int)best);
+			if (it != end) {
+				std::swap(*it, *(end - 1));
+				remaining[v]--;
+			}
+		}
+		unsigned int const* tri = indices.data() + 3 * best;
+		for (unsigned int v : cache)
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+
+		// vertices pushed out of the cache lose their cache score
+		for (size_t i = CACHE_SIZE; i < newCache.size(); ++i) {
+			unsigned int v = newCache[i];
+			cachePos[v] = -1;
+			vScore[v] = vertexScore(-1, remaining[v]);
+			for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+				tScore[adjacency[a]] = triangleScore(adjacency[a]);
+		}
+		if (newCache.size() > CACHE_SIZE) newCache.resize(CACHE_SIZE);
+
+		for (size_t i = 0; i < newCache.size(); ++i) {
+			unsigned int v = newCache[i];
+			cachePos[v] = (int)i;
+			vScore[v] = vertexScore((int)i, remaining[v]);
+		}
+
+		// the next triangle is the best one using a cached vertex
+		float bestScore = -1.f;
+		bool found = false;
+		for (unsigned int v : newCache) {
+			for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a) {
+				unsigned int t = adjacency[a];
+				tScore[t] = triangleScore(t);
+				if (tScore[t] > bestScore) {
+					bestScore = tScore[t];
+					best = t;
+					found = true;
+				}
+			}
+		}
+		std::swap(cache, newCache);
+
+		if (!found) {
+			// nothing in the cache has triangles left, continue with the next triangle not drawn yet
+			while (scanCursor < triCount && emitted[scanCursor]) scanCursor++;
+			if (scanCursor == triCount) break;
+			best = scanCursor;
+		}
+	}
+
+	indices = std::move(result);
+}
+
+std::vector<unsigned int> MeshOptimizer::optimizeVertexFetch(std::vector<unsigned int>& indices, size_t vertexCount, size_t& usedCount) {
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertexCount, unused);
+	unsigned int next = 0;
+	for (unsigned int& i : indices) {
+		if (remap[i] == unused) remap[i] = next++;
+		i = remap[i];
+	}
+	usedCount = next;
+	return remap;
+}
+
+double MeshOptimizer::computeACMR(std::vector<unsigned int> const& indices, size_t vertexCount, int cacheSize) {
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0) return 0.0;
+
+	// a vertex is cached if fewer than cacheSize misses happened since it was loaded
+	std::vector<size_t> loadedAt(vertexCount, 0);
+	std::vector<bool> loaded(vertexCount, false);
+	size_t misses = 0;
+	for (unsigned int v : indices) {
+		if (loaded[v] && misses - loadedAt[v] < (size_t)cacheSize) continue;
+		loaded[v] = true;
+		loadedAt[v] = misses++;
+	}
+	return misses / (double)triCount;
+}
@@ -0,0 +1,241 @@
+#include <rendering/panoramaConverter.h>
+#include <helpers/parallelRows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PANORAMA_SSE
+#include <emmintrin.h>
+#endif
+
+static const float PI = 3.14159265358979f;
+static const char* FACE_NAMES[6] = { "px", "nx", "py", "ny", "pz", "nz" };
+
+// one RGBA pixel, the four channels in one SSE register
+#ifdef PANORAMA_SSE
+struct Pixel {
+	__m128 v;
+
+	static Pixel zero() { return { _mm_setzero_ps() }; }
+	static Pixel load(float const* p) { return { _mm_loadu_ps(p) }; }
+	void store(float* p) const { _mm_storeu_ps(p, v); }
+	Pixel operator+(Pixel b) const { return { _mm_add_ps(v, b.v) }; }
+	Pixel operator*(float s) const { return { _mm_mul_ps(v, _mm_set1_ps(s)) }; }
+};
+#else
+struct Pixel {
+	float v[4];
+
+	static Pixel zero() { return { { 0.f, 0.f, 0.f, 0.f } }; }
+	static Pixel load(float const* p) { return { { p[0], p[1], p[2], p[3] } }; }
+	void store(float* p) const { std::copy(v, v + 4, p); }
+	Pixel operator+(Pixel b) const { return { { v[0] + b.v[0], v[1] + b.v[1], v[2] + b.v[2], v[3] + b.v[3] } }; }
+	Pixel operator*(float s) const { return { { v[0] * s, v[1] * s, v[2] * s, v[3] * s } }; }
+};
+#endif
+
+// direction of the face coordinates s, t in [-1, 1], same as the GL cube map face selection
+static void faceDirection(int face, float s, float t, float& x, float& y, float& z) {
+	switch (face) {
+	case 0: x = 1.f; y = -t; z = -s; break;
+	case 1: x = -1.f; y = -t; z = s; break;
+	case 2: x = s; y = 1.f; z = t; break;
+	case 3: x = s; y = -1.f; z = -t; break;
+	case 4: x = s; y = -t; z = 1.f; break;
+	default: x = -s; y = -t; z = -1.f; break;
+	}
+}
+
+// bilinear tap at pixel coordinates x, y (pixel centers at +0.5), wraps around horizontally
+static Pixel sampleBilinear(TextureBaker::Image const& image, float x, float y) {
+	x -= 0.5f;
+	y -= 0.5f;
+	int x0 = (int)std::floor(x);
+	int y0 = (int)std::floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	x0 = (x0 % image.width + image.width) % image.width;
+	int x1 = x0 + 1 == image.width ? 0 : x0 + 1;
+	float const* row0 = image.row(std::clamp(y0, 0, image.height - 1));
+	float const* row1 = image.row(std::clamp(y0 + 1, 0, image.height - 1));
+
+	Pixel top = Pixel::load(row0 + x0 * 4) * (1.f - fx) + Pixel::load(row0 + x1 * 4) * fx;
+	Pixel bottom = Pixel::load(row1 + x0 * 4) * (1.f - fx) + Pixel::load(row1 + x1 * 4) * fx;
+	return top * (1.f - fy) + bottom * fy;
+}
+
+PanoramaConverter::PanoramaConverter(int threads)
+	: samples_(0)
+	, threads_(threads)
+	, hdr_(false)
+	, convertTime_(0.0)
+{}
+
+bool PanoramaConverter::load(std::string const& path)
+{
+	return TextureBaker::loadImage(path, panorama_, hdr_);
+}
+
+void PanoramaConverter::setPanorama(TextureBaker::Image const& panorama, bool hdr)
+{
+	panorama_ = panorama;
+	hdr_ = hdr;
+}
+
+std::vector<TextureBaker::Image> PanoramaConverter::convert(int faceSize) const
+{
+	if (panorama_.pixels.empty() || faceSize <= 0) {
+		std::cerr << "[PanoramaConverter] no panorama loaded" << std::endl;
+		return {};
+	}
+	auto start_time = std::chrono::high_resolution_clock::now();
+
+	int samples = getSamples(faceSize);
+	// angle between two taps at the face center
+	TextureBaker::Image filtered = prefilterRows(2.f / (faceSize * samples));
+
+	std::vector<TextureBaker::Image> faces(6);
+	for (auto& face : faces) {
+		face.width = faceSize;
+		face.height = faceSize;
+		face.pixels.resize((size_t)faceSize * faceSize * 4);
+	}
+
+	float width = (float)filtered.width;
+	float height = (float)filtered.height;
+	parallelRows(6 * faceSize, threads_, [&](int row) {
+		int face = row / faceSize;
+		int y = row % faceSize;
+		float* out = faces[face].row(y);
+
+		for (int x = 0; x < faceSize; ++x) {
+			Pixel sum = Pixel::zero();
+			float weightSum = 0.f;
+			for (int j = 0; j < samples; ++j) {
+				float t = 2.f * (y + (j + 0.5f) / samples) / faceSize - 1.f;
+				for (int i = 0; i < samples; ++i) {
+					float s = 2.f * (x + (i + 0.5f) / samples) / faceSize - 1.f;
+					// solid angle of the tap
+					float r2 = 1.f + s * s + t * t;
+					float weight = 1.f / (r2 * std::sqrt(r2));
+
+					float dx, dy, dz;
+					faceDirection(face, s, t, dx, dy, dz);
+					float theta = std::acos(std::clamp(dy / std::sqrt(r2), -1.f, 1.f));
+					float phi = std::atan2(-dx, -dz);
+					if (phi < 0.f) phi += 2.f * PI;
+
+					sum = sum + sampleBilinear(filtered, phi / (2.f * PI) * width, theta / PI * height) * weight;
+					weightSum += weight;
+				}
+			}
+			(sum * (1.f / weightSum)).store(out + x * 4);
+		}
+	});
+
+	auto end_time = std::chrono::high_resolution_clock::now();
+	convertTime_ = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+	return faces;
+}
+
+bool PanoramaConverter::bake(std::string const& path, int faceSize, TextureBaker& baker)
+{
+	if (!load(path)) return false;
+	std::vector<TextureBaker::Image> faces = convert(faceSize);
+	if (faces.empty()) return false;
+	std::cout << "[PanoramaConverter] " << path << ": " << panorama_.width << "x" << panorama_.height
+		<< " to 6x" << faceSize << "x" << faceSize << " in " << convertTime_ << "ms" << std::endl;
+
+	for (int face = 0; face < 6; ++face) {
+		if (!baker.bake(faces[face], hdr_, getCachePath(path, faceSize, face)))
+			return false;
+	}
+	return true;
+}
+
+std::string PanoramaConverter::getCachePath(std::string const& path, int faceSize, int face)
+{
+	return path + ".cube" + std::to_string(faceSize) + "." + FACE_NAMES[face] + ".ktx2";
+}
+
+int PanoramaConverter::getSamples(int faceSize) const
+{
+	if (samples_ > 0) return samples_;
+	// taps at least as dense as the panorama pixels at the equator
+	float texelAngle = 2.f / faceSize;
+	float pixelAngle = PI / panorama_.height;
+	return std::clamp((int)std::ceil(texelAngle / pixelAngle), 1, 8);
+}
+
+TextureBaker::Image PanoramaConverter::prefilterRows(float tapAngle) const
+{
+	int width = panorama_.width;
+	int height = panorama_.height;
+
+	// vertical box over the rows between two taps, only if the taps skip rows
+	TextureBaker::Image columns;
+	float boxHeight = tapAngle / (PI / height);
+	if (boxHeight > 1.f) {
+		columns.width = width;
+		columns.height = height;
+		columns.pixels.assign(panorama_.pixels.size(), 0.f);
+		parallelRows(height, threads_, [&](int y) {
+			float top = y + 0.5f - boxHeight / 2;
+			float bottom = y + 0.5f + boxHeight / 2;
+			float* row = columns.row(y);
+			float weightSum = 0.f;
+			for (int src = std::max(0, (int)std::floor(top)); src < std::min(height, (int)std::ceil(bottom)); ++src) {
+				float weight = std::min(src + 1.f, bottom) - std::max((float)src, top);
+				float const* in = panorama_.row(src);
+				for (int i = 0; i < width * 4; ++i) row[i] += weight * in[i];
+				weightSum += weight;
+			}
+			for (int i = 0; i < width * 4; ++i) row[i] /= weightSum;
+		});
+	}
+	TextureBaker::Image const& source = boxHeight > 1.f ? columns : panorama_;
+
+	TextureBaker::Image out;
+	out.width = width;
+	out.height = height;
+	out.pixels.resize(panorama_.pixels.size());
+
+	parallelRows(height, threads_, [&](int y) {
+		float const* in = source.row(y);
+		float* row = out.row(y);
+
+		// pixels are narrower by sin(theta) towards the poles
+		float theta = (y + 0.5f) / height * PI;
+		float pixelAngle = 2.f * PI / width * std::sin(theta);
+		double box = std::min((double)width, (double)tapAngle / pixelAngle);
+		if (box <= 1.0) {
+			std::copy(in, in + width * 4, row);
+			return;
+		}
+
+		// box filter of fractional width with the prefix sums of the row
+		std::vector<double> prefix((size_t)(width + 1) * 4, 0.0);
+		for (int x = 0; x < width; ++x)
+			for (int c = 0; c < 4; ++c)
+				prefix[(x + 1) * 4 + c] = prefix[x * 4 + c] + in[x * 4 + c];
+
+		// sum of the row from 0 to a, wraps around
+		auto integral = [&](double a, int c) {
+			double turns = std::floor(a / width);
+			double r = a - turns * width;
+			int i = std::min((int)r, width - 1);
+			return turns * prefix[width * 4 + c] + prefix[i * 4 + c] + (r - i) * in[i * 4 + c];
+		};
+		for (int x = 0; x < width; ++x) {
+			double center = x + 0.5;
+			for (int c = 0; c < 4; ++c)
+				row[x * 4 + c] = (float)((integral(center + box / 2, c) - integral(center - box / 2, c)) / box);
+		}
+	});
+	return out;
+}
+
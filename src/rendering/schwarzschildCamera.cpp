@@ -3,6 +3,7 @@
 #include <numeric>
 
 #include <helpers/uboBindings.h>
+#include <helpers/json_helper.h>
 #include <rendering/schwarzschildCamera.h>
 #include <glm/gtx/string_cast.hpp>
 
@@ -272,10 +273,35 @@ void SchwarzschildCamera::mouseInput(GLFWwindow* window, float dt) {
 
 void SchwarzschildCamera::storeConfig(boost::json::object& obj)
 {
+    obj["positionRTP"] = { positionRTP_.x, positionRTP_.y, positionRTP_.z };
+    obj["prevPositionXYZ"] = { prevPositionXYZ_.x, prevPositionXYZ_.y, prevPositionXYZ_.z };
+    obj["velocityRTP"] = { velocityRTP_.x, velocityRTP_.y, velocityRTP_.z };
+    obj["viewDirTP"] = { viewDirTP_.x, viewDirTP_.y };
+    obj["fov"] = fov_;
+    obj["translationSpeed"] = translationSpeed_;
+    obj["speedScale"] = speedScale_;
+    obj["lockedMode"] = lockedMode_;
+    obj["friction"] = friction_;
 }
 
 void SchwarzschildCamera::loadConfig(boost::json::object& obj)
 {
+    glm::vec3 position = positionRTP_;
+    if (jhelper::getValue(obj, "positionRTP", position))
+        setPosRTP(position);
+    // the previous position gives the current velocity, see getCurrentVelXYZ
+    jhelper::getValue(obj, "prevPositionXYZ", prevPositionXYZ_);
+    jhelper::getValue(obj, "velocityRTP", velocityRTP_);
+
+    glm::vec2 viewDir = viewDirTP_;
+    if (jhelper::getValue(obj, "viewDirTP", viewDir))
+        setViewDirTP(viewDir);
+    jhelper::getValue(obj, "fov", fov_);
+    jhelper::getValue(obj, "translationSpeed", translationSpeed_);
+    jhelper::getValue(obj, "speedScale", speedScale_);
+    jhelper::getValue(obj, "lockedMode", lockedMode_);
+    jhelper::getValue(obj, "friction", friction_);
+    changed_ = true;
 }
 
 glm::vec3 SchwarzschildCamera::dirCamToXYZ(glm::vec3 dir) const
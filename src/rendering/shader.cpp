@@ -3,36 +3,118 @@
 #include <helpers/RootDir.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <filesystem>
 #include <vector>
 
+static const std::string SHADER_DIR = ROOT_DIR "resources/shaders/";
 
-std::string ShaderBase::readShaderFiles(std::vector<std::string> paths) const {
+static std::set<ShaderBase*>& instances() {
+	static std::set<ShaderBase*> shaders;
+	return shaders;
+}
+
+// file name of a line #include "file", false for other lines
+static bool parseInclude(std::string const& line, std::string& file) {
+	size_t pos = line.find_first_not_of(" \t");
+	if (pos == std::string::npos || line[pos] != '#') return false;
+	pos = line.find_first_not_of(" \t", pos + 1);
+	if (pos == std::string::npos || line.compare(pos, 7, "include") != 0) return false;
+
+	size_t begin = line.find('"', pos + 7);
+	size_t end = begin == std::string::npos ? begin : line.find('"', begin + 1);
+	if (end == std::string::npos) return false;
+	file = line.substr(begin + 1, end - begin - 1);
+	return true;
+}
+
+// path relative to the shader directory, next to the including file first
+static std::string resolveInclude(std::string const& from, std::string const& file) {
+	namespace fs = std::filesystem;
+	std::string local = (fs::path(from).parent_path() / file).lexically_normal().generic_string();
+	if (fs::exists(SHADER_DIR + local)) return local;
+	std::string global = fs::path(file).lexically_normal().generic_string();
+	if (fs::exists(SHADER_DIR + global)) return global;
+	return "";
+}
+
+ShaderBase::ShaderBase() : ID_(0) {
+	instances().insert(this);
+}
+
+ShaderBase::ShaderBase(ShaderBase const& other)
+	: ID_(other.ID_)
+	, versionDirective_(other.versionDirective_)
+	, preprocessorFlags_(other.preprocessorFlags_)
+	, preprocessorValues_(other.preprocessorValues_)
+	, dependencies_(other.dependencies_)
+	, sourceNames_(other.sourceNames_) {
+	instances().insert(this);
+}
+
+ShaderBase::~ShaderBase() {
+	instances().erase(this);
+}
+
+std::set<ShaderBase*> const& ShaderBase::getInstances() {
+	return instances();
+}
+
+
+std::string ShaderBase::readShaderFiles(std::vector<std::string> paths) {
 
 	std::string shaderCode;
-	std::ifstream file;
-	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	std::set<std::string> included;
 
 	for (auto const& path : paths) {
+		std::string file = std::filesystem::path(path).lexically_normal().generic_string();
+		if (!readShaderFile(file, included, shaderCode)) return "";
+	}
 
-		try {
-
-			file.open(ROOT_DIR "resources/shaders/" + path);
-			// won't need these stream objects after file was read
-			std::stringstream stream;
-			// read
-			stream << file.rdbuf();
-			// close
-			file.close();
-			// to string
-			shaderCode += stream.str();
-
-		} catch (std::ifstream::failure& error) {
-			std::cout << "[Error][Shader] File " << path << " not read" << std::endl;
-			return "";
+	return shaderCode;
+}
+
+bool ShaderBase::readShaderFile(std::string const& path, std::set<std::string>& included, std::string& code) {
+	// once per stage, like #pragma once
+	if (!included.insert(path).second) return true;
+	// also if missing, the program is reloaded when the file appears
+	dependencies_.insert(path);
+
+	std::ifstream file(SHADER_DIR + path);
+	if (!file) {
+		std::cout << "[Error][Shader] File " << path << " not read" << std::endl;
+		return false;
+	}
+
+	std::string source = std::to_string(getSourceNumber(path));
+	code += "#line 1 " + source + "\n";
+
+	std::string line, include;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		++lineNumber;
+		if (!parseInclude(line, include)) {
+			code += line + "\n";
+			continue;
 		}
+
+		std::string includePath = resolveInclude(path, include);
+		if (includePath.empty()) {
+			std::cout << "[Error][Shader] File " << include << " included in " << path << "(" << lineNumber << ") not found" << std::endl;
+			dependencies_.insert(std::filesystem::path(include).lexically_normal().generic_string());
+			return false;
+		}
+		if (!readShaderFile(includePath, included, code)) return false;
+		code += "#line " + std::to_string(lineNumber + 1) + " " + source + "\n";
 	}
+	return true;
+}
 
-	return shaderCode;
+int ShaderBase::getSourceNumber(std::string const& path) {
+	auto it = std::find(sourceNames_.begin(), sourceNames_.end(), path);
+	if (it != sourceNames_.end()) return (int)(it - sourceNames_.begin());
+	sourceNames_.push_back(path);
+	return (int)sourceNames_.size() - 1;
 }
 
 bool ShaderBase::checkCompileErrors(int shader, std::string name) {
@@ -48,6 +130,9 @@ bool ShaderBase::checkCompileErrors(int shader, std::string name) {
 		glGetShaderInfoLog(shader, maxLen, NULL, log.data());
 
 		std::cout << "[Error][Shader] Compilation error at: " << name << "\n" << log.data() << std::endl;
+		// errors are reported as source:line
+		for (size_t i = 0; i < sourceNames_.size(); ++i)
+			std::cout << "  " << i << ": " << sourceNames_[i] << std::endl;
 
 		return false;
 	}
@@ -110,9 +195,19 @@ void ShaderBase::setUniform(const std::string& name, glm::mat4 value) {
 }
 
 void ShaderBase::reload() {
-	glDeleteProgram(ID_);
+	unsigned int oldID = ID_;
 	ID_ = 0;
+	dependencies_.clear();
+	sourceNames_.clear();
 	compile();
+
+	if (ID_ == 0 && oldID != 0) {
+		// keep the last working program until the error is fixed
+		ID_ = oldID;
+		std::cout << "[Error][Shader] Reload failed, keeping the previous program" << std::endl;
+	} else {
+		glDeleteProgram(oldID);
+	}
 }
 
 std::string ShaderBase::createPreprocessorCommands() const {
@@ -182,7 +277,7 @@ void Shader::compile() {
 	fsCode = versionDirective_ + ppflags + readShaderFiles(fsPaths_);
 
 	if(hasGeometryShader())
-		fsCode = versionDirective_ + ppflags + readShaderFiles(gsPaths_);
+		gsCode = versionDirective_ + ppflags + readShaderFiles(gsPaths_);
 
 
 	unsigned int vsID = 0, gsID = 0, fsID = 0, ID = 0;
@@ -197,7 +292,7 @@ void Shader::compile() {
 	bool gsCompiled = true;
 	if (hasGeometryShader()) {
 
-		// compile fragment shader
+		// compile geometry shader
 		gsID = glCreateShader(GL_GEOMETRY_SHADER);
 		glShaderSource(gsID, 1, &gsCodeChar, NULL);
 		glCompileShader(gsID);
@@ -221,6 +316,8 @@ void Shader::compile() {
 
 	if(vsCompiled && gsCompiled && fsCompiled && linked)
 		ID_ = ID;
+	else
+		glDeleteProgram(ID);
 	glDeleteShader(vsID);
 	if (hasGeometryShader()) glDeleteShader(gsID);
 	glDeleteShader(fsID);
@@ -257,6 +354,9 @@ void ComputeShader::compile() {
 	glLinkProgram(ID_);
 	bool linked = checkLinkErrors(ID_);
 
-	if (!compiled || !linked) ID_ = 0;
+	if (!compiled || !linked) {
+		glDeleteProgram(ID_);
+		ID_ = 0;
+	}
 	glDeleteShader(csID);
 }
\ No newline at end of file
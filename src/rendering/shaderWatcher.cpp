@@ -0,0 +1,190 @@
+#include <rendering/shaderWatcher.h>
+#include <rendering/shader.h>
+
+#include <helpers/RootDir.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static const std::string SHADER_DIR = ROOT_DIR "resources/shaders/";
+
+#ifdef __linux__
+
+ShaderWatcher::ShaderWatcher()
+	: enabled_(true)
+	, stop_(false)
+	, inotifyFd_(inotify_init1(IN_CLOEXEC))
+	, stopFd_(eventfd(0, EFD_CLOEXEC))
+{
+	if (inotifyFd_ < 0 || stopFd_ < 0) {
+		std::cerr << "[ShaderWatcher] inotify not available, shaders aren't reloaded on change" << std::endl;
+		return;
+	}
+
+	// inotify watches aren't recursive
+	addWatch("");
+	std::error_code error;
+	for (auto const& entry : std::filesystem::recursive_directory_iterator(SHADER_DIR, error)) {
+		if (entry.is_directory(error))
+			addWatch(std::filesystem::relative(entry.path(), SHADER_DIR).generic_string() + "/");
+	}
+
+	thread_ = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	stop_ = true;
+	if (thread_.joinable()) {
+		uint64_t one = 1;
+		if (write(stopFd_, &one, sizeof(one)) != sizeof(one))
+			std::cerr << "[ShaderWatcher] can't stop the watcher thread" << std::endl;
+		thread_.join();
+	}
+	if (inotifyFd_ >= 0) close(inotifyFd_);
+	if (stopFd_ >= 0) close(stopFd_);
+}
+
+void ShaderWatcher::addWatch(std::string const& directory)
+{
+	// saved files, and files replaced by editors that write a copy and rename it
+	int wd = inotify_add_watch(inotifyFd_, (SHADER_DIR + directory).c_str(),
+		IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd < 0) {
+		std::cerr << "[ShaderWatcher] can't watch " << SHADER_DIR + directory << std::endl;
+		return;
+	}
+	directories_[wd] = directory;
+}
+
+void ShaderWatcher::watchLoop()
+{
+	alignas(inotify_event) char buffer[16 * 1024];
+
+	while (!stop_) {
+		pollfd fds[2] = { { inotifyFd_, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		if (fds[1].revents) break;
+
+		ssize_t length = read(inotifyFd_, buffer, sizeof(buffer));
+		for (char* p = buffer; length > 0 && p < buffer + length;) {
+			inotify_event const* event = (inotify_event const*)p;
+			p += sizeof(inotify_event) + event->len;
+
+			auto directory = directories_.find(event->wd);
+			if (event->len == 0 || directory == directories_.end()) continue;
+			std::string path = directory->second + event->name;
+
+			if (event->mask & IN_ISDIR) {
+				if (event->mask & (IN_CREATE | IN_MOVED_TO)) addWatch(path + "/");
+			}
+			// created files are still empty, they follow with IN_CLOSE_WRITE
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+				notify(path);
+			}
+		}
+	}
+}
+
+#else
+
+// modification times of all files in the shader directory
+static std::map<std::string, std::filesystem::file_time_type> scanShaderFiles()
+{
+	std::map<std::string, std::filesystem::file_time_type> times;
+	std::error_code error;
+	for (auto const& entry : std::filesystem::recursive_directory_iterator(SHADER_DIR, error)) {
+		if (entry.is_regular_file(error))
+			times[std::filesystem::relative(entry.path(), SHADER_DIR).generic_string()] = entry.last_write_time(error);
+	}
+	return times;
+}
+
+ShaderWatcher::ShaderWatcher()
+	: enabled_(true)
+	, stop_(false)
+{
+	thread_ = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(stopMutex_);
+		stop_ = true;
+	}
+	stopCondition_.notify_all();
+	thread_.join();
+}
+
+void ShaderWatcher::watchLoop()
+{
+	auto times = scanShaderFiles();
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(stopMutex_);
+			if (stopCondition_.wait_for(lock, std::chrono::milliseconds(500), [this] { return stop_.load(); }))
+				break;
+		}
+
+		auto newTimes = scanShaderFiles();
+		for (auto const& [path, time] : newTimes) {
+			auto it = times.find(path);
+			if (it == times.end() || it->second != time) notify(path);
+		}
+		times = std::move(newTimes);
+	}
+}
+
+#endif
+
+void ShaderWatcher::notify(std::string const& path)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	changed_.insert(path);
+}
+
+int ShaderWatcher::update()
+{
+	if (!enabled_) return 0;
+
+	std::set<std::string> changed;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		changed.swap(changed_);
+	}
+	if (changed.empty()) return 0;
+
+	// reloading doesn't create or destroy shader objects, the set stays valid
+	int reloaded = 0;
+	for (ShaderBase* shader : ShaderBase::getInstances()) {
+		auto const& dependencies = shader->getDependencies();
+		bool affected = std::any_of(changed.begin(), changed.end(),
+			[&](std::string const& path) { return dependencies.count(path) > 0; });
+		if (affected) {
+			shader->reload();
+			++reloaded;
+		}
+	}
+
+	if (reloaded > 0) {
+		for (auto const& path : changed)
+			std::cout << "[ShaderWatcher] " << path << " changed" << std::endl;
+		std::cout << "[ShaderWatcher] reloaded " << reloaded << " programs" << std::endl;
+	}
+	return reloaded;
+}
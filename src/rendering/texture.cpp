@@ -116,6 +116,29 @@ Texture2D::Texture2D(TextureParams const& params)
     unbind();
 }
 
+void Texture2D::setImage(TextureParams const& params)
+{
+    if (params.level == 0) {
+        width_ = params.width;
+        height_ = params.height;
+    }
+    bind();
+    createTexture(params);
+    unbind();
+}
+
+void Texture2D::setCompressedImage(TextureParams const& params, GLsizei imageSize)
+{
+    if (params.level == 0) {
+        width_ = params.width;
+        height_ = params.height;
+    }
+    bind();
+    glCompressedTexImage2D(params.target, params.level, params.internalFormat, params.width, params.height,
+        params.border, imageSize, params.data);
+    unbind();
+}
+
 void Texture2D::createTexture(TextureParams const& params)
 {
     glTexImage2D(params.target, params.level, params.internalFormat, params.width, params.height,
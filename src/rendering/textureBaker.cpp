@@ -0,0 +1,578 @@
+#include <rendering/textureBaker.h>
+#include <rendering/ktx2.h>
+#include <helpers/parallelRows.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// interpolation weights of 4 bit indices, shared by BC6H and BC7
+static const int BPTC_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// width (radius in destination pixels) and alpha of the Kaiser window
+static const float KAISER_WIDTH = 3.f;
+static const float KAISER_ALPHA = 4.f;
+static const float PI = 3.14159265358979f;
+
+static float srgbToLinear(float c) {
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c) {
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+}
+
+// round to nearest even, overflow goes to infinity
+static uint16_t floatToHalf(float value) {
+	uint32_t f;
+	std::memcpy(&f, &value, 4);
+	uint32_t const f32infty = 255u << 23;
+	uint32_t const f16max = (127u + 16u) << 23;
+	uint32_t const denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+	uint32_t sign = f & 0x80000000u;
+	f ^= sign;
+	uint16_t half;
+	if (f >= f16max) {
+		half = f > f32infty ? 0x7e00 : 0x7c00;
+	}
+	else if (f < (113u << 23)) {
+		// subnormal, let the float addition do the rounding
+		float ff, magic;
+		std::memcpy(&ff, &f, 4);
+		std::memcpy(&magic, &denormMagic, 4);
+		ff += magic;
+		std::memcpy(&f, &ff, 4);
+		half = (uint16_t)(f - denormMagic);
+	}
+	else {
+		uint32_t mantissaOdd = (f >> 13) & 1;
+		f += ((uint32_t)(15 - 127) << 23) + 0xfff;
+		f += mantissaOdd;
+		half = (uint16_t)(f >> 13);
+	}
+	return (uint16_t)(half | (sign >> 16));
+}
+
+// modified Bessel function of the first kind, order 0
+static double besselI0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 50 && term > sum * 1e-12; ++k) {
+		term *= (x * x / 4.0) / ((double)k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+static float kaiser(float x) {
+	float t = x / KAISER_WIDTH;
+	if (std::abs(t) >= 1.f) return 0.f;
+	float sinc = x == 0.f ? 1.f : std::sin(PI * x) / (PI * x);
+	return sinc * (float)(besselI0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / besselI0(KAISER_ALPHA));
+}
+
+// 128 bit block, written from the least significant bit
+struct BlockWriter {
+	unsigned char bytes[16] = {};
+	int pos = 0;
+
+	void write(uint32_t value, int bits) {
+		for (int i = 0; i < bits; ++i, ++pos) {
+			if (value >> i & 1) bytes[pos >> 3] |= (unsigned char)(1 << (pos & 7));
+		}
+	}
+};
+
+// the 4x4 pixels of block (bx, by), edge pixels are repeated for partial blocks
+static void loadBlock(TextureBaker::Image const& image, int bx, int by, float block[16][4]) {
+	for (int y = 0; y < 4; ++y) {
+		float const* row = image.row(std::min(by * 4 + y, image.height - 1));
+		for (int x = 0; x < 4; ++x) {
+			float const* p = row + std::min(bx * 4 + x, image.width - 1) * 4;
+			std::copy(p, p + 4, block[y * 4 + x]);
+		}
+	}
+}
+
+// principal axis of n points with dims channels by power iteration, returns the mean
+template <int dims>
+static void principalAxis(float const (*points)[4], int n, float mean[dims], float axis[dims]) {
+	for (int c = 0; c < dims; ++c) {
+		mean[c] = 0.f;
+		for (int i = 0; i < n; ++i) mean[c] += points[i][c];
+		mean[c] /= n;
+	}
+	float cov[dims][dims] = {};
+	for (int i = 0; i < n; ++i) {
+		for (int a = 0; a < dims; ++a)
+			for (int b = 0; b < dims; ++b)
+				cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+	}
+	for (int c = 0; c < dims; ++c) axis[c] = 1.f;
+	for (int iter = 0; iter < 8; ++iter) {
+		float next[dims] = {};
+		for (int a = 0; a < dims; ++a)
+			for (int b = 0; b < dims; ++b)
+				next[a] += cov[a][b] * axis[b];
+		float len = 0.f;
+		for (int c = 0; c < dims; ++c) len += next[c] * next[c];
+		len = std::sqrt(len);
+		if (len < 1e-12f) break;
+		for (int c = 0; c < dims; ++c) axis[c] = next[c] / len;
+	}
+}
+
+// endpoints at the extremes of the projection onto the principal axis
+template <int dims>
+static void fitEndpoints(float const (*points)[4], float e0[dims], float e1[dims]) {
+	float mean[dims], axis[dims];
+	principalAxis<dims>(points, 16, mean, axis);
+	float tMin = INFINITY, tMax = -INFINITY;
+	for (int i = 0; i < 16; ++i) {
+		float t = 0.f;
+		for (int c = 0; c < dims; ++c) t += (points[i][c] - mean[c]) * axis[c];
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	for (int c = 0; c < dims; ++c) {
+		e0[c] = mean[c] + axis[c] * tMin;
+		e1[c] = mean[c] + axis[c] * tMax;
+	}
+}
+
+// least squares endpoints for fixed indices, false if the indices don't span a line
+template <int dims>
+static bool refineEndpoints(float const (*points)[4], int const indices[16], float e0[dims], float e1[dims]) {
+	float aa = 0.f, ab = 0.f, bb = 0.f;
+	float ax[dims] = {}, bx[dims] = {};
+	for (int i = 0; i < 16; ++i) {
+		float b = BPTC_WEIGHTS4[indices[i]] / 64.f;
+		float a = 1.f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < dims; ++c) {
+			ax[c] += a * points[i][c];
+			bx[c] += b * points[i][c];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f) return false;
+	for (int c = 0; c < dims; ++c) {
+		e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+		e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+	}
+	return true;
+}
+
+// the first pixel (anchor) stores its index without the most significant bit
+static void writeIndices(BlockWriter& writer, int indices[16]) {
+	writer.write(indices[0], 3);
+	for (int i = 1; i < 16; ++i) writer.write(indices[i], 4);
+}
+
+// BC7 mode 6: one subset, RGBA endpoints with 7 bits and a p-bit each, 4 bit indices
+struct BC7Mode6 {
+	int endpoint[2][4];
+	int pbit[2];
+	int indices[16];
+	float error;
+
+	// 8 bit endpoint color
+	int color(int e, int c) const { return endpoint[e][c] << 1 | pbit[e]; }
+
+	// best indices for the current endpoints
+	void assign(float const (*pixels)[4]) {
+		int palette[16][4];
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 4; ++c)
+				palette[i][c] = (color(0, c) * (64 - BPTC_WEIGHTS4[i]) + color(1, c) * BPTC_WEIGHTS4[i] + 32) >> 6;
+		}
+		error = 0.f;
+		for (int p = 0; p < 16; ++p) {
+			float best = INFINITY;
+			for (int i = 0; i < 16; ++i) {
+				float e = 0.f;
+				for (int c = 0; c < 4; ++c) {
+					float d = pixels[p][c] - palette[i][c];
+					e += d * d;
+				}
+				if (e < best) {
+					best = e;
+					indices[p] = i;
+				}
+			}
+			error += best;
+		}
+	}
+
+	// quantized endpoints with the best p-bits
+	static BC7Mode6 quantize(float const (*pixels)[4], float const e0[4], float const e1[4]) {
+		BC7Mode6 best;
+		best.error = INFINITY;
+		for (int p = 0; p < 4; ++p) {
+			BC7Mode6 mode;
+			mode.pbit[0] = p & 1;
+			mode.pbit[1] = p >> 1;
+			for (int c = 0; c < 4; ++c) {
+				mode.endpoint[0][c] = std::clamp((int)std::lround((e0[c] - mode.pbit[0]) / 2.f), 0, 127);
+				mode.endpoint[1][c] = std::clamp((int)std::lround((e1[c] - mode.pbit[1]) / 2.f), 0, 127);
+			}
+			mode.assign(pixels);
+			if (mode.error < best.error) best = mode;
+		}
+		return best;
+	}
+
+	void write(unsigned char* out) {
+		if (indices[0] >= 8) {
+			std::swap(endpoint[0], endpoint[1]);
+			std::swap(pbit[0], pbit[1]);
+			for (int& i : indices) i = 15 - i;
+		}
+		BlockWriter writer;
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c) {
+			writer.write(endpoint[0][c], 7);
+			writer.write(endpoint[1][c], 7);
+		}
+		writer.write(pbit[0], 1);
+		writer.write(pbit[1], 1);
+		writeIndices(writer, indices);
+		std::memcpy(out, writer.bytes, 16);
+	}
+};
+
+static void encodeBC7Block(float const (*block)[4], unsigned char* out) {
+	float pixels[16][4];
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 4; ++c)
+			pixels[i][c] = std::clamp(block[i][c], 0.f, 1.f) * 255.f;
+
+	float e0[4], e1[4];
+	fitEndpoints<4>(pixels, e0, e1);
+	BC7Mode6 mode = BC7Mode6::quantize(pixels, e0, e1);
+	if (mode.error > 0.f && refineEndpoints<4>(pixels, mode.indices, e0, e1)) {
+		BC7Mode6 refined = BC7Mode6::quantize(pixels, e0, e1);
+		if (refined.error < mode.error) mode = refined;
+	}
+	mode.write(out);
+}
+
+// BC6H mode 11: one region, unsigned 10 bit RGB endpoints, 4 bit indices.
+// Works on the unquantized values u (half = u * 31 / 64) like the decoder.
+struct BC6HMode11 {
+	int endpoint[2][3];
+	int indices[16];
+	float error;
+
+	static int unquantize(int x) {
+		if (x == 0) return 0;
+		if (x == 1023) return 0xFFFF;
+		return (x << 6) + 32;
+	}
+
+	// nearest endpoint for an unquantized value
+	static int quantize(float u) {
+		int x = std::clamp((int)std::floor((u - 32.f) / 64.f), 0, 1022);
+		return std::abs(unquantize(x) - u) <= std::abs(unquantize(x + 1) - u) ? x : x + 1;
+	}
+
+	void assign(float const (*halves)[4]) {
+		float palette[16][3];
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 3; ++c) {
+				int u = (unquantize(endpoint[0][c]) * (64 - BPTC_WEIGHTS4[i]) + unquantize(endpoint[1][c]) * BPTC_WEIGHTS4[i] + 32) >> 6;
+				palette[i][c] = (float)((u * 31) >> 6);
+			}
+		}
+		error = 0.f;
+		for (int p = 0; p < 16; ++p) {
+			float best = INFINITY;
+			for (int i = 0; i < 16; ++i) {
+				float e = 0.f;
+				for (int c = 0; c < 3; ++c) {
+					float d = halves[p][c] - palette[i][c];
+					e += d * d;
+				}
+				if (e < best) {
+					best = e;
+					indices[p] = i;
+				}
+			}
+			error += best;
+		}
+	}
+
+	static BC6HMode11 fromEndpoints(float const (*halves)[4], float const e0[3], float const e1[3]) {
+		BC6HMode11 mode;
+		for (int c = 0; c < 3; ++c) {
+			mode.endpoint[0][c] = quantize(e0[c] * 64.f / 31.f);
+			mode.endpoint[1][c] = quantize(e1[c] * 64.f / 31.f);
+		}
+		mode.assign(halves);
+		return mode;
+	}
+
+	void write(unsigned char* out) {
+		if (indices[0] >= 8) {
+			std::swap(endpoint[0], endpoint[1]);
+			for (int& i : indices) i = 15 - i;
+		}
+		BlockWriter writer;
+		writer.write(0x03, 5);
+		for (int e = 0; e < 2; ++e)
+			for (int c = 0; c < 3; ++c)
+				writer.write(endpoint[e][c], 10);
+		writeIndices(writer, indices);
+		std::memcpy(out, writer.bytes, 16);
+	}
+};
+
+static void encodeBC6HBlock(float const (*block)[4], unsigned char* out) {
+	// fit in the half float bit pattern, which is about logarithmic in the value
+	float halves[16][4];
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 3; ++c) {
+			float v = std::max(block[i][c], 0.f);
+			halves[i][c] = (float)std::min<int>(floatToHalf(v), 0x7BFF);
+		}
+		halves[i][3] = 0.f;
+	}
+
+	float e0[3], e1[3];
+	fitEndpoints<3>(halves, e0, e1);
+	BC6HMode11 mode = BC6HMode11::fromEndpoints(halves, e0, e1);
+	if (mode.error > 0.f && refineEndpoints<3>(halves, mode.indices, e0, e1)) {
+		BC6HMode11 refined = BC6HMode11::fromEndpoints(halves, e0, e1);
+		if (refined.error < mode.error) mode = refined;
+	}
+	mode.write(out);
+}
+
+TextureBaker::TextureBaker(int threads)
+	: filter_(Filter::Kaiser)
+	, compress_(true)
+	, srgb_(false)
+	, mipmaps_(true)
+	, threads_(threads)
+	, bakeTime_(0.0)
+{}
+
+bool TextureBaker::bake(std::string const& source, std::string const& target)
+{
+	Image base;
+	bool hdr;
+	if (!loadImage(source, base, hdr, srgb_)) return false;
+	return bake(base, hdr, target.empty() ? getCachePath(source) : target);
+}
+
+bool TextureBaker::bake(Image const& base, bool hdr, std::string const& target)
+{
+	auto start_time = std::chrono::high_resolution_clock::now();
+
+	std::vector<Image> mips = mipmaps_ ? buildMipChain(base) : std::vector<Image>{ base };
+
+	uint32_t vkFormat;
+	if (hdr)
+		vkFormat = compress_ ? VK_FORMAT_BC6H_UFLOAT_BLOCK : VK_FORMAT_R16G16B16A16_SFLOAT;
+	else if (compress_)
+		vkFormat = srgb_ ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	else
+		vkFormat = srgb_ ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+
+	std::vector<std::vector<unsigned char>> levels;
+	size_t bytes = 0;
+	for (Image& mip : mips) {
+		if (!hdr && srgb_) {
+			for (size_t i = 0; i < mip.pixels.size(); ++i)
+				if (i % 4 != 3) mip.pixels[i] = linearToSrgb(std::clamp(mip.pixels[i], 0.f, 1.f));
+		}
+		if (hdr)
+			levels.push_back(compress_ ? encodeBC6H(mip) : toRGBA16F(mip));
+		else
+			levels.push_back(compress_ ? encodeBC7(mip) : toRGBA8(mip));
+		bytes += levels.back().size();
+	}
+
+	if (!Ktx2::write(target, vkFormat, base.width, base.height, levels)) return false;
+
+	auto end_time = std::chrono::high_resolution_clock::now();
+	bakeTime_ = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+
+	std::cout << "[TextureBaker] " << target << ": " << base.width << "x" << base.height << ", "
+		<< levels.size() << " levels, " << bytes / 1024 << " KB in " << bakeTime_ << "ms" << std::endl;
+	return true;
+}
+
+bool TextureBaker::loadImage(std::string const& path, Image& image, bool& hdr, bool srgb)
+{
+	int components;
+	hdr = stbi_is_hdr(path.c_str());
+	if (hdr) {
+		float* data = stbi_loadf(path.c_str(), &image.width, &image.height, &components, 4);
+		if (!data) {
+			std::cerr << "[TextureBaker] failed to load " << path << std::endl;
+			return false;
+		}
+		image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+		stbi_image_free(data);
+	}
+	else {
+		unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &components, 4);
+		if (!data) {
+			std::cerr << "[TextureBaker] failed to load " << path << std::endl;
+			return false;
+		}
+		float toFloat[256];
+		for (int i = 0; i < 256; ++i)
+			toFloat[i] = srgb ? srgbToLinear(i / 255.f) : i / 255.f;
+		image.pixels.resize((size_t)image.width * image.height * 4);
+		for (size_t i = 0; i < image.pixels.size(); ++i)
+			image.pixels[i] = i % 4 == 3 ? data[i] / 255.f : toFloat[data[i]];
+		stbi_image_free(data);
+	}
+	return true;
+}
+
+std::vector<TextureBaker::Image> TextureBaker::buildMipChain(Image const& base) const
+{
+	std::vector<Image> mips{ base };
+	while (mips.back().width > 1 || mips.back().height > 1) {
+		Image const& prev = mips.back();
+		mips.push_back(downsample(prev, std::max(1, prev.width / 2), std::max(1, prev.height / 2)));
+	}
+	return mips;
+}
+
+std::vector<unsigned char> TextureBaker::encodeBC7(Image const& image) const
+{
+	int blocksX = (image.width + 3) / 4;
+	int blocksY = (image.height + 3) / 4;
+	std::vector<unsigned char> out((size_t)blocksX * blocksY * 16);
+	parallelRows(blocksY, threads_, [&](int by) {
+		float block[16][4];
+		for (int bx = 0; bx < blocksX; ++bx) {
+			loadBlock(image, bx, by, block);
+			encodeBC7Block(block, out.data() + ((size_t)by * blocksX + bx) * 16);
+		}
+	});
+	return out;
+}
+
+std::vector<unsigned char> TextureBaker::encodeBC6H(Image const& image) const
+{
+	int blocksX = (image.width + 3) / 4;
+	int blocksY = (image.height + 3) / 4;
+	std::vector<unsigned char> out((size_t)blocksX * blocksY * 16);
+	parallelRows(blocksY, threads_, [&](int by) {
+		float block[16][4];
+		for (int bx = 0; bx < blocksX; ++bx) {
+			loadBlock(image, bx, by, block);
+			encodeBC6HBlock(block, out.data() + ((size_t)by * blocksX + bx) * 16);
+		}
+	});
+	return out;
+}
+
+std::vector<unsigned char> TextureBaker::toRGBA8(Image const& image)
+{
+	std::vector<unsigned char> out(image.pixels.size());
+	for (size_t i = 0; i < out.size(); ++i)
+		out[i] = (unsigned char)(std::clamp(image.pixels[i], 0.f, 1.f) * 255.f + 0.5f);
+	return out;
+}
+
+std::vector<unsigned char> TextureBaker::toRGBA16F(Image const& image)
+{
+	std::vector<unsigned char> out(image.pixels.size() * 2);
+	for (size_t i = 0; i < image.pixels.size(); ++i) {
+		uint16_t half = floatToHalf(image.pixels[i]);
+		std::memcpy(out.data() + i * 2, &half, 2);
+	}
+	return out;
+}
+
+TextureBaker::Weights TextureBaker::filterWeights(int srcSize, int dstSize) const
+{
+	Weights w;
+	float scale = (float)srcSize / dstSize;
+	// support in source pixels
+	float radius = filter_ == Filter::Box ? scale * 0.5f : KAISER_WIDTH * scale;
+	w.maxTaps = (int)std::ceil(radius * 2.f) + 2;
+	w.first.resize(dstSize);
+	w.count.resize(dstSize);
+	w.weights.assign((size_t)dstSize * w.maxTaps, 0.f);
+
+	for (int i = 0; i < dstSize; ++i) {
+		float center = (i + 0.5f) * scale;
+		int first = std::max(0, (int)std::floor(center - radius));
+		int last = std::min(srcSize - 1, (int)std::ceil(center + radius));
+		float* weights = w.weights.data() + (size_t)i * w.maxTaps;
+
+		float sum = 0.f;
+		int count = std::min(last - first + 1, w.maxTaps);
+		for (int k = 0; k < count; ++k) {
+			int j = first + k;
+			float weight;
+			if (filter_ == Filter::Box) {
+				// coverage of the source pixel by the destination pixel
+				weight = std::max(0.f, std::min(j + 1.f, center + radius) - std::max((float)j, center - radius));
+			}
+			else {
+				weight = kaiser((j + 0.5f - center) / scale);
+			}
+			weights[k] = weight;
+			sum += weight;
+		}
+		// pixels outside of the image are left out
+		for (int k = 0; k < count; ++k) weights[k] /= sum;
+		w.first[i] = first;
+		w.count[i] = count;
+	}
+	return w;
+}
+
+TextureBaker::Image TextureBaker::downsample(Image const& src, int width, int height) const
+{
+	Weights wx = filterWeights(src.width, width);
+	Weights wy = filterWeights(src.height, height);
+
+	// horizontal pass
+	Image tmp;
+	tmp.width = width;
+	tmp.height = src.height;
+	tmp.pixels.assign((size_t)width * src.height * 4, 0.f);
+	parallelRows(src.height, threads_, [&](int y) {
+		float const* in = src.row(y);
+		float* out = tmp.row(y);
+		for (int x = 0; x < width; ++x) {
+			float const* weights = wx.weights.data() + (size_t)x * wx.maxTaps;
+			float const* p = in + wx.first[x] * 4;
+			float sum[4] = {};
+			for (int k = 0; k < wx.count[x]; ++k, p += 4)
+				for (int c = 0; c < 4; ++c) sum[c] += weights[k] * p[c];
+			std::copy(sum, sum + 4, out + x * 4);
+		}
+	});
+
+	// vertical pass, negative lobes of the Kaiser filter are clamped
+	Image dst;
+	dst.width = width;
+	dst.height = height;
+	dst.pixels.assign((size_t)width * height * 4, 0.f);
+	parallelRows(height, threads_, [&](int y) {
+		float const* weights = wy.weights.data() + (size_t)y * wy.maxTaps;
+		float* out = dst.row(y);
+		for (int k = 0; k < wy.count[y]; ++k) {
+			float const* in = tmp.row(wy.first[y] + k);
+			for (int i = 0; i < width * 4; ++i) out[i] += weights[k] * in[i];
+		}
+		for (int i = 0; i < width * 4; ++i) out[i] = std::max(out[i], 0.f);
+	});
+	return dst;
+}
+
@@ -0,0 +1,508 @@
+#include <rendering/textureLoader.h>
+#include <rendering/ktx2.h>
+#include <rendering/panoramaConverter.h>
+#include <rendering/textureBaker.h>
+#include <helpers/mappedFile.h>
+#include <helpers/RootDir.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+PBOTextureUploader::PBOTextureUploader(size_t stagingSize)
+	: pbo_(0)
+	, mapped_(nullptr)
+	, size_(stagingSize)
+	, head_(0)
+{
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &pbo_);
+	glNamedBufferStorage(pbo_, size_, nullptr, flags);
+	mapped_ = (unsigned char*)glMapNamedBufferRange(pbo_, 0, size_, flags);
+	if (!mapped_) {
+		std::cerr << "[TextureLoader] could not map the staging buffer, uploading directly" << std::endl;
+		size_ = 0;
+	}
+}
+
+PBOTextureUploader::~PBOTextureUploader()
+{
+	for (auto const& transfer : transfers_)
+		glDeleteSync(transfer.fence);
+	if (mapped_)
+		glUnmapNamedBuffer(pbo_);
+	glDeleteBuffers(1, &pbo_);
+}
+
+std::shared_ptr<Texture2D> PBOTextureUploader::createPlaceholder(GLenum target)
+{
+	// one grey texel
+	unsigned char grey[4] = { 128, 128, 128, 255 };
+	TextureParams params;
+	params.width = 1;
+	params.height = 1;
+	params.nrComponents = 4;
+	params.internalFormat = GL_RGBA;
+	params.format = GL_RGBA;
+	params.data = grey;
+
+	// same parameters as the synchronous constructors
+	std::vector<std::pair<GLenum, GLint>> texParameters{
+		{GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE},
+		{GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE},
+		{GL_TEXTURE_MIN_FILTER, GL_LINEAR},
+		{GL_TEXTURE_MAG_FILTER, GL_LINEAR}
+	};
+
+	std::shared_ptr<Texture2D> texture;
+	if (target == GL_TEXTURE_CUBE_MAP) {
+		texture = std::make_shared<CubeMap>(1, 1);
+		for (int face = 0; face < 6; ++face) {
+			params.target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+			texture->setImage(params);
+		}
+		texParameters.push_back({ GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE });
+	}
+	else {
+		texture = std::make_shared<Texture2D>(params);
+	}
+	texture->setParam(texParameters);
+	return texture;
+}
+
+bool PBOTextureUploader::upload(Texture2D* texture, GLenum target, DecodedImage const& image, bool srgb)
+{
+	if (!texture) return true;
+	if (!image.levels.empty()) return uploadLevels(texture, target, image, srgb);
+
+	// same formats as Texture::setTextureFormat
+	TextureParams params;
+	params.target = target;
+	params.width = image.width;
+	params.height = image.height;
+	params.nrComponents = image.components;
+	if (image.components == 2) {
+		params.internalFormat = GL_RG;
+		params.format = GL_RG;
+	}
+	else if (image.components == 3) {
+		params.internalFormat = srgb ? GL_SRGB : GL_RGB;
+		params.format = GL_RGB;
+	}
+	else if (image.components == 4) {
+		params.internalFormat = srgb ? GL_SRGB_ALPHA : GL_RGBA;
+		params.format = GL_RGBA;
+	}
+
+	size_t bytes = image.size();
+	// rows of rgb images are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (bytes > size_) {
+		// doesn't fit into the staging buffer
+		params.data = image.pixels.get();
+		texture->setImage(params);
+	}
+	else {
+		size_t offset;
+		if (!allocate(bytes, offset)) {
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			return false;
+		}
+		std::memcpy(mapped_ + offset, image.pixels.get(), bytes);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+		params.data = (void*)offset;
+		texture->setImage(params);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		transfers_.push_back({ offset, bytes, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	return true;
+}
+
+bool PBOTextureUploader::uploadLevels(Texture2D* texture, GLenum target, DecodedImage const& image, bool srgb)
+{
+	Ktx2::GLFormat format;
+	if (!Ktx2::getGLFormat(image.vkFormat, srgb, format)) {
+		std::cerr << "[TextureLoader] unsupported format of " << image.path << std::endl;
+		return true;
+	}
+
+	// all levels go into one region of the staging buffer, one after the other
+	size_t bytes = image.size();
+	size_t offset = 0;
+	bool staged = bytes <= size_;
+	if (staged) {
+		if (!allocate(bytes, offset)) return false;
+		size_t pos = offset;
+		for (auto const& level : image.levels) {
+			std::memcpy(mapped_ + pos, image.pixels.get() + level.offset, level.size);
+			pos += level.size;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	size_t pos = offset;
+	for (int i = 0; i < image.levels.size(); ++i) {
+		auto const& level = image.levels.at(i);
+		TextureParams params;
+		params.target = target;
+		params.level = i;
+		params.internalFormat = format.internalFormat;
+		params.width = level.width;
+		params.height = level.height;
+		params.format = format.format;
+		params.type = format.type;
+		params.data = staged ? (void*)pos : image.pixels.get() + level.offset;
+		if (format.compressed)
+			texture->setCompressedImage(params, (GLsizei)level.size);
+		else
+			texture->setImage(params);
+		pos += level.size;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (staged) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		transfers_.push_back({ offset, bytes, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+	}
+	return true;
+}
+
+void PBOTextureUploader::finish(Texture2D* texture, bool mipmaps)
+{
+	if (texture && mipmaps)
+		texture->generateMipMap();
+}
+
+void PBOTextureUploader::beginUpdate()
+{
+	// release the regions of finished transfers
+	while (!transfers_.empty()) {
+		GLenum status = glClientWaitSync(transfers_.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		glDeleteSync(transfers_.front().fence);
+		transfers_.pop_front();
+	}
+}
+
+bool PBOTextureUploader::allocate(size_t size, size_t& offset)
+{
+	size = (size + 15) & ~size_t(15);
+	if (transfers_.empty()) {
+		head_ = 0;
+	}
+	else {
+		// start of the oldest transfer, free space is [head_, tail) or [head_, end) and [0, tail)
+		size_t tail = transfers_.front().offset;
+		if (head_ > tail && head_ + size > size_) {
+			// wrap around
+			if (size >= tail) return false;
+			offset = 0;
+			head_ = size;
+			return true;
+		}
+		if (head_ < tail && head_ + size >= tail) return false;
+	}
+	if (head_ + size > size_) return false;
+	offset = head_;
+	head_ += size;
+	return true;
+}
+
+TextureLoader::TextureLoader(std::shared_ptr<TextureUploader> uploader, int threads, Decoder decoder)
+	: uploadBudget_(32 << 20)
+	, uploader_(uploader ? uploader : std::make_shared<PBOTextureUploader>())
+	, decoder_(decoder ? decoder : decodeFile)
+	, jobs_(std::make_shared<JobSystem>(threads))
+{
+}
+
+TextureLoader::TextureLoader(std::shared_ptr<JobSystem> jobs, std::shared_ptr<TextureUploader> uploader, Decoder decoder)
+	: uploadBudget_(32 << 20)
+	, uploader_(uploader ? uploader : std::make_shared<PBOTextureUploader>())
+	, decoder_(decoder ? decoder : decodeFile)
+	, jobs_(jobs ? jobs : std::make_shared<JobSystem>())
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	token_.cancel();
+	for (auto const& handle : handles_)
+		handle.wait();
+
+	for (auto const& request : requests_)
+		request->promise.set_value(false);
+}
+
+TextureHandle<Texture2D> TextureLoader::load(std::string const& filename, bool srgb, bool mipmaps,
+	std::function<void()> onReady)
+{
+	auto request = std::make_shared<Request>();
+	request->texture = uploader_->createPlaceholder(GL_TEXTURE_2D);
+	request->target = GL_TEXTURE_2D;
+	request->srgb = srgb;
+	request->mipmaps = mipmaps;
+	request->paths = { TEX_DIR"" + filename };
+	request->onReady = onReady;
+
+	TextureHandle<Texture2D> handle{ request->texture, request->promise.get_future().share() };
+	submit(request);
+	return handle;
+}
+
+TextureHandle<CubeMap> TextureLoader::loadCubeMap(std::vector<std::string> const& faces, bool mipmaps,
+	std::function<void()> onReady)
+{
+	if (faces.size() != 6) {
+		std::cerr << "[TextureLoader] Invalid number of cube map textures!" << std::endl;
+	}
+
+	auto request = std::make_shared<Request>();
+	request->texture = uploader_->createPlaceholder(GL_TEXTURE_CUBE_MAP);
+	request->target = GL_TEXTURE_CUBE_MAP;
+	request->srgb = false;
+	request->mipmaps = mipmaps;
+	for (auto const& face : faces)
+		request->paths.push_back(TEX_DIR"" + face);
+	request->onReady = onReady;
+
+	TextureHandle<CubeMap> handle{ std::dynamic_pointer_cast<CubeMap>(request->texture), request->promise.get_future().share() };
+	submit(request);
+	return handle;
+}
+
+TextureHandle<CubeMap> TextureLoader::loadPanorama(std::string const& filename, int faceSize, bool mipmaps,
+	std::function<void()> onReady)
+{
+	auto request = std::make_shared<Request>();
+	request->texture = uploader_->createPlaceholder(GL_TEXTURE_CUBE_MAP);
+	request->target = GL_TEXTURE_CUBE_MAP;
+	request->srgb = false;
+	request->mipmaps = mipmaps;
+	std::string path = TEX_DIR"" + filename;
+	for (int face = 0; face < 6; ++face)
+		request->paths.push_back(PanoramaConverter::getCachePath(path, faceSize, face));
+	request->onReady = onReady;
+	request->decodeAll = [path, faceSize](std::vector<DecodedImage>& faces) {
+		return decodePanorama(path, faceSize, faces);
+	};
+
+	TextureHandle<CubeMap> handle{ std::dynamic_pointer_cast<CubeMap>(request->texture), request->promise.get_future().share() };
+	submit(request);
+	return handle;
+}
+
+void TextureLoader::update()
+{
+	handles_.erase(std::remove_if(handles_.begin(), handles_.end(),
+		[](JobHandle const& handle) { return handle.isDone(); }), handles_.end());
+	uploader_->beginUpdate();
+
+	size_t budget = uploadBudget_;
+	while (!requests_.empty()) {
+		Request& request = *requests_.front();
+		if (!uploadRequest(request, budget)) break;
+
+		bool success;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			success = std::find(request.failed.begin(), request.failed.end(), true) == request.failed.end();
+		}
+		if (success) {
+			// baked textures bring their mip levels
+			bool mipChain = std::all_of(request.images.begin(), request.images.end(),
+				[](DecodedImage const& image) { return image.levels.size() > 1; });
+			uploader_->finish(request.texture.get(), request.mipmaps && !mipChain);
+		}
+		request.promise.set_value(success);
+		if (success && request.onReady)
+			request.onReady();
+
+		requests_.pop_front();
+	}
+}
+
+void TextureLoader::finish()
+{
+	size_t budget = uploadBudget_;
+	uploadBudget_ = SIZE_MAX;
+	while (true) {
+		update();
+		if (requests_.empty()) break;
+		// woken up by the next decoded image, the timeout polls for free staging memory
+		std::unique_lock<std::mutex> lock(mutex_);
+		imageDecoded_.wait_for(lock, std::chrono::milliseconds(1));
+	}
+	uploadBudget_ = budget;
+}
+
+size_t TextureLoader::getPendingCount() const
+{
+	return requests_.size();
+}
+
+bool TextureLoader::decodeFile(std::string const& path, DecodedImage& image)
+{
+	// the baked texture is used while it is newer than the file, or if there is no file
+	std::string bakedPath = TextureBaker::getCachePath(path);
+	std::error_code ec, bakedEc;
+	auto bakedTime = std::filesystem::last_write_time(bakedPath, bakedEc);
+	if (!bakedEc) {
+		auto fileTime = std::filesystem::last_write_time(path, ec);
+		if ((ec || bakedTime >= fileTime) && decodeBaked(bakedPath, image))
+			return true;
+	}
+
+	int width, height, components;
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &components, 0);
+	if (!data) return false;
+
+	image.path = path;
+	image.width = width;
+	image.height = height;
+	image.components = components;
+	image.pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+	return true;
+}
+
+bool TextureLoader::decodeBaked(std::string const& path, DecodedImage& image)
+{
+	auto file = std::make_shared<MappedFile>(path);
+	Ktx2 ktx;
+	if (!file->isOpen() || !ktx.parse(file->data(), file->size())) {
+		std::cerr << "[TextureLoader] invalid baked texture " << path << std::endl;
+		return false;
+	}
+	file->prefetch();
+
+	image.path = path;
+	image.width = ktx.width;
+	image.height = ktx.height;
+	image.components = 4;
+	image.vkFormat = ktx.vkFormat;
+	image.levels.clear();
+	for (auto const& level : ktx.levels)
+		image.levels.push_back({ level.width, level.height, level.offset, level.size });
+	// the file stays mapped as long as the pixels are used
+	image.pixels = std::shared_ptr<unsigned char>(file, const_cast<unsigned char*>(file->data()));
+	return true;
+}
+
+bool TextureLoader::decodePanorama(std::string const& path, int faceSize, std::vector<DecodedImage>& faces)
+{
+	std::error_code ec, bakedEc;
+	auto fileTime = std::filesystem::last_write_time(path, ec);
+	bool baked = true;
+	for (int face = 0; face < 6; ++face) {
+		auto bakedTime = std::filesystem::last_write_time(PanoramaConverter::getCachePath(path, faceSize, face), bakedEc);
+		baked = baked && !bakedEc && (ec || bakedTime >= fileTime);
+	}
+
+	if (!baked) {
+		PanoramaConverter converter;
+		TextureBaker baker;
+		if (!converter.bake(path, faceSize, baker)) return false;
+	}
+
+	faces.resize(6);
+	for (int face = 0; face < 6; ++face) {
+		if (!decodeBaked(PanoramaConverter::getCachePath(path, faceSize, face), faces[face]))
+			return false;
+	}
+	return true;
+}
+
+void TextureLoader::submit(std::shared_ptr<Request> const& request)
+{
+	size_t count = request->paths.size();
+	request->images.resize(count);
+	request->decoded.assign(count, false);
+	request->failed.assign(count, false);
+	requests_.push_back(request);
+
+	// the images are needed for the next frames
+	size_t jobCount = request->decodeAll ? 1 : count;
+	for (size_t i = 0; i < jobCount; ++i) {
+		DecodeJob job{ request, i };
+		handles_.push_back(jobs_->submit([this, job](CancellationToken const&) { decode(job); },
+			JobPriority::HIGH, token_));
+	}
+}
+
+void TextureLoader::decode(DecodeJob const& job)
+{
+	if (job.request->decodeAll) {
+		std::vector<DecodedImage> images(job.request->paths.size());
+		bool ok = job.request->decodeAll(images) && images.size() == job.request->paths.size();
+		if (!ok)
+			std::cerr << "[TextureLoader] Texture failed to load: " << job.request->paths.front() << std::endl;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (ok) job.request->images = std::move(images);
+			job.request->failed.assign(job.request->paths.size(), !ok);
+			job.request->decoded.assign(job.request->paths.size(), true);
+		}
+		imageDecoded_.notify_all();
+		return;
+	}
+
+	std::string const& path = job.request->paths.at(job.image);
+	DecodedImage image;
+	bool ok = decoder_(path, image);
+	if (!ok)
+		std::cerr << "[TextureLoader] Texture failed to load: " << path << std::endl;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job.request->images[job.image] = std::move(image);
+		job.request->failed[job.image] = !ok;
+		job.request->decoded[job.image] = true;
+	}
+	imageDecoded_.notify_all();
+}
+
+bool TextureLoader::uploadRequest(Request& request, size_t& budget)
+{
+	// start a request only when all images are decoded, so cube maps don't show mixed faces
+	if (request.uploaded == 0) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (std::find(request.decoded.begin(), request.decoded.end(), false) != request.decoded.end())
+			return false;
+		if (budget == 0)
+			return false;
+	}
+
+	while (request.uploaded < request.paths.size()) {
+		size_t i = request.uploaded;
+		DecodedImage& image = request.images[i];
+		bool failed;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			failed = request.failed[i];
+		}
+
+		if (!failed) {
+			// mip levels of baked textures are only uploaded if they are used
+			if (!request.mipmaps && image.levels.size() > 1)
+				image.levels.resize(1);
+			GLenum target = request.target == GL_TEXTURE_CUBE_MAP
+				? GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)i
+				: request.target;
+			if (!uploader_->upload(request.texture.get(), target, image, request.srgb))
+				return false;
+			budget -= std::min(budget, image.size());
+		}
+
+		image.pixels.reset();
+		request.uploaded++;
+	}
+	return true;
+}
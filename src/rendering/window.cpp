@@ -29,7 +29,15 @@ bool GLWindow::shouldClose() {
 }
 
 void GLWindow::endFrame() {
+	pollEvents();
+	swapBuffers();
+}
+
+void GLWindow::pollEvents() {
 	glfwPollEvents();
+}
+
+void GLWindow::swapBuffers() {
 	glfwSwapBuffers(windowPtr_);
 }
 